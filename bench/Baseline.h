@@ -0,0 +1,171 @@
+#ifndef BASELINE_H
+#define BASELINE_H
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace mysn
+{
+    // 一个基准程序多次运行的结果，指令数和周期数每次都一样，只有耗时不同
+    struct WorkloadSamples
+    {
+        std::string name;
+        std::uint64_t instructions;
+        std::uint64_t cycles;
+        // 每次运行的 MIPS
+        std::vector<double> mips;
+    };
+
+    inline double median(std::vector<double> values)
+    {
+        if (values.empty())
+        {
+            return 0;
+        }
+
+        std::sort(values.begin(), values.end());
+        std::size_t middle = values.size() / 2;
+
+        return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+    }
+
+    /// Mann-Whitney U 检验的单侧 p 值：current 整体比 baseline 小的显著性。
+    /// 不假设正态分布，偶尔被打断的几次慢运行只影响秩，不会拉偏结果。
+    /// 用带连续性校正的正态近似，每边 5 次以上就够用
+    inline double slower_p_value(const std::vector<double> &current, const std::vector<double> &baseline)
+    {
+        if (current.empty() || baseline.empty())
+        {
+            return 1;
+        }
+
+        double u = 0;
+        for (double c : current)
+        {
+            for (double b : baseline)
+            {
+                u += c < b ? 1 : c == b ? 0.5 : 0;
+            }
+        }
+
+        double n1 = double(current.size());
+        double n2 = double(baseline.size());
+        double mean = n1 * n2 / 2;
+        double sd = std::sqrt(n1 * n2 * (n1 + n2 + 1) / 12);
+        double z = (u - mean - 0.5) / sd;
+
+        return 0.5 * std::erfc(z / std::sqrt(2.0));
+    }
+
+    // {"version": 1, "workloads": [{"name": "alu_loop", "instructions": 1, "cycles": 2, "mips": [3.5, 3.6]}]}
+    inline bool save_baseline(const std::string &path, const std::vector<WorkloadSamples> &workloads)
+    {
+        std::ofstream out(path.c_str());
+
+        out << "{\n  \"version\": 1,\n  \"workloads\": [";
+        for (std::size_t i = 0; i < workloads.size(); ++i)
+        {
+            const WorkloadSamples &workload = workloads[i];
+
+            out << (i ? ",\n" : "\n") << "    {\"name\": \"" << workload.name << "\", \"instructions\": "
+                << workload.instructions << ", \"cycles\": " << workload.cycles << ", \"mips\": [";
+            for (std::size_t k = 0; k < workload.mips.size(); ++k)
+            {
+                out << (k ? ", " : "") << std::setprecision(9) << workload.mips[k];
+            }
+            out << "]}";
+        }
+        out << "\n  ]\n}\n";
+        out.close();
+
+        return bool(out);
+    }
+
+    namespace baseline_detail
+    {
+        // text 里 from 之后第一个 "key": 的值的起始位置
+        inline std::size_t value_of(const std::string &text, const char *key, std::size_t from)
+        {
+            std::size_t pos = text.find(std::string("\"") + key + "\"", from);
+
+            if (pos == std::string::npos || (pos = text.find(':', pos)) == std::string::npos)
+            {
+                return std::string::npos;
+            }
+
+            ++pos;
+            while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos])))
+            {
+                ++pos;
+            }
+
+            return pos;
+        }
+    }
+
+    // 只读 save_baseline 写出的格式，按对象顺序取 name、instructions、cycles、mips
+    inline bool load_baseline(const std::string &path, std::vector<WorkloadSamples> &workloads)
+    {
+        using baseline_detail::value_of;
+
+        std::ifstream in(path.c_str());
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        std::string text = buffer.str();
+
+        if (!in || value_of(text, "version", 0) == std::string::npos || std::atoi(text.c_str() + value_of(text, "version", 0)) != 1)
+        {
+            return false;
+        }
+
+        std::vector<WorkloadSamples> loaded;
+        std::size_t pos = value_of(text, "workloads", 0);
+
+        while (pos != std::string::npos && (pos = value_of(text, "name", pos)) != std::string::npos)
+        {
+            WorkloadSamples workload;
+            std::size_t end = text.find('"', pos + 1);
+            std::size_t instructions = value_of(text, "instructions", pos);
+            std::size_t cycles = value_of(text, "cycles", pos);
+            std::size_t mips = value_of(text, "mips", pos);
+
+            if (text[pos] != '"' || end == std::string::npos || instructions == std::string::npos ||
+                cycles == std::string::npos || mips == std::string::npos || text[mips] != '[')
+            {
+                return false;
+            }
+
+            workload.name = text.substr(pos + 1, end - pos - 1);
+            workload.instructions = std::strtoull(text.c_str() + instructions, nullptr, 10);
+            workload.cycles = std::strtoull(text.c_str() + cycles, nullptr, 10);
+
+            const char *p = text.c_str() + mips + 1;
+            char *next = nullptr;
+            for (double value = std::strtod(p, &next); next != p; value = std::strtod(p, &next))
+            {
+                workload.mips.push_back(value);
+                p = next;
+                while (*p == ',' || std::isspace(static_cast<unsigned char>(*p)))
+                {
+                    ++p;
+                }
+            }
+
+            loaded.push_back(workload);
+            pos = std::size_t(p - text.c_str());
+        }
+
+        workloads.swap(loaded);
+        return true;
+    }
+}
+
+#endif // BASELINE_H
@@ -0,0 +1,65 @@
+#ifndef HOSTCOUNTERS_H
+#define HOSTCOUNTERS_H
+
+#include "PerfCounters.h"
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+
+namespace mysn
+{
+    // --counters 时表格右边多出的几列
+    inline void print_counter_header(std::ostream &out)
+    {
+        out << std::setw(8) << "IPC" << std::setw(10) << "brmiss/i" << std::setw(10) << "L1dmiss/i"
+            << std::setw(10) << "LLCmiss/i";
+    }
+
+    // 宿主机 IPC 和每条模拟指令的分支预测失败、缓存未命中，拿不到的列打 "-"
+    inline void print_counters(std::ostream &out, const PerfSample &sample, std::uint64_t emulated)
+    {
+        double ipc = sample.ipc();
+        const PerfCounter per_instruction[] = {Perf_Branch_Misses, Perf_L1d_Misses, Perf_LLC_Misses};
+
+        out << std::fixed << std::setprecision(2) << std::setw(8);
+        if (ipc < 0)
+        {
+            out << "-";
+        }
+        else
+        {
+            out << ipc;
+        }
+
+        out << std::setprecision(4);
+        for (PerfCounter counter : per_instruction)
+        {
+            double value = sample.per_instruction(counter, emulated);
+
+            out << std::setw(10);
+            if (value < 0)
+            {
+                out << "-";
+            }
+            else
+            {
+                out << value;
+            }
+        }
+    }
+
+    // 打不开时说明一次原因，表格照常输出，计数列都是 "-"
+    inline void report_counters(const PerfCounters &counters)
+    {
+        if (!counters.available())
+        {
+            std::cerr << "warning: hardware counters unavailable: " << counters.error() << "\n";
+        }
+        else if (!counters.error().empty())
+        {
+            std::cerr << "warning: some hardware counters unavailable: " << counters.error() << "\n";
+        }
+    }
+}
+
+#endif // HOSTCOUNTERS_H
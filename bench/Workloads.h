@@ -0,0 +1,70 @@
+#ifndef WORKLOADS_H
+#define WORKLOADS_H
+
+#include "CPU.h"
+#include <string>
+#include <vector>
+
+namespace mysn
+{
+    // 基准程序，都从 $8000 开始执行，以 BRK 结束
+    struct Workload
+    {
+        std::string name;
+        std::vector<Byte> program;
+    };
+
+    inline std::vector<Workload> benchmark_workloads()
+    {
+        std::vector<Workload> workloads;
+
+        // 256 x 256 次 CLC/ADC #/EOR zp/STA zp，算术与零页
+        workloads.push_back({"alu_loop", {
+            0xa2, 0x00,       // LDX #$00
+            0xa0, 0x00,       // outer: LDY #$00
+            0x18,             // inner: CLC
+            0x69, 0x03,       // ADC #$03
+            0x45, 0x10,       // EOR $10
+            0x85, 0x10,       // STA $10
+            0xc8,             // INY
+            0xd0, 0xf6,       // BNE inner
+            0xe8,             // INX
+            0xd0, 0xf1,       // BNE outer
+            0x00,             // BRK
+        }});
+
+        // 把 $0200 页复制到 $0300，重复 256 次，绝对变址读写
+        workloads.push_back({"page_copy", {
+            0xa0, 0x00,       // LDY #$00
+            0xa2, 0x00,       // outer: LDX #$00
+            0xbd, 0x00, 0x02, // inner: LDA $0200,X
+            0x9d, 0x00, 0x03, // STA $0300,X
+            0xe8,             // INX
+            0xd0, 0xf7,       // BNE inner
+            0xc8,             // INY
+            0xd0, 0xf2,       // BNE outer
+            0x00,             // BRK
+        }});
+
+        // ($10),Y 指向 $0280，Y >= $80 时跨页；ADC $0400,X 不跨页
+        workloads.push_back({"indirect_page_cross", {
+            0xa9, 0x80,       // LDA #$80
+            0x85, 0x10,       // STA $10
+            0xa9, 0x02,       // LDA #$02
+            0x85, 0x11,       // STA $11
+            0xa2, 0x00,       // LDX #$00
+            0xa0, 0x00,       // outer: LDY #$00
+            0xb1, 0x10,       // inner: LDA ($10),Y
+            0x7d, 0x00, 0x04, // ADC $0400,X
+            0xc8,             // INY
+            0xd0, 0xf8,       // BNE inner
+            0xe8,             // INX
+            0xd0, 0xf3,       // BNE outer
+            0x00,             // BRK
+        }});
+
+        return workloads;
+    }
+}
+
+#endif // WORKLOADS_H
@@ -0,0 +1,229 @@
+#include "BatchCPU.h"
+#include "CPU.h"
+#include "CPURun.h"
+#include "HostCounters.h"
+#include "InstancePool.h"
+#include "Workloads.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace
+{
+    // 标量 CPU 没有指令计数，用一个只做加法的策略统计
+    struct InstructionCounter
+    {
+        uint64_t count;
+
+        void before_instruction(mysn::CPU &, mysn::Byte) {}
+
+        void after_instruction(mysn::CPU &, mysn::Byte, bool)
+        {
+            ++count;
+        }
+    };
+
+    struct Result
+    {
+        double seconds;
+        uint64_t instructions;
+        double lanes_per_issue;
+        // 没开 --counters 时全部无效
+        mysn::PerfSample host;
+    };
+
+    void start(mysn::PerfCounters *counters)
+    {
+        if (counters != nullptr)
+        {
+            counters->start();
+        }
+    }
+
+    mysn::PerfSample stop(mysn::PerfCounters *counters)
+    {
+        return counters != nullptr ? counters->stop() : mysn::PerfSample();
+    }
+
+    // 实例 i 的 $00 写入 inputs(i)，所有实例输入相同时完全锁步
+    template <typename Input>
+    Result run_scalar(const mysn::Workload &workload, size_t count, Input inputs, mysn::PerfCounters *counters)
+    {
+        vector<mysn::CPU> cpus(count);
+        InstructionCounter counter = {0};
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            vector<mysn::Byte> program = workload.program;
+            // 和 InstancePool 一样只留少量指令记录，默认的 32KB 一份会把上千个实例挤出缓存
+            cpus[i].flight_recorder.set_capacity(mysn::InstancePool::RECORDER_CAPACITY);
+            cpus[i].load_and_reset(program);
+            cpus[i].mem_write(0x00, inputs(i));
+        }
+
+        start(counters);
+        auto begin = chrono::steady_clock::now();
+        for (mysn::CPU &cpu : cpus)
+        {
+            cpu.run_with(counter);
+        }
+        auto end = chrono::steady_clock::now();
+        mysn::PerfSample host = stop(counters);
+
+        Result result = {chrono::duration<double>(end - begin).count(), counter.count, 1.0, host};
+        return result;
+    }
+
+    template <typename Input>
+    Result run_batch(const mysn::Workload &workload, size_t count, Input inputs, mysn::PerfCounters *counters)
+    {
+        mysn::BatchCPU batch(count);
+        batch.load_and_reset(workload.program);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            batch.poke(i, 0x00, inputs(i));
+        }
+
+        start(counters);
+        auto begin = chrono::steady_clock::now();
+        batch.run();
+        auto end = chrono::steady_clock::now();
+        mysn::PerfSample host = stop(counters);
+
+        Result result = {chrono::duration<double>(end - begin).count(), batch.instructions(),
+                         double(batch.instructions()) / double(batch.issues()), host};
+        return result;
+    }
+
+    void print_row(const string &name, const char *variant, const Result &result, double baseline,
+                   bool counters)
+    {
+        double mips = result.instructions / result.seconds / 1e6;
+
+        cout << left << setw(22) << name << setw(8) << variant << right
+             << setw(14) << result.instructions
+             << setw(12) << fixed << setprecision(3) << result.seconds * 1e3
+             << setw(12) << setprecision(1) << mips
+             << setw(10) << setprecision(1) << result.lanes_per_issue;
+
+        if (baseline > 0)
+        {
+            cout << setw(9) << setprecision(2) << baseline / result.seconds << "x";
+        }
+        else if (counters)
+        {
+            cout << setw(10) << "";
+        }
+
+        if (counters)
+        {
+            mysn::print_counters(cout, result.host, result.instructions);
+        }
+
+        cout << "\n";
+    }
+
+    void usage()
+    {
+        cerr << "usage: batch_bench [--instances N] [--filter NAME] [--counters]\n"
+             << "  --counters  用 perf_event_open 读宿主机 IPC、分支预测失败和缓存未命中\n";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t count = 1024;
+    string filter;
+    bool use_counters = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc)
+        {
+            count = size_t(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else if (strcmp(argv[i], "--counters") == 0)
+        {
+            use_counters = true;
+        }
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    if (count < 1)
+    {
+        count = 1;
+    }
+
+#ifndef NDEBUG
+    cerr << "warning: 未开优化编译，数字没有参考价值；请用 -DCMAKE_BUILD_TYPE=Release 配置\n";
+#endif
+
+    vector<mysn::Workload> workloads = mysn::benchmark_workloads();
+
+    // 内层循环次数取自 $00，每个实例不同，PC 很快分开
+    workloads.push_back({"divergent_loop", {
+        0xa0, 0x00,       // LDY #$00
+        0xa6, 0x00,       // outer: LDX $00
+        0xca,             // inner: DEX
+        0xd0, 0xfd,       // BNE inner
+        0xc8,             // INY
+        0xd0, 0xf8,       // BNE outer
+        0x00,             // BRK
+    }});
+
+    mysn::PerfCounters perf;
+    mysn::PerfCounters *counters = use_counters ? &perf : nullptr;
+    if (use_counters)
+    {
+        mysn::report_counters(perf);
+    }
+
+    cout << count << " instances, " << mysn::BatchCPU::LANES << " lanes per group\n";
+    cout << left << setw(22) << "workload" << setw(8) << "core" << right
+         << setw(14) << "instructions" << setw(12) << "ms" << setw(12) << "MIPS"
+         << setw(10) << "lanes" << setw(10) << "speedup";
+    if (use_counters)
+    {
+        mysn::print_counter_header(cout);
+    }
+    cout << "\n";
+
+    for (const mysn::Workload &workload : workloads)
+    {
+        if (!filter.empty() && workload.name.find(filter) == string::npos)
+        {
+            continue;
+        }
+
+        bool divergent = workload.name == "divergent_loop";
+        auto inputs = [divergent](size_t i) { return mysn::Byte(divergent ? 1 + i % 61 : 0); };
+
+        Result scalar = run_scalar(workload, count, inputs, counters);
+        print_row(workload.name, "scalar", scalar, 0, use_counters);
+
+        Result batch = run_batch(workload, count, inputs, counters);
+        print_row(workload.name, "batch", batch, scalar.seconds, use_counters);
+
+        if (batch.instructions != scalar.instructions)
+        {
+            cerr << workload.name << ": instruction count mismatch\n";
+            return 1;
+        }
+    }
+
+    return 0;
+}
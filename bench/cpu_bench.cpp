@@ -0,0 +1,391 @@
+#include "Baseline.h"
+#include "CPU.h"
+#include "CPURun.h"
+#include "HostCounters.h"
+#include "OpcodeProfiler.h"
+#include "Workloads.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace
+{
+    struct Timing
+    {
+        double seconds;
+        uint64_t cycles;
+        // counters 不为空时，最快那次的宿主机计数
+        mysn::PerfSample host;
+    };
+
+    // 取 repeat 次中最快的一次，CPU 的构造不计入；counters 只包住 runner
+    template <typename Runner>
+    Timing measure(const mysn::Workload &workload, int repeat, mysn::PerfCounters *counters, Runner runner)
+    {
+        Timing best = {1e30, 0, mysn::PerfSample()};
+
+        for (int i = 0; i < repeat; ++i)
+        {
+            mysn::CPU cpu;
+            vector<mysn::Byte> program = workload.program;
+            mysn::PerfSample host = mysn::PerfSample();
+
+            if (counters != nullptr)
+            {
+                counters->start();
+            }
+            auto begin = chrono::steady_clock::now();
+            runner(cpu, program);
+            auto end = chrono::steady_clock::now();
+            if (counters != nullptr)
+            {
+                host = counters->stop();
+            }
+
+            double seconds = chrono::duration<double>(end - begin).count();
+            if (seconds < best.seconds)
+            {
+                best.seconds = seconds;
+                best.cycles = cpu.cycles;
+                best.host = host;
+            }
+        }
+
+        return best;
+    }
+
+    // instructions 不为 0 时在后面加上宿主机计数的几列
+    void print_row(const string &name, const char *variant, const Timing &timing, double baseline,
+                   uint64_t instructions)
+    {
+        double mhz = timing.cycles / timing.seconds / 1e6;
+
+        cout << left << setw(22) << name << setw(10) << variant << right
+             << setw(12) << timing.cycles
+             << setw(12) << fixed << setprecision(3) << timing.seconds * 1e3
+             << setw(12) << setprecision(1) << mhz;
+
+        if (baseline > 0)
+        {
+            cout << setw(10) << setprecision(1) << showpos << (timing.seconds / baseline - 1.0) * 100.0 << "%" << noshowpos;
+        }
+        else if (instructions != 0)
+        {
+            cout << setw(11) << "";
+        }
+
+        if (instructions != 0)
+        {
+            mysn::print_counters(cout, timing.host, instructions);
+        }
+
+        cout << "\n";
+    }
+
+    struct InstructionCounter
+    {
+        uint64_t count;
+
+        void before_instruction(mysn::CPU &, mysn::Byte) {}
+
+        void after_instruction(mysn::CPU &, mysn::Byte, bool)
+        {
+            ++count;
+        }
+    };
+
+    uint64_t count_instructions(const mysn::Workload &workload)
+    {
+        InstructionCounter counter = {0};
+        mysn::CPU cpu;
+        vector<mysn::Byte> program = workload.program;
+        cpu.load_and_run_with(program, counter);
+
+        return counter.count;
+    }
+
+    // 判定变慢的显著性水平
+    const double SIGNIFICANCE = 0.05;
+
+    // 基线读不出来时的退出码，git bisect run 把它当作跳过这个提交
+    const int EXIT_SKIP = 125;
+
+    // 指令数单独数一次，之后 trials 次都用 run() 计时，每次一个样本
+    mysn::WorkloadSamples sample(const mysn::Workload &workload, int trials)
+    {
+        mysn::WorkloadSamples samples;
+        samples.name = workload.name;
+
+        {
+            InstructionCounter counter = {0};
+            mysn::CPU cpu;
+            vector<mysn::Byte> program = workload.program;
+            cpu.load_and_run_with(program, counter);
+            samples.instructions = counter.count;
+            samples.cycles = cpu.cycles;
+        }
+
+        for (int i = 0; i < trials; ++i)
+        {
+            Timing timing = measure(workload, 1, nullptr, [](mysn::CPU &cpu, vector<mysn::Byte> &program) {
+                cpu.load_and_run(program);
+            });
+            samples.mips.push_back(samples.instructions / timing.seconds / 1e6);
+        }
+
+        return samples;
+    }
+
+    const mysn::WorkloadSamples *find_samples(const vector<mysn::WorkloadSamples> &all, const string &name)
+    {
+        for (const mysn::WorkloadSamples &samples : all)
+        {
+            if (samples.name == name)
+            {
+                return &samples;
+            }
+        }
+
+        return nullptr;
+    }
+
+    /// 和基线比较，每个程序一行：中位数 MIPS、按同样指令数折算的帧率、变化和 p 值。
+    /// 中位数下降超过 threshold 且检验显著才算变慢；只满足一个条件的视为噪声。
+    /// 返回 0 表示没有变慢，1 表示有程序变慢，可以直接给 git bisect run 用
+    int compare(const vector<mysn::WorkloadSamples> &baseline, const vector<mysn::WorkloadSamples> &current,
+                double threshold)
+    {
+        int regressions = 0;
+
+        cout << left << setw(22) << "workload" << right << setw(12) << "base MIPS" << setw(12) << "MIPS"
+             << setw(12) << "base fps" << setw(12) << "fps" << setw(10) << "delta" << setw(10) << "p"
+             << "  status\n";
+
+        for (const mysn::WorkloadSamples &samples : current)
+        {
+            const mysn::WorkloadSamples *base = find_samples(baseline, samples.name);
+
+            if (base == nullptr || base->mips.empty())
+            {
+                cout << left << setw(22) << samples.name << right << setw(12) << "-" << setw(12)
+                     << fixed << setprecision(1) << mysn::median(samples.mips) << "  (no baseline)\n";
+                continue;
+            }
+
+            double base_mips = mysn::median(base->mips);
+            double mips = mysn::median(samples.mips);
+            // 每秒帧数 = 每秒指令数 / 每帧指令数，每帧指令数由该程序的平均 CPI 决定
+            double base_fps = base_mips * 1e6 * base->cycles / base->instructions / mysn::CYCLES_PER_FRAME;
+            double fps = mips * 1e6 * samples.cycles / samples.instructions / mysn::CYCLES_PER_FRAME;
+            double delta = (mips / base_mips - 1.0) * 100.0;
+            double p = mysn::slower_p_value(samples.mips, base->mips);
+            bool slower = delta < -threshold && p < SIGNIFICANCE;
+
+            const char *status = slower ? "REGRESSION" : delta < -threshold ? "noise" : "ok";
+            if (base->instructions != samples.instructions || base->cycles != samples.cycles)
+            {
+                // 程序或周期计算变了，MIPS 仍可比，但提醒一下
+                status = slower ? "REGRESSION (workload changed)" : "ok (workload changed)";
+            }
+
+            cout << left << setw(22) << samples.name << right << fixed
+                 << setw(12) << setprecision(1) << base_mips << setw(12) << mips
+                 << setw(12) << setprecision(0) << base_fps << setw(12) << fps
+                 << setw(9) << setprecision(1) << showpos << delta << "%" << noshowpos
+                 << setw(10) << setprecision(4) << p << "  " << status << "\n";
+
+            regressions += slower ? 1 : 0;
+        }
+
+        if (regressions > 0)
+        {
+            cout << regressions << " workload(s) slower than baseline by more than " << setprecision(1) << threshold << "%\n";
+            return 1;
+        }
+
+        return 0;
+    }
+
+    void usage()
+    {
+        cerr << "usage: cpu_bench [--repeat N] [--filter NAME] [--profile PATH] [--counters]\n"
+             << "       cpu_bench [--filter NAME] [--trials N] [--save-baseline PATH] [--baseline PATH] [--threshold PCT]\n"
+             << "  --profile PATH        按操作码统计并写出报告，.json 结尾写 JSON\n"
+             << "  --counters            用 perf_event_open 读宿主机 IPC、分支预测失败和缓存未命中\n"
+             << "  --trials N            基线模式下每个程序计时的次数，默认 15\n"
+             << "  --save-baseline PATH  把这次的样本写成基线 JSON\n"
+             << "  --baseline PATH       和基线比较，变慢时退出码为 1，基线读不出来时为 125\n"
+             << "  --threshold PCT       中位数 MIPS 下降超过 PCT% 且显著才算变慢，默认 5\n"
+             << "\n"
+             << "二分性能回退：\n"
+             << "  cpu_bench --save-baseline /tmp/base.json   # 在好的提交上\n"
+             << "  git bisect run sh -c 'cmake --build build --target cpu_bench || exit 125; "
+             << "build/bench/cpu_bench --baseline /tmp/base.json'\n";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int repeat = 5;
+    string filter;
+    string profile_path;
+    int trials = 15;
+    string baseline_path;
+    string save_path;
+    double threshold = 5.0;
+    bool use_counters = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+        {
+            repeat = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+        {
+            profile_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--trials") == 0 && i + 1 < argc)
+        {
+            trials = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+        {
+            baseline_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--save-baseline") == 0 && i + 1 < argc)
+        {
+            save_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+        {
+            threshold = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--counters") == 0)
+        {
+            use_counters = true;
+        }
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    if (repeat < 1)
+    {
+        repeat = 1;
+    }
+
+#ifndef NDEBUG
+    cerr << "warning: 未开优化编译，数字没有参考价值；请用 -DCMAKE_BUILD_TYPE=Release 配置\n";
+#endif
+
+    if (!baseline_path.empty() || !save_path.empty())
+    {
+        // 先读基线，读不出来就不必花时间计时
+        vector<mysn::WorkloadSamples> baseline;
+        if (!baseline_path.empty() && !mysn::load_baseline(baseline_path, baseline))
+        {
+            cerr << "cannot read baseline " << baseline_path << "\n";
+            return EXIT_SKIP;
+        }
+
+        if (trials < 2)
+        {
+            trials = 2;
+        }
+
+        vector<mysn::WorkloadSamples> current;
+        for (const mysn::Workload &workload : mysn::benchmark_workloads())
+        {
+            if (filter.empty() || workload.name.find(filter) != string::npos)
+            {
+                current.push_back(sample(workload, trials));
+            }
+        }
+
+        if (!save_path.empty() && !mysn::save_baseline(save_path, current))
+        {
+            cerr << "cannot write " << save_path << "\n";
+            return 1;
+        }
+
+        return baseline_path.empty() ? 0 : compare(baseline, current, threshold);
+    }
+
+    // 打不开时表格照常输出，计数列都是 "-"
+    mysn::PerfCounters perf;
+    mysn::PerfCounters *counters = use_counters ? &perf : nullptr;
+    if (use_counters)
+    {
+        mysn::report_counters(perf);
+    }
+
+    cout << left << setw(22) << "workload" << setw(10) << "policy" << right
+         << setw(12) << "cycles" << setw(12) << "ms" << setw(12) << "MHz" << setw(11) << "overhead";
+    if (use_counters)
+    {
+        mysn::print_counter_header(cout);
+    }
+    cout << "\n";
+
+    for (const mysn::Workload &workload : mysn::benchmark_workloads())
+    {
+        if (!filter.empty() && workload.name.find(filter) == string::npos)
+        {
+            continue;
+        }
+
+        uint64_t instructions = use_counters ? count_instructions(workload) : 0;
+
+        Timing base = measure(workload, repeat, counters, [](mysn::CPU &cpu, vector<mysn::Byte> &program) {
+            cpu.load_and_run(program);
+        });
+        print_row(workload.name, "run", base, 0, instructions);
+
+        // 显式传入空策略，应与 run() 没有差别
+        mysn::NullPolicy null_policy;
+        Timing null_run = measure(workload, repeat, counters, [&](mysn::CPU &cpu, vector<mysn::Byte> &program) {
+            cpu.load_and_run_with(program, null_policy);
+        });
+        print_row(workload.name, "null", null_run, base.seconds, instructions);
+
+        mysn::OpcodeProfiler profiler;
+        Timing profiled = measure(workload, repeat, counters, [&](mysn::CPU &cpu, vector<mysn::Byte> &program) {
+            cpu.load_and_run_with(program, profiler);
+        });
+        print_row(workload.name, "profile", profiled, base.seconds, instructions);
+
+        // 报告只统计单次运行，每个程序写一份：profile.json -> profile.alu_loop.json
+        if (!profile_path.empty())
+        {
+            mysn::OpcodeProfiler once;
+            mysn::CPU cpu;
+            vector<mysn::Byte> program = workload.program;
+            cpu.load_and_run_with(program, once);
+
+            string path = profile_path;
+            string::size_type dot = path.rfind('.');
+            string stem = dot == string::npos ? path : path.substr(0, dot);
+            string ext = dot == string::npos ? "" : path.substr(dot);
+
+            if (!once.dump(stem + "." + workload.name + ext))
+            {
+                cerr << "cannot write " << stem << "." << workload.name << ext << "\n";
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
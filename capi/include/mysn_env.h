@@ -0,0 +1,74 @@
+#ifndef MYSN_ENV_H
+#define MYSN_ENV_H
+
+/*
+ * 批量环境的 C 接口（libmysn_env），给 C++ 以外的调用方（Python ctypes/cffi 等）使用。
+ *
+ *     mysn_batch *batch = mysn_create_batch(64, program, length, 0);
+ *     mysn_reset(batch, seeds);
+ *     for (;;)
+ *     {
+ *         mysn_step(batch, actions, 4);
+ *         const uint8_t *ram = mysn_ram(batch, 0);   // 直接读，不复制
+ *         const uint8_t *done = mysn_done(batch);
+ *     }
+ *     mysn_destroy_batch(batch);
+ *
+ * 每个实例是一个 CPU，挂着 port 0 的手柄和 PPU。返回的指针直接指向实例内部的状态，
+ * 在 mysn_destroy_batch 之前一直有效、地址不变，内容在 mysn_reset/mysn_step 返回后更新；
+ * 这两个函数执行期间不要读。同一个 batch 的函数不能从多个线程同时调用。
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define MYSN_API __attribute__((visibility("default")))
+#else
+#define MYSN_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 接口有不兼容的改动时加一 */
+#define MYSN_ENV_VERSION 1
+
+/* mysn_ram 指向的内部 RAM（$0000-$07FF） */
+#define MYSN_RAM_SIZE 2048
+/* mysn_frame 指向的 PPU 精灵属性表（OAM），64 个精灵 x 4 字节 */
+#define MYSN_FRAME_SIZE 256
+
+typedef struct mysn_batch mysn_batch;
+
+MYSN_API int mysn_env_version(void);
+
+/* 程序从 $8000 开始装载，超过 32KB 的部分丢弃；threads 为 0 时按 CPU 核数。
+   创建后所有实例已按种子 0 复位。失败时返回 NULL */
+MYSN_API mysn_batch *mysn_create_batch(size_t count, const uint8_t *program, size_t length, int threads);
+MYSN_API void mysn_destroy_batch(mysn_batch *batch);
+
+MYSN_API size_t mysn_batch_size(const mysn_batch *batch);
+
+/* 重新装载程序并复位所有实例。seeds 为每个实例的种子，用来生成上电时的 RAM 内容，
+   种子 0 表示全零；seeds 为 NULL 时都按 0 处理 */
+MYSN_API void mysn_reset(mysn_batch *batch, const uint64_t *seeds);
+
+/* 每个实例按下 actions[i]（JoypadButton 的组合，NULL 表示不按键）执行 frames 帧。
+   程序结束（BRK 或未知操作码）的实例 done 置 1，之后的 step 跳过它，直到下一次 reset */
+MYSN_API void mysn_step(mysn_batch *batch, const uint8_t *actions, uint32_t frames);
+
+/* 第 index 个实例的 MYSN_RAM_SIZE 字节 RAM */
+MYSN_API const uint8_t *mysn_ram(const mysn_batch *batch, size_t index);
+/* 第 index 个实例的 MYSN_FRAME_SIZE 字节 OAM */
+MYSN_API const uint8_t *mysn_frame(const mysn_batch *batch, size_t index);
+/* count 个字节，每个实例一个 */
+MYSN_API const uint8_t *mysn_done(const mysn_batch *batch);
+MYSN_API uint64_t mysn_cycles(const mysn_batch *batch, size_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MYSN_ENV_H */
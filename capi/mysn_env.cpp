@@ -0,0 +1,175 @@
+#include "mysn_env.h"
+#include "CPU.h"
+#include "InstancePool.h"
+#include "ThreadPool.h"
+#include <memory>
+#include <new>
+#include <system_error>
+#include <vector>
+
+namespace
+{
+    // splitmix64，种子相同时上电 RAM 相同
+    std::uint64_t next_random(std::uint64_t &state)
+    {
+        std::uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+
+        return z ^ (z >> 31);
+    }
+}
+
+struct mysn_batch
+{
+    // 所有实例共享一份 ROM，快照是上电状态
+    mysn::InstancePool instances;
+    std::vector<std::uint8_t> done;
+    mysn::ThreadPool pool;
+
+    mysn_batch(std::size_t count, const mysn::SharedRom &rom, int threads)
+        : instances(count, rom), done(count, 0), pool(threads)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            // 出错时的指令记录写到调用方的标准错误里没有意义
+            instances.instance(i).cpu.flight_recorder.set_dump_fd(-1);
+        }
+    }
+
+    void reset(std::size_t index, std::uint64_t seed)
+    {
+        mysn::PoolInstance &instance = instances.instance(index);
+
+        instances.reset(index);
+
+        if (seed != 0)
+        {
+            std::uint64_t state = seed;
+
+            for (mysn::Address addr = 0; addr < MYSN_RAM_SIZE; addr += 8)
+            {
+                std::uint64_t bits = next_random(state);
+
+                for (int k = 0; k < 8; ++k)
+                {
+                    instance.cpu.mem_write(mysn::Address(addr + k), mysn::Byte(bits >> (k * 8)));
+                }
+            }
+        }
+
+        done[index] = 0;
+    }
+
+    void step(std::size_t index, mysn::Byte buttons, std::uint32_t frames)
+    {
+        mysn::PoolInstance &instance = instances.instance(index);
+
+        if (done[index])
+        {
+            return;
+        }
+
+        instance.joypad.set_buttons(buttons);
+
+        mysn::RunBudget budget = {0, 0, true};
+
+        for (std::uint32_t frame = 0; frame < frames; ++frame)
+        {
+            if (instance.cpu.run_for(budget) != mysn::Run_Frame_End)
+            {
+                done[index] = 1;
+                return;
+            }
+        }
+    }
+};
+
+extern "C"
+{
+    int mysn_env_version(void)
+    {
+        return MYSN_ENV_VERSION;
+    }
+
+    mysn_batch *mysn_create_batch(size_t count, const uint8_t *program, size_t length, int threads)
+    {
+        if (program == nullptr && length != 0)
+        {
+            return nullptr;
+        }
+
+        // 异常不能穿过 C 接口
+        try
+        {
+            mysn::SharedRom rom = mysn::make_rom(std::vector<mysn::Byte>(program, program + length));
+            std::unique_ptr<mysn_batch> batch(new mysn_batch(count, rom, threads));
+
+            return batch.release();
+        }
+        catch (const std::bad_alloc &)
+        {
+            return nullptr;
+        }
+        catch (const std::system_error &)
+        {
+            return nullptr;
+        }
+        catch (...)
+        {
+            // 例如 count 太大时 std::vector 抛出的 std::length_error
+            return nullptr;
+        }
+    }
+
+    void mysn_destroy_batch(mysn_batch *batch)
+    {
+        delete batch;
+    }
+
+    size_t mysn_batch_size(const mysn_batch *batch)
+    {
+        return batch->instances.size();
+    }
+
+    void mysn_reset(mysn_batch *batch, const uint64_t *seeds)
+    {
+        batch->pool.parallel_for(batch->instances.size(), [&](std::size_t i) {
+            batch->reset(i, seeds != nullptr ? seeds[i] : 0);
+        });
+    }
+
+    void mysn_step(mysn_batch *batch, const uint8_t *actions, uint32_t frames)
+    {
+        // 捕获不超过两个指针，std::function 不用在堆上分配
+        struct
+        {
+            const uint8_t *actions;
+            uint32_t frames;
+        } request = {actions, frames};
+
+        batch->pool.parallel_for(batch->instances.size(), [batch, &request](std::size_t i) {
+            batch->step(i, request.actions != nullptr ? request.actions[i] : 0, request.frames);
+        });
+    }
+
+    const uint8_t *mysn_ram(const mysn_batch *batch, size_t index)
+    {
+        return batch->instances.instance(index).cpu.memory_data();
+    }
+
+    const uint8_t *mysn_frame(const mysn_batch *batch, size_t index)
+    {
+        return batch->instances.instance(index).ppu.oam;
+    }
+
+    const uint8_t *mysn_done(const mysn_batch *batch)
+    {
+        return batch->done.data();
+    }
+
+    uint64_t mysn_cycles(const mysn_batch *batch, size_t index)
+    {
+        return batch->instances.instance(index).cpu.cycles;
+    }
+}
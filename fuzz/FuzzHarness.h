@@ -0,0 +1,240 @@
+#ifndef FUZZHARNESS_H
+#define FUZZHARNESS_H
+
+#include "BatchCPU.h"
+#include "CPU.h"
+#include "CPURun.h"
+#include "CoverageMap.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace mysn
+{
+    // 限制指令数的策略，可选地同时记录 PRG 覆盖
+    struct FuzzPolicy
+    {
+        std::uint64_t budget;
+        std::uint64_t executed;
+        CoverageMap *coverage;
+
+        FuzzPolicy(std::uint64_t budget, CoverageMap *coverage)
+            : budget(budget), executed(0), coverage(coverage) {}
+
+        void before_instruction(CPU &cpu, Byte code)
+        {
+            if (coverage != nullptr)
+            {
+                coverage->before_instruction(cpu, code);
+            }
+        }
+
+        void after_instruction(CPU &cpu, Byte, bool)
+        {
+            if (++executed >= budget)
+            {
+                cpu.request_stop();
+            }
+        }
+    };
+
+    /// 把任意字节当作程序装到 $8000 执行，libFuzzer 入口和独立驱动共用。
+    ///
+    /// 同一个 CPU 实例用 hard_reset 反复使用，ROM 也是同一块 32KB，每次原地改写，执行时不分配内存。
+    /// 每次执行后检查：
+    ///   - 指令数不超过预算，周期数不超过每条指令 7 个周期
+    ///   - 飞行记录器的条数与执行的指令数一致（未知操作码多记一条）
+    /// 每 check_interval 次再用新构造的 CPU 和 BatchCPU 各执行一遍，比较寄存器、周期和内存，
+    /// 确认复用实例的结果与全新实例、批量核心一致。程序写过 ROM 时不和 BatchCPU 比较（它忽略 ROM 写入）。
+    /// 检查失败时打印原因后 abort。
+    class FuzzHarness
+    {
+    public:
+        explicit FuzzHarness(std::uint64_t budget = 10000, unsigned check_interval = 256)
+            : image(std::make_shared<std::vector<Byte>>(0x8000, 0)),
+              rom(image),
+              loaded(0),
+              batch(1),
+              budget(budget),
+              check_interval(check_interval),
+              runs(0)
+        {
+            // 随机程序大多以未知操作码结束，不逐次打印
+            machine.flight_recorder.set_dump_fd(-1);
+        }
+
+        // 返回执行的指令数
+        std::uint64_t run(const std::uint8_t *data, std::size_t size, CoverageMap *coverage = nullptr)
+        {
+            program.assign(data, data + size);
+
+            // 先卸下 ROM，改写时没有实例在用它
+            machine.hard_reset();
+            load_image(data, size);
+            machine.load_and_reset(rom);
+            FuzzPolicy policy(budget, coverage);
+            machine.run_with(policy);
+
+            check_bounds(policy.executed);
+
+            if (check_interval != 0 && ++runs % check_interval == 0)
+            {
+                cross_check();
+            }
+
+            return policy.executed;
+        }
+
+        const CPU &cpu() const
+        {
+            return machine;
+        }
+
+    private:
+        CPU machine;
+        // 可写的 ROM 映像和同一块内存的只读视图；CPU 写 ROM 时会复制出自己的，不会改到这里
+        std::shared_ptr<std::vector<Byte>> image;
+        SharedRom rom;
+        // 上次装载的程序长度，改写时只需清掉多出来的部分
+        std::size_t loaded;
+        BatchCPU batch;
+        std::vector<Byte> program;
+        std::uint64_t budget;
+        unsigned check_interval;
+        std::uint64_t runs;
+
+        static void fail(const char *reason)
+        {
+            std::fprintf(stderr, "fuzz check failed: %s\n", reason);
+            std::abort();
+        }
+
+        // 与 make_rom 相同的映像：程序放在 $8000，超过 32KB 的部分丢弃，复位向量指向 $8000
+        void load_image(const std::uint8_t *data, std::size_t size)
+        {
+            std::size_t length = size < 0x8000 ? size : 0x8000;
+            Byte *bytes = &(*image)[0];
+
+            if (length != 0)
+            {
+                std::memcpy(bytes, data, length);
+            }
+            if (loaded > length)
+            {
+                std::memset(bytes + length, 0, loaded - length);
+            }
+            loaded = length;
+
+            bytes[0xFFFC - 0x8000] = 0x00;
+            bytes[0xFFFD - 0x8000] = 0x80;
+            if (loaded < 0xFFFC - 0x8000 + 2)
+            {
+                loaded = 0xFFFC - 0x8000 + 2;
+            }
+        }
+
+        void check_bounds(std::uint64_t executed) const
+        {
+            std::uint64_t recorded = machine.flight_recorder.total_recorded();
+
+            if (executed > budget)
+            {
+                fail("instruction budget exceeded");
+            }
+
+            if (machine.cycles > executed * 7)
+            {
+                fail("more than 7 cycles per instruction");
+            }
+
+            if (recorded != executed && recorded != executed + 1)
+            {
+                fail("flight recorder out of step with executed instructions");
+            }
+        }
+
+        void cross_check()
+        {
+            CPU fresh;
+            fresh.flight_recorder.set_dump_fd(-1);
+            fresh.load_and_reset(rom);
+            FuzzPolicy policy(budget, nullptr);
+            RunExit exit = fresh.run_with(policy);
+
+            if (fresh.program_counter != machine.program_counter ||
+                fresh.register_a != machine.register_a ||
+                fresh.register_x != machine.register_x ||
+                fresh.register_y != machine.register_y ||
+                fresh.stack_pointer != machine.stack_pointer ||
+                fresh.status != machine.status ||
+                fresh.cycles != machine.cycles)
+            {
+                fail("registers differ from a freshly constructed CPU");
+            }
+
+            // $8000 以下除了可写内存都是开放总线
+            if (std::memcmp(fresh.memory_data(), machine.memory_data(), WRITABLE_MEMORY_SIZE) != 0)
+            {
+                fail("memory differs from a freshly constructed CPU");
+            }
+
+            if (std::memcmp(fresh.rom_data(), machine.rom_data(), image->size()) != 0)
+            {
+                fail("ROM differs from a freshly constructed CPU");
+            }
+
+            // 写过 ROM 的程序不和 BatchCPU 比较
+            if (std::memcmp(machine.rom_data(), &(*image)[0], image->size()) == 0)
+            {
+                compare_batch(exit == Run_Stopped);
+            }
+        }
+
+        // 程序自己结束时 BatchCPU 也跑到结束；用完指令预算时以结束时的周期为上限，
+        // 指令至少 2 个周期，BatchCPU 正好执行同样多的指令
+        void compare_batch(bool budget_exhausted)
+        {
+            batch.load_and_reset(program);
+            if (budget_exhausted)
+            {
+                batch.run(machine.cycles);
+            }
+            else
+            {
+                batch.run();
+            }
+
+            if (batch.program_counter(0) != machine.program_counter ||
+                batch.register_a(0) != machine.register_a ||
+                batch.register_x(0) != machine.register_x ||
+                batch.register_y(0) != machine.register_y ||
+                batch.stack_pointer(0) != machine.stack_pointer ||
+                batch.status(0) != machine.status ||
+                batch.cycles(0) != machine.cycles)
+            {
+                fail("registers differ from BatchCPU");
+            }
+
+            // 只比较可写内存：内部 RAM、I/O 页和 PRG RAM
+            static const Address ranges[][2] = {{0x0000, 0x0800}, {0x4000, 0x4100}, {0x6000, 0x8000}};
+            const Byte *memory = machine.memory_data();
+
+            for (const auto &range : ranges)
+            {
+                for (std::uint32_t addr = range[0]; addr < range[1]; ++addr)
+                {
+                    if (batch.peek(0, Address(addr)) != memory[writable_offset(Address(addr))])
+                    {
+                        fail("memory differs from BatchCPU");
+                    }
+                }
+            }
+        }
+    };
+}
+
+#endif // FUZZHARNESS_H
@@ -0,0 +1,11 @@
+#include "FuzzHarness.h"
+
+// libFuzzer 入口：cmake -DMYSN_LIBFUZZER=ON -DCMAKE_CXX_COMPILER=clang++
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data, std::size_t size)
+{
+    static mysn::FuzzHarness harness;
+
+    harness.run(data, size);
+
+    return 0;
+}
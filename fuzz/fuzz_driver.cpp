@@ -0,0 +1,394 @@
+#include "FuzzHarness.h"
+#include "CPUOpcodes.h"
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+// 没有 libFuzzer 时用的进程内驱动：先逐个执行语料，再按 PRG 覆盖做变异。
+// 覆盖有新增的输入留在语料池里；崩溃时把当前输入写到 crash-input.bin。
+
+namespace
+{
+    typedef vector<mysn::Byte> Input;
+
+    mysn::FuzzHarness *active_harness = nullptr;
+    const Input *current_input = nullptr;
+
+    void crash_handler(int signal)
+    {
+        static const char message[] = "fuzz_driver: crashed, input written to crash-input.bin\n";
+
+        if (current_input != nullptr)
+        {
+            int fd = open("crash-input.bin", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd >= 0)
+            {
+                ssize_t written = write(fd, current_input->data(), current_input->size());
+                (void)written;
+                close(fd);
+            }
+        }
+
+        ssize_t written = write(STDERR_FILENO, message, sizeof(message) - 1);
+        (void)written;
+
+        if (active_harness != nullptr)
+        {
+            active_harness->cpu().flight_recorder.dump(STDERR_FILENO, "crash");
+        }
+
+        std::signal(signal, SIG_DFL);
+        std::raise(signal);
+    }
+
+    void install_crash_handler()
+    {
+        const int signals[] = {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT};
+
+        for (int signal : signals)
+        {
+            std::signal(signal, crash_handler);
+        }
+    }
+
+    bool read_file(const string &path, Input &out)
+    {
+        FILE *file = fopen(path.c_str(), "rb");
+
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        out.clear();
+        int c;
+        while ((c = fgetc(file)) != EOF)
+        {
+            out.push_back(mysn::Byte(c));
+        }
+        fclose(file);
+
+        return true;
+    }
+
+    // 目录里的每个普通文件都是一个输入
+    void collect_inputs(const string &path, vector<Input> &corpus)
+    {
+        DIR *dir = opendir(path.c_str());
+
+        if (dir == nullptr)
+        {
+            Input input;
+            if (read_file(path, input))
+            {
+                corpus.push_back(input);
+            }
+            else
+            {
+                cerr << "fuzz_driver: cannot read " << path << "\n";
+            }
+            return;
+        }
+
+        while (dirent *entry = readdir(dir))
+        {
+            if (entry->d_name[0] == '.')
+            {
+                continue;
+            }
+
+            Input input;
+            if (read_file(path + "/" + entry->d_name, input))
+            {
+                corpus.push_back(input);
+            }
+        }
+        closedir(dir);
+    }
+
+    bool write_file(const string &path, const Input &input)
+    {
+        FILE *file = fopen(path.c_str(), "wb");
+
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        bool ok = fwrite(input.data(), 1, input.size(), file) == input.size();
+
+        return fclose(file) == 0 && ok;
+    }
+
+    // 这次运行是否覆盖了 total 里没有的字节
+    bool has_new_coverage(const mysn::CoverageMap &run, const mysn::CoverageMap &total)
+    {
+        const mysn::Byte *a = run.data();
+        const mysn::Byte *b = total.data();
+
+        // 每次执行都要扫一遍 4KB 的位图，按 8 字节一组比较
+        for (size_t i = 0; i < mysn::CoverageMap::BITMAP_BYTES; i += sizeof(uint64_t))
+        {
+            uint64_t x, y;
+            memcpy(&x, a + i, sizeof(x));
+            memcpy(&y, b + i, sizeof(y));
+
+            if ((x & ~y) != 0)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    class Mutator
+    {
+    public:
+        Mutator(unsigned seed, size_t max_length) : rng(seed), max_length(max_length)
+        {
+            for (auto &opcode : mysn::CPUOpcodes::CPU_OPS_CODES_MAP)
+            {
+                opcodes.push_back(opcode.first);
+            }
+        }
+
+        void mutate(Input &input, const vector<Input> &pool)
+        {
+            int rounds = 1 + int(next(4));
+
+            for (int i = 0; i < rounds; ++i)
+            {
+                mutate_once(input, pool);
+            }
+
+            if (input.empty())
+            {
+                input.push_back(random_opcode());
+            }
+            if (input.size() > max_length)
+            {
+                input.resize(max_length);
+            }
+        }
+
+    private:
+        mt19937 rng;
+        size_t max_length;
+        vector<mysn::Byte> opcodes;
+
+        size_t next(size_t bound)
+        {
+            return bound == 0 ? 0 : size_t(rng() % bound);
+        }
+
+        mysn::Byte random_opcode()
+        {
+            return opcodes[next(opcodes.size())];
+        }
+
+        void mutate_once(Input &input, const vector<Input> &pool)
+        {
+            size_t position = next(input.size() + 1);
+
+            switch (next(6))
+            {
+            case 0:
+                // 翻转一位
+                if (!input.empty())
+                {
+                    input[next(input.size())] ^= mysn::Byte(1 << next(8));
+                }
+                break;
+
+            case 1:
+                if (!input.empty())
+                {
+                    input[next(input.size())] = mysn::Byte(rng());
+                }
+                break;
+
+            case 2:
+                // 插入一条合法指令的操作码和随机操作数
+                input.insert(input.begin() + position, random_opcode());
+                for (size_t n = next(3); n > 0; --n)
+                {
+                    input.insert(input.begin() + position + 1, mysn::Byte(rng()));
+                }
+                break;
+
+            case 3:
+                if (!input.empty())
+                {
+                    position = next(input.size());
+                    size_t length = 1 + next(min(size_t(8), input.size() - position));
+                    input.erase(input.begin() + position, input.begin() + position + length);
+                }
+                break;
+
+            case 4:
+                // 复制一段到别处
+                if (!input.empty())
+                {
+                    size_t from = next(input.size());
+                    size_t length = 1 + next(input.size() - from);
+                    Input chunk(input.begin() + from, input.begin() + from + length);
+                    input.insert(input.begin() + position, chunk.begin(), chunk.end());
+                }
+                break;
+
+            case 5:
+                // 与语料池里的另一个输入拼接
+                if (!pool.empty())
+                {
+                    const Input &other = pool[next(pool.size())];
+                    size_t from = next(other.size() + 1);
+                    input.resize(position);
+                    input.insert(input.end(), other.begin() + from, other.end());
+                }
+                break;
+            }
+        }
+    };
+
+    void usage()
+    {
+        cerr << "usage: fuzz_driver [--runs N] [--budget N] [--seed N] [--max-len N]\n"
+             << "                   [--check-every N] [--save DIR] [CORPUS...]\n"
+             << "  CORPUS         输入文件或目录，先逐个执行；--runs 0 时只执行语料（复现崩溃）\n"
+             << "  --budget N     每个输入最多执行的指令数，默认 10000\n"
+             << "  --check-every  每 N 次与新构造的 CPU 对比一次，0 表示不对比，默认 256\n"
+             << "  --save DIR     把覆盖有新增的输入写到 DIR\n";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t runs = 1000000;
+    uint64_t budget = 10000;
+    unsigned seed = 1;
+    size_t max_length = 256;
+    unsigned check_every = 256;
+    string save_dir;
+    vector<string> corpus_paths;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(argv[i], "--runs") == 0 && has_value)
+        {
+            runs = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--budget") == 0 && has_value)
+        {
+            budget = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && has_value)
+        {
+            seed = unsigned(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--max-len") == 0 && has_value)
+        {
+            max_length = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--check-every") == 0 && has_value)
+        {
+            check_every = unsigned(strtoul(argv[++i], nullptr, 10));
+        }
+        else if (strcmp(argv[i], "--save") == 0 && has_value)
+        {
+            save_dir = argv[++i];
+        }
+        else if (argv[i][0] == '-')
+        {
+            usage();
+            return 1;
+        }
+        else
+        {
+            corpus_paths.push_back(argv[i]);
+        }
+    }
+
+    if (budget == 0 || max_length == 0)
+    {
+        usage();
+        return 1;
+    }
+
+    vector<Input> pool;
+    for (const string &path : corpus_paths)
+    {
+        collect_inputs(path, pool);
+    }
+
+    mysn::FuzzHarness harness(budget, check_every);
+    mysn::CoverageMap total;
+    mysn::CoverageMap coverage;
+    active_harness = &harness;
+    install_crash_handler();
+
+    auto begin = chrono::steady_clock::now();
+
+    for (const Input &input : pool)
+    {
+        current_input = &input;
+        harness.run(input.data(), input.size(), &coverage);
+        total.merge(coverage);
+        coverage.clear();
+    }
+    size_t replayed = pool.size();
+
+    if (pool.empty())
+    {
+        pool.push_back(Input(1, 0xea));
+    }
+
+    Mutator mutator(seed, max_length);
+    Input input;
+    size_t saved = 0;
+
+    for (uint64_t run = 0; run < runs; ++run)
+    {
+        input = pool[run % pool.size()];
+        mutator.mutate(input, pool);
+
+        current_input = &input;
+        harness.run(input.data(), input.size(), &coverage);
+
+        if (has_new_coverage(coverage, total))
+        {
+            total.merge(coverage);
+            pool.push_back(input);
+
+            if (!save_dir.empty())
+            {
+                char name[32];
+                snprintf(name, sizeof(name), "/input-%06zu", saved++);
+                write_file(save_dir + name, input);
+            }
+        }
+        coverage.clear();
+    }
+    current_input = nullptr;
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    uint64_t execs = replayed + runs;
+
+    cout << "execs " << execs
+         << ", " << uint64_t(execs / (seconds > 0 ? seconds : 1e-9)) << " execs/s"
+         << ", corpus " << pool.size()
+         << ", coverage " << total.covered_count() << " bytes\n";
+
+    return 0;
+}
@@ -0,0 +1,993 @@
+#include "APU.h"
+#include "AudioSink.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace mysn
+{
+    namespace
+    {
+        const Byte LENGTH_TABLE[32] = {
+            10, 254, 20, 2, 40, 4, 80, 6, 160, 8, 60, 10, 14, 12, 26, 14,
+            12, 16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30};
+
+        // 按输出顺序排列的占空比序列
+        const Byte DUTY_TABLE[4][8] = {
+            {0, 1, 0, 0, 0, 0, 0, 0},
+            {0, 1, 1, 0, 0, 0, 0, 0},
+            {0, 1, 1, 1, 1, 0, 0, 0},
+            {1, 0, 0, 1, 1, 1, 1, 1}};
+
+        const Byte TRIANGLE_TABLE[32] = {
+            15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+            0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+
+        // NTSC，单位都是 CPU 周期
+        const DobuleByte NOISE_PERIODS[16] = {
+            4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068};
+
+        const DobuleByte DMC_RATES[16] = {
+            428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54};
+
+        // 帧计数器每一步相对序列起点的周期，第 1、3 步同时是半帧
+        const std::uint32_t FOUR_STEP_TIMES[4] = {7457, 14913, 22371, 29829};
+        const std::uint32_t FOUR_STEP_PERIOD = 29830;
+        const std::uint32_t FIVE_STEP_TIMES[4] = {7457, 14913, 22371, 37281};
+        const std::uint32_t FIVE_STEP_PERIOD = 37282;
+
+        // 线性混音系数换算成满幅 32767 的采样幅度
+        const int PULSE_WEIGHT = int(PULSE_MIX * 32767 + 0.5f);
+        const int TRIANGLE_WEIGHT = int(TRIANGLE_MIX * 32767 + 0.5f);
+        const int NOISE_WEIGHT = int(NOISE_MIX * 32767 + 0.5f);
+        const int DMC_WEIGHT = int(DMC_MIX * 32767 + 0.5f);
+
+        // 每帧最多展开的 APU 周期数
+        const std::size_t LEVEL_CAPACITY = APU::FLUSH_INTERVAL / 2 + 2;
+
+        const std::uint64_t NEVER = std::numeric_limits<std::uint64_t>::max();
+
+        // 把 time 推进到 end 之后的第一个时钟，返回经过的时钟数
+        std::uint64_t skip_clocks(std::uint64_t &time, std::uint64_t end, std::uint64_t period)
+        {
+            if (time > end)
+            {
+                return 0;
+            }
+
+            std::uint64_t count = (end - time) / period + 1;
+            time += count * period;
+
+            return count;
+        }
+    }
+
+    ChannelOutput::ChannelOutput(int weight) : weight(weight),
+                                               last(0),
+                                               levels(nullptr),
+                                               filled(0) {}
+
+    void ChannelOutput::set(BlipBuffer &blip, std::uint32_t time, int level)
+    {
+        if (level == last)
+        {
+            return;
+        }
+
+        if (levels != nullptr)
+        {
+            fill_to(time >> 1);
+        }
+        else
+        {
+            blip.add_delta(time, (level - last) * weight);
+        }
+
+        last = level;
+    }
+
+    void ChannelOutput::fill_to(std::uint32_t index)
+    {
+        if (index > filled)
+        {
+            std::memset(levels + filled, last, index - filled);
+            filled = index;
+        }
+    }
+
+    Envelope::Envelope() : start(false),
+                           loop(false),
+                           constant(false),
+                           param(0),
+                           divider(0),
+                           decay(0) {}
+
+    void Envelope::write(Byte data)
+    {
+        loop = data & 0x20;
+        constant = data & 0x10;
+        param = data & 0x0F;
+    }
+
+    void Envelope::clock()
+    {
+        if (start)
+        {
+            start = false;
+            decay = 15;
+            divider = param;
+        }
+        else if (divider == 0)
+        {
+            divider = param;
+
+            if (decay > 0)
+            {
+                --decay;
+            }
+            else if (loop)
+            {
+                decay = 15;
+            }
+        }
+        else
+        {
+            --divider;
+        }
+    }
+
+    int Envelope::volume() const
+    {
+        return constant ? param : decay;
+    }
+
+    PulseChannel::PulseChannel(bool second) : second(second),
+                                              enabled(false),
+                                              duty(0),
+                                              phase(0),
+                                              timer_period(0),
+                                              length(0),
+                                              sweep_enabled(false),
+                                              sweep_negate(false),
+                                              sweep_reload(false),
+                                              sweep_period(0),
+                                              sweep_shift(0),
+                                              sweep_divider(0),
+                                              time(0),
+                                              output(PULSE_WEIGHT) {}
+
+    void PulseChannel::write(int reg, Byte data)
+    {
+        switch (reg)
+        {
+        case 0:
+            duty = data >> 6;
+            envelope.write(data);
+            break;
+
+        case 1:
+            sweep_enabled = data & 0x80;
+            sweep_period = (data >> 4) & 0x07;
+            sweep_negate = data & 0x08;
+            sweep_shift = data & 0x07;
+            sweep_reload = true;
+            break;
+
+        case 2:
+            timer_period = (timer_period & 0x700) | data;
+            break;
+
+        case 3:
+            timer_period = (timer_period & 0xFF) | ((data & 0x07) << 8);
+
+            if (enabled)
+            {
+                length = LENGTH_TABLE[data >> 3];
+            }
+
+            phase = 0;
+            envelope.start = true;
+            break;
+        }
+    }
+
+    int PulseChannel::sweep_target() const
+    {
+        int change = timer_period >> sweep_shift;
+
+        if (sweep_negate)
+        {
+            return timer_period - change - (second ? 0 : 1);
+        }
+
+        return timer_period + change;
+    }
+
+    bool PulseChannel::muted() const
+    {
+        return timer_period < 8 || sweep_target() > 0x7FF;
+    }
+
+    void PulseChannel::clock_quarter()
+    {
+        envelope.clock();
+    }
+
+    void PulseChannel::clock_half()
+    {
+        if (!envelope.loop && length > 0)
+        {
+            --length;
+        }
+
+        if (sweep_divider == 0 && sweep_enabled && sweep_shift > 0 && !muted())
+        {
+            int target = sweep_target();
+            timer_period = DobuleByte(target < 0 ? 0 : target);
+        }
+
+        if (sweep_divider == 0 || sweep_reload)
+        {
+            sweep_divider = sweep_period;
+            sweep_reload = false;
+        }
+        else
+        {
+            --sweep_divider;
+        }
+    }
+
+    void PulseChannel::run(BlipBuffer &blip, std::uint64_t frame_start, std::uint64_t from, std::uint64_t end)
+    {
+        std::uint64_t period = (std::uint64_t(timer_period) + 1) * 2;
+        int volume = (length == 0 || muted()) ? 0 : envelope.volume();
+
+        if (volume == 0)
+        {
+            output.set(blip, std::uint32_t(from - frame_start), 0);
+            phase = Byte((phase + skip_clocks(time, end, period)) & 7);
+            return;
+        }
+
+        const Byte *sequence = DUTY_TABLE[duty];
+        output.set(blip, std::uint32_t(from - frame_start), sequence[phase] ? volume : 0);
+
+        while (time <= end)
+        {
+            phase = (phase + 1) & 7;
+            output.set(blip, std::uint32_t(time - frame_start), sequence[phase] ? volume : 0);
+            time += period;
+        }
+    }
+
+    TriangleChannel::TriangleChannel() : enabled(false),
+                                         control(false),
+                                         linear_reload_value(0),
+                                         linear_counter(0),
+                                         linear_reload(false),
+                                         timer_period(0),
+                                         length(0),
+                                         phase(0),
+                                         time(0),
+                                         output(TRIANGLE_WEIGHT) {}
+
+    void TriangleChannel::write(int reg, Byte data)
+    {
+        switch (reg)
+        {
+        case 0:
+            control = data & 0x80;
+            linear_reload_value = data & 0x7F;
+            break;
+
+        case 2:
+            timer_period = (timer_period & 0x700) | data;
+            break;
+
+        case 3:
+            timer_period = (timer_period & 0xFF) | ((data & 0x07) << 8);
+
+            if (enabled)
+            {
+                length = LENGTH_TABLE[data >> 3];
+            }
+
+            linear_reload = true;
+            break;
+        }
+    }
+
+    void TriangleChannel::clock_quarter()
+    {
+        if (linear_reload)
+        {
+            linear_counter = linear_reload_value;
+        }
+        else if (linear_counter > 0)
+        {
+            --linear_counter;
+        }
+
+        if (!control)
+        {
+            linear_reload = false;
+        }
+    }
+
+    void TriangleChannel::clock_half()
+    {
+        if (!control && length > 0)
+        {
+            --length;
+        }
+    }
+
+    void TriangleChannel::run(BlipBuffer &blip, std::uint64_t frame_start, std::uint64_t from, std::uint64_t end)
+    {
+        std::uint64_t period = std::uint64_t(timer_period) + 1;
+
+        output.set(blip, std::uint32_t(from - frame_start), TRIANGLE_TABLE[phase]);
+
+        // 三角波停止时保持当前电平；周期过小时是超声波，同样不步进
+        if (length == 0 || linear_counter == 0 || timer_period < 2)
+        {
+            skip_clocks(time, end, period);
+            return;
+        }
+
+        while (time <= end)
+        {
+            phase = (phase + 1) & 31;
+            output.set(blip, std::uint32_t(time - frame_start), TRIANGLE_TABLE[phase]);
+            time += period;
+        }
+    }
+
+    NoiseChannel::NoiseChannel() : enabled(false),
+                                   short_mode(false),
+                                   period_index(0),
+                                   length(0),
+                                   lfsr(1),
+                                   time(0),
+                                   output(NOISE_WEIGHT) {}
+
+    void NoiseChannel::write(int reg, Byte data)
+    {
+        switch (reg)
+        {
+        case 0:
+            envelope.write(data);
+            break;
+
+        case 2:
+            short_mode = data & 0x80;
+            period_index = data & 0x0F;
+            break;
+
+        case 3:
+            if (enabled)
+            {
+                length = LENGTH_TABLE[data >> 3];
+            }
+
+            envelope.start = true;
+            break;
+        }
+    }
+
+    void NoiseChannel::clock_quarter()
+    {
+        envelope.clock();
+    }
+
+    void NoiseChannel::clock_half()
+    {
+        if (!envelope.loop && length > 0)
+        {
+            --length;
+        }
+    }
+
+    void NoiseChannel::run(BlipBuffer &blip, std::uint64_t frame_start, std::uint64_t from, std::uint64_t end)
+    {
+        std::uint64_t period = NOISE_PERIODS[period_index];
+        int tap = short_mode ? 6 : 1;
+        int volume = length == 0 ? 0 : envelope.volume();
+
+        output.set(blip, std::uint32_t(from - frame_start), (lfsr & 1) ? 0 : volume);
+
+        // 静音时移位寄存器照常运转，只是不产生阶跃
+        if (volume == 0)
+        {
+            for (; time <= end; time += period)
+            {
+                DobuleByte feedback = (lfsr ^ (lfsr >> tap)) & 1;
+                lfsr = (lfsr >> 1) | (feedback << 14);
+            }
+            return;
+        }
+
+        for (; time <= end; time += period)
+        {
+            DobuleByte feedback = (lfsr ^ (lfsr >> tap)) & 1;
+            lfsr = (lfsr >> 1) | (feedback << 14);
+            output.set(blip, std::uint32_t(time - frame_start), (lfsr & 1) ? 0 : volume);
+        }
+    }
+
+    DmcChannel::DmcChannel() : irq_enabled(false),
+                               loop(false),
+                               irq(false),
+                               rate_index(0),
+                               level(0),
+                               sample_address(0xC000),
+                               sample_length(1),
+                               current_address(0xC000),
+                               bytes_remaining(0),
+                               buffer(0),
+                               buffer_full(false),
+                               shift(0),
+                               bits_remaining(8),
+                               silence(true),
+                               time(0),
+                               output(DMC_WEIGHT),
+                               stall(0) {}
+
+    void DmcChannel::write(int reg, Byte data)
+    {
+        switch (reg)
+        {
+        case 0:
+            irq_enabled = data & 0x80;
+            loop = data & 0x40;
+            rate_index = data & 0x0F;
+
+            if (!irq_enabled)
+            {
+                irq = false;
+            }
+            break;
+
+        case 1:
+            level = data & 0x7F;
+            break;
+
+        case 2:
+            sample_address = 0xC000 | (Address(data) << 6);
+            break;
+
+        case 3:
+            sample_length = (DobuleByte(data) << 4) | 1;
+            break;
+        }
+    }
+
+    void DmcChannel::set_enabled(bool enabled, const Reader &reader)
+    {
+        irq = false;
+
+        if (!enabled)
+        {
+            bytes_remaining = 0;
+        }
+        else if (bytes_remaining == 0)
+        {
+            current_address = sample_address;
+            bytes_remaining = sample_length;
+            fill_buffer(reader);
+        }
+    }
+
+    void DmcChannel::fill_buffer(const Reader &reader)
+    {
+        if (buffer_full || bytes_remaining == 0)
+        {
+            return;
+        }
+
+        buffer = reader ? reader(current_address) : 0;
+        buffer_full = true;
+        stall += 4;
+        current_address = current_address == 0xFFFF ? 0x8000 : current_address + 1;
+
+        if (--bytes_remaining == 0)
+        {
+            if (loop)
+            {
+                current_address = sample_address;
+                bytes_remaining = sample_length;
+            }
+            else if (irq_enabled)
+            {
+                irq = true;
+            }
+        }
+    }
+
+    void DmcChannel::start_output_cycle(const Reader &reader)
+    {
+        bits_remaining = 8;
+        silence = !buffer_full;
+
+        if (buffer_full)
+        {
+            shift = buffer;
+            buffer_full = false;
+            fill_buffer(reader);
+        }
+    }
+
+    std::uint64_t DmcChannel::next_fetch() const
+    {
+        if (bytes_remaining == 0 || !buffer_full)
+        {
+            return NEVER;
+        }
+
+        // 输出单元取走缓冲字节的那个时钟
+        return time + std::uint64_t(bits_remaining - 1) * DMC_RATES[rate_index];
+    }
+
+    void DmcChannel::run(BlipBuffer &blip, std::uint64_t frame_start, std::uint64_t from, std::uint64_t end,
+                         const Reader &reader)
+    {
+        std::uint64_t period = DMC_RATES[rate_index];
+
+        output.set(blip, std::uint32_t(from - frame_start), level);
+
+        for (; time <= end; time += period)
+        {
+            if (!silence)
+            {
+                if (shift & 1)
+                {
+                    if (level <= 125)
+                    {
+                        level += 2;
+                    }
+                }
+                else if (level >= 2)
+                {
+                    level -= 2;
+                }
+
+                output.set(blip, std::uint32_t(time - frame_start), level);
+            }
+
+            shift >>= 1;
+
+            if (--bits_remaining == 0)
+            {
+                start_output_cycle(reader);
+            }
+        }
+    }
+
+    void DmcChannel::run_status(std::uint64_t end, const Reader &reader)
+    {
+        std::uint64_t period = DMC_RATES[rate_index];
+
+        while (true)
+        {
+            std::uint64_t boundary = time + std::uint64_t(bits_remaining - 1) * period;
+
+            if (boundary > end)
+            {
+                std::uint64_t count = skip_clocks(time, end, period);
+                bits_remaining -= Byte(count);
+                shift = Byte(shift >> count);
+                return;
+            }
+
+            time = boundary + period;
+            start_output_cycle(reader);
+        }
+    }
+
+    APU::APU(long sample_rate, APUMode mode) : mode(mode),
+                                               pulse1(false),
+                                               pulse2(true),
+                                               blip(CPU_CLOCK_RATE, sample_rate,
+                                                    std::size_t(std::uint64_t(FLUSH_INTERVAL) * sample_rate / CPU_CLOCK_RATE) + 64),
+                                               sink(nullptr),
+                                               samples(std::size_t(std::uint64_t(FLUSH_INTERVAL) * sample_rate / CPU_CLOCK_RATE) + 64),
+                                               dc_input(0.0f),
+                                               dc_output(0.0f)
+    {
+        reset();
+    }
+
+    void APU::reset(std::uint64_t cycle)
+    {
+        pulse1 = PulseChannel(false);
+        pulse2 = PulseChannel(true);
+        triangle = TriangleChannel();
+        noise = NoiseChannel();
+        dmc = DmcChannel();
+
+        pulse1.time = cycle + 2;
+        pulse2.time = cycle + 2;
+        triangle.time = cycle + 1;
+        noise.time = cycle + NOISE_PERIODS[0];
+        dmc.time = cycle + DMC_RATES[0];
+
+        five_step = false;
+        irq_inhibit = false;
+        frame_irq = false;
+
+        last_time = cycle;
+        frame_start = cycle;
+        blip.clear();
+        bind_outputs();
+
+        restart_frame_counter(cycle);
+        update_next_event();
+    }
+
+    APUMode APU::get_mode() const
+    {
+        return mode;
+    }
+
+    void APU::set_mode(APUMode mode)
+    {
+        if (mode == this->mode)
+        {
+            return;
+        }
+
+        if (this->mode == Status_Only)
+        {
+            // 关闭合成期间波形声道没有推进，从当前时刻重新开始计时
+            pulse1.time = last_time + 1;
+            pulse2.time = last_time + 1;
+            triangle.time = last_time + 1;
+            noise.time = last_time + 1;
+            frame_start = last_time;
+        }
+        else
+        {
+            flush(last_time);
+        }
+
+        this->mode = mode;
+        bind_outputs();
+        update_next_event();
+    }
+
+    void APU::bind_outputs()
+    {
+        ChannelOutput *outputs[5] = {&pulse1.output, &pulse2.output, &triangle.output, &noise.output, &dmc.output};
+
+        if (mode == Resampled_Synthesis && !resampler)
+        {
+            resampler.reset(new Resampler(CPU_CLOCK_RATE / 2.0, blip.sample_rate(), LEVEL_CAPACITY));
+            levels.resize(LEVEL_CAPACITY * 5);
+            mixed.resize(LEVEL_CAPACITY);
+            resampled.resize(resampler->max_output());
+            samples.resize(std::max(samples.size(), resampled.size()));
+        }
+
+        if (mode == Full_Synthesis)
+        {
+            // blip 缓冲区从静音开始，电平在下一次推进时重新以阶跃写入
+            blip.clear();
+        }
+
+        for (int k = 0; k < 5; ++k)
+        {
+            outputs[k]->levels = mode == Resampled_Synthesis ? &levels[k * LEVEL_CAPACITY] : nullptr;
+            outputs[k]->filled = 0;
+
+            if (mode == Full_Synthesis)
+            {
+                outputs[k]->last = 0;
+            }
+        }
+    }
+
+    void APU::set_sink(AudioSink *sink)
+    {
+        this->sink = sink;
+    }
+
+    void APU::set_dmc_reader(DmcChannel::Reader reader)
+    {
+        dmc_reader = reader;
+    }
+
+    void APU::write_register(Address addr, Byte data, std::uint64_t cycle)
+    {
+        run_until(cycle);
+
+        if (addr < 0x4004)
+        {
+            pulse1.write(addr & 3, data);
+        }
+        else if (addr < 0x4008)
+        {
+            pulse2.write(addr & 3, data);
+        }
+        else if (addr < 0x400C)
+        {
+            triangle.write(addr & 3, data);
+        }
+        else if (addr < 0x4010)
+        {
+            noise.write(addr & 3, data);
+        }
+        else if (addr < 0x4014)
+        {
+            dmc.write(addr & 3, data);
+        }
+        else if (addr == 0x4015)
+        {
+            pulse1.enabled = data & 0x01;
+            pulse2.enabled = data & 0x02;
+            triangle.enabled = data & 0x04;
+            noise.enabled = data & 0x08;
+
+            if (!pulse1.enabled)
+            {
+                pulse1.length = 0;
+            }
+            if (!pulse2.enabled)
+            {
+                pulse2.length = 0;
+            }
+            if (!triangle.enabled)
+            {
+                triangle.length = 0;
+            }
+            if (!noise.enabled)
+            {
+                noise.length = 0;
+            }
+
+            dmc.set_enabled(data & 0x10, dmc_reader);
+        }
+        else if (addr == 0x4017)
+        {
+            five_step = data & 0x80;
+            irq_inhibit = data & 0x40;
+
+            if (irq_inhibit)
+            {
+                frame_irq = false;
+            }
+
+            restart_frame_counter(cycle);
+        }
+
+        update_next_event();
+    }
+
+    Byte APU::read_status(std::uint64_t cycle)
+    {
+        run_until(cycle);
+
+        Byte result = 0;
+
+        if (pulse1.length > 0)
+        {
+            result |= 0x01;
+        }
+        if (pulse2.length > 0)
+        {
+            result |= 0x02;
+        }
+        if (triangle.length > 0)
+        {
+            result |= 0x04;
+        }
+        if (noise.length > 0)
+        {
+            result |= 0x08;
+        }
+        if (dmc.bytes_remaining > 0)
+        {
+            result |= 0x10;
+        }
+        if (frame_irq)
+        {
+            result |= 0x40;
+        }
+        if (dmc.irq)
+        {
+            result |= 0x80;
+        }
+
+        // 读 $4015 清除帧中断标志
+        frame_irq = false;
+        update_next_event();
+
+        return result;
+    }
+
+    void APU::run_until(std::uint64_t cycle)
+    {
+        while (mode != Status_Only && cycle >= frame_start + FLUSH_INTERVAL)
+        {
+            flush(frame_start + FLUSH_INTERVAL);
+        }
+
+        advance(cycle);
+        update_next_event();
+    }
+
+    void APU::end_frame(std::uint64_t cycle)
+    {
+        run_until(cycle);
+
+        if (mode != Status_Only && cycle > frame_start)
+        {
+            flush(cycle);
+        }
+
+        update_next_event();
+    }
+
+    void APU::advance(std::uint64_t cycle)
+    {
+        while (frame_next <= cycle)
+        {
+            run_channels(frame_next);
+            clock_frame_step();
+        }
+
+        run_channels(cycle);
+    }
+
+    void APU::run_channels(std::uint64_t end)
+    {
+        if (end < last_time)
+        {
+            return;
+        }
+
+        if (mode == Status_Only)
+        {
+            dmc.run_status(end, dmc_reader);
+        }
+        else
+        {
+            pulse1.run(blip, frame_start, last_time, end);
+            pulse2.run(blip, frame_start, last_time, end);
+            triangle.run(blip, frame_start, last_time, end);
+            noise.run(blip, frame_start, last_time, end);
+            dmc.run(blip, frame_start, last_time, end, dmc_reader);
+        }
+
+        last_time = end;
+    }
+
+    void APU::clock_frame_step()
+    {
+        bool half = frame_step == 1 || frame_step == 3;
+
+        pulse1.clock_quarter();
+        pulse2.clock_quarter();
+        triangle.clock_quarter();
+        noise.clock_quarter();
+
+        if (half)
+        {
+            pulse1.clock_half();
+            pulse2.clock_half();
+            triangle.clock_half();
+            noise.clock_half();
+        }
+
+        if (!five_step && frame_step == 3 && !irq_inhibit)
+        {
+            frame_irq = true;
+        }
+
+        if (++frame_step == 4)
+        {
+            frame_step = 0;
+            frame_sequence_start += five_step ? FIVE_STEP_PERIOD : FOUR_STEP_PERIOD;
+        }
+
+        frame_next = frame_sequence_start + (five_step ? FIVE_STEP_TIMES : FOUR_STEP_TIMES)[frame_step];
+    }
+
+    void APU::restart_frame_counter(std::uint64_t cycle)
+    {
+        frame_step = 0;
+        frame_sequence_start = cycle;
+        frame_next = cycle + (five_step ? FIVE_STEP_TIMES[0] : FOUR_STEP_TIMES[0]);
+
+        // 5 步模式写入时立即产生一次四分之一帧和半帧时钟
+        if (five_step)
+        {
+            pulse1.clock_quarter();
+            pulse2.clock_quarter();
+            triangle.clock_quarter();
+            noise.clock_quarter();
+
+            pulse1.clock_half();
+            pulse2.clock_half();
+            triangle.clock_half();
+            noise.clock_half();
+        }
+    }
+
+    void APU::flush(std::uint64_t cycle)
+    {
+        if (mode == Resampled_Synthesis)
+        {
+            flush_resampled(cycle);
+            return;
+        }
+
+        advance(cycle);
+        blip.end_frame(std::uint32_t(cycle - frame_start));
+        frame_start = cycle;
+
+        while (blip.samples_available() > 0)
+        {
+            std::size_t count = blip.read_samples(&samples[0], samples.size());
+
+            if (sink != nullptr)
+            {
+                sink->write_samples(&samples[0], count);
+            }
+        }
+    }
+
+    void APU::flush_resampled(std::uint64_t cycle)
+    {
+        advance(cycle);
+
+        // 帧起点保持在偶数个 CPU 周期上，多出的一个周期留给下一帧
+        std::uint32_t count = std::uint32_t((cycle - frame_start) >> 1);
+        ChannelOutput *outputs[5] = {&pulse1.output, &pulse2.output, &triangle.output, &noise.output, &dmc.output};
+
+        for (int k = 0; k < 5; ++k)
+        {
+            outputs[k]->fill_to(count);
+            outputs[k]->filled = 0;
+        }
+
+        ChannelLevels channel_levels = {&levels[0], &levels[LEVEL_CAPACITY], &levels[LEVEL_CAPACITY * 2],
+                                        &levels[LEVEL_CAPACITY * 3], &levels[LEVEL_CAPACITY * 4]};
+        mixer.mix(channel_levels, count, &mixed[0]);
+
+        std::size_t produced = resampler->process(&mixed[0], count, &resampled[0]);
+
+        // 一阶隔直滤波后转成 16 位
+        for (std::size_t i = 0; i < produced; ++i)
+        {
+            float y = resampled[i] - dc_input + 0.995f * dc_output;
+            dc_input = resampled[i];
+            dc_output = y;
+
+            float s = y * 32767.0f;
+            samples[i] = std::int16_t(s > 32767.0f ? 32767 : (s < -32768.0f ? -32768 : int(s)));
+        }
+
+        frame_start += std::uint64_t(count) * 2;
+
+        if (sink != nullptr && produced > 0)
+        {
+            sink->write_samples(&samples[0], produced);
+        }
+    }
+
+    void APU::update_next_event()
+    {
+        next_event = frame_next;
+
+        std::uint64_t fetch = dmc.next_fetch();
+        if (fetch < next_event)
+        {
+            next_event = fetch;
+        }
+
+        if (mode != Status_Only && frame_start + FLUSH_INTERVAL < next_event)
+        {
+            next_event = frame_start + FLUSH_INTERVAL;
+        }
+    }
+}
@@ -0,0 +1,117 @@
+#include "AudioMixer.h"
+
+#if MYSN_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace mysn
+{
+    namespace
+    {
+        void mix_scalar(const ChannelLevels &in, std::size_t begin, std::size_t count, float *out)
+        {
+            for (std::size_t i = begin; i < count; ++i)
+            {
+                out[i] = PULSE_MIX * float(in.pulse1[i] + in.pulse2[i]) +
+                         TRIANGLE_MIX * float(in.triangle[i]) +
+                         NOISE_MIX * float(in.noise[i]) +
+                         DMC_MIX * float(in.dmc[i]);
+            }
+        }
+
+#if MYSN_X86_SIMD
+        // 16 个 u8 扩展成 4 组 4 个 i32
+        inline void widen_u8(__m128i bytes, __m128i out[4])
+        {
+            const __m128i zero = _mm_setzero_si128();
+            __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+            __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+
+            out[0] = _mm_unpacklo_epi16(lo, zero);
+            out[1] = _mm_unpackhi_epi16(lo, zero);
+            out[2] = _mm_unpacklo_epi16(hi, zero);
+            out[3] = _mm_unpackhi_epi16(hi, zero);
+        }
+
+        void mix_sse2(const ChannelLevels &in, std::size_t count, float *out)
+        {
+            const __m128 pulse_mix = _mm_set1_ps(PULSE_MIX);
+            const __m128 triangle_mix = _mm_set1_ps(TRIANGLE_MIX);
+            const __m128 noise_mix = _mm_set1_ps(NOISE_MIX);
+            const __m128 dmc_mix = _mm_set1_ps(DMC_MIX);
+
+            std::size_t i = 0;
+
+            for (; i + 16 <= count; i += 16)
+            {
+                __m128i p1[4], p2[4], t[4], n[4], d[4];
+                widen_u8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in.pulse1 + i)), p1);
+                widen_u8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in.pulse2 + i)), p2);
+                widen_u8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in.triangle + i)), t);
+                widen_u8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in.noise + i)), n);
+                widen_u8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in.dmc + i)), d);
+
+                for (int k = 0; k < 4; ++k)
+                {
+                    __m128 sum = _mm_mul_ps(pulse_mix, _mm_cvtepi32_ps(_mm_add_epi32(p1[k], p2[k])));
+                    sum = _mm_add_ps(sum, _mm_mul_ps(triangle_mix, _mm_cvtepi32_ps(t[k])));
+                    sum = _mm_add_ps(sum, _mm_mul_ps(noise_mix, _mm_cvtepi32_ps(n[k])));
+                    sum = _mm_add_ps(sum, _mm_mul_ps(dmc_mix, _mm_cvtepi32_ps(d[k])));
+                    _mm_storeu_ps(out + i + k * 4, sum);
+                }
+            }
+
+            mix_scalar(in, i, count, out);
+        }
+
+        MYSN_TARGET_AVX2 inline __m256 load_u8x8(const std::uint8_t *p)
+        {
+            __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+            return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+        }
+
+        MYSN_TARGET_AVX2 void mix_avx2(const ChannelLevels &in, std::size_t count, float *out)
+        {
+            const __m256 pulse_mix = _mm256_set1_ps(PULSE_MIX);
+            const __m256 triangle_mix = _mm256_set1_ps(TRIANGLE_MIX);
+            const __m256 noise_mix = _mm256_set1_ps(NOISE_MIX);
+            const __m256 dmc_mix = _mm256_set1_ps(DMC_MIX);
+
+            std::size_t i = 0;
+
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256 pulse = _mm256_add_ps(load_u8x8(in.pulse1 + i), load_u8x8(in.pulse2 + i));
+                __m256 sum = _mm256_mul_ps(pulse_mix, pulse);
+                sum = _mm256_fmadd_ps(triangle_mix, load_u8x8(in.triangle + i), sum);
+                sum = _mm256_fmadd_ps(noise_mix, load_u8x8(in.noise + i), sum);
+                sum = _mm256_fmadd_ps(dmc_mix, load_u8x8(in.dmc + i), sum);
+                _mm256_storeu_ps(out + i, sum);
+            }
+
+            mix_scalar(in, i, count, out);
+        }
+#endif
+    }
+
+    AudioMixer::AudioMixer(SimdLevel level) : level(level) {}
+
+    void AudioMixer::mix(const ChannelLevels &levels, std::size_t count, float *out) const
+    {
+        switch (level)
+        {
+#if MYSN_X86_SIMD
+        case Simd_AVX2:
+            mix_avx2(levels, count, out);
+            return;
+
+        case Simd_SSE2:
+            mix_sse2(levels, count, out);
+            return;
+#endif
+        default:
+            mix_scalar(levels, 0, count, out);
+            return;
+        }
+    }
+}
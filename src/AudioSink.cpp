@@ -0,0 +1,114 @@
+#include "AudioSink.h"
+
+namespace mysn
+{
+    namespace
+    {
+        void put_u16(std::FILE *file, std::uint16_t value)
+        {
+            std::uint8_t bytes[2] = {std::uint8_t(value), std::uint8_t(value >> 8)};
+            std::fwrite(bytes, 1, 2, file);
+        }
+
+        void put_u32(std::FILE *file, std::uint32_t value)
+        {
+            std::uint8_t bytes[4] = {std::uint8_t(value), std::uint8_t(value >> 8),
+                                  std::uint8_t(value >> 16), std::uint8_t(value >> 24)};
+            std::fwrite(bytes, 1, 4, file);
+        }
+    }
+
+    WavWriter::WavWriter(const std::string &path, long sample_rate)
+        : file(std::fopen(path.c_str(), "wb")),
+          data_bytes(0)
+    {
+        if (file != nullptr)
+        {
+            write_header(sample_rate);
+        }
+    }
+
+    WavWriter::~WavWriter()
+    {
+        close();
+    }
+
+    bool WavWriter::is_open() const
+    {
+        return file != nullptr;
+    }
+
+    void WavWriter::write_header(long sample_rate)
+    {
+        const std::uint16_t channels = 1;
+        const std::uint16_t bits = 16;
+
+        std::fwrite("RIFF", 1, 4, file);
+        put_u32(file, 0); // 回填
+        std::fwrite("WAVE", 1, 4, file);
+
+        std::fwrite("fmt ", 1, 4, file);
+        put_u32(file, 16);
+        put_u16(file, 1); // PCM
+        put_u16(file, channels);
+        put_u32(file, std::uint32_t(sample_rate));
+        put_u32(file, std::uint32_t(sample_rate) * channels * bits / 8);
+        put_u16(file, channels * bits / 8);
+        put_u16(file, bits);
+
+        std::fwrite("data", 1, 4, file);
+        put_u32(file, 0); // 回填
+    }
+
+    void WavWriter::write_samples(const std::int16_t *samples, std::size_t count)
+    {
+        if (file == nullptr)
+        {
+            return;
+        }
+
+        // WAV 固定小端序，分块转换后整块写入
+        std::uint8_t chunk[1024];
+
+        for (std::size_t i = 0; i < count;)
+        {
+            std::size_t n = 0;
+
+            for (; i < count && n < sizeof(chunk); ++i, n += 2)
+            {
+                chunk[n] = std::uint8_t(samples[i]);
+                chunk[n + 1] = std::uint8_t(std::uint16_t(samples[i]) >> 8);
+            }
+
+            std::fwrite(chunk, 1, n, file);
+        }
+
+        data_bytes += std::uint32_t(count * 2);
+    }
+
+    void WavWriter::close()
+    {
+        if (file == nullptr)
+        {
+            return;
+        }
+
+        std::fseek(file, 4, SEEK_SET);
+        put_u32(file, 36 + data_bytes);
+        std::fseek(file, 40, SEEK_SET);
+        put_u32(file, data_bytes);
+
+        std::fclose(file);
+        file = nullptr;
+    }
+
+    CallbackSink::CallbackSink(Callback callback) : callback(callback) {}
+
+    void CallbackSink::write_samples(const std::int16_t *samples, std::size_t count)
+    {
+        if (callback)
+        {
+            callback(samples, count);
+        }
+    }
+}
@@ -0,0 +1,1059 @@
+#include "BatchCPU.h"
+#include "CPUOpcodes.h"
+#include "SimdDispatch.h"
+#include <algorithm>
+#include <cstring>
+
+#if MYSN_X86_SIMD && defined(__SSE2__)
+#define MYSN_BATCH_SSE2 1
+#include <emmintrin.h>
+#else
+#define MYSN_BATCH_SSE2 0
+#endif
+
+namespace mysn
+{
+    namespace
+    {
+        const int LANES = int(BatchCPU::LANES);
+        const Address ROM_START = BatchCPU::ROM_START;
+        const std::size_t RAM_SIZE = BatchCPU::RAM_SIZE;
+        const unsigned FULL_MASK = (1u << LANES) - 1;
+
+        struct OpcodeInfo
+        {
+            bool valid;
+            CPUOpcodeMnemonics mnemonic;
+            AddressingMode mode;
+            Byte len;
+            Byte cycles;
+        };
+
+        // 以操作码为下标展开的指令表，执行时不查 map
+        const OpcodeInfo *opcode_table()
+        {
+            struct Table
+            {
+                OpcodeInfo entries[256];
+
+                Table()
+                {
+                    std::memset(entries, 0, sizeof(entries));
+
+                    for (auto &opcode : CPUOpcodes::CPU_OPS_CODES_MAP)
+                    {
+                        OpcodeInfo &info = entries[opcode.first];
+                        info.valid = true;
+                        info.mnemonic = opcode.second.mnemonic;
+                        info.mode = opcode.second.mode;
+                        info.len = opcode.second.len;
+                        info.cycles = opcode.second.cycles;
+                    }
+                }
+            };
+
+            static const Table table;
+
+            return table.entries;
+        }
+
+        // 16 个实例的同一个 8 位寄存器。比较结果按字节全 1 或全 0
+#if MYSN_BATCH_SSE2
+        typedef __m128i Vec;
+
+        inline Vec vload(const Byte *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+        inline void vstore(Byte *p, Vec v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v); }
+        inline Vec vsplat(Byte value) { return _mm_set1_epi8(char(value)); }
+        inline Vec vand(Vec a, Vec b) { return _mm_and_si128(a, b); }
+        inline Vec vor(Vec a, Vec b) { return _mm_or_si128(a, b); }
+        inline Vec vxor(Vec a, Vec b) { return _mm_xor_si128(a, b); }
+        inline Vec vadd(Vec a, Vec b) { return _mm_add_epi8(a, b); }
+        inline Vec vsub(Vec a, Vec b) { return _mm_sub_epi8(a, b); }
+        inline Vec veq(Vec a, Vec b) { return _mm_cmpeq_epi8(a, b); }
+        // 无符号 a >= b
+        inline Vec vge(Vec a, Vec b) { return _mm_cmpeq_epi8(_mm_max_epu8(a, b), a); }
+        inline Vec vshl1(Vec a) { return _mm_add_epi8(a, a); }
+        // SSE2 没有 8 位移位，按 16 位移后清掉从高字节移进来的位
+        inline Vec vshr1(Vec a) { return _mm_and_si128(_mm_srli_epi16(a, 1), _mm_set1_epi8(0x7f)); }
+        inline Vec vselect(Vec mask, Vec a, Vec b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+        inline unsigned vbits(Vec mask) { return unsigned(_mm_movemask_epi8(mask)); }
+#else
+        struct Vec
+        {
+            Byte v[16];
+        };
+
+        template <typename Op>
+        inline Vec vmap(Vec a, Vec b, Op op)
+        {
+            Vec r;
+            for (int i = 0; i < 16; ++i)
+            {
+                r.v[i] = Byte(op(a.v[i], b.v[i]));
+            }
+            return r;
+        }
+
+        inline Vec vload(const Byte *p)
+        {
+            Vec r;
+            std::memcpy(r.v, p, 16);
+            return r;
+        }
+
+        inline void vstore(Byte *p, Vec v) { std::memcpy(p, v.v, 16); }
+
+        inline Vec vsplat(Byte value)
+        {
+            Vec r;
+            std::memset(r.v, value, 16);
+            return r;
+        }
+
+        inline Vec vand(Vec a, Vec b) { return vmap(a, b, [](Byte x, Byte y) { return x & y; }); }
+        inline Vec vor(Vec a, Vec b) { return vmap(a, b, [](Byte x, Byte y) { return x | y; }); }
+        inline Vec vxor(Vec a, Vec b) { return vmap(a, b, [](Byte x, Byte y) { return x ^ y; }); }
+        inline Vec vadd(Vec a, Vec b) { return vmap(a, b, [](Byte x, Byte y) { return x + y; }); }
+        inline Vec vsub(Vec a, Vec b) { return vmap(a, b, [](Byte x, Byte y) { return x - y; }); }
+        inline Vec veq(Vec a, Vec b) { return vmap(a, b, [](Byte x, Byte y) { return x == y ? 0xff : 0; }); }
+        inline Vec vge(Vec a, Vec b) { return vmap(a, b, [](Byte x, Byte y) { return x >= y ? 0xff : 0; }); }
+        inline Vec vshl1(Vec a) { return vadd(a, a); }
+        inline Vec vshr1(Vec a) { return vmap(a, a, [](Byte x, Byte) { return x >> 1; }); }
+
+        inline Vec vselect(Vec mask, Vec a, Vec b)
+        {
+            return vor(vand(mask, a), vand(vxor(mask, vsplat(0xff)), b));
+        }
+
+        inline unsigned vbits(Vec mask)
+        {
+            unsigned bits = 0;
+            for (int i = 0; i < 16; ++i)
+            {
+                bits |= unsigned(mask.v[i] >> 7) << i;
+            }
+            return bits;
+        }
+#endif
+
+        inline Vec vnonzero(Vec a)
+        {
+            return vxor(veq(a, vsplat(0)), vsplat(0xff));
+        }
+
+        // 第 i 位为 1 的实例对应字节全 1
+        inline Vec vmask(unsigned bits)
+        {
+            Byte mask[16];
+            for (int i = 0; i < 16; ++i)
+            {
+                mask[i] = (bits >> i) & 1 ? 0xff : 0;
+            }
+            return vload(mask);
+        }
+
+        inline Vec with_nz(Vec status, Vec result)
+        {
+            Vec zero = vand(veq(result, vsplat(0)), vsplat(CpuFlags::Zero));
+            Vec negative = vand(result, vsplat(CpuFlags::Negative));
+
+            return vor(vor(vand(status, vsplat(Byte(~(CpuFlags::Zero | CpuFlags::Negative)))), negative), zero);
+        }
+
+        // condition 按字节全 1 或全 0
+        inline Vec with_flag(Vec status, CpuFlags flag, Vec condition)
+        {
+            return vor(vand(status, vsplat(Byte(~flag))), vand(condition, vsplat(flag)));
+        }
+
+        inline Byte with_nz(Byte status, Byte result)
+        {
+            return Byte((status & ~(CpuFlags::Zero | CpuFlags::Negative)) | (result & CpuFlags::Negative) |
+                        (result == 0 ? CpuFlags::Zero : 0));
+        }
+
+        inline int lowest(unsigned bits)
+        {
+            return __builtin_ctz(bits);
+        }
+
+        // 一组 16 个实例的视图，寄存器都指向 BatchCPU 里这一组的起始位置
+        struct Lanes
+        {
+            Address *pc;
+            Byte *a;
+            Byte *x;
+            Byte *y;
+            Byte *sp;
+            Byte *status;
+            Byte *stopped;
+            std::uint64_t *cycles;
+            Byte *ram;
+            const Byte *rom;
+
+            Byte read(int lane, Address addr) const
+            {
+                if (addr >= ROM_START)
+                {
+                    return rom[addr - ROM_START];
+                }
+
+                std::size_t offset = writable_offset(addr);
+
+                return offset < RAM_SIZE ? ram[offset * LANES + lane] : 0;
+            }
+
+            void write(int lane, Address addr, Byte data)
+            {
+                std::size_t offset = addr < ROM_START ? writable_offset(addr) : RAM_SIZE;
+
+                if (offset < RAM_SIZE)
+                {
+                    ram[offset * LANES + lane] = data;
+                }
+            }
+
+            Address read_u16(int lane, Address addr) const
+            {
+                return Address(read(lane, addr) | read(lane, Address(addr + 1)) << 8);
+            }
+
+            void push(int lane, Byte data)
+            {
+                write(lane, Address(0x100 | sp[lane]), data);
+                --sp[lane];
+            }
+
+            Byte pop(int lane)
+            {
+                return read(lane, Address(0x100 | ++sp[lane]));
+            }
+        };
+
+        // 操作数地址：所有实例相同时是一次向量访问，否则逐个实例访问
+        struct Operand
+        {
+            bool uniform;
+            Address addr;
+            Address lanes[16];
+            // 变址后跨页的实例，读指令要多算一个周期
+            unsigned crossed;
+        };
+
+        void resolve(const Lanes &g, AddressingMode mode, Address pc, Byte op, Address word, unsigned mask, Operand &out)
+        {
+            out.uniform = true;
+            out.crossed = 0;
+
+            switch (mode)
+            {
+            case Immediate:
+                out.addr = Address(pc + 1);
+                return;
+
+            case ZeroPage:
+                out.addr = op;
+                return;
+
+            case Absolute:
+                out.addr = word;
+                return;
+
+            default:
+                break;
+            }
+
+            for (int i = 0; i < LANES; ++i)
+            {
+                Address addr = 0;
+
+                switch (mode)
+                {
+                // 变址零页和零页指针都在零页内回绕
+                case ZeroPage_X:
+                    addr = Byte(op + g.x[i]);
+                    break;
+
+                case ZeroPage_Y:
+                    addr = Byte(op + g.y[i]);
+                    break;
+
+                case Absolute_X:
+                    addr = Address(word + g.x[i]);
+                    out.crossed |= unsigned(((word ^ addr) & 0xFF00) != 0) << i;
+                    break;
+
+                case Absolute_Y:
+                    addr = Address(word + g.y[i]);
+                    out.crossed |= unsigned(((word ^ addr) & 0xFF00) != 0) << i;
+                    break;
+
+                case Indirect_X:
+                {
+                    Byte pointer = Byte(op + g.x[i]);
+                    addr = Address(g.read(i, pointer) | g.read(i, Byte(pointer + 1)) << 8);
+                    break;
+                }
+
+                case Indirect_Y:
+                {
+                    Address base = Address(g.read(i, op) | g.read(i, Byte(op + 1)) << 8);
+                    addr = Address(base + g.y[i]);
+                    out.crossed |= unsigned(((base ^ addr) & 0xFF00) != 0) << i;
+                    break;
+                }
+
+                default:
+                    break;
+                }
+
+                out.lanes[i] = addr;
+            }
+
+            // 变址寄存器相同时（例如锁步的循环计数）仍然是一次向量访问
+            out.addr = out.lanes[lowest(mask)];
+            for (unsigned bits = mask; bits != 0; bits &= bits - 1)
+            {
+                if (out.lanes[lowest(bits)] != out.addr)
+                {
+                    out.uniform = false;
+                    return;
+                }
+            }
+        }
+
+        Vec load(const Lanes &g, const Operand &operand)
+        {
+            if (operand.uniform)
+            {
+                if (operand.addr >= ROM_START)
+                {
+                    return vsplat(g.rom[operand.addr - ROM_START]);
+                }
+
+                std::size_t offset = writable_offset(operand.addr);
+
+                return offset < RAM_SIZE ? vload(g.ram + offset * LANES) : vsplat(0);
+            }
+
+            Byte values[16];
+            for (int i = 0; i < LANES; ++i)
+            {
+                values[i] = g.read(i, operand.lanes[i]);
+            }
+            return vload(values);
+        }
+
+        void store(Lanes &g, const Operand &operand, Vec value, Vec m, unsigned mask)
+        {
+            if (operand.uniform)
+            {
+                std::size_t offset = operand.addr < ROM_START ? writable_offset(operand.addr) : RAM_SIZE;
+
+                if (offset < RAM_SIZE)
+                {
+                    Byte *p = g.ram + offset * LANES;
+                    vstore(p, vselect(m, value, vload(p)));
+                }
+                return;
+            }
+
+            Byte values[16];
+            vstore(values, value);
+            for (unsigned bits = mask; bits != 0; bits &= bits - 1)
+            {
+                int i = lowest(bits);
+                g.write(i, operand.lanes[i], values[i]);
+            }
+        }
+
+        void add_with_carry(Vec &a, Vec &status, Vec value)
+        {
+            Vec sum = vadd(vadd(a, value), vand(status, vsplat(CpuFlags::Carry)));
+            // 第 7 位的进位：两个加数都是 1，或者至少一个是 1 而和是 0
+            Vec carry = vor(vand(a, value), vand(vor(a, value), vxor(sum, vsplat(0xff))));
+            Vec overflow = vand(vxor(a, sum), vxor(value, sum));
+
+            status = with_flag(status, CpuFlags::Carry, vnonzero(vand(carry, vsplat(0x80))));
+            status = with_flag(status, CpuFlags::Overflow, vnonzero(vand(overflow, vsplat(0x80))));
+            a = sum;
+            status = with_nz(status, a);
+        }
+
+        void compare(Vec &status, Vec reg, Vec value)
+        {
+            status = with_flag(status, CpuFlags::Carry, vge(reg, value));
+            status = with_nz(status, vsub(reg, value));
+        }
+
+        // 需要逐个实例读写栈的指令，mask 里每个实例单独执行
+        void execute_lane(Lanes &g, int i, const OpcodeInfo &info, Address pc, Address word)
+        {
+            Address next = Address(pc + info.len);
+
+            switch (info.mnemonic)
+            {
+            case JSR:
+            {
+                g.push(i, Byte(Address(pc + 2) >> 8));
+                g.push(i, Byte(pc + 2));
+                g.pc[i] = word;
+                return;
+            }
+
+            case PHA:
+                g.push(i, g.a[i]);
+                break;
+
+            case PHP:
+                g.push(i, Byte(g.status[i] | CpuFlags::Break | CpuFlags::Break2));
+                break;
+
+            case PLA:
+                g.a[i] = g.pop(i);
+                g.status[i] = with_nz(g.status[i], g.a[i]);
+                break;
+
+            case PLP:
+                g.status[i] = Byte((g.pop(i) & ~CpuFlags::Break) | CpuFlags::Break2);
+                break;
+
+            case RTI:
+            {
+                g.status[i] = Byte((g.pop(i) & ~CpuFlags::Break) | CpuFlags::Break2);
+                Byte lo = g.pop(i);
+                Byte hi = g.pop(i);
+                g.pc[i] = Address(lo | hi << 8);
+                return;
+            }
+
+            case RTS:
+            {
+                Byte lo = g.pop(i);
+                Byte hi = g.pop(i);
+                g.pc[i] = Address((lo | hi << 8) + 1);
+                return;
+            }
+
+            default:
+                break;
+            }
+
+            g.pc[i] = next;
+        }
+
+        // mask 里的实例都停在 pc，指令字节相同
+        void execute(Lanes &g, Address pc, unsigned mask)
+        {
+            int leader = lowest(mask);
+            const OpcodeInfo &info = opcode_table()[g.read(leader, pc)];
+
+            if (!info.valid)
+            {
+                // 与 CPU 一致：停在操作码之后，不计周期
+                for (unsigned bits = mask; bits != 0; bits &= bits - 1)
+                {
+                    int i = lowest(bits);
+                    g.pc[i] = Address(pc + 1);
+                    g.stopped[i] = 1;
+                }
+                return;
+            }
+
+            Byte op = g.read(leader, Address(pc + 1));
+            Address word = g.read_u16(leader, Address(pc + 1));
+
+            if (mask == FULL_MASK)
+            {
+                for (int i = 0; i < LANES; ++i)
+                {
+                    g.cycles[i] += info.cycles;
+                }
+            }
+            else
+            {
+                for (unsigned bits = mask; bits != 0; bits &= bits - 1)
+                {
+                    g.cycles[lowest(bits)] += info.cycles;
+                }
+            }
+
+            switch (info.mnemonic)
+            {
+            case JSR:
+            case PHA:
+            case PHP:
+            case PLA:
+            case PLP:
+            case RTI:
+            case RTS:
+                for (unsigned bits = mask; bits != 0; bits &= bits - 1)
+                {
+                    execute_lane(g, lowest(bits), info, pc, word);
+                }
+                return;
+
+            default:
+                break;
+            }
+
+            Vec m = vmask(mask);
+            Vec a = vload(g.a);
+            Vec x = vload(g.x);
+            Vec y = vload(g.y);
+            Vec sp = vload(g.sp);
+            Vec status = vload(g.status);
+
+            Operand operand;
+            Vec value;
+
+            // 分支和跳转自己写 PC，BRK 停机
+            unsigned taken = 0;
+            Address target = Address(pc + info.len);
+            bool jumps = false;
+            bool halts = false;
+
+            switch (info.mnemonic)
+            {
+            case ADC:
+                resolve(g, info.mode, pc, op, word, mask, operand);
+                add_with_carry(a, status, load(g, operand));
+                break;
+
+            case SBC:
+                resolve(g, info.mode, pc, op, word, mask, operand);
+                add_with_carry(a, status, vxor(load(g, operand), vsplat(0xff)));
+                break;
+
+            case AND:
+                resolve(g, info.mode, pc, op, word, mask, operand);
+                a = vand(a, load(g, operand));
+                status = with_nz(status, a);
+                break;
+
+            case ORA:
+                resolve(g, info.mode, pc, op, word, mask, operand);
+                a = vor(a, load(g, operand));
+                status = with_nz(status, a);
+                break;
+
+            case EOR:
+                resolve(g, info.mode, pc, op, word, mask, operand);
+                a = vxor(a, load(g, operand));
+                status = with_nz(status, a);
+                break;
+
+            case BIT:
+                resolve(g, info.mode, pc, op, word, mask, operand);
+                value = load(g, operand);
+                status = with_flag(status, CpuFlags::Zero, veq(vand(a, value), vsplat(0)));
+                status = vor(vand(status, vsplat(Byte(~(CpuFlags::Overflow | CpuFlags::Negative)))),
+                             vand(value, vsplat(CpuFlags::Overflow | CpuFlags::Negative)));
+                break;
+
+            case CMP:
+                resolve(g, info.mode, pc, op, word, mask, operand);
+                compare(status, a, load(g, operand));
+                break;
+
+            case CPX:
+                resolve(g, info.mode, pc, op, word, mask, operand);
+                compare(status, x, load(g, operand));
+                break;
+
+            case CPY:
+                resolve(g, info.mode, pc, op, word, mask, operand);
+                compare(status, y, load(g, operand));
+                break;
+
+            case ASL:
+            case LSR:
+            case ROL:
+            case ROR:
+            {
+                bool accumulator = info.mode == Accumulator;
+
+                if (!accumulator)
+                {
+                    resolve(g, info.mode, pc, op, word, mask, operand);
+                }
+                value = accumulator ? a : load(g, operand);
+
+                Vec result;
+                Vec carry;
+                if (info.mnemonic == ASL || info.mnemonic == ROL)
+                {
+                    carry = vand(value, vsplat(0x80));
+                    result = vshl1(value);
+                    if (info.mnemonic == ROL)
+                    {
+                        result = vor(result, vand(status, vsplat(CpuFlags::Carry)));
+                    }
+                }
+                else
+                {
+                    carry = vand(value, vsplat(0x01));
+                    result = vshr1(value);
+                    if (info.mnemonic == ROR)
+                    {
+                        result = vor(result, vand(vnonzero(vand(status, vsplat(CpuFlags::Carry))), vsplat(0x80)));
+                    }
+                }
+
+                status = with_flag(status, CpuFlags::Carry, vnonzero(carry));
+                status = with_nz(status, result);
+
+                if (accumulator)
+                {
+                    a = result;
+                }
+                else
+                {
+                    store(g, operand, result, m, mask);
+                }
+                break;
+            }
+
+            case INC:
+            case DEC:
+                resolve(g, info.mode, pc, op, word, mask, operand);
+                value = info.mnemonic == INC ? vadd(load(g, operand), vsplat(1)) : vsub(load(g, operand), vsplat(1));
+                store(g, operand, value, m, mask);
+                status = with_nz(status, value);
+                break;
+
+            case INX:
+                x = vadd(x, vsplat(1));
+                status = with_nz(status, x);
+                break;
+
+            case INY:
+                y = vadd(y, vsplat(1));
+                status = with_nz(status, y);
+                break;
+
+            case DEX:
+                x = vsub(x, vsplat(1));
+                status = with_nz(status, x);
+                break;
+
+            case DEY:
+                y = vsub(y, vsplat(1));
+                status = with_nz(status, y);
+                break;
+
+            case LDA:
+                resolve(g, info.mode, pc, op, word, mask, operand);
+                a = load(g, operand);
+                status = with_nz(status, a);
+                break;
+
+            case LDX:
+                resolve(g, info.mode, pc, op, word, mask, operand);
+                x = load(g, operand);
+                status = with_nz(status, x);
+                break;
+
+            case LDY:
+                resolve(g, info.mode, pc, op, word, mask, operand);
+                y = load(g, operand);
+                status = with_nz(status, y);
+                break;
+
+            case STA:
+                resolve(g, info.mode, pc, op, word, mask, operand);
+                store(g, operand, a, m, mask);
+                break;
+
+            case STX:
+                resolve(g, info.mode, pc, op, word, mask, operand);
+                store(g, operand, x, m, mask);
+                break;
+
+            case STY:
+                resolve(g, info.mode, pc, op, word, mask, operand);
+                store(g, operand, y, m, mask);
+                break;
+
+            case CLC:
+                status = vand(status, vsplat(Byte(~CpuFlags::Carry)));
+                break;
+
+            case CLD:
+                status = vand(status, vsplat(Byte(~CpuFlags::Decimal_Mode)));
+                break;
+
+            case CLI:
+                status = vand(status, vsplat(Byte(~CpuFlags::Interrupt_Disable)));
+                break;
+
+            case CLV:
+                status = vand(status, vsplat(Byte(~CpuFlags::Overflow)));
+                break;
+
+            case SEC:
+                status = vor(status, vsplat(CpuFlags::Carry));
+                break;
+
+            case SED:
+                status = vor(status, vsplat(CpuFlags::Decimal_Mode));
+                break;
+
+            case SEI:
+                status = vor(status, vsplat(CpuFlags::Interrupt_Disable));
+                break;
+
+            case TAX:
+                x = a;
+                status = with_nz(status, x);
+                break;
+
+            case TAY:
+                y = a;
+                status = with_nz(status, y);
+                break;
+
+            case TSX:
+                x = sp;
+                status = with_nz(status, x);
+                break;
+
+            case TXA:
+                a = x;
+                status = with_nz(status, a);
+                break;
+
+            case TXS:
+                sp = x;
+                break;
+
+            case TYA:
+                a = y;
+                status = with_nz(status, a);
+                break;
+
+            case BRK:
+                halts = true;
+                break;
+
+            case BCC:
+            case BCS:
+            case BEQ:
+            case BMI:
+            case BNE:
+            case BPL:
+            case BVC:
+            case BVS:
+            {
+                CpuFlags flag = info.mnemonic == BCC || info.mnemonic == BCS   ? CpuFlags::Carry
+                                : info.mnemonic == BEQ || info.mnemonic == BNE ? CpuFlags::Zero
+                                : info.mnemonic == BMI || info.mnemonic == BPL ? CpuFlags::Negative
+                                                                               : CpuFlags::Overflow;
+                bool when_set = info.mnemonic == BCS || info.mnemonic == BEQ || info.mnemonic == BMI || info.mnemonic == BVS;
+
+                taken = vbits(vnonzero(vand(status, vsplat(flag))));
+                if (!when_set)
+                {
+                    taken = ~taken;
+                }
+                target = Address(pc + 2 + std::int8_t(op));
+                jumps = true;
+                break;
+            }
+
+            case JMP:
+                if (info.mode == Absolute)
+                {
+                    taken = mask;
+                    target = word;
+                }
+                else
+                {
+                    // 间接跳转的页内回绕，指针内容每个实例可能不同
+                    Address high = Address((word & 0xFF00) | ((word + 1) & 0xFF));
+                    for (unsigned bits = mask; bits != 0; bits &= bits - 1)
+                    {
+                        int i = lowest(bits);
+                        g.pc[i] = Address(g.read(i, word) | g.read(i, high) << 8);
+                    }
+                }
+                jumps = true;
+                break;
+
+            case NOP:
+            default:
+                break;
+            }
+
+            vstore(g.a, vselect(m, a, vload(g.a)));
+            vstore(g.x, vselect(m, x, vload(g.x)));
+            vstore(g.y, vselect(m, y, vload(g.y)));
+            vstore(g.sp, vselect(m, sp, vload(g.sp)));
+            vstore(g.status, vselect(m, status, vload(g.status)));
+
+            if (halts)
+            {
+                for (unsigned bits = mask; bits != 0; bits &= bits - 1)
+                {
+                    int i = lowest(bits);
+                    g.pc[i] = Address(pc + 1);
+                    g.stopped[i] = 1;
+                }
+                return;
+            }
+
+            // 读指令变址跨页多一个周期；成立的分支多一个周期，跳到另一页再多一个
+            if (info.mode == Relative)
+            {
+                Byte extra = Byte(((pc + 2) ^ target) & 0xFF00 ? 2 : 1);
+
+                for (unsigned bits = taken & mask; bits != 0; bits &= bits - 1)
+                {
+                    g.cycles[lowest(bits)] += extra;
+                }
+            }
+            else if (adds_page_cycle(info.mnemonic))
+            {
+                for (unsigned bits = operand.crossed & mask; bits != 0; bits &= bits - 1)
+                {
+                    ++g.cycles[lowest(bits)];
+                }
+            }
+
+            // 间接跳转已经逐个实例写好了 PC
+            if (info.mnemonic == JMP && info.mode != Absolute)
+            {
+                return;
+            }
+
+            Address next = Address(pc + info.len);
+            if (!jumps)
+            {
+                taken = 0;
+            }
+
+            // 整组锁步时是定长的无分支循环，可以向量化；部分实例时只访问 mask 里的实例
+            if (mask == FULL_MASK)
+            {
+                for (int i = 0; i < LANES; ++i)
+                {
+                    g.pc[i] = (taken >> i) & 1 ? target : next;
+                }
+                return;
+            }
+
+            for (unsigned bits = mask; bits != 0; bits &= bits - 1)
+            {
+                int i = lowest(bits);
+                g.pc[i] = (taken >> i) & 1 ? target : next;
+            }
+        }
+
+        // pending 里与最低位实例处在同一条指令上的实例
+        unsigned same_instruction(const Lanes &g, unsigned pending)
+        {
+            int leader = lowest(pending);
+            Address pc = g.pc[leader];
+            unsigned mask = 0;
+
+            for (int i = 0; i < LANES; ++i)
+            {
+                mask |= unsigned(g.pc[i] == pc) << i;
+            }
+            mask &= pending;
+
+            // RAM 里的代码每个实例可能不同，指令字节也要一致
+            if (pc < ROM_START || Address(pc + 2) < ROM_START)
+            {
+                for (unsigned bits = mask & (mask - 1); bits != 0; bits &= bits - 1)
+                {
+                    int i = lowest(bits);
+
+                    for (Address k = 0; k < 3; ++k)
+                    {
+                        if (g.read(i, Address(pc + k)) != g.read(leader, Address(pc + k)))
+                        {
+                            mask &= ~(1u << i);
+                            break;
+                        }
+                    }
+                }
+            }
+
+            return mask;
+        }
+    }
+
+    BatchCPU::BatchCPU(std::size_t count)
+        : count(count),
+          padded((count + LANES - 1) / LANES * LANES),
+          program_counters(padded, 0),
+          registers_a(padded, 0),
+          registers_x(padded, 0),
+          registers_y(padded, 0),
+          stack_pointers(padded, 0xfd),
+          statuses(padded, 0),
+          stopped(padded, 1),
+          cycle_counts(padded, 0),
+          ram(padded * RAM_SIZE, 0),
+          rom(0x10000 - ROM_START, 0),
+          executed(0),
+          issued(0)
+    {
+    }
+
+    std::size_t BatchCPU::size() const
+    {
+        return count;
+    }
+
+    void BatchCPU::load_and_reset(const std::vector<Byte> &program)
+    {
+        std::size_t length = std::min(program.size(), rom.size());
+
+        std::fill(rom.begin(), rom.end(), 0);
+        std::copy(program.begin(), program.begin() + length, rom.begin());
+        rom[0xFFFC - ROM_START] = 0x00;
+        rom[0xFFFD - ROM_START] = 0x80;
+
+        std::fill(ram.begin(), ram.end(), 0);
+        std::fill(program_counters.begin(), program_counters.end(), 0x8000);
+        std::fill(registers_a.begin(), registers_a.end(), 0);
+        std::fill(registers_x.begin(), registers_x.end(), 0);
+        std::fill(registers_y.begin(), registers_y.end(), 0);
+        std::fill(stack_pointers.begin(), stack_pointers.end(), 0xfd);
+        std::fill(statuses.begin(), statuses.end(), 0);
+        std::fill(cycle_counts.begin(), cycle_counts.end(), 0);
+        std::fill(stopped.begin(), stopped.begin() + count, 0);
+        std::fill(stopped.begin() + count, stopped.end(), 1);
+
+        executed = 0;
+        issued = 0;
+    }
+
+    void BatchCPU::run(std::uint64_t cycle_limit)
+    {
+        // 各组互不相关，一组跑完再跑下一组，这一组的 168KB 内存留在缓存里
+        for (std::size_t group = 0; group < padded / LANES; ++group)
+        {
+            run_group(group, cycle_limit);
+        }
+    }
+
+    void BatchCPU::run_group(std::size_t group, std::uint64_t cycle_limit)
+    {
+        std::size_t base = group * LANES;
+        Lanes g = {
+            &program_counters[base],
+            &registers_a[base],
+            &registers_x[base],
+            &registers_y[base],
+            &stack_pointers[base],
+            &statuses[base],
+            &stopped[base],
+            &cycle_counts[base],
+            &ram[group * RAM_SIZE * LANES],
+            &rom[0],
+        };
+
+        while (true)
+        {
+            unsigned pending = 0;
+
+            for (int i = 0; i < int(LANES); ++i)
+            {
+                pending |= unsigned(g.stopped[i] == 0 && g.cycles[i] < cycle_limit) << i;
+            }
+
+            if (pending == 0)
+            {
+                return;
+            }
+
+            // 每个实例执行一条指令，PC 相同的一起执行
+            while (pending != 0)
+            {
+                unsigned mask = same_instruction(g, pending);
+
+                execute(g, g.pc[lowest(mask)], mask);
+                executed += unsigned(__builtin_popcount(mask));
+                ++issued;
+                pending &= ~mask;
+            }
+        }
+    }
+
+    bool BatchCPU::halted(std::size_t index) const
+    {
+        return stopped[index] != 0;
+    }
+
+    Address BatchCPU::program_counter(std::size_t index) const
+    {
+        return program_counters[index];
+    }
+
+    Byte BatchCPU::register_a(std::size_t index) const
+    {
+        return registers_a[index];
+    }
+
+    Byte BatchCPU::register_x(std::size_t index) const
+    {
+        return registers_x[index];
+    }
+
+    Byte BatchCPU::register_y(std::size_t index) const
+    {
+        return registers_y[index];
+    }
+
+    Byte BatchCPU::stack_pointer(std::size_t index) const
+    {
+        return stack_pointers[index];
+    }
+
+    Byte BatchCPU::status(std::size_t index) const
+    {
+        return statuses[index];
+    }
+
+    std::uint64_t BatchCPU::cycles(std::size_t index) const
+    {
+        return cycle_counts[index];
+    }
+
+    Byte BatchCPU::peek(std::size_t index, Address addr) const
+    {
+        if (addr >= ROM_START)
+        {
+            return rom[addr - ROM_START];
+        }
+
+        std::size_t group = index / LANES;
+        std::size_t offset = writable_offset(addr);
+
+        return offset < RAM_SIZE ? ram[(group * RAM_SIZE + offset) * LANES + index % LANES] : 0;
+    }
+
+    void BatchCPU::poke(std::size_t index, Address addr, Byte data)
+    {
+        std::size_t group = index / LANES;
+        std::size_t offset = addr < ROM_START ? writable_offset(addr) : RAM_SIZE;
+
+        if (offset < RAM_SIZE)
+        {
+            ram[(group * RAM_SIZE + offset) * LANES + index % LANES] = data;
+        }
+    }
+
+    std::uint64_t BatchCPU::instructions() const
+    {
+        return executed;
+    }
+
+    std::uint64_t BatchCPU::issues() const
+    {
+        return issued;
+    }
+}
@@ -0,0 +1,189 @@
+#include "BlipBuffer.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <cassert>
+
+namespace mysn
+{
+    namespace
+    {
+        // 低频泄漏，相当于一个很低截止频率的高通，去掉直流分量
+        const int BASS_SHIFT = 9;
+
+        typedef std::int16_t Kernel[BlipBuffer::PHASE_COUNT][BlipBuffer::KERNEL_WIDTH];
+
+        // 加 Blackman 窗的 sinc 冲激响应，t 的单位是输出采样
+        double windowed_sinc(double t)
+        {
+            const double pi = 3.14159265358979323846;
+            const double cutoff = 0.45; // 相对采样率，略低于奈奎斯特频率
+            const double half = BlipBuffer::HALF_WIDTH;
+
+            if (t <= -half || t >= half)
+            {
+                return 0.0;
+            }
+
+            double x = 2.0 * cutoff * t;
+            double sinc = (x == 0.0) ? 1.0 : std::sin(pi * x) / (pi * x);
+            double window = 0.42 + 0.5 * std::cos(pi * t / half) + 0.08 * std::cos(2.0 * pi * t / half);
+
+            return 2.0 * cutoff * sinc * window;
+        }
+
+        // kernel[phase][j] 是阶跃响应在第 j 个采样上的增量，每行之和为 KERNEL_UNIT，
+        // 积分后得到带限阶跃。阶跃的位置固定延后 HALF_WIDTH - 1 个采样。
+        struct StepKernel
+        {
+            Kernel kernel;
+
+            StepKernel()
+            {
+                const int steps = 32;
+
+                for (int phase = 0; phase < BlipBuffer::PHASE_COUNT; ++phase)
+                {
+                    double frac = double(phase) / BlipBuffer::PHASE_COUNT;
+                    double row[BlipBuffer::KERNEL_WIDTH];
+                    double total = 0.0;
+
+                    for (int j = 0; j < BlipBuffer::KERNEL_WIDTH; ++j)
+                    {
+                        double from = j - BlipBuffer::HALF_WIDTH - frac;
+                        double sum = 0.0;
+
+                        for (int k = 0; k < steps; ++k)
+                        {
+                            sum += windowed_sinc(from + (k + 0.5) / steps);
+                        }
+
+                        row[j] = sum / steps;
+                        total += row[j];
+                    }
+
+                    int error = BlipBuffer::KERNEL_UNIT;
+                    int peak = 0;
+
+                    for (int j = 0; j < BlipBuffer::KERNEL_WIDTH; ++j)
+                    {
+                        int value = int(std::floor(row[j] / total * BlipBuffer::KERNEL_UNIT + 0.5));
+                        kernel[phase][j] = std::int16_t(value);
+                        error -= value;
+
+                        if (value > kernel[phase][peak])
+                        {
+                            peak = j;
+                        }
+                    }
+
+                    // 舍入误差补到峰值上，保证没有直流漂移
+                    kernel[phase][peak] += std::int16_t(error);
+                }
+            }
+        };
+
+        const Kernel &step_kernel()
+        {
+            static const StepKernel table;
+
+            return table.kernel;
+        }
+    }
+
+    BlipBuffer::BlipBuffer(long clock_rate, long sample_rate, std::size_t max_samples)
+        : rate(sample_rate),
+          factor((std::uint64_t(sample_rate) << 32) / std::uint64_t(clock_rate)),
+          offset(0),
+          avail(0),
+          capacity(max_samples),
+          integrator(0),
+          buffer(max_samples + KERNEL_WIDTH, 0)
+    {
+        step_kernel();
+    }
+
+    void BlipBuffer::add_delta(std::uint32_t clock_time, int delta)
+    {
+        if (delta == 0)
+        {
+            return;
+        }
+
+        std::uint64_t pos = offset + std::uint64_t(clock_time) * factor;
+        std::size_t index = avail + std::size_t(pos >> 32);
+        int phase = int(pos >> (32 - PHASE_BITS)) & (PHASE_COUNT - 1);
+
+        assert(index < capacity);
+
+        const std::int16_t *in = step_kernel()[phase];
+        std::int32_t *out = &buffer[index];
+
+        for (int j = 0; j < KERNEL_WIDTH; ++j)
+        {
+            out[j] += in[j] * delta;
+        }
+    }
+
+    void BlipBuffer::end_frame(std::uint32_t clock_duration)
+    {
+        offset += std::uint64_t(clock_duration) * factor;
+        avail += std::size_t(offset >> 32);
+        offset &= 0xFFFFFFFFu;
+
+        assert(avail <= capacity);
+    }
+
+    std::size_t BlipBuffer::samples_available() const
+    {
+        return avail;
+    }
+
+    std::size_t BlipBuffer::read_samples(std::int16_t *out, std::size_t max_samples)
+    {
+        std::size_t count = max_samples < avail ? max_samples : avail;
+
+        std::int32_t sum = integrator;
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            sum += buffer[i];
+            std::int32_t s = sum >> KERNEL_BITS;
+
+            if (s > 32767)
+            {
+                s = 32767;
+            }
+            else if (s < -32768)
+            {
+                s = -32768;
+            }
+
+            out[i] = std::int16_t(s);
+            sum -= s * (1 << (KERNEL_BITS - BASS_SHIFT));
+        }
+
+        integrator = sum;
+
+        // 未读出的部分（含尚未结束的核尾巴）移到缓冲区开头
+        std::size_t remain = avail - count + KERNEL_WIDTH;
+        std::memmove(&buffer[0], &buffer[count], remain * sizeof(std::int32_t));
+        std::memset(&buffer[remain], 0, count * sizeof(std::int32_t));
+        avail -= count;
+
+        return count;
+    }
+
+    void BlipBuffer::clear()
+    {
+        offset = 0;
+        avail = 0;
+        integrator = 0;
+        std::fill(buffer.begin(), buffer.end(), 0);
+    }
+
+    long BlipBuffer::sample_rate() const
+    {
+        return rate;
+    }
+}
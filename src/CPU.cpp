@@ -1,17 +1,140 @@
 #include "CPU.h"
 #include <iostream>
 #include <CPUOpcodes.h>
+#include "CPURun.h"
+#include "OpcodeProfiler.h"
+#include "SamplingProfiler.h"
+#include "TraceLogger.h"
+#include "CoverageMap.h"
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include "APU.h"
+#include "PPU.h"
+#include "Joypad.h"
+#include "Debugger.h"
 
 namespace mysn
 {
-    CPU::CPU() : program_counter(0),
+    namespace
+    {
+        // 刚构造的 CPU 和 hard_reset 之后装的全零 ROM
+        const SharedRom &empty_rom()
+        {
+            static const SharedRom rom = std::make_shared<std::vector<Byte>>(0x8000, 0);
+
+            return rom;
+        }
+
+        // run_for 的预算，cycle_limit 是绝对周期数
+        struct BudgetPolicy
+        {
+            std::uint64_t instruction_limit;
+            std::uint64_t cycle_limit;
+            RunExit cycle_exit;
+            std::uint64_t executed;
+            RunExit exit;
+
+            void before_instruction(CPU &, Byte) {}
+
+            void after_instruction(CPU &cpu, Byte, bool)
+            {
+                if (++executed >= instruction_limit)
+                {
+                    exit = Run_Instruction_Limit;
+                    cpu.request_stop();
+                }
+                else if (cpu.cycles >= cycle_limit)
+                {
+                    exit = cycle_exit;
+                    cpu.request_stop();
+                }
+            }
+        };
+    }
+
+    CPU::CPU() : rom(empty_rom()),
+                 apu(nullptr),
+                 ppu(nullptr),
+                 debugger(nullptr),
+                 page_crossed(false),
+                 stop_requested(false),
+                 program_counter(0),
                  register_a(0),
                  register_x(0),
                  register_y(0),
                  stack_pointer(0xfd),
                  status(0),
-                 memory(0xFFFF, 0){};
+                 cycles(0)
+    {
+        std::memset(writable, 0, sizeof(writable));
+        joypads[0] = nullptr;
+        joypads[1] = nullptr;
+        map_pages();
+    };
+
+    CPU::CPU(FlightRecord *recorder_buffer, std::size_t recorder_capacity)
+        : rom(empty_rom()),
+          apu(nullptr),
+          ppu(nullptr),
+          debugger(nullptr),
+          page_crossed(false),
+          stop_requested(false),
+          program_counter(0),
+          register_a(0),
+          register_x(0),
+          register_y(0),
+          stack_pointer(0xfd),
+          status(0),
+          cycles(0),
+          flight_recorder(recorder_buffer, recorder_capacity)
+    {
+        std::memset(writable, 0, sizeof(writable));
+        joypads[0] = nullptr;
+        joypads[1] = nullptr;
+        map_pages();
+    }
+
+    CPU::CPU(const CPU &other) : rom(other.rom),
+                                 apu(nullptr),
+                                 ppu(nullptr),
+                                 debugger(nullptr),
+                                 page_crossed(false),
+                                 stop_requested(false),
+                                 program_counter(other.program_counter),
+                                 register_a(other.register_a),
+                                 register_x(other.register_x),
+                                 register_y(other.register_y),
+                                 stack_pointer(other.stack_pointer),
+                                 status(other.status),
+                                 cycles(other.cycles),
+                                 flight_recorder(other.flight_recorder)
+    {
+        std::memcpy(writable, other.writable, sizeof(writable));
+        joypads[0] = nullptr;
+        joypads[1] = nullptr;
+        map_pages();
+    }
+
+    CPU &CPU::operator=(const CPU &other)
+    {
+        if (this != &other)
+        {
+            program_counter = other.program_counter;
+            register_a = other.register_a;
+            register_x = other.register_x;
+            register_y = other.register_y;
+            stack_pointer = other.stack_pointer;
+            status = other.status;
+            cycles = other.cycles;
+            flight_recorder = other.flight_recorder;
+            std::memcpy(writable, other.writable, sizeof(writable));
+            rom = other.rom;
+            map_pages();
+        }
+
+        return *this;
+    }
 
     // https://stackoverflow.com/questions/47981/how-do-you-set-clear-and-toggle-a-single-bit
     void CPU::set_flag(CpuFlags flag)
@@ -37,425 +160,47 @@ namespace mysn
         return !!(status & flag);
     }
 
+    template RunExit CPU::run_with<NullPolicy>(NullPolicy &policy);
+    template RunExit CPU::run_with<OpcodeProfiler>(OpcodeProfiler &policy);
+    template RunExit CPU::run_with<SamplingProfiler>(SamplingProfiler &policy);
+    template RunExit CPU::run_with<Tracer>(Tracer &policy);
+    template RunExit CPU::run_with<CoverageMap>(CoverageMap &policy);
+
     void CPU::run()
     {
-        while (true)
-        {
-            // 操作码
-            auto code = mem_read(program_counter);
-            ++program_counter;
-            auto program_counter_state = program_counter;
-            auto opcode = CPUOpcodes::CPU_OPS_CODES_MAP.find(code);
-
-            // 判断操作码是否存在
-            if (opcode == CPUOpcodes::CPU_OPS_CODES_MAP.end())
-            {
-                return;
-            }
-
-            auto mnemonic = (opcode->second).mnemonic;
-            auto mode = (opcode->second).mode;
-            auto len = (opcode->second).len;
-
-            switch (mnemonic)
-            {
-            case CPUOpcodeMnemonics::ADC:
-            {
-                adc(mode);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::AND:
-            {
-                i_and(mode);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::ASL:
-            {
-                if (mode == AddressingMode::Accumulator)
-                {
-                    i_asl_accumulator();
-                }
-                else
-                {
-
-                    i_asl(mode);
-                }
-                break;
-            }
-
-            case CPUOpcodeMnemonics::BCC:
-            {
-                branch(!contain_flag(CpuFlags::Carry));
-                break;
-            }
-
-            case CPUOpcodeMnemonics::BCS:
-            {
-                branch(contain_flag(CpuFlags::Carry));
-                break;
-            }
-
-            case CPUOpcodeMnemonics::BEQ:
-            {
-                branch(contain_flag(CpuFlags::Zero));
-                break;
-            }
-
-            case CPUOpcodeMnemonics::BIT:
-            {
-                bit(mode);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::BMI:
-            {
-                branch(contain_flag(CpuFlags::Negative));
-                break;
-            }
-
-            case CPUOpcodeMnemonics::BNE:
-            {
-                branch(!contain_flag(CpuFlags::Zero));
-                break;
-            }
-
-            case CPUOpcodeMnemonics::BPL:
-            {
-                branch(!contain_flag(CpuFlags::Negative));
-                break;
-            }
-
-            case CPUOpcodeMnemonics::BVC:
-            {
-                branch(!contain_flag(CpuFlags::Overflow));
-                break;
-            }
-
-            case CPUOpcodeMnemonics::BVS:
-            {
-                branch(contain_flag(CpuFlags::Overflow));
-                break;
-            }
-
-            case CPUOpcodeMnemonics::CLC:
-            {
-                clear_flag(CpuFlags::Carry);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::CLD:
-            {
-                clear_flag(CpuFlags::Decimal_Mode);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::CLI:
-            {
-                clear_flag(CpuFlags::Interrupt_Disable);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::CLV:
-            {
-                clear_flag(CpuFlags::Overflow);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::CMP:
-            {
-                compare(mode, register_a);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::CPX:
-            {
-                compare(mode, register_x);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::CPY:
-            {
-                compare(mode, register_y);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::DEC:
-            {
-                dec(mode);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::DEX:
-            {
-                dex();
-                break;
-            }
-
-            case CPUOpcodeMnemonics::DEY:
-            {
-                dey();
-                break;
-            }
-
-            case CPUOpcodeMnemonics::EOR:
-            {
-                eor(mode);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::INC:
-            {
-                inc(mode);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::INX:
-            {
-                inx();
-                break;
-            }
-
-            case CPUOpcodeMnemonics::INY:
-            {
-                iny();
-                break;
-            }
-
-            case CPUOpcodeMnemonics::JMP:
-            {
-                if (mode == AddressingMode::Absolute)
-                {
-                    auto addr = mem_read_u16(program_counter);
-                    program_counter = addr;
-                }
-                else if (mode == AddressingMode::Indirect)
-                {
-                    Address location = mem_read_u16(program_counter);
-                    //6502 has a bug such that the when the vector of anindirect address begins at the last byte of a page,
-                    //the second byte is fetched from the beginning of that page rather than the beginning of the next
-                    //Recreating here:
-                    Address Page = location & 0xff00;
-                    program_counter = mem_read(location) |
-                                      mem_read(Page | ((location + 1) & 0xff)) << 8;
-                }
-
-                break;
-            }
-
-            case CPUOpcodeMnemonics::JSR:
-            {
-                stack_push_u16(program_counter + 1);
-                auto target_address = mem_read_u16(program_counter);
-                program_counter = target_address;
-            }
-
-            case CPUOpcodeMnemonics::LDA:
-            {
-                lda(mode);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::LDX:
-            {
-                ldx(mode);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::LDY:
-            {
-                ldy(mode);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::LSR:
-            {
-                if (mode == AddressingMode::Accumulator)
-                {
-                    lsr_accumulator();
-                }
-                else
-                {
-                    lsr(mode);
-                }
-                break;
-            }
-
-            case CPUOpcodeMnemonics::NOP:
-            {
-                break;
-            }
-
-            case CPUOpcodeMnemonics::ORA:
-            {
-                ora(mode);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::PHA:
-            {
-                stack_push(register_a);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::PHP:
-            {
-                stack_push(status);
-                set_flag(CpuFlags::Break);
-                set_flag(CpuFlags::Break2);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::PLA:
-            {
-                pla();
-                break;
-            }
-
-            case CPUOpcodeMnemonics::PLP:
-            {
-                status = stack_pop();
-                clear_flag(CpuFlags::Break);
-                set_flag(CpuFlags::Break2);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::ROL:
-            {
-                if (mode == AddressingMode::Accumulator)
-                {
-                    rol_accumulator();
-                }
-                else
-                {
-                    rol(mode);
-                }
-                break;
-            }
-
-            case CPUOpcodeMnemonics::ROR:
-            {
-                if (mode == AddressingMode::Accumulator)
-                {
-                    ror_accumulator();
-                }
-                else
-                {
-                    ror(mode);
-                }
-                break;
-            }
-
-            case CPUOpcodeMnemonics::RTI:
-            {
-                status = stack_pop();
-                clear_flag(CpuFlags::Break);
-                set_flag(CpuFlags::Break2);
-
-                program_counter = stack_pop_u16();
-
-                break;
-            }
-
-            case CPUOpcodeMnemonics::RTS:
-            {
-                program_counter = stack_pop_u16() + 1;
-                break;
-            }
-
-            case CPUOpcodeMnemonics::SBC:
-            {
-                sbc(mode);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::SEC:
-            {
-                set_flag(CpuFlags::Carry);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::SED:
-            {
-                set_flag(CpuFlags::Decimal_Mode);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::SEI:
-            {
-                set_flag(CpuFlags::Interrupt_Disable);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::STA:
-            {
-                sta(mode);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::STX:
-            {
-                auto addr = get_operand_address(mode);
-                mem_write(addr, register_x);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::STY:
-            {
-                auto addr = get_operand_address(mode);
-                mem_write(addr, register_y);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::TAX:
-            {
-                tax();
-                break;
-            }
-
-            case CPUOpcodeMnemonics::TAY:
-            {
-                register_y = register_a;
-                update_zero_and_negative_flags(register_y);
-                break;
-            }
-
-            case CPUOpcodeMnemonics::TSX:
-            {
-                register_x = stack_pointer;
-                update_zero_and_negative_flags(register_x);
-                break;
-            }
+        NullPolicy policy;
+        run_with(policy);
+    }
 
-            case CPUOpcodeMnemonics::TXA:
-            {
-                register_a = register_x;
-                update_zero_and_negative_flags(register_a);
-            }
+    RunExit CPU::run_for(const RunBudget &budget)
+    {
+        const std::uint64_t unlimited = ~std::uint64_t(0);
+        BudgetPolicy policy = {unlimited, unlimited, Run_Cycle_Limit, 0, Run_Stopped};
 
-            case CPUOpcodeMnemonics::TXS:
-            {
-                stack_pointer = register_x;
-            }
+        if (budget.instructions != 0)
+        {
+            policy.instruction_limit = budget.instructions;
+        }
+        if (budget.cycles != 0 && budget.cycles <= unlimited - cycles)
+        {
+            policy.cycle_limit = cycles + budget.cycles;
+        }
+        if (budget.frame)
+        {
+            std::uint64_t frame_end = (cycles / CYCLES_PER_FRAME + 1) * CYCLES_PER_FRAME;
 
-            case CPUOpcodeMnemonics::TYA:
+            // 两者同时到达时报帧结束，调度方通常据此提交一帧的结果
+            if (frame_end <= policy.cycle_limit)
             {
-                register_a = register_y;
-                update_zero_and_negative_flags(register_a);
+                policy.cycle_limit = frame_end;
+                policy.cycle_exit = Run_Frame_End;
             }
+        }
 
-            case CPUOpcodeMnemonics::BRK:
-            {
-                return;
-            }
-            }
+        // 最后一条指令是 BRK 时 run_with 报 Run_Halted，即使它恰好用完了预算
+        RunExit exit = run_with(policy);
 
-            if (program_counter_state == program_counter)
-            {
-                program_counter += (len - 1);
-            }
-        }
+        return exit == Run_Stopped ? policy.exit : exit;
     }
 
     void CPU::adc(AddressingMode mode)
@@ -511,15 +256,20 @@ namespace mysn
         update_zero_and_negative_flags(register_a);
     }
 
-    void CPU::branch(bool condition)
+    bool CPU::branch(bool condition)
     {
         if (condition)
         {
             int8_t jump = mem_read(program_counter);
             auto jump_addr = static_cast<Address>(program_counter + 1 + jump);
 
+            // 成立时多一个周期，跳到另一页再多一个
+            page_crossed = ((program_counter + 1) ^ jump_addr) & 0xFF00;
+            cycles += page_crossed ? 2 : 1;
             program_counter = jump_addr;
         }
+
+        return condition;
     }
 
     void CPU::bit(AddressingMode mode)
@@ -795,12 +545,265 @@ namespace mysn
 
     Byte CPU::mem_read(Address addr)
     {
-        return memory[addr];
+        Byte *page = pages[addr >> 8];
+
+        if (page != nullptr)
+        {
+            return page[addr & 0xFF];
+        }
+
+        return io_read(addr);
     }
 
     void CPU::mem_write(Address addr, Byte data)
     {
-        memory[addr] = data;
+        Byte *page = pages[addr >> 8];
+
+        // ROM 页在 pages 里也有地址，但只读
+        if (page != nullptr && addr < 0x8000)
+        {
+            page[addr & 0xFF] = data;
+            return;
+        }
+
+        io_write(addr, data);
+    }
+
+    Byte CPU::peek(Address addr) const
+    {
+        const Byte *location = read_location(addr);
+
+        return location != nullptr ? *location : 0;
+    }
+
+    const Byte *CPU::memory_data() const
+    {
+        return writable;
+    }
+
+    const Byte *CPU::rom_data() const
+    {
+        return &(*rom)[0];
+    }
+
+    void CPU::load_memory(const Byte *data)
+    {
+        std::memcpy(writable, data, sizeof(writable));
+    }
+
+    const Byte *CPU::read_location(Address addr) const
+    {
+        if (addr >= 0x8000)
+        {
+            return &(*rom)[addr - 0x8000];
+        }
+
+        std::size_t offset = writable_offset(addr);
+
+        return offset < WRITABLE_MEMORY_SIZE ? &writable[offset] : nullptr;
+    }
+
+    Byte *CPU::write_location(Address addr)
+    {
+        // 写 ROM 很少见（测试直接改向量、自修改代码），第一次写时复制一份自己的，不影响共享它的实例
+        if (addr >= 0x8000)
+        {
+            if (rom.use_count() != 1)
+            {
+                rom = std::make_shared<std::vector<Byte>>(*rom);
+                map_pages();
+            }
+
+            // 只有这个实例持有，而且不是按 const 创建的
+            return const_cast<Byte *>(&(*rom)[addr - 0x8000]);
+        }
+
+        std::size_t offset = writable_offset(addr);
+
+        return offset < WRITABLE_MEMORY_SIZE ? &writable[offset] : nullptr;
+    }
+
+    void CPU::map_pages()
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            pages[i] = const_cast<Byte *>(read_location(Address(i << 8)));
+        }
+
+        if (ppu != nullptr)
+        {
+            for (int i = 0x20; i < 0x40; ++i)
+            {
+                pages[i] = nullptr;
+            }
+        }
+
+        if (apu != nullptr || ppu != nullptr || joypads[0] != nullptr || joypads[1] != nullptr)
+        {
+            pages[0x40] = nullptr;
+        }
+
+        if (debugger != nullptr)
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                if (debugger->page_watched(i))
+                {
+                    pages[i] = nullptr;
+                }
+            }
+        }
+    }
+
+    Byte CPU::io_read(Address addr)
+    {
+        if (debugger != nullptr)
+        {
+            debugger->on_read(*this, addr);
+        }
+
+        if (ppu != nullptr && addr >= 0x2000 && addr < 0x4000)
+        {
+            return ppu->read_register(addr);
+        }
+
+        if (apu != nullptr && addr == 0x4015)
+        {
+            return apu->read_status(cycles);
+        }
+
+        if ((addr == 0x4016 || addr == 0x4017) && joypads[addr - 0x4016] != nullptr)
+        {
+            return joypads[addr - 0x4016]->read();
+        }
+
+        return peek(addr);
+    }
+
+    void CPU::io_write(Address addr, Byte data)
+    {
+        if (debugger != nullptr)
+        {
+            debugger->on_write(*this, addr, peek(addr), data);
+        }
+
+        if (ppu != nullptr && addr >= 0x2000 && addr < 0x4000)
+        {
+            ppu->write_register(addr, data);
+            return;
+        }
+
+        if (ppu != nullptr && addr == 0x4014)
+        {
+            oam_dma(data);
+            return;
+        }
+
+        if (addr == 0x4016 && (joypads[0] != nullptr || joypads[1] != nullptr))
+        {
+            for (Joypad *joypad : joypads)
+            {
+                if (joypad != nullptr)
+                {
+                    joypad->write(data);
+                }
+            }
+            return;
+        }
+
+        // $4014 是 OAM DMA，$4016 是手柄，其余 $4000-$4017 归 APU
+        if (apu != nullptr && addr >= 0x4000 && addr <= 0x4017 && addr != 0x4014 && addr != 0x4016)
+        {
+            apu->write_register(addr, data, cycles);
+            return;
+        }
+
+        Byte *location = write_location(addr);
+
+        if (location != nullptr)
+        {
+            *location = data;
+        }
+    }
+
+    /// OAM DMA http://wiki.nesdev.com/w/index.php/PPU_registers#OAMDMA
+    ///
+    /// 把 $XX00-$XXFF 拷进 OAM。CPU 挂起 513 个周期，写入发生在奇数周期时再多等 1 个周期对齐。
+    /// 普通页整页 memcpy；I/O 页的读有副作用，只能逐字节走 mem_read。
+    void CPU::oam_dma(Byte page)
+    {
+        cycles += 513 + (cycles & 1);
+
+        const Byte *source = pages[page];
+
+        if (source != nullptr)
+        {
+            ppu->oam_dma(source);
+            return;
+        }
+
+        Address base = Address(page) << 8;
+
+        for (int i = 0; i < 256; ++i)
+        {
+            ppu->write_oam_data(mem_read(base | i));
+        }
+    }
+
+    void CPU::attach_apu(APU *apu)
+    {
+        this->apu = apu;
+        map_pages();
+
+        if (apu != nullptr)
+        {
+            apu->reset(cycles);
+            apu->set_dmc_reader([this](Address addr) { return peek(addr); });
+        }
+    }
+
+    void CPU::attach_ppu(PPU *ppu)
+    {
+        this->ppu = ppu;
+        map_pages();
+    }
+
+    void CPU::attach_joypad(int port, Joypad *joypad)
+    {
+        joypads[port & 1] = joypad;
+        map_pages();
+    }
+
+    void CPU::attach_debugger(Debugger *debugger)
+    {
+        this->debugger = debugger;
+        map_pages();
+    }
+
+    void CPU::poll_apu()
+    {
+        if (cycles >= apu->next_event_cycle())
+        {
+            apu->run_until(cycles);
+        }
+
+        // DMC 取样时 CPU 被挂起
+        cycles += apu->take_dma_stall();
+
+        if (apu->irq_pending() && !contain_flag(CpuFlags::Interrupt_Disable))
+        {
+            interrupt_irq();
+        }
+    }
+
+    void CPU::interrupt_irq()
+    {
+        stack_push_u16(program_counter);
+        stack_push((status & ~CpuFlags::Break) | CpuFlags::Break2);
+        set_flag(CpuFlags::Interrupt_Disable);
+
+        cycles += 7;
+        program_counter = mem_read_u16(0xFFFE);
     }
 
     DobuleByte CPU::mem_read_u16(Address addr)
@@ -817,20 +820,24 @@ namespace mysn
         mem_write(addr + 1, high);
     }
 
-    void CPU::load(std::vector<Byte> &program)
+    SharedRom make_rom(const std::vector<Byte> &program)
     {
-        Address start = 0x8000;
-
         // 程序数据（Program ROM/PRG ROM），存储在插入的墨盒中（Cartridges），存储的是游戏的代码
-        // 从内存地址的 0x8000 开始装载
-        // TODO: 暂时不考虑溢出情况
-        for (auto i : program)
-        {
-            memory[start] = i;
-            ++start;
-        }
+        // 从内存地址的 0x8000 开始装载，超出 $FFFF 的部分丢弃
+        std::size_t length = program.size() < 0x8000 ? program.size() : 0x8000;
+        std::shared_ptr<std::vector<Byte>> rom = std::make_shared<std::vector<Byte>>(0x8000, 0);
 
-        mem_write_u16(0xFFFC, 0x8000);
+        std::copy(program.begin(), program.begin() + length, rom->begin());
+        (*rom)[0xFFFC - 0x8000] = 0x00;
+        (*rom)[0xFFFD - 0x8000] = 0x80;
+
+        return rom;
+    }
+
+    void CPU::load(std::vector<Byte> &program)
+    {
+        rom = make_rom(program);
+        map_pages();
     }
 
     void CPU::reset()
@@ -843,6 +850,63 @@ namespace mysn
         program_counter = mem_read_u16(0xFFFC);
     }
 
+    void CPU::restore(const CPU &other)
+    {
+        program_counter = other.program_counter;
+        register_a = other.register_a;
+        register_x = other.register_x;
+        register_y = other.register_y;
+        stack_pointer = other.stack_pointer;
+        status = other.status;
+        cycles = other.cycles;
+        std::memcpy(writable, other.writable, sizeof(writable));
+        page_crossed = false;
+        stop_requested = false;
+        flight_recorder.clear();
+
+        if (rom != other.rom)
+        {
+            rom = other.rom;
+            map_pages();
+        }
+    }
+
+    void CPU::hard_reset()
+    {
+        std::memset(writable, 0, sizeof(writable));
+        rom = empty_rom();
+        map_pages();
+
+        program_counter = 0;
+        register_a = 0;
+        register_x = 0;
+        register_y = 0;
+        stack_pointer = 0xfd;
+        status = 0;
+        cycles = 0;
+        page_crossed = false;
+        stop_requested = false;
+        flight_recorder.clear();
+    }
+
+    void CPU::request_stop()
+    {
+        stop_requested = true;
+    }
+
+    void CPU::load_and_reset(std::vector<Byte> &program)
+    {
+        load(program);
+        reset();
+    }
+
+    void CPU::load_and_reset(const SharedRom &rom)
+    {
+        this->rom = rom;
+        map_pages();
+        reset();
+    }
+
     void CPU::load_and_run(std::vector<Byte> &program)
     {
         load(program);
@@ -856,11 +920,13 @@ namespace mysn
         {
         case AddressingMode::Accumulator:
         {
+            flight_recorder.fault("unsupported addressing mode");
             abort();
         };
 
         case AddressingMode::Relative:
         {
+            flight_recorder.fault("unsupported addressing mode");
             abort();
         };
 
@@ -884,7 +950,7 @@ namespace mysn
         case AddressingMode::ZeroPage_X:
         {
             auto pos = mem_read(program_counter);
-            Address addr = Address(pos) + Address(register_x);
+            Address addr = Byte(pos + register_x);
 
             return addr;
         }
@@ -892,7 +958,7 @@ namespace mysn
         case AddressingMode::ZeroPage_Y:
         {
             auto pos = mem_read(program_counter);
-            Address addr = Address(pos) + Address(register_y);
+            Address addr = Byte(pos + register_y);
 
             return addr;
 
@@ -903,6 +969,7 @@ namespace mysn
         {
             auto base = mem_read_u16(program_counter);
             Address addr = base + register_x;
+            page_crossed = (base ^ addr) & 0xFF00;
 
             return addr;
         }
@@ -911,12 +978,14 @@ namespace mysn
         {
             auto base = mem_read_u16(program_counter);
             Address addr = base + register_y;
+            page_crossed = (base ^ addr) & 0xFF00;
 
             return addr;
         }
 
         case AddressingMode::Indirect:
         {
+            flight_recorder.fault("unsupported addressing mode");
             abort();
         }
 
@@ -925,7 +994,7 @@ namespace mysn
             auto base = mem_read(program_counter);
             auto ptr = Byte(base + register_x);
             DobuleByte lo = DobuleByte(mem_read(ptr));
-            DobuleByte hi = DobuleByte(Byte(ptr + 1));
+            DobuleByte hi = DobuleByte(mem_read(Byte(ptr + 1)));
 
             return lo | hi << 8;
         }
@@ -934,9 +1003,10 @@ namespace mysn
         {
             auto base = mem_read(program_counter);
             auto lo = mem_read(base);
-            auto hi = mem_read(base + 1);
+            auto hi = mem_read(Byte(base + 1));
             auto deref_base = lo | hi << 8;
             auto deref = register_y + deref_base;
+            page_crossed = (deref_base ^ deref) & 0xFF00;
 
             return deref;
         }
@@ -944,6 +1014,7 @@ namespace mysn
         case AddressingMode::NoneAddressing:
         {
             std::cout << mode << "is not supported" << std::endl;
+            flight_recorder.fault("unsupported addressing mode");
             abort();
         }
         }
@@ -203,4 +203,31 @@ namespace mysn
         {0x9a, CPUOpcodes(0x9a, CPUOpcodeMnemonics::TXS, 1, 2, AddressingMode::NoneAddressing)},
         {0x98, CPUOpcodes(0x98, CPUOpcodeMnemonics::TYA, 1, 2, AddressingMode::NoneAddressing)},
     };
+
+    const char *mnemonic_name(CPUOpcodeMnemonics mnemonic)
+    {
+        static const char *names[] = {
+            "ADC", "AND", "ASL", "BCC", "BCS", "BEQ", "BIT", "BMI",
+            "BNE", "BPL", "BRK", "BVC", "BVS", "CLC", "CLD", "CLI",
+            "CLV", "CMP", "CPX", "CPY", "DEC", "DEX", "DEY", "EOR",
+            "INC", "INX", "INY", "JMP", "JSR", "LDA", "LDX", "LDY",
+            "LSR", "NOP", "ORA", "PHA", "PHP", "PLA", "PLP", "ROL",
+            "ROR", "RTI", "RTS", "SBC", "SEC", "SED", "SEI", "STA",
+            "STX", "STY", "TAX", "TAY", "TSX", "TXA", "TXS", "TYA",
+        };
+
+        return names[mnemonic];
+    }
+
+    const char *addressing_mode_name(AddressingMode mode)
+    {
+        static const char *names[] = {
+            "Accumulator", "Immediate", "Relative", "ZeroPage",
+            "ZeroPage_X", "ZeroPage_Y", "Absolute", "Absolute_X",
+            "Absolute_Y", "Indirect", "Indirect_X", "Indirect_Y",
+            "NoneAddressing",
+        };
+
+        return names[mode];
+    }
 }
@@ -0,0 +1,224 @@
+#include "CoverageMap.h"
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+
+#if MYSN_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace mysn
+{
+    namespace
+    {
+        const char MAGIC[4] = {'M', 'S', 'C', 'V'};
+        const std::uint16_t VERSION = 1;
+        const std::size_t HEADER_SIZE = 16;
+
+        void put_u16(Byte *p, std::uint16_t value)
+        {
+            p[0] = Byte(value);
+            p[1] = Byte(value >> 8);
+        }
+
+        void put_u32(Byte *p, std::uint32_t value)
+        {
+            put_u16(p, std::uint16_t(value));
+            put_u16(p + 2, std::uint16_t(value >> 16));
+        }
+
+        std::uint16_t get_u16(const Byte *p)
+        {
+            return std::uint16_t(p[0] | p[1] << 8);
+        }
+
+        std::uint32_t get_u32(const Byte *p)
+        {
+            return get_u16(p) | std::uint32_t(get_u16(p + 2)) << 16;
+        }
+
+        std::size_t count_bits(const Byte *bits, std::size_t count)
+        {
+            std::size_t total = 0;
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                total += std::size_t(__builtin_popcount(bits[i]));
+            }
+
+            return total;
+        }
+
+        void merge_scalar(Byte *dst, const Byte *src, std::size_t count)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                dst[i] |= src[i];
+            }
+        }
+
+#if MYSN_X86_SIMD
+        std::size_t merge_sse2(Byte *dst, const Byte *src, std::size_t count)
+        {
+            std::size_t i = 0;
+
+            for (; i + 16 <= count; i += 16)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_or_si128(a, b));
+            }
+
+            return i;
+        }
+
+        MYSN_TARGET_AVX2 std::size_t merge_avx2(Byte *dst, const Byte *src, std::size_t count)
+        {
+            std::size_t i = 0;
+
+            for (; i + 32 <= count; i += 32)
+            {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_or_si256(a, b));
+            }
+
+            return i;
+        }
+#endif
+    }
+
+    void merge_coverage_bits(Byte *dst, const Byte *src, std::size_t count, SimdLevel level)
+    {
+        std::size_t done = 0;
+
+#if MYSN_X86_SIMD
+        if (level == Simd_AVX2)
+        {
+            done = merge_avx2(dst, src, count);
+        }
+        else if (level == Simd_SSE2)
+        {
+            done = merge_sse2(dst, src, count);
+        }
+#else
+        (void)level;
+#endif
+
+        merge_scalar(dst + done, src + done, count - done);
+    }
+
+    CoverageMap::CoverageMap()
+    {
+        clear();
+    }
+
+    void CoverageMap::clear()
+    {
+        std::memset(bitmap, 0, sizeof(bitmap));
+    }
+
+    bool CoverageMap::covered(Address addr) const
+    {
+        std::uint32_t offset = std::uint32_t(addr) - PRG_START;
+
+        return offset < PRG_SIZE && (bitmap[offset >> 3] >> (offset & 7) & 1) != 0;
+    }
+
+    std::size_t CoverageMap::covered_count() const
+    {
+        return count_bits(bitmap, BITMAP_BYTES);
+    }
+
+    std::size_t CoverageMap::bank_covered_count(std::size_t bank) const
+    {
+        if (bank >= BANK_COUNT)
+        {
+            return 0;
+        }
+
+        return count_bits(bitmap + bank * (BANK_SIZE / 8), BANK_SIZE / 8);
+    }
+
+    const Byte *CoverageMap::data() const
+    {
+        return bitmap;
+    }
+
+    void CoverageMap::merge(const CoverageMap &other, SimdLevel level)
+    {
+        merge_coverage_bits(bitmap, other.bitmap, BITMAP_BYTES, level);
+    }
+
+    bool CoverageMap::save(const std::string &path) const
+    {
+        std::FILE *file = std::fopen(path.c_str(), "wb");
+
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        Byte header[HEADER_SIZE] = {0};
+        std::memcpy(header, MAGIC, 4);
+        put_u16(header + 4, VERSION);
+        put_u16(header + 6, PRG_START);
+        put_u32(header + 8, std::uint32_t(PRG_SIZE));
+
+        bool ok = std::fwrite(header, 1, HEADER_SIZE, file) == HEADER_SIZE &&
+                  std::fwrite(bitmap, 1, BITMAP_BYTES, file) == BITMAP_BYTES;
+
+        return std::fclose(file) == 0 && ok;
+    }
+
+    bool CoverageMap::load(const std::string &path)
+    {
+        std::FILE *file = std::fopen(path.c_str(), "rb");
+
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        Byte header[HEADER_SIZE];
+        Byte bits[BITMAP_BYTES];
+
+        bool ok = std::fread(header, 1, HEADER_SIZE, file) == HEADER_SIZE &&
+                  std::memcmp(header, MAGIC, 4) == 0 &&
+                  get_u16(header + 4) == VERSION &&
+                  get_u16(header + 6) == PRG_START &&
+                  get_u32(header + 8) == PRG_SIZE &&
+                  std::fread(bits, 1, BITMAP_BYTES, file) == BITMAP_BYTES;
+
+        std::fclose(file);
+
+        if (ok)
+        {
+            std::memcpy(bitmap, bits, BITMAP_BYTES);
+        }
+
+        return ok;
+    }
+
+    void CoverageMap::write_summary(std::ostream &out) const
+    {
+        out << "bank  range              covered     total         %\n";
+
+        for (std::size_t bank = 0; bank < BANK_COUNT; ++bank)
+        {
+            std::size_t first = PRG_START + bank * BANK_SIZE;
+            std::size_t covered = bank_covered_count(bank);
+
+            out << std::setw(4) << bank << "  $" << std::hex << std::uppercase << std::setfill('0')
+                << std::setw(4) << first << "-$" << std::setw(4) << first + BANK_SIZE - 1
+                << std::dec << std::nouppercase << std::setfill(' ')
+                << std::setw(17) << covered
+                << std::setw(10) << BANK_SIZE
+                << std::setw(10) << std::fixed << std::setprecision(2) << 100.0 * covered / BANK_SIZE << "\n";
+        }
+
+        std::size_t total = covered_count();
+        out << "\ntotal " << total << " of " << PRG_SIZE << " bytes ("
+            << std::fixed << std::setprecision(2) << 100.0 * total / PRG_SIZE << "%)\n";
+    }
+}
@@ -0,0 +1,146 @@
+#include "Debugger.h"
+#include "CPURun.h"
+#include <algorithm>
+#include <cstring>
+
+namespace mysn
+{
+    namespace
+    {
+        // 内部 RAM 在 $0800-$1FFF 镜像三次，观察点按 writable_offset 归到 $0000-$07FF，
+        // 经过任何一个镜像的读写都能命中
+        Address watch_address(Address addr)
+        {
+            std::size_t offset = writable_offset(addr);
+
+            return offset < 0x800 ? Address(offset) : addr;
+        }
+
+        int watch_page(int page)
+        {
+            return int(watch_address(Address(page << 8)) >> 8);
+        }
+    }
+
+    Debugger::Debugger()
+        : breakpoints(0x10000, 0),
+          watchpoints(0x10000, 0),
+          cycle_limit(~std::uint64_t(0)),
+          reason(Debug_None),
+          address(0),
+          instruction(0)
+    {
+        std::memset(break_pages, 0, sizeof(break_pages));
+        std::memset(watch_pages, 0, sizeof(watch_pages));
+    }
+
+    void Debugger::add_breakpoint(Address pc)
+    {
+        breakpoints[pc] = 1;
+        break_pages[pc >> 8] = 1;
+    }
+
+    void Debugger::remove_breakpoint(Address pc)
+    {
+        breakpoints[pc] = 0;
+        update_page(break_pages, breakpoints, pc >> 8);
+    }
+
+    void Debugger::add_watchpoint(Address addr, int kinds)
+    {
+        addr = watch_address(addr);
+        watchpoints[addr] |= Byte(kinds & (Watch_Read | Watch_Write | Watch_Change));
+        update_page(watch_pages, watchpoints, addr >> 8);
+    }
+
+    void Debugger::remove_watchpoint(Address addr)
+    {
+        addr = watch_address(addr);
+        watchpoints[addr] = 0;
+        update_page(watch_pages, watchpoints, addr >> 8);
+    }
+
+    void Debugger::clear()
+    {
+        std::fill(breakpoints.begin(), breakpoints.end(), 0);
+        std::fill(watchpoints.begin(), watchpoints.end(), 0);
+        std::memset(break_pages, 0, sizeof(break_pages));
+        std::memset(watch_pages, 0, sizeof(watch_pages));
+        cycle_limit = ~std::uint64_t(0);
+    }
+
+    void Debugger::set_cycle_limit(std::uint64_t limit)
+    {
+        cycle_limit = limit != 0 ? limit : ~std::uint64_t(0);
+    }
+
+    RunExit Debugger::run(CPU &cpu)
+    {
+        reason = Debug_None;
+        address = 0;
+        instruction = cpu.program_counter;
+
+        // 观察点所在的页只在 run 期间走慢路径
+        cpu.attach_debugger(this);
+        RunExit exit = cpu.run_with(*this);
+        cpu.attach_debugger(nullptr);
+
+        return exit;
+    }
+
+    DebugStop Debugger::stop_reason() const
+    {
+        return reason;
+    }
+
+    Address Debugger::stop_address() const
+    {
+        return address;
+    }
+
+    Address Debugger::stop_instruction() const
+    {
+        return instruction;
+    }
+
+    bool Debugger::page_watched(int page) const
+    {
+        return watch_pages[watch_page(page)] != 0;
+    }
+
+    void Debugger::on_read(CPU &cpu, Address addr)
+    {
+        addr = watch_address(addr);
+
+        if (reason == Debug_None && (watchpoints[addr] & Watch_Read))
+        {
+            stop(cpu, Debug_Watchpoint, addr);
+        }
+    }
+
+    void Debugger::on_write(CPU &cpu, Address addr, Byte old_value, Byte data)
+    {
+        addr = watch_address(addr);
+        Byte kinds = watchpoints[addr];
+
+        if (reason == Debug_None &&
+            ((kinds & Watch_Write) || ((kinds & Watch_Change) && old_value != data)))
+        {
+            stop(cpu, Debug_Watchpoint, addr);
+        }
+    }
+
+    void Debugger::stop(CPU &cpu, DebugStop reason, Address address)
+    {
+        this->reason = reason;
+        this->address = address;
+        cpu.request_stop();
+    }
+
+    void Debugger::update_page(Byte *pages, const std::vector<Byte> &flags, int page)
+    {
+        const Byte *begin = &flags[page << 8];
+
+        pages[page] = std::find_if(begin, begin + 256, [](Byte flag) { return flag != 0; }) != begin + 256;
+    }
+}
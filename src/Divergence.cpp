@@ -0,0 +1,437 @@
+#include "Divergence.h"
+#include <cstring>
+#include <fstream>
+
+namespace mysn
+{
+    namespace
+    {
+        const std::uint64_t FNV_OFFSET = 14695981039346656037ull;
+        const std::uint64_t FNV_PRIME = 1099511628211ull;
+
+        const char *const CHAIN_MAGIC = "mysn-hash-chain";
+        const int CHAIN_VERSION = 1;
+
+        std::uint64_t mix(std::uint64_t hash, Byte value)
+        {
+            return (hash ^ value) * FNV_PRIME;
+        }
+
+        std::uint64_t mix_u64(std::uint64_t hash, std::uint64_t value)
+        {
+            for (int i = 0; i < 8; ++i)
+            {
+                hash = mix(hash, Byte(value >> (8 * i)));
+            }
+
+            return hash;
+        }
+
+        // writable_offset 的逆映射
+        Address writable_address(std::size_t offset)
+        {
+            if (offset < 0x800)
+            {
+                return Address(offset);
+            }
+            if (offset < 0x900)
+            {
+                return Address(0x4000 + (offset - 0x800));
+            }
+
+            return Address(0x6000 + (offset - 0x900));
+        }
+
+        bool same_state(const CoreState &a, const CoreState &b)
+        {
+            return a.program_counter == b.program_counter &&
+                   a.register_a == b.register_a &&
+                   a.register_x == b.register_x &&
+                   a.register_y == b.register_y &&
+                   a.stack_pointer == b.stack_pointer &&
+                   a.status == b.status &&
+                   a.cycles == b.cycles &&
+                   a.halted == b.halted &&
+                   std::memcmp(a.memory, b.memory, WRITABLE_MEMORY_SIZE) == 0;
+        }
+
+        void write_hex(std::ostream &out, std::uint64_t value, int digits)
+        {
+            static const char table[] = "0123456789abcdef";
+
+            for (int i = digits - 1; i >= 0; --i)
+            {
+                out << table[(value >> (4 * i)) & 0xF];
+            }
+        }
+
+        void write_registers(std::ostream &out, const char *name, const CoreState &state)
+        {
+            out << name << ": PC:";
+            write_hex(out, state.program_counter, 4);
+            out << " A:";
+            write_hex(out, state.register_a, 2);
+            out << " X:";
+            write_hex(out, state.register_x, 2);
+            out << " Y:";
+            write_hex(out, state.register_y, 2);
+            out << " P:";
+            write_hex(out, state.status, 2);
+            out << " SP:";
+            write_hex(out, state.stack_pointer, 2);
+            out << " CYC:" << state.cycles;
+            if (state.halted)
+            {
+                out << " halted";
+            }
+            out << '\n';
+        }
+
+        // states 在 lo 时相同、在 hi 时不同，从 lo 的检查点二分到 hi == lo + 1
+        void bisect(std::unique_ptr<DivergenceCore> reference, std::unique_ptr<DivergenceCore> candidate,
+                    std::uint64_t lo, std::uint64_t hi, Divergence &result)
+        {
+            while (hi - lo > 1)
+            {
+                std::uint64_t mid = lo + (hi - lo) / 2;
+                std::unique_ptr<DivergenceCore> left = reference->clone();
+                std::unique_ptr<DivergenceCore> right = candidate->clone();
+
+                left->run_to(mid);
+                right->run_to(mid);
+                left->capture(result.reference);
+                right->capture(result.candidate);
+
+                if (same_state(result.reference, result.candidate))
+                {
+                    reference = std::move(left);
+                    candidate = std::move(right);
+                    lo = mid;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+
+            // lo 时的周期数正好是 lo（否则跑到 lo + 1 什么也不执行，两边不会不同），所以只差一条指令
+            reference->capture(result.before);
+            reference->run_to(hi);
+            candidate->run_to(hi);
+            reference->capture(result.reference);
+            candidate->capture(result.candidate);
+            result.found = true;
+            result.cycle = hi;
+        }
+    }
+
+    std::uint64_t core_state_hash(const CoreState &state)
+    {
+        std::uint64_t hash = FNV_OFFSET;
+
+        hash = mix(hash, Byte(state.program_counter));
+        hash = mix(hash, Byte(state.program_counter >> 8));
+        hash = mix(hash, state.register_a);
+        hash = mix(hash, state.register_x);
+        hash = mix(hash, state.register_y);
+        hash = mix(hash, state.status);
+        hash = mix(hash, state.stack_pointer);
+        hash = mix_u64(hash, state.cycles);
+        hash = mix(hash, state.halted ? 1 : 0);
+
+        for (std::size_t i = 0; i < WRITABLE_MEMORY_SIZE; ++i)
+        {
+            hash = mix(hash, state.memory[i]);
+        }
+
+        return hash;
+    }
+
+    CPUCore::CPUCore(const SharedRom &rom) : halted(false)
+    {
+        cpu.load_and_reset(rom);
+    }
+
+    CPUCore::CPUCore(const CPU &cpu) : cpu(cpu), halted(false)
+    {
+    }
+
+    std::unique_ptr<DivergenceCore> CPUCore::clone() const
+    {
+        return std::unique_ptr<DivergenceCore>(new CPUCore(*this));
+    }
+
+    bool CPUCore::run_to(std::uint64_t cycle_limit)
+    {
+        if (halted)
+        {
+            return false;
+        }
+
+        if (cpu.cycles < cycle_limit)
+        {
+            RunBudget budget = {0, cycle_limit - cpu.cycles, false};
+            RunExit exit = cpu.run_for(budget);
+
+            halted = exit == Run_Halted || exit == Run_Invalid_Opcode;
+        }
+
+        return !halted;
+    }
+
+    void CPUCore::capture(CoreState &state) const
+    {
+        state.program_counter = cpu.program_counter;
+        state.register_a = cpu.register_a;
+        state.register_x = cpu.register_x;
+        state.register_y = cpu.register_y;
+        state.stack_pointer = cpu.stack_pointer;
+        state.status = cpu.status;
+        state.cycles = cpu.cycles;
+        state.halted = halted;
+
+        for (int i = 0; i < 3; ++i)
+        {
+            state.instruction[i] = cpu.peek(Address(cpu.program_counter + i));
+        }
+
+        std::memcpy(state.memory, cpu.memory_data(), WRITABLE_MEMORY_SIZE);
+    }
+
+    BatchCPUCore::BatchCPUCore(const std::vector<Byte> &program) : batch(1)
+    {
+        batch.load_and_reset(program);
+    }
+
+    std::unique_ptr<DivergenceCore> BatchCPUCore::clone() const
+    {
+        return std::unique_ptr<DivergenceCore>(new BatchCPUCore(*this));
+    }
+
+    bool BatchCPUCore::run_to(std::uint64_t cycle_limit)
+    {
+        if (batch.halted(0))
+        {
+            return false;
+        }
+
+        batch.run(cycle_limit);
+
+        return !batch.halted(0);
+    }
+
+    void BatchCPUCore::capture(CoreState &state) const
+    {
+        state.program_counter = batch.program_counter(0);
+        state.register_a = batch.register_a(0);
+        state.register_x = batch.register_x(0);
+        state.register_y = batch.register_y(0);
+        state.stack_pointer = batch.stack_pointer(0);
+        state.status = batch.status(0);
+        state.cycles = batch.cycles(0);
+        state.halted = batch.halted(0);
+
+        for (int i = 0; i < 3; ++i)
+        {
+            state.instruction[i] = batch.peek(0, Address(state.program_counter + i));
+        }
+
+        for (std::size_t offset = 0; offset < WRITABLE_MEMORY_SIZE; ++offset)
+        {
+            state.memory[offset] = batch.peek(0, writable_address(offset));
+        }
+    }
+
+    bool HashChain::save(const std::string &path) const
+    {
+        std::ofstream out(path.c_str());
+
+        out << CHAIN_MAGIC << ' ' << CHAIN_VERSION << ' ' << interval << '\n';
+        for (std::uint64_t link : links)
+        {
+            write_hex(out, link, 16);
+            out << '\n';
+        }
+        out.close();
+
+        return bool(out);
+    }
+
+    bool HashChain::load(const std::string &path)
+    {
+        std::ifstream in(path.c_str());
+        std::string magic;
+        int version = 0;
+        std::uint64_t read_interval = 0;
+
+        if (!(in >> magic >> version >> read_interval) || magic != CHAIN_MAGIC || version != CHAIN_VERSION ||
+            read_interval == 0)
+        {
+            return false;
+        }
+
+        std::vector<std::uint64_t> read_links;
+        std::uint64_t link;
+
+        while (in >> std::hex >> link)
+        {
+            read_links.push_back(link);
+        }
+
+        if (!in.eof())
+        {
+            return false;
+        }
+
+        interval = read_interval;
+        links.swap(read_links);
+
+        return true;
+    }
+
+    HashChain record_hash_chain(DivergenceCore &core, std::uint64_t interval, std::uint64_t cycle_limit)
+    {
+        HashChain chain;
+        chain.interval = interval;
+
+        CoreState state;
+        core.capture(state);
+
+        std::uint64_t start = state.cycles;
+        std::uint64_t link = FNV_OFFSET;
+
+        for (std::uint64_t target = start + interval; target <= cycle_limit; target += interval)
+        {
+            core.run_to(target);
+            core.capture(state);
+            link = mix_u64(link, core_state_hash(state));
+            chain.links.push_back(link);
+
+            if (state.halted)
+            {
+                break;
+            }
+        }
+
+        return chain;
+    }
+
+    Divergence find_divergence(DivergenceCore &reference, DivergenceCore &candidate,
+                               std::uint64_t interval, std::uint64_t cycle_limit)
+    {
+        Divergence result;
+        result.found = false;
+
+        reference.capture(result.reference);
+        candidate.capture(result.candidate);
+
+        std::uint64_t lo = result.reference.cycles;
+
+        if (!same_state(result.reference, result.candidate))
+        {
+            result.found = true;
+            result.cycle = lo;
+            result.before = result.reference;
+            return result;
+        }
+
+        while (lo < cycle_limit && !result.reference.halted)
+        {
+            std::uint64_t hi = cycle_limit - lo > interval ? lo + interval : cycle_limit;
+            std::unique_ptr<DivergenceCore> reference_checkpoint = reference.clone();
+            std::unique_ptr<DivergenceCore> candidate_checkpoint = candidate.clone();
+
+            reference.run_to(hi);
+            candidate.run_to(hi);
+            reference.capture(result.reference);
+            candidate.capture(result.candidate);
+
+            if (!same_state(result.reference, result.candidate))
+            {
+                bisect(std::move(reference_checkpoint), std::move(candidate_checkpoint), lo, hi, result);
+                break;
+            }
+
+            lo = hi;
+        }
+
+        return result;
+    }
+
+    Divergence find_divergence(DivergenceCore &reference, DivergenceCore &candidate, const HashChain &chain)
+    {
+        CoreState state;
+        candidate.capture(state);
+
+        std::uint64_t start = state.cycles;
+        std::uint64_t link = FNV_OFFSET;
+        std::unique_ptr<DivergenceCore> checkpoint;
+
+        for (std::size_t i = 0; i < chain.links.size(); ++i)
+        {
+            checkpoint = candidate.clone();
+            candidate.run_to(start + (i + 1) * chain.interval);
+            candidate.capture(state);
+            link = mix_u64(link, core_state_hash(state));
+
+            if (link != chain.links[i])
+            {
+                // 前一个检查点之前都一致，参考核心直接跑过去，只在这一段里逐段比较
+                std::uint64_t lo = start + i * chain.interval;
+                reference.run_to(lo);
+
+                return find_divergence(reference, *checkpoint, chain.interval, lo + chain.interval);
+            }
+
+            if (state.halted)
+            {
+                break;
+            }
+        }
+
+        Divergence result;
+        result.found = false;
+
+        return result;
+    }
+
+    void write_divergence(std::ostream &out, const Divergence &divergence)
+    {
+        if (!divergence.found)
+        {
+            out << "no divergence\n";
+            return;
+        }
+
+        out << "first divergence at cycle " << divergence.cycle << ", instruction at $";
+        write_hex(out, divergence.before.program_counter, 4);
+        out << ':';
+        for (int i = 0; i < 3; ++i)
+        {
+            out << ' ';
+            write_hex(out, divergence.before.instruction[i], 2);
+        }
+        out << '\n';
+
+        write_registers(out, "before   ", divergence.before);
+        write_registers(out, "reference", divergence.reference);
+        write_registers(out, "candidate", divergence.candidate);
+
+        for (std::size_t offset = 0; offset < WRITABLE_MEMORY_SIZE; ++offset)
+        {
+            Byte expected = divergence.reference.memory[offset];
+            Byte actual = divergence.candidate.memory[offset];
+
+            if (expected != actual)
+            {
+                out << '$';
+                write_hex(out, writable_address(offset), 4);
+                out << ": ";
+                write_hex(out, expected, 2);
+                out << " -> ";
+                write_hex(out, actual, 2);
+                out << '\n';
+            }
+        }
+    }
+}
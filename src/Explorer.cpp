@@ -0,0 +1,365 @@
+#include "Explorer.h"
+#include "Joypad.h"
+#include <cmath>
+#include <iterator>
+#include <random>
+#include <thread>
+
+namespace mysn
+{
+    namespace
+    {
+        std::size_t round_up_pow2(std::size_t value)
+        {
+            std::size_t result = 16;
+
+            while (result < value)
+            {
+                result <<= 1;
+            }
+
+            return result;
+        }
+
+        // 槽里的 0 表示空，哈希值 0 记作 1
+        std::uint64_t slot_key(std::uint64_t hash)
+        {
+            return hash == 0 ? 1 : hash;
+        }
+
+    }
+
+    StateHashSet::StateHashSet(std::size_t capacity)
+        : mask(round_up_pow2(capacity) - 1),
+          limit((mask + 1) / 8 * 7),
+          count(0),
+          rejected(0)
+    {
+        slots.reset(new std::atomic<std::uint64_t>[mask + 1]);
+
+        for (std::size_t i = 0; i <= mask; ++i)
+        {
+            slots[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    bool StateHashSet::insert(std::uint64_t hash)
+    {
+        std::uint64_t key = slot_key(hash);
+
+        for (std::size_t i = std::size_t(key) & mask, probes = 0; probes <= mask; i = (i + 1) & mask, ++probes)
+        {
+            std::uint64_t current = slots[i].load(std::memory_order_acquire);
+
+            if (current == key)
+            {
+                return false;
+            }
+
+            if (current != 0)
+            {
+                continue;
+            }
+
+            if (count.load(std::memory_order_relaxed) >= limit)
+            {
+                rejected.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+
+            if (slots[i].compare_exchange_strong(current, key, std::memory_order_acq_rel))
+            {
+                count.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            // 别的线程抢先写了这个槽，可能正是同一个哈希
+            if (current == key)
+            {
+                return false;
+            }
+        }
+
+        rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    bool StateHashSet::contains(std::uint64_t hash) const
+    {
+        std::uint64_t key = slot_key(hash);
+
+        for (std::size_t i = std::size_t(key) & mask, probes = 0; probes <= mask; i = (i + 1) & mask, ++probes)
+        {
+            std::uint64_t current = slots[i].load(std::memory_order_acquire);
+
+            if (current == key)
+            {
+                return true;
+            }
+            if (current == 0)
+            {
+                return false;
+            }
+        }
+
+        return false;
+    }
+
+    std::size_t StateHashSet::size() const
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    std::size_t StateHashSet::capacity() const
+    {
+        return mask + 1;
+    }
+
+    std::uint64_t StateHashSet::dropped() const
+    {
+        return rejected.load(std::memory_order_relaxed);
+    }
+
+    ExploreConfig::ExploreConfig()
+        : threads(0),
+          frames_per_step(8),
+          sequences_per_state(8),
+          max_frontier(1024),
+          visited_capacity(std::size_t(1) << 22),
+          max_expansions(10000),
+          seed(1)
+    {
+    }
+
+    // 手柄的移位寄存器也是状态的一部分，帧边界可能正好在读按键的中间
+    // 存档和工作线程的 CPU 都只留一条指令记录（默认的 2048 条每份 32KB），
+    // 不登记到崩溃处理函数；状态之间用 restore 复制，不复制记录也不分配内存
+    struct Explorer::Node
+    {
+        FlightRecord record;
+        CPU state;
+        Joypad joypad;
+        std::vector<Byte> inputs;
+
+        Node() : state(&record, 1) {}
+    };
+
+    struct Explorer::Worker
+    {
+        FlightRecord record;
+        CPU cpu;
+        Joypad joypad;
+        std::mt19937 rng;
+        std::vector<Byte> path;
+
+        explicit Worker(unsigned seed) : cpu(&record, 1), rng(seed) {}
+    };
+
+    Explorer::Explorer(const CPU &root, const ExploreConfig &config, const Joypad *joypad)
+        : config(config),
+          seen(config.visited_capacity),
+          feature_counts(new std::atomic<std::uint32_t>[config.features.size() * 256 + 1]),
+          started(0),
+          finished(0),
+          busy(0)
+    {
+        for (std::size_t i = 0; i < config.features.size() * 256; ++i)
+        {
+            feature_counts[i].store(0, std::memory_order_relaxed);
+        }
+
+        std::shared_ptr<Node> node = std::make_shared<Node>();
+        node->state.restore(root);
+        if (joypad != nullptr)
+        {
+            node->joypad = *joypad;
+        }
+
+        seen.insert(state_hash(node->state));
+        novelty(node->state);
+        frontier.insert(std::make_pair(0.0, std::shared_ptr<const Node>(node)));
+    }
+
+    Explorer::~Explorer()
+    {
+    }
+
+    void Explorer::run()
+    {
+        int count = config.threads > 0 ? config.threads : int(std::thread::hardware_concurrency());
+        std::vector<std::thread> threads;
+
+        for (int i = 0; i < (count > 0 ? count : 1); ++i)
+        {
+            threads.push_back(std::thread(&Explorer::worker_loop, this, config.seed + unsigned(i)));
+        }
+
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    std::uint64_t Explorer::expansions() const
+    {
+        return finished.load();
+    }
+
+    std::size_t Explorer::visited() const
+    {
+        return seen.size();
+    }
+
+    std::size_t Explorer::frontier_size() const
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        return frontier.size();
+    }
+
+    std::vector<ExploreFinding> Explorer::findings() const
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        return found;
+    }
+
+    void Explorer::worker_loop(unsigned seed)
+    {
+        Worker worker(seed);
+
+        while (std::shared_ptr<const Node> node = take())
+        {
+            expand(worker, *node);
+
+            std::lock_guard<std::mutex> guard(lock);
+            --busy;
+            finished.fetch_add(1);
+            wake.notify_all();
+        }
+    }
+
+    std::shared_ptr<const Explorer::Node> Explorer::take()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+
+        while (true)
+        {
+            if (started >= config.max_expansions)
+            {
+                return nullptr;
+            }
+
+            if (!frontier.empty())
+            {
+                auto best = std::prev(frontier.end());
+                std::shared_ptr<const Node> node = best->second;
+                frontier.erase(best);
+                ++started;
+                ++busy;
+
+                return node;
+            }
+
+            // 前沿空了而且没有线程还在扩展，探索结束
+            if (busy == 0)
+            {
+                return nullptr;
+            }
+
+            wake.wait(guard);
+        }
+    }
+
+    void Explorer::expand(Worker &worker, const Node &node)
+    {
+        for (std::size_t sequence = 0; sequence < config.sequences_per_state; ++sequence)
+        {
+            worker.cpu.restore(node.state);
+            worker.joypad = node.joypad;
+            worker.cpu.attach_joypad(0, &worker.joypad);
+            worker.path = node.inputs;
+
+            // 一半的帧沿用上一帧的按键，按住方向键走一段的序列更常见
+            Byte buttons = node.inputs.empty() ? 0 : node.inputs.back();
+            bool halted = false;
+
+            for (std::size_t frame = 0; frame < config.frames_per_step && !halted; ++frame)
+            {
+                if (worker.rng() & 1)
+                {
+                    buttons = Byte(worker.rng());
+                }
+
+                worker.joypad.set_buttons(buttons);
+                worker.path.push_back(buttons);
+
+                RunBudget budget = {0, 0, true};
+                halted = worker.cpu.run_for(budget) != Run_Frame_End;
+            }
+
+            std::uint64_t hash = state_hash(worker.cpu);
+
+            if (!seen.insert(hash))
+            {
+                continue;
+            }
+
+            if (halted)
+            {
+                report(Explore_Halted, hash, worker.path);
+                continue;
+            }
+
+            if (config.goal && config.goal(worker.cpu))
+            {
+                report(Explore_Goal, hash, worker.path);
+            }
+
+            std::shared_ptr<Node> child = std::make_shared<Node>();
+            child->state.restore(worker.cpu);
+            child->joypad = worker.joypad;
+            child->inputs = worker.path;
+
+            double score = novelty(child->state);
+            push(child, score);
+        }
+    }
+
+    // 每个特征值的得分是 1/sqrt(出现次数)，没见过的值得分最高
+    double Explorer::novelty(const CPU &cpu)
+    {
+        double score = 0.0;
+
+        for (std::size_t i = 0; i < config.features.size(); ++i)
+        {
+            Byte value = cpu.peek(config.features[i]);
+            std::uint32_t count = feature_counts[i * 256 + value].fetch_add(1, std::memory_order_relaxed) + 1;
+            score += 1.0 / std::sqrt(double(count));
+        }
+
+        return score;
+    }
+
+    void Explorer::push(std::shared_ptr<const Node> node, double score)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        frontier.insert(std::make_pair(score, node));
+
+        if (frontier.size() > config.max_frontier)
+        {
+            frontier.erase(frontier.begin());
+        }
+
+        wake.notify_one();
+    }
+
+    void Explorer::report(ExploreEvent event, std::uint64_t hash, const std::vector<Byte> &inputs)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        ExploreFinding finding = {event, hash, inputs};
+        found.push_back(finding);
+    }
+}
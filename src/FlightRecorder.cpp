@@ -0,0 +1,323 @@
+#include "FlightRecorder.h"
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <unistd.h>
+
+namespace mysn
+{
+    namespace
+    {
+        // 崩溃时要写出的记录器，槽位用完后新建的记录器不再登记
+        const int MAX_INSTANCES = 64;
+        std::atomic<FlightRecorder *> instances[MAX_INSTANCES];
+
+        const int FATAL_SIGNALS[] = {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT};
+
+        // 一行的缓冲，装不下的部分截掉
+        struct TextBuffer
+        {
+            char text[96];
+            std::size_t length;
+
+            TextBuffer() : length(0) {}
+
+            void put(char c)
+            {
+                if (length < sizeof(text))
+                {
+                    text[length++] = c;
+                }
+            }
+
+            void str(const char *s)
+            {
+                while (*s != '\0' && length < sizeof(text))
+                {
+                    text[length++] = *s++;
+                }
+            }
+
+            void hex(std::uint64_t value, int digits)
+            {
+                static const char table[] = "0123456789ABCDEF";
+
+                for (int i = digits - 1; i >= 0; --i)
+                {
+                    put(table[(value >> (4 * i)) & 0xF]);
+                }
+            }
+
+            void dec(std::uint64_t value)
+            {
+                char digits[24];
+                int n = 0;
+
+                do
+                {
+                    digits[n++] = char('0' + value % 10);
+                    value /= 10;
+                } while (value != 0);
+
+                while (n > 0)
+                {
+                    put(digits[--n]);
+                }
+            }
+
+            void flush(int fd)
+            {
+                std::size_t offset = 0;
+
+                while (offset < length)
+                {
+                    ssize_t written = ::write(fd, text + offset, length - offset);
+                    if (written <= 0)
+                    {
+                        break;
+                    }
+                    offset += std::size_t(written);
+                }
+
+                length = 0;
+            }
+        };
+
+        std::size_t round_up_pow2(std::size_t value)
+        {
+            std::size_t result = 1;
+
+            while (result < value)
+            {
+                result <<= 1;
+            }
+
+            return result;
+        }
+    }
+
+    FlightRecorder::FlightRecorder(std::size_t capacity)
+        : next(0),
+          fd(STDERR_FILENO),
+          faulted_at(0),
+          registered(false)
+    {
+        set_capacity(capacity);
+        register_instance();
+    }
+
+    FlightRecorder::FlightRecorder(FlightRecord *buffer, std::size_t capacity)
+        : data(buffer),
+          mask(capacity - 1),
+          next(0),
+          fd(STDERR_FILENO),
+          faulted_at(0),
+          registered(false)
+    {
+    }
+
+    FlightRecorder::FlightRecorder(const FlightRecorder &other)
+        : records(other.data, other.data + other.capacity()),
+          data(&records[0]),
+          mask(other.mask),
+          next(other.next),
+          fd(other.fd),
+          faulted_at(0),
+          registered(false)
+    {
+        register_instance();
+    }
+
+    FlightRecorder &FlightRecorder::operator=(const FlightRecorder &other)
+    {
+        if (this != &other)
+        {
+            if (records.empty() && capacity() == other.capacity())
+            {
+                // 调用者的存储，容量一样时原地复制
+                std::copy(other.data, other.data + other.capacity(), data);
+            }
+            else
+            {
+                records.assign(other.data, other.data + other.capacity());
+                data = &records[0];
+            }
+            mask = other.mask;
+            next = other.next;
+            fd = other.fd;
+            faulted_at = 0;
+        }
+
+        return *this;
+    }
+
+    FlightRecorder::~FlightRecorder()
+    {
+        unregister_instance();
+    }
+
+    void FlightRecorder::set_capacity(std::size_t capacity)
+    {
+        std::size_t size = round_up_pow2(capacity == 0 ? 1 : capacity);
+
+        records.assign(size, FlightRecord());
+        data = &records[0];
+        mask = size - 1;
+        next = 0;
+        faulted_at = 0;
+    }
+
+    std::size_t FlightRecorder::capacity() const
+    {
+        return std::size_t(mask + 1);
+    }
+
+    std::uint64_t FlightRecorder::total_recorded() const
+    {
+        return next;
+    }
+
+    void FlightRecorder::clear()
+    {
+        next = 0;
+        faulted_at = 0;
+    }
+
+    std::vector<FlightRecord> FlightRecorder::snapshot() const
+    {
+        std::uint64_t count = next < capacity() ? next : capacity();
+        std::vector<FlightRecord> result;
+        result.reserve(std::size_t(count));
+
+        for (std::uint64_t i = next - count; i < next; ++i)
+        {
+            result.push_back(data[i & mask]);
+        }
+
+        return result;
+    }
+
+    void FlightRecorder::set_dump_fd(int fd)
+    {
+        this->fd = fd;
+    }
+
+    int FlightRecorder::dump_fd() const
+    {
+        return fd;
+    }
+
+    void FlightRecorder::dump(int fd, const char *reason) const
+    {
+        if (fd < 0)
+        {
+            return;
+        }
+
+        std::uint64_t count = next < capacity() ? next : capacity();
+        TextBuffer line;
+
+        line.str("flight recorder: ");
+        line.str(reason);
+        line.str(", last ");
+        line.dec(count);
+        line.str(" of ");
+        line.dec(next);
+        line.str(" instructions\n");
+        line.flush(fd);
+
+        for (std::uint64_t i = next - count; i < next; ++i)
+        {
+            const FlightRecord &r = data[i & mask];
+
+            line.hex(r.pc, 4);
+            line.str("  ");
+            line.hex(r.opcode, 2);
+            line.str("  A:");
+            line.hex(r.a, 2);
+            line.str(" X:");
+            line.hex(r.x, 2);
+            line.str(" Y:");
+            line.hex(r.y, 2);
+            line.str(" P:");
+            line.hex(r.status, 2);
+            line.str(" SP:");
+            line.hex(r.sp, 2);
+            line.str(" CYC:");
+            line.dec(r.cycles);
+            line.str("\n");
+            line.flush(fd);
+        }
+    }
+
+    void FlightRecorder::dump(std::FILE *file, const char *reason) const
+    {
+        std::fflush(file);
+        dump(fileno(file), reason);
+    }
+
+    void FlightRecorder::fault(const char *reason) const
+    {
+        dump(fd, reason);
+        faulted_at = next;
+    }
+
+    void FlightRecorder::register_instance()
+    {
+        for (int i = 0; i < MAX_INSTANCES; ++i)
+        {
+            FlightRecorder *expected = nullptr;
+
+            if (instances[i].compare_exchange_strong(expected, this))
+            {
+                registered = true;
+                return;
+            }
+        }
+    }
+
+    void FlightRecorder::unregister_instance()
+    {
+        if (!registered)
+        {
+            return;
+        }
+
+        for (int i = 0; i < MAX_INSTANCES; ++i)
+        {
+            FlightRecorder *expected = this;
+
+            if (instances[i].compare_exchange_strong(expected, nullptr))
+            {
+                return;
+            }
+        }
+    }
+
+    void FlightRecorder::crash_handler(int signal)
+    {
+        const char *reason = signal == SIGABRT ? "abort" : "fatal signal";
+
+        for (int i = 0; i < MAX_INSTANCES; ++i)
+        {
+            FlightRecorder *recorder = instances[i].load();
+
+            if (recorder != nullptr && recorder->next != 0 && recorder->faulted_at != recorder->next)
+            {
+                recorder->dump(recorder->fd, reason);
+            }
+        }
+
+        std::signal(signal, SIG_DFL);
+        std::raise(signal);
+    }
+
+    void FlightRecorder::install_crash_handler()
+    {
+        for (int signal : FATAL_SIGNALS)
+        {
+            std::signal(signal, &FlightRecorder::crash_handler);
+        }
+    }
+}
@@ -0,0 +1,270 @@
+#include "ForkServer.h"
+#include "CPURun.h"
+#include "Joypad.h"
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace mysn
+{
+    namespace
+    {
+        // 执行到周期上限或指定 PC 后停下
+        struct RunUntil
+        {
+            std::uint64_t cycle_limit;
+            bool stop_at_pc;
+            Address pc;
+            bool stopped;
+
+            void before_instruction(CPU &, Byte) {}
+
+            void after_instruction(CPU &cpu, Byte, bool)
+            {
+                if (cpu.cycles >= cycle_limit || (stop_at_pc && cpu.program_counter == pc))
+                {
+                    stopped = true;
+                    cpu.request_stop();
+                }
+            }
+        };
+
+        ForkResult failed_result()
+        {
+            ForkResult result;
+            std::memset(&result, 0, sizeof(result));
+            result.outcome = Fork_Failed;
+
+            return result;
+        }
+
+        bool write_all(int fd, const void *data, std::size_t length)
+        {
+            const char *p = static_cast<const char *>(data);
+
+            while (length != 0)
+            {
+                ssize_t written = ::write(fd, p, length);
+
+                if (written < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (written <= 0)
+                {
+                    return false;
+                }
+
+                p += written;
+                length -= std::size_t(written);
+            }
+
+            return true;
+        }
+
+        std::size_t read_all(int fd, void *data, std::size_t length)
+        {
+            char *p = static_cast<char *>(data);
+            std::size_t total = 0;
+
+            while (total < length)
+            {
+                ssize_t n = ::read(fd, p + total, length - total);
+
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n <= 0)
+                {
+                    break;
+                }
+
+                total += std::size_t(n);
+            }
+
+            return total;
+        }
+    }
+
+    ForkServer::ForkServer(CPU &cpu, Joypad *joypad) : cpu(cpu), joypad(joypad)
+    {
+    }
+
+    bool ForkServer::run_until(std::uint64_t cycle_limit, bool stop_at_pc, Address pc)
+    {
+        if (cpu.cycles >= cycle_limit)
+        {
+            return true;
+        }
+
+        RunUntil policy = {cycle_limit, stop_at_pc, pc, false};
+        cpu.run_with(policy);
+
+        return policy.stopped;
+    }
+
+    bool ForkServer::run_to_pc(Address pc, std::uint64_t max_cycles)
+    {
+        if (cpu.program_counter == pc)
+        {
+            return true;
+        }
+
+        return run_until(cpu.cycles + max_cycles, true, pc) && cpu.program_counter == pc;
+    }
+
+    bool ForkServer::run_to_frame(std::uint64_t frame)
+    {
+        return run_until(frame * CYCLES_PER_FRAME, false, 0);
+    }
+
+    std::uint64_t ForkServer::frame() const
+    {
+        return cpu.cycles / CYCLES_PER_FRAME;
+    }
+
+    ForkResult ForkServer::execute(const std::vector<Byte> &inputs)
+    {
+        ForkResult result = failed_result();
+        result.outcome = Fork_Completed;
+
+        std::uint64_t first = frame();
+
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+        {
+            if (joypad != nullptr)
+            {
+                joypad->set_buttons(inputs[i]);
+            }
+
+            if (!run_until((first + i + 1) * CYCLES_PER_FRAME, false, 0))
+            {
+                result.outcome = Fork_Halted;
+                break;
+            }
+
+            ++result.frames;
+        }
+
+        result.cycles = cpu.cycles;
+        result.program_counter = cpu.program_counter;
+        result.register_a = cpu.register_a;
+        result.register_x = cpu.register_x;
+        result.register_y = cpu.register_y;
+        result.status = cpu.status;
+        result.stack_pointer = cpu.stack_pointer;
+        result.ram_hash = ram_hash(cpu);
+
+        return result;
+    }
+
+    ForkServer::Child ForkServer::spawn(const std::vector<Byte> &inputs, std::size_t index, ForkResult &failed)
+    {
+        Child child = {-1, -1, index};
+        int fds[2];
+
+        if (pipe(fds) != 0)
+        {
+            failed = failed_result();
+            return child;
+        }
+
+        pid_t pid = fork();
+
+        if (pid < 0)
+        {
+            close(fds[0]);
+            close(fds[1]);
+            failed = failed_result();
+            return child;
+        }
+
+        if (pid == 0)
+        {
+            close(fds[0]);
+            ForkResult result = execute(inputs);
+            bool ok = write_all(fds[1], &result, sizeof(result));
+            // 不跑父进程注册的 atexit，也不重复刷出父进程的 stdio 缓冲
+            _exit(ok ? 0 : 1);
+        }
+
+        close(fds[1]);
+        child.pid = pid;
+        child.fd = fds[0];
+
+        return child;
+    }
+
+    ForkResult ForkServer::collect(const Child &child)
+    {
+        ForkResult result;
+        bool received = read_all(child.fd, &result, sizeof(result)) == sizeof(result);
+        close(child.fd);
+
+        int status = 0;
+        while (waitpid(child.pid, &status, 0) < 0 && errno == EINTR)
+        {
+        }
+
+        if (WIFSIGNALED(status))
+        {
+            result = failed_result();
+            result.outcome = Fork_Crashed;
+            result.signal = WTERMSIG(status);
+        }
+        else if (!received || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            result = failed_result();
+        }
+
+        return result;
+    }
+
+    ForkResult ForkServer::run_case(const std::vector<Byte> &inputs)
+    {
+        ForkResult result;
+        Child child = spawn(inputs, 0, result);
+
+        if (child.pid < 0)
+        {
+            return result;
+        }
+
+        return collect(child);
+    }
+
+    std::vector<ForkResult> ForkServer::run_cases(const std::vector<std::vector<Byte>> &cases, int parallel)
+    {
+        std::vector<ForkResult> results(cases.size());
+        std::deque<Child> running;
+        std::size_t limit = parallel > 0 ? std::size_t(parallel) : 1;
+
+        for (std::size_t i = 0; i < cases.size(); ++i)
+        {
+            // 结果只有几十字节，小于 PIPE_BUF，子进程写完即退出，不会因为父进程还没读而阻塞
+            if (running.size() >= limit)
+            {
+                results[running.front().index] = collect(running.front());
+                running.pop_front();
+            }
+
+            Child child = spawn(cases[i], i, results[i]);
+
+            if (child.pid >= 0)
+            {
+                running.push_back(child);
+            }
+        }
+
+        while (!running.empty())
+        {
+            results[running.front().index] = collect(running.front());
+            running.pop_front();
+        }
+
+        return results;
+    }
+}
@@ -0,0 +1,318 @@
+#include "FrameEncoder.h"
+#include <cstring>
+
+#if MYSN_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace mysn
+{
+    namespace
+    {
+        struct CrcTable
+        {
+            std::uint32_t entries[256];
+
+            CrcTable()
+            {
+                for (std::uint32_t n = 0; n < 256; ++n)
+                {
+                    std::uint32_t c = n;
+
+                    for (int k = 0; k < 8; ++k)
+                    {
+                        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    }
+
+                    entries[n] = c;
+                }
+            }
+        };
+
+        std::uint32_t crc32_update(std::uint32_t crc, const std::uint8_t *data, std::size_t length)
+        {
+            static const CrcTable table;
+
+            for (std::size_t i = 0; i < length; ++i)
+            {
+                crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+            }
+
+            return crc;
+        }
+
+        void store_u32_be(std::uint8_t *out, std::uint32_t value)
+        {
+            out[0] = std::uint8_t(value >> 24);
+            out[1] = std::uint8_t(value >> 16);
+            out[2] = std::uint8_t(value >> 8);
+            out[3] = std::uint8_t(value);
+        }
+
+        void write_chunk(std::FILE *file, const char *type, const std::uint8_t *data, std::size_t length)
+        {
+            std::uint8_t header[8];
+            store_u32_be(header, std::uint32_t(length));
+            std::memcpy(header + 4, type, 4);
+
+            std::uint32_t crc = crc32_update(0xFFFFFFFFu, header + 4, 4);
+            crc = crc32_update(crc, data, length) ^ 0xFFFFFFFFu;
+
+            std::uint8_t trailer[4];
+            store_u32_be(trailer, crc);
+
+            std::fwrite(header, 1, 8, file);
+            // IEND 没有数据，data 为 nullptr，不能传给 fwrite
+            if (length != 0)
+            {
+                std::fwrite(data, 1, length, file);
+            }
+            std::fwrite(trailer, 1, 4, file);
+        }
+
+        std::uint8_t clamp_u8(int value)
+        {
+            return std::uint8_t(value < 0 ? 0 : (value > 255 ? 255 : value));
+        }
+
+        const std::size_t STORED_BLOCK = 65535;
+    }
+
+    RawRgbEncoder::RawRgbEncoder(const std::string &path, int width, int height)
+        : file(std::fopen(path.c_str(), "wb")),
+          frame_bytes(std::size_t(width) * height * 3)
+    {
+    }
+
+    RawRgbEncoder::~RawRgbEncoder()
+    {
+        close();
+    }
+
+    bool RawRgbEncoder::is_open() const
+    {
+        return file != nullptr;
+    }
+
+    void RawRgbEncoder::write_frame(const std::uint8_t *rgb)
+    {
+        if (file != nullptr)
+        {
+            std::fwrite(rgb, 1, frame_bytes, file);
+        }
+    }
+
+    void RawRgbEncoder::close()
+    {
+        if (file != nullptr)
+        {
+            std::fclose(file);
+            file = nullptr;
+        }
+    }
+
+    Y4mEncoder::Y4mEncoder(const std::string &path, int width, int height)
+        : file(std::fopen(path.c_str(), "wb")),
+          width(width),
+          height(height),
+          planes(std::size_t(width) * height + 2 * std::size_t((width + 1) / 2) * ((height + 1) / 2))
+    {
+        if (file != nullptr)
+        {
+            std::fprintf(file, "YUV4MPEG2 W%d H%d F39375000:655171 Ip A1:1 C420jpeg\n", width, height);
+        }
+    }
+
+    Y4mEncoder::~Y4mEncoder()
+    {
+        close();
+    }
+
+    bool Y4mEncoder::is_open() const
+    {
+        return file != nullptr;
+    }
+
+    void Y4mEncoder::write_frame(const std::uint8_t *rgb)
+    {
+        if (file == nullptr)
+        {
+            return;
+        }
+
+        const int chroma_width = (width + 1) / 2;
+        const int chroma_height = (height + 1) / 2;
+        std::uint8_t *y_plane = &planes[0];
+        std::uint8_t *u_plane = y_plane + std::size_t(width) * height;
+        std::uint8_t *v_plane = u_plane + std::size_t(chroma_width) * chroma_height;
+
+        // 系数放大 2^16 后取整
+        for (int i = 0; i < width * height; ++i)
+        {
+            const std::uint8_t *p = rgb + 3 * i;
+            y_plane[i] = std::uint8_t((19595 * p[0] + 38470 * p[1] + 7471 * p[2] + 32768) >> 16);
+        }
+
+        // 色度取 2x2 块的平均
+        for (int cy = 0; cy < chroma_height; ++cy)
+        {
+            for (int cx = 0; cx < chroma_width; ++cx)
+            {
+                int r = 0, g = 0, b = 0, n = 0;
+
+                for (int dy = 0; dy < 2 && 2 * cy + dy < height; ++dy)
+                {
+                    for (int dx = 0; dx < 2 && 2 * cx + dx < width; ++dx)
+                    {
+                        const std::uint8_t *p = rgb + 3 * ((2 * cy + dy) * width + 2 * cx + dx);
+                        r += p[0];
+                        g += p[1];
+                        b += p[2];
+                        ++n;
+                    }
+                }
+
+                int u = (-11059 * r - 21709 * g + 32768 * b) / n;
+                int v = (32768 * r - 27439 * g - 5329 * b) / n;
+
+                u_plane[cy * chroma_width + cx] = clamp_u8(128 + ((u + 32768) >> 16));
+                v_plane[cy * chroma_width + cx] = clamp_u8(128 + ((v + 32768) >> 16));
+            }
+        }
+
+        std::fwrite("FRAME\n", 1, 6, file);
+        std::fwrite(&planes[0], 1, planes.size(), file);
+    }
+
+    void Y4mEncoder::close()
+    {
+        if (file != nullptr)
+        {
+            std::fclose(file);
+            file = nullptr;
+        }
+    }
+
+    PngEncoder::PngEncoder(const std::string &prefix, int width, int height)
+        : prefix(prefix),
+          width(width),
+          height(height),
+          index(0),
+          failed(false),
+          scanlines(std::size_t(height) * (1 + std::size_t(width) * 3)),
+          path(prefix.size() + 16)
+    {
+        std::size_t raw = scanlines.size();
+
+#if MYSN_HAVE_ZLIB
+        compressed.resize(compressBound(uLong(raw)));
+#else
+        compressed.resize(2 + (raw / STORED_BLOCK + 1) * 5 + raw + 4);
+#endif
+    }
+
+    bool PngEncoder::is_open() const
+    {
+        return !failed;
+    }
+
+    std::size_t PngEncoder::deflate()
+    {
+        const std::size_t raw = scanlines.size();
+
+#if MYSN_HAVE_ZLIB
+        uLongf length = uLongf(compressed.size());
+        compress2(&compressed[0], &length, &scanlines[0], uLong(raw), Z_BEST_SPEED);
+
+        return std::size_t(length);
+#else
+        // zlib 头 + 不压缩的 deflate 块 + Adler-32
+        std::uint8_t *out = &compressed[0];
+        std::uint32_t a = 1, b = 0;
+
+        *out++ = 0x78;
+        *out++ = 0x01;
+
+        for (std::size_t offset = 0; offset < raw;)
+        {
+            std::size_t length = raw - offset < STORED_BLOCK ? raw - offset : STORED_BLOCK;
+
+            *out++ = std::uint8_t(offset + length == raw ? 1 : 0);
+            *out++ = std::uint8_t(length);
+            *out++ = std::uint8_t(length >> 8);
+            *out++ = std::uint8_t(~length);
+            *out++ = std::uint8_t(~length >> 8);
+            std::memcpy(out, &scanlines[offset], length);
+            out += length;
+
+            for (std::size_t i = 0; i < length; ++i)
+            {
+                a = (a + scanlines[offset + i]) % 65521;
+                b = (b + a) % 65521;
+            }
+
+            offset += length;
+        }
+
+        store_u32_be(out, (b << 16) | a);
+        out += 4;
+
+        return std::size_t(out - &compressed[0]);
+#endif
+    }
+
+    void PngEncoder::write_frame(const std::uint8_t *rgb)
+    {
+        const std::size_t row = std::size_t(width) * 3;
+
+        for (int y = 0; y < height; ++y)
+        {
+            std::uint8_t *line = &scanlines[y * (row + 1)];
+            line[0] = 0; // 不做行滤波
+            std::memcpy(line + 1, rgb + y * row, row);
+        }
+
+        std::size_t length = deflate();
+
+        std::snprintf(&path[0], path.size(), "%s_%06u.png", prefix.c_str(), unsigned(index++));
+        std::FILE *file = std::fopen(&path[0], "wb");
+
+        if (file == nullptr)
+        {
+            failed = true;
+            return;
+        }
+
+        static const std::uint8_t signature[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+        std::uint8_t ihdr[13];
+        store_u32_be(ihdr, std::uint32_t(width));
+        store_u32_be(ihdr + 4, std::uint32_t(height));
+        ihdr[8] = 8;  // 位深
+        ihdr[9] = 2;  // RGB
+        ihdr[10] = 0; // deflate
+        ihdr[11] = 0; // 自适应滤波
+        ihdr[12] = 0; // 不隔行
+
+        std::fwrite(signature, 1, 8, file);
+        write_chunk(file, "IHDR", ihdr, sizeof(ihdr));
+        write_chunk(file, "IDAT", &compressed[0], length);
+        write_chunk(file, "IEND", nullptr, 0);
+        std::fclose(file);
+    }
+
+    std::unique_ptr<FrameEncoder> make_frame_encoder(FrameFormat format, const std::string &path,
+                                                     int width, int height)
+    {
+        switch (format)
+        {
+        case Frame_Y4M:
+            return std::unique_ptr<FrameEncoder>(new Y4mEncoder(path, width, height));
+
+        case Frame_PNG:
+            return std::unique_ptr<FrameEncoder>(new PngEncoder(path, width, height));
+
+        default:
+            return std::unique_ptr<FrameEncoder>(new RawRgbEncoder(path, width, height));
+        }
+    }
+}
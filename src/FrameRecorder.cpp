@@ -0,0 +1,175 @@
+#include "FrameRecorder.h"
+#include <chrono>
+#include <utility>
+
+namespace mysn
+{
+    namespace
+    {
+        // 先让出几次时间片，仍然等不到再短暂休眠，空闲时不空转占满一个核
+        void backoff(int &spins)
+        {
+            if (++spins < 64)
+            {
+                std::this_thread::yield();
+            }
+            else
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        }
+    }
+
+    FrameRing::FrameRing(std::size_t frame_bytes, std::size_t capacity)
+        : bytes(frame_bytes),
+          slots(capacity < 2 ? 2 : capacity),
+          storage(bytes * slots),
+          head(0),
+          tail(0)
+    {
+    }
+
+    std::size_t FrameRing::frame_bytes() const
+    {
+        return bytes;
+    }
+
+    std::size_t FrameRing::capacity() const
+    {
+        return slots;
+    }
+
+    std::uint8_t *FrameRing::acquire()
+    {
+        std::size_t h = head.load(std::memory_order_relaxed);
+
+        if (h - tail.load(std::memory_order_acquire) >= slots)
+        {
+            return nullptr;
+        }
+
+        return &storage[(h % slots) * bytes];
+    }
+
+    void FrameRing::publish()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    const std::uint8_t *FrameRing::front()
+    {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+
+        if (t == head.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+
+        return &storage[(t % slots) * bytes];
+    }
+
+    void FrameRing::release()
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    FrameRecorder::FrameRecorder(std::unique_ptr<FrameEncoder> encoder, int width, int height,
+                                 FramePolicy policy, std::size_t capacity)
+        : ring(std::size_t(width) * height * 3, capacity),
+          encoder(std::move(encoder)),
+          policy(policy),
+          stopping(false),
+          written(0),
+          dropped(0)
+    {
+        writer = std::thread(&FrameRecorder::writer_loop, this);
+    }
+
+    FrameRecorder::~FrameRecorder()
+    {
+        close();
+    }
+
+    std::uint8_t *FrameRecorder::begin_frame()
+    {
+        std::uint8_t *frame = ring.acquire();
+        int spins = 0;
+
+        while (frame == nullptr)
+        {
+            if (policy == Drop_When_Full || stopping.load(std::memory_order_relaxed))
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            backoff(spins);
+            frame = ring.acquire();
+        }
+
+        return frame;
+    }
+
+    void FrameRecorder::end_frame()
+    {
+        ring.publish();
+    }
+
+    void FrameRecorder::close()
+    {
+        if (!writer.joinable())
+        {
+            return;
+        }
+
+        stopping.store(true, std::memory_order_release);
+        writer.join();
+
+        if (encoder)
+        {
+            encoder->close();
+        }
+    }
+
+    std::uint64_t FrameRecorder::frames_written() const
+    {
+        return written.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t FrameRecorder::frames_dropped() const
+    {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    void FrameRecorder::writer_loop()
+    {
+        int spins = 0;
+
+        while (true)
+        {
+            const std::uint8_t *frame = ring.front();
+
+            if (frame == nullptr)
+            {
+                // 先看停止标志再确认一次环空，保证 close 之前提交的帧都写完
+                if (stopping.load(std::memory_order_acquire) && ring.front() == nullptr)
+                {
+                    return;
+                }
+
+                backoff(spins);
+                continue;
+            }
+
+            spins = 0;
+
+            if (encoder)
+            {
+                encoder->write_frame(frame);
+            }
+
+            ring.release();
+            written.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,170 @@
+#include "InstancePool.h"
+#include <cstdint>
+#include <new>
+#include <sys/mman.h>
+
+namespace mysn
+{
+    namespace
+    {
+        // 透明大页的大小，区域按它对齐才能整页映射
+        const std::size_t HUGE_PAGE_SIZE = std::size_t(2) << 20;
+
+        std::size_t round_up(std::size_t value, std::size_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        // 多映射一个大页再把首尾多余的部分还回去，得到按大页对齐的区域
+        void *map_arena(std::size_t size)
+        {
+            std::size_t mapped_size = size + HUGE_PAGE_SIZE;
+            void *mapped = ::mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if (mapped == MAP_FAILED)
+            {
+                throw std::bad_alloc();
+            }
+
+            char *begin = static_cast<char *>(mapped);
+            char *aligned = reinterpret_cast<char *>(round_up(reinterpret_cast<std::size_t>(begin), HUGE_PAGE_SIZE));
+            char *end = begin + mapped_size;
+
+            if (aligned != begin)
+            {
+                ::munmap(begin, std::size_t(aligned - begin));
+            }
+            if (aligned + size != end)
+            {
+                ::munmap(aligned + size, std::size_t(end - (aligned + size)));
+            }
+
+#ifdef MADV_HUGEPAGE
+            // 只是建议，内核不支持时忽略
+            ::madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+
+            return aligned;
+        }
+    }
+
+    namespace
+    {
+        // count 个实例加快照，连同它们的指令记录一共要的字节数，按大页取整；放不下时抛 std::bad_alloc
+        std::size_t arena_bytes(std::size_t count)
+        {
+            const std::size_t per_instance =
+                sizeof(PoolInstance) + InstancePool::RECORDER_CAPACITY * sizeof(FlightRecord);
+
+            // count + 1 和取整都不能溢出，否则映射的区域比构造的实例小
+            if (count >= (SIZE_MAX - HUGE_PAGE_SIZE) / per_instance)
+            {
+                throw std::bad_alloc();
+            }
+
+            return round_up((count + 1) * per_instance, HUGE_PAGE_SIZE);
+        }
+    }
+
+    PoolInstance::PoolInstance(FlightRecord *recorder_buffer)
+        : cpu(recorder_buffer, InstancePool::RECORDER_CAPACITY)
+    {
+        cpu.attach_ppu(&ppu);
+        cpu.attach_joypad(0, &joypad);
+    }
+
+    InstancePool::InstancePool(std::size_t count, const SharedRom &rom)
+        : count(count),
+          instances(nullptr),
+          records(nullptr),
+          arena(nullptr),
+          arena_size(arena_bytes(count))
+    {
+        arena = map_arena(arena_size);
+        instances = static_cast<PoolInstance *>(arena);
+        records = reinterpret_cast<FlightRecord *>(instances + count + 1);
+
+        std::size_t constructed = 0;
+
+        try
+        {
+            for (; constructed <= count; ++constructed)
+            {
+                PoolInstance *instance = new (&instances[constructed]) PoolInstance(&records[constructed * RECORDER_CAPACITY]);
+                instance->cpu.load_and_reset(rom);
+            }
+        }
+        catch (...)
+        {
+            // 析构函数不会执行，已经构造的实例要在这里析构
+            while (constructed > 0)
+            {
+                instances[--constructed].~PoolInstance();
+            }
+            ::munmap(arena, arena_size);
+            throw;
+        }
+    }
+
+    InstancePool::~InstancePool()
+    {
+        for (std::size_t i = 0; i <= count; ++i)
+        {
+            instances[i].~PoolInstance();
+        }
+
+        ::munmap(arena, arena_size);
+    }
+
+    std::size_t InstancePool::size() const
+    {
+        return count;
+    }
+
+    PoolInstance &InstancePool::instance(std::size_t index)
+    {
+        return instances[index];
+    }
+
+    const PoolInstance &InstancePool::instance(std::size_t index) const
+    {
+        return instances[index];
+    }
+
+    void InstancePool::set_snapshot(const PoolInstance &state)
+    {
+        PoolInstance &snapshot = instances[count];
+
+        if (&state == &snapshot)
+        {
+            return;
+        }
+
+        snapshot.cpu.restore(state.cpu);
+        snapshot.ppu = state.ppu;
+        snapshot.joypad = state.joypad;
+    }
+
+    const PoolInstance &InstancePool::snapshot() const
+    {
+        return instances[count];
+    }
+
+    void InstancePool::reset(std::size_t index)
+    {
+        const PoolInstance &snapshot = instances[count];
+        PoolInstance &instance = instances[index];
+
+        instance.cpu.restore(snapshot.cpu);
+        instance.ppu = snapshot.ppu;
+        instance.joypad = snapshot.joypad;
+    }
+
+    void InstancePool::reset_all()
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            reset(i);
+        }
+    }
+}
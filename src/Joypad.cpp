@@ -0,0 +1,55 @@
+#include "Joypad.h"
+
+namespace mysn
+{
+    Joypad::Joypad() : state(0), shift(0), strobe(false)
+    {
+    }
+
+    void Joypad::set_buttons(Byte buttons)
+    {
+        state = buttons;
+    }
+
+    Byte Joypad::buttons() const
+    {
+        return state;
+    }
+
+    void Joypad::write(Byte data)
+    {
+        strobe = (data & 1) != 0;
+
+        if (strobe)
+        {
+            shift = state;
+        }
+    }
+
+    Byte Joypad::read()
+    {
+        if (strobe)
+        {
+            return 0x40 | (state & Button_A);
+        }
+
+        Byte bit = shift & 1;
+        shift = Byte(shift >> 1 | 0x80);
+
+        return 0x40 | bit;
+    }
+
+    void Joypad::save_state(Byte *data) const
+    {
+        data[0] = state;
+        data[1] = shift;
+        data[2] = strobe ? 1 : 0;
+    }
+
+    void Joypad::load_state(const Byte *data)
+    {
+        state = data[0];
+        shift = data[1];
+        strobe = data[2] != 0;
+    }
+}
@@ -0,0 +1,694 @@
+#include "Movie.h"
+#include "StateHash.h"
+#include "ThreadPool.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace mysn
+{
+    namespace
+    {
+        const char *const MAGIC = "mysn-movie";
+        const int VERSION = 1;
+
+        const char CHECKPOINT_MAGIC[4] = {'M', 'S', 'C', 'K'};
+        const std::uint16_t CHECKPOINT_VERSION = 1;
+        const std::size_t CHECKPOINT_HEADER_SIZE = 16;
+
+        // save_state 第 0 字节，记下挂了哪几个手柄口
+        const Byte STATE_PORT0 = 0x01;
+        const Byte STATE_PORT1 = 0x02;
+        const std::size_t STATE_MEMORY_OFFSET = 16;
+        const std::size_t STATE_JOYPAD_OFFSET = STATE_MEMORY_OFFSET + WRITABLE_MEMORY_SIZE;
+
+        const std::uint64_t FNV_OFFSET = 0xcbf29ce484222325ull;
+        const std::uint64_t FNV_PRIME = 0x100000001b3ull;
+
+        void put_u16(Byte *p, std::uint16_t value)
+        {
+            p[0] = Byte(value);
+            p[1] = Byte(value >> 8);
+        }
+
+        void put_u32(Byte *p, std::uint32_t value)
+        {
+            put_u16(p, std::uint16_t(value));
+            put_u16(p + 2, std::uint16_t(value >> 16));
+        }
+
+        void put_u64(Byte *p, std::uint64_t value)
+        {
+            put_u32(p, std::uint32_t(value));
+            put_u32(p + 4, std::uint32_t(value >> 32));
+        }
+
+        std::uint16_t get_u16(const Byte *p)
+        {
+            return std::uint16_t(p[0] | p[1] << 8);
+        }
+
+        std::uint32_t get_u32(const Byte *p)
+        {
+            return get_u16(p) | std::uint32_t(get_u16(p + 2)) << 16;
+        }
+
+        std::uint64_t get_u64(const Byte *p)
+        {
+            return get_u32(p) | std::uint64_t(get_u32(p + 4)) << 32;
+        }
+
+        std::uint64_t fnv_hash(const std::vector<Byte> &data)
+        {
+            std::uint64_t hash = FNV_OFFSET;
+
+            for (Byte value : data)
+            {
+                hash = (hash ^ value) * FNV_PRIME;
+            }
+
+            return hash;
+        }
+
+        // verify_segments 里每段自己的一套
+        struct SegmentMachine
+        {
+            CPU cpu;
+            Joypad port0;
+            Joypad port1;
+        };
+
+        // 从第 7 位到第 0 位
+        const char BUTTON_LETTERS[] = "RLDUTSBA";
+
+        void write_buttons(std::ostream &out, Byte buttons)
+        {
+            for (int i = 0; i < 8; ++i)
+            {
+                out << ((buttons & (0x80 >> i)) ? BUTTON_LETTERS[i] : '.');
+            }
+        }
+
+        bool parse_buttons(const std::string &text, std::size_t offset, Byte &buttons)
+        {
+            buttons = 0;
+
+            for (int i = 0; i < 8; ++i)
+            {
+                char c = text[offset + i];
+
+                if (c == BUTTON_LETTERS[i])
+                {
+                    buttons |= Byte(0x80 >> i);
+                }
+                else if (c != '.')
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        bool parse_hash(const std::string &text, std::size_t offset, std::uint64_t &hash)
+        {
+            if (text.size() - offset != 16)
+            {
+                return false;
+            }
+
+            hash = 0;
+            for (std::size_t i = offset; i < text.size(); ++i)
+            {
+                char c = text[i];
+                int digit;
+
+                if (c >= '0' && c <= '9')
+                {
+                    digit = c - '0';
+                }
+                else if (c >= 'a' && c <= 'f')
+                {
+                    digit = c - 'a' + 10;
+                }
+                else if (c >= 'A' && c <= 'F')
+                {
+                    digit = c - 'A' + 10;
+                }
+                else
+                {
+                    return false;
+                }
+
+                hash = hash << 4 | std::uint64_t(digit);
+            }
+
+            return true;
+        }
+
+        // "|RLDUTSBA|RLDUTSBA|hash"
+        bool parse_frame(const std::string &line, MovieFrame &frame)
+        {
+            if (line.size() < 19 || line[9] != '|' || line[18] != '|')
+            {
+                return false;
+            }
+
+            frame.has_hash = line.size() > 19;
+            frame.hash = 0;
+
+            return parse_buttons(line, 1, frame.port0) && parse_buttons(line, 10, frame.port1) &&
+                   (!frame.has_hash || parse_hash(line, 19, frame.hash));
+        }
+
+        void write_hex(std::ostream &out, std::uint64_t value, int digits)
+        {
+            static const char table[] = "0123456789abcdef";
+
+            for (int i = digits - 1; i >= 0; --i)
+            {
+                out << table[(value >> (4 * i)) & 0xF];
+            }
+        }
+
+        void write_register(std::ostream &out, const char *name, unsigned expected, unsigned actual, int digits)
+        {
+            out << name << ": ";
+            write_hex(out, expected, digits);
+            out << " -> ";
+            write_hex(out, actual, digits);
+            out << '\n';
+        }
+    }
+
+    std::string Movie::get(const std::string &key) const
+    {
+        for (const std::pair<std::string, std::string> &entry : metadata)
+        {
+            if (entry.first == key)
+            {
+                return entry.second;
+            }
+        }
+
+        return std::string();
+    }
+
+    void Movie::set(const std::string &key, const std::string &value)
+    {
+        for (std::pair<std::string, std::string> &entry : metadata)
+        {
+            if (entry.first == key)
+            {
+                entry.second = value;
+                return;
+            }
+        }
+
+        metadata.push_back(std::make_pair(key, value));
+    }
+
+    bool Movie::read(std::istream &in)
+    {
+        std::vector<std::pair<std::string, std::string>> read_metadata;
+        std::vector<MovieFrame> read_frames;
+        std::string line;
+        bool header = false;
+
+        while (std::getline(in, line))
+        {
+            if (!line.empty() && line[line.size() - 1] == '\r')
+            {
+                line.erase(line.size() - 1);
+            }
+
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+
+            if (!header)
+            {
+                std::string expected = std::string(MAGIC) + " " + std::to_string(VERSION);
+
+                if (line != expected)
+                {
+                    return false;
+                }
+                header = true;
+                continue;
+            }
+
+            if (line[0] == '|')
+            {
+                MovieFrame frame;
+
+                if (!parse_frame(line, frame))
+                {
+                    return false;
+                }
+                read_frames.push_back(frame);
+                continue;
+            }
+
+            std::size_t space = line.find(' ');
+            std::string key = line.substr(0, space);
+            std::string value = space == std::string::npos ? std::string() : line.substr(space + 1);
+            read_metadata.push_back(std::make_pair(key, value));
+        }
+
+        if (!header)
+        {
+            return false;
+        }
+
+        metadata.swap(read_metadata);
+        frames.swap(read_frames);
+
+        return true;
+    }
+
+    void Movie::write(std::ostream &out) const
+    {
+        out << MAGIC << ' ' << VERSION << '\n';
+
+        for (const std::pair<std::string, std::string> &entry : metadata)
+        {
+            out << entry.first << ' ' << entry.second << '\n';
+        }
+
+        for (const MovieFrame &frame : frames)
+        {
+            out << '|';
+            write_buttons(out, frame.port0);
+            out << '|';
+            write_buttons(out, frame.port1);
+            out << '|';
+            if (frame.has_hash)
+            {
+                write_hex(out, frame.hash, 16);
+            }
+            out << '\n';
+        }
+    }
+
+    bool Movie::load(const std::string &path)
+    {
+        std::ifstream in(path.c_str());
+
+        return in && read(in);
+    }
+
+    bool Movie::save(const std::string &path) const
+    {
+        std::ofstream out(path.c_str());
+
+        write(out);
+        out.close();
+
+        return bool(out);
+    }
+
+    bool save_checkpoints(const std::string &path, const std::vector<MovieCheckpoint> &checkpoints)
+    {
+        std::FILE *file = std::fopen(path.c_str(), "wb");
+
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        Byte header[CHECKPOINT_HEADER_SIZE] = {0};
+        std::memcpy(header, CHECKPOINT_MAGIC, 4);
+        put_u16(header + 4, CHECKPOINT_VERSION);
+        put_u32(header + 8, std::uint32_t(checkpoints.size()));
+        put_u32(header + 12, std::uint32_t(MovieReplayer::STATE_SIZE));
+
+        bool ok = std::fwrite(header, 1, CHECKPOINT_HEADER_SIZE, file) == CHECKPOINT_HEADER_SIZE;
+
+        for (std::size_t i = 0; ok && i < checkpoints.size(); ++i)
+        {
+            Byte frame[8];
+            put_u64(frame, checkpoints[i].frame);
+
+            ok = checkpoints[i].state.size() == MovieReplayer::STATE_SIZE &&
+                 std::fwrite(frame, 1, 8, file) == 8 &&
+                 std::fwrite(checkpoints[i].state.data(), 1, MovieReplayer::STATE_SIZE, file) == MovieReplayer::STATE_SIZE;
+        }
+
+        return std::fclose(file) == 0 && ok;
+    }
+
+    bool load_checkpoints(const std::string &path, std::vector<MovieCheckpoint> &checkpoints)
+    {
+        std::FILE *file = std::fopen(path.c_str(), "rb");
+
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        Byte header[CHECKPOINT_HEADER_SIZE];
+        std::vector<MovieCheckpoint> read_checkpoints;
+
+        bool ok = std::fread(header, 1, CHECKPOINT_HEADER_SIZE, file) == CHECKPOINT_HEADER_SIZE &&
+                  std::memcmp(header, CHECKPOINT_MAGIC, 4) == 0 &&
+                  get_u16(header + 4) == CHECKPOINT_VERSION &&
+                  get_u32(header + 12) == MovieReplayer::STATE_SIZE;
+
+        for (std::uint32_t i = 0, count = ok ? get_u32(header + 8) : 0; ok && i < count; ++i)
+        {
+            Byte frame[8];
+            MovieCheckpoint checkpoint;
+            checkpoint.state.resize(MovieReplayer::STATE_SIZE);
+
+            ok = std::fread(frame, 1, 8, file) == 8 &&
+                 std::fread(checkpoint.state.data(), 1, MovieReplayer::STATE_SIZE, file) == MovieReplayer::STATE_SIZE;
+            checkpoint.frame = std::size_t(get_u64(frame));
+            read_checkpoints.push_back(checkpoint);
+        }
+
+        std::fclose(file);
+
+        if (ok)
+        {
+            checkpoints.swap(read_checkpoints);
+        }
+
+        return ok;
+    }
+
+    MovieReplayer::MovieReplayer(CPU &cpu, Joypad *port0, Joypad *port1)
+        : cpu(cpu), port0(port0), port1(port1)
+    {
+    }
+
+    ReplayResult MovieReplayer::verify(const Movie &movie)
+    {
+        return verify(movie, 0, movie.frames.size());
+    }
+
+    ReplayResult MovieReplayer::verify(const Movie &movie, std::size_t begin, std::size_t end)
+    {
+        ReplayResult result = {Replay_Completed, begin, 0, 0, 0};
+
+        if (end > movie.frames.size())
+        {
+            end = movie.frames.size();
+        }
+
+        for (; result.frame < end; ++result.frame)
+        {
+            const MovieFrame &frame = movie.frames[result.frame];
+
+            if (!run_frame(frame))
+            {
+                result.status = Replay_Halted;
+                result.program_counter = cpu.program_counter;
+                return result;
+            }
+
+            if (frame.has_hash)
+            {
+                std::uint64_t hash = state_hash(cpu);
+
+                if (hash != frame.hash)
+                {
+                    result.status = Replay_Mismatch;
+                    result.program_counter = cpu.program_counter;
+                    result.expected_hash = frame.hash;
+                    result.actual_hash = hash;
+                    return result;
+                }
+            }
+        }
+
+        return result;
+    }
+
+    ReplayResult MovieReplayer::run(const Movie &movie, std::size_t frames)
+    {
+        ReplayResult result = {Replay_Completed, 0, 0, 0, 0};
+        std::size_t count = frames < movie.frames.size() ? frames : movie.frames.size();
+
+        for (; result.frame < count; ++result.frame)
+        {
+            if (!run_frame(movie.frames[result.frame]))
+            {
+                result.status = Replay_Halted;
+                result.program_counter = cpu.program_counter;
+                return result;
+            }
+        }
+
+        return result;
+    }
+
+    ReplayResult MovieReplayer::record(Movie &movie)
+    {
+        std::vector<MovieCheckpoint> checkpoints;
+
+        return record(movie, 0, checkpoints);
+    }
+
+    ReplayResult MovieReplayer::record(Movie &movie, std::size_t interval, std::vector<MovieCheckpoint> &checkpoints)
+    {
+        ReplayResult result = {Replay_Completed, 0, 0, 0, 0};
+        checkpoints.clear();
+
+        for (; result.frame < movie.frames.size(); ++result.frame)
+        {
+            MovieFrame &frame = movie.frames[result.frame];
+
+            if (interval != 0 && result.frame % interval == 0)
+            {
+                MovieCheckpoint checkpoint = {result.frame, save_state()};
+                checkpoints.push_back(checkpoint);
+            }
+
+            if (!run_frame(frame))
+            {
+                result.status = Replay_Halted;
+                result.program_counter = cpu.program_counter;
+                return result;
+            }
+
+            frame.has_hash = true;
+            frame.hash = state_hash(cpu);
+        }
+
+        if (interval != 0)
+        {
+            MovieCheckpoint checkpoint = {result.frame, save_state()};
+            checkpoints.push_back(checkpoint);
+        }
+
+        return result;
+    }
+
+    std::vector<Byte> MovieReplayer::save_state() const
+    {
+        std::vector<Byte> state(STATE_SIZE, 0);
+        Byte *p = state.data();
+
+        p[0] = Byte((port0 != nullptr ? STATE_PORT0 : 0) | (port1 != nullptr ? STATE_PORT1 : 0));
+        put_u16(p + 1, cpu.program_counter);
+        p[3] = cpu.register_a;
+        p[4] = cpu.register_x;
+        p[5] = cpu.register_y;
+        p[6] = cpu.stack_pointer;
+        p[7] = cpu.status;
+        put_u64(p + 8, cpu.cycles);
+        std::memcpy(p + STATE_MEMORY_OFFSET, cpu.memory_data(), WRITABLE_MEMORY_SIZE);
+
+        if (port0 != nullptr)
+        {
+            port0->save_state(p + STATE_JOYPAD_OFFSET);
+        }
+        if (port1 != nullptr)
+        {
+            port1->save_state(p + STATE_JOYPAD_OFFSET + Joypad::STATE_SIZE);
+        }
+
+        return state;
+    }
+
+    bool MovieReplayer::load_state(const std::vector<Byte> &state)
+    {
+        if (state.size() != STATE_SIZE)
+        {
+            return false;
+        }
+
+        const Byte *p = state.data();
+        Byte ports = Byte((port0 != nullptr ? STATE_PORT0 : 0) | (port1 != nullptr ? STATE_PORT1 : 0));
+
+        if (p[0] != ports)
+        {
+            return false;
+        }
+
+        cpu.program_counter = get_u16(p + 1);
+        cpu.register_a = p[3];
+        cpu.register_x = p[4];
+        cpu.register_y = p[5];
+        cpu.stack_pointer = p[6];
+        cpu.status = p[7];
+        cpu.cycles = get_u64(p + 8);
+        cpu.load_memory(p + STATE_MEMORY_OFFSET);
+
+        if (port0 != nullptr)
+        {
+            port0->load_state(p + STATE_JOYPAD_OFFSET);
+        }
+        if (port1 != nullptr)
+        {
+            port1->load_state(p + STATE_JOYPAD_OFFSET + Joypad::STATE_SIZE);
+        }
+
+        return true;
+    }
+
+    bool MovieReplayer::run_frame(const MovieFrame &frame)
+    {
+        if (port0 != nullptr)
+        {
+            port0->set_buttons(frame.port0);
+        }
+        if (port1 != nullptr)
+        {
+            port1->set_buttons(frame.port1);
+        }
+
+        RunBudget budget = {0, 0, true};
+
+        return cpu.run_for(budget) == Run_Frame_End;
+    }
+
+    ReplayResult verify_segments(const Movie &movie, const std::vector<MovieCheckpoint> &checkpoints,
+                                 const SharedRom &rom, ThreadPool &pool)
+    {
+        std::size_t segments = checkpoints.size() > 1 ? checkpoints.size() - 1 : 0;
+        std::vector<ReplayResult> results(segments);
+
+        pool.parallel_for(segments, [&](std::size_t i) {
+            const MovieCheckpoint &from = checkpoints[i];
+            const MovieCheckpoint &to = checkpoints[i + 1];
+            ReplayResult &result = results[i];
+            Byte ports = from.state.empty() ? 0 : from.state[0];
+
+            SegmentMachine machine;
+            machine.cpu.load_and_reset(rom);
+            if (ports & STATE_PORT0)
+            {
+                machine.cpu.attach_joypad(0, &machine.port0);
+            }
+            if (ports & STATE_PORT1)
+            {
+                machine.cpu.attach_joypad(1, &machine.port1);
+            }
+
+            MovieReplayer replayer(machine.cpu, (ports & STATE_PORT0) ? &machine.port0 : nullptr,
+                                   (ports & STATE_PORT1) ? &machine.port1 : nullptr);
+
+            if (!replayer.load_state(from.state))
+            {
+                ReplayResult unusable = {Replay_Mismatch, from.frame, 0, 0, 0};
+                result = unusable;
+                return;
+            }
+
+            result = replayer.verify(movie, from.frame, to.frame);
+
+            if (result.status == Replay_Completed && result.frame == to.frame)
+            {
+                std::vector<Byte> reached = replayer.save_state();
+
+                if (reached != to.state)
+                {
+                    result.status = Replay_Mismatch;
+                    result.frame = to.frame > 0 ? to.frame - 1 : 0;
+                    result.program_counter = machine.cpu.program_counter;
+                    result.expected_hash = fnv_hash(to.state);
+                    result.actual_hash = fnv_hash(reached);
+                }
+            }
+            else if (result.status == Replay_Completed)
+            {
+                // 检查点超出了录像的帧数
+                result.status = Replay_Mismatch;
+            }
+        });
+
+        ReplayResult first = {Replay_Completed, checkpoints.empty() ? 0 : checkpoints.back().frame, 0, 0, 0};
+
+        for (const ReplayResult &result : results)
+        {
+            if (result.status != Replay_Completed && (first.status == Replay_Completed || result.frame < first.frame))
+            {
+                first = result;
+            }
+        }
+
+        return first;
+    }
+
+    void write_state_diff(std::ostream &out, const CPU &expected, const CPU &actual)
+    {
+        bool same = true;
+
+        if (expected.program_counter != actual.program_counter)
+        {
+            write_register(out, "PC", expected.program_counter, actual.program_counter, 4);
+            same = false;
+        }
+        if (expected.register_a != actual.register_a)
+        {
+            write_register(out, "A", expected.register_a, actual.register_a, 2);
+            same = false;
+        }
+        if (expected.register_x != actual.register_x)
+        {
+            write_register(out, "X", expected.register_x, actual.register_x, 2);
+            same = false;
+        }
+        if (expected.register_y != actual.register_y)
+        {
+            write_register(out, "Y", expected.register_y, actual.register_y, 2);
+            same = false;
+        }
+        if (expected.status != actual.status)
+        {
+            write_register(out, "P", expected.status, actual.status, 2);
+            same = false;
+        }
+        if (expected.stack_pointer != actual.stack_pointer)
+        {
+            write_register(out, "SP", expected.stack_pointer, actual.stack_pointer, 2);
+            same = false;
+        }
+
+        for (Address addr = 0; addr < 0x0800; ++addr)
+        {
+            Byte before = expected.peek(addr);
+            Byte after = actual.peek(addr);
+
+            if (before != after)
+            {
+                out << '$';
+                write_hex(out, addr, 4);
+                out << ": ";
+                write_hex(out, before, 2);
+                out << " -> ";
+                write_hex(out, after, 2);
+                out << '\n';
+                same = false;
+            }
+        }
+
+        if (same)
+        {
+            out << "identical\n";
+        }
+    }
+}
@@ -0,0 +1,182 @@
+#include "OpcodeProfiler.h"
+#include "CPUOpcodes.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+
+namespace mysn
+{
+    namespace
+    {
+        const int MODE_COUNT = NoneAddressing + 1;
+
+        // 执行过的操作码，次数多的在前，次数相同按操作码升序
+        std::vector<int> executed_opcodes(const std::uint64_t *counts)
+        {
+            std::vector<int> codes;
+
+            for (int code = 0; code < 256; ++code)
+            {
+                if (counts[code] != 0)
+                {
+                    codes.push_back(code);
+                }
+            }
+
+            std::stable_sort(codes.begin(), codes.end(), [counts](int a, int b) { return counts[a] > counts[b]; });
+
+            return codes;
+        }
+
+        void describe(int code, const char *&mnemonic, const char *&mode)
+        {
+            auto opcode = CPUOpcodes::CPU_OPS_CODES_MAP.find(Byte(code));
+
+            if (opcode == CPUOpcodes::CPU_OPS_CODES_MAP.end())
+            {
+                mnemonic = "???";
+                mode = "Unknown";
+                return;
+            }
+
+            mnemonic = mnemonic_name((opcode->second).mnemonic);
+            mode = addressing_mode_name((opcode->second).mode);
+        }
+    }
+
+    OpcodeProfiler::OpcodeProfiler()
+    {
+        clear();
+    }
+
+    void OpcodeProfiler::clear()
+    {
+        std::memset(counts, 0, sizeof(counts));
+        std::memset(cycle_totals, 0, sizeof(cycle_totals));
+        std::memset(page_crosses, 0, sizeof(page_crosses));
+        start_cycles = 0;
+    }
+
+    std::uint64_t OpcodeProfiler::count(Byte code) const
+    {
+        return counts[code];
+    }
+
+    std::uint64_t OpcodeProfiler::cycles(Byte code) const
+    {
+        return cycle_totals[code];
+    }
+
+    std::uint64_t OpcodeProfiler::page_cross_count(Byte code) const
+    {
+        return page_crosses[code];
+    }
+
+    std::uint64_t OpcodeProfiler::total_instructions() const
+    {
+        std::uint64_t total = 0;
+
+        for (int code = 0; code < 256; ++code)
+        {
+            total += counts[code];
+        }
+
+        return total;
+    }
+
+    void OpcodeProfiler::write_report(std::ostream &out) const
+    {
+        std::uint64_t total = total_instructions();
+        std::uint64_t mode_counts[MODE_COUNT] = {0};
+        std::uint64_t mode_cycles[MODE_COUNT] = {0};
+
+        out << "opcode  mnemonic  mode            count         %      cycles  page-cross\n";
+
+        for (int code : executed_opcodes(counts))
+        {
+            const char *mnemonic;
+            const char *mode;
+            describe(code, mnemonic, mode);
+
+            out << "  $" << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << code
+                << std::dec << std::nouppercase << std::setfill(' ')
+                << "  " << std::left << std::setw(8) << mnemonic << "  " << std::setw(14) << mode << std::right
+                << std::setw(12) << counts[code]
+                << std::setw(8) << std::fixed << std::setprecision(2) << 100.0 * counts[code] / total
+                << std::setw(12) << cycle_totals[code]
+                << std::setw(12) << page_crosses[code] << "\n";
+
+            auto opcode = CPUOpcodes::CPU_OPS_CODES_MAP.find(Byte(code));
+            if (opcode != CPUOpcodes::CPU_OPS_CODES_MAP.end())
+            {
+                mode_counts[(opcode->second).mode] += counts[code];
+                mode_cycles[(opcode->second).mode] += cycle_totals[code];
+            }
+        }
+
+        out << "\nmode            count         %      cycles\n";
+
+        for (int mode = 0; mode < MODE_COUNT; ++mode)
+        {
+            if (mode_counts[mode] == 0)
+            {
+                continue;
+            }
+
+            out << std::left << std::setw(14) << addressing_mode_name(AddressingMode(mode)) << std::right
+                << std::setw(12) << mode_counts[mode]
+                << std::setw(8) << std::fixed << std::setprecision(2) << 100.0 * mode_counts[mode] / total
+                << std::setw(12) << mode_cycles[mode] << "\n";
+        }
+
+        out << "\ntotal " << total << " instructions\n";
+    }
+
+    void OpcodeProfiler::write_json(std::ostream &out) const
+    {
+        out << "{\n  \"total_instructions\": " << total_instructions() << ",\n  \"opcodes\": [";
+
+        bool first = true;
+        for (int code : executed_opcodes(counts))
+        {
+            const char *mnemonic;
+            const char *mode;
+            describe(code, mnemonic, mode);
+
+            out << (first ? "\n" : ",\n")
+                << "    {\"opcode\": " << code
+                << ", \"mnemonic\": \"" << mnemonic
+                << "\", \"mode\": \"" << mode
+                << "\", \"count\": " << counts[code]
+                << ", \"cycles\": " << cycle_totals[code]
+                << ", \"page_crosses\": " << page_crosses[code] << "}";
+            first = false;
+        }
+
+        out << "\n  ]\n}\n";
+    }
+
+    bool OpcodeProfiler::dump(const std::string &path) const
+    {
+        std::ofstream out(path.c_str());
+
+        if (!out)
+        {
+            return false;
+        }
+
+        const std::string suffix = ".json";
+        if (path.size() >= suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0)
+        {
+            write_json(out);
+        }
+        else
+        {
+            write_report(out);
+        }
+
+        return bool(out);
+    }
+}
@@ -0,0 +1,60 @@
+#include "PPU.h"
+#include <cstring>
+
+namespace mysn
+{
+    PPU::PPU()
+    {
+        reset();
+    }
+
+    void PPU::reset()
+    {
+        std::memset(oam, 0, sizeof(oam));
+        std::memset(registers, 0, sizeof(registers));
+        oam_address = 0;
+    }
+
+    void PPU::write_register(Address addr, Byte data)
+    {
+        auto reg = addr & 0x07;
+        registers[reg] = data;
+
+        switch (reg)
+        {
+        case 0x03:
+            oam_address = data;
+            break;
+
+        case 0x04:
+            write_oam_data(data);
+            break;
+        }
+    }
+
+    Byte PPU::read_register(Address addr)
+    {
+        auto reg = addr & 0x07;
+
+        if (reg == 0x04)
+        {
+            return oam[oam_address];
+        }
+
+        return registers[reg];
+    }
+
+    void PPU::write_oam_data(Byte data)
+    {
+        oam[oam_address] = data;
+        ++oam_address;
+    }
+
+    void PPU::oam_dma(const Byte *page)
+    {
+        std::size_t first = 256 - oam_address;
+
+        std::memcpy(oam + oam_address, page, first);
+        std::memcpy(oam, page + first, oam_address);
+    }
+}
@@ -0,0 +1,204 @@
+#include "PerfCounters.h"
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace mysn
+{
+    namespace
+    {
+        const char *const NAMES[PERF_COUNTER_COUNT] = {
+            "cycles",
+            "instructions",
+            "branch-misses",
+            "L1-dcache-load-misses",
+            "LLC-load-misses",
+        };
+
+#ifdef __linux__
+        std::uint64_t cache_miss(std::uint64_t cache)
+        {
+            return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        }
+
+        int open_counter(PerfCounter counter)
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            switch (counter)
+            {
+            case Perf_Cycles:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case Perf_Instructions:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case Perf_Branch_Misses:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+            case Perf_L1d_Misses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = cache_miss(PERF_COUNT_HW_CACHE_L1D);
+                break;
+            default:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = cache_miss(PERF_COUNT_HW_CACHE_LL);
+                break;
+            }
+
+            // 本线程，任意 CPU
+            return int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+    }
+
+    const char *perf_counter_name(PerfCounter counter)
+    {
+        return counter < PERF_COUNTER_COUNT ? NAMES[counter] : "unknown";
+    }
+
+    double PerfSample::ipc() const
+    {
+        if (!valid[Perf_Cycles] || !valid[Perf_Instructions] || values[Perf_Cycles] == 0)
+        {
+            return -1;
+        }
+
+        return double(values[Perf_Instructions]) / double(values[Perf_Cycles]);
+    }
+
+    double PerfSample::per_instruction(PerfCounter counter, std::uint64_t emulated) const
+    {
+        if (!valid[counter] || emulated == 0)
+        {
+            return -1;
+        }
+
+        return double(values[counter]) / double(emulated);
+    }
+
+    PerfCounters::PerfCounters()
+    {
+        for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+        {
+            fds[i] = -1;
+        }
+
+#ifdef __linux__
+        for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+        {
+            fds[i] = open_counter(PerfCounter(i));
+
+            if (fds[i] < 0 && reason.empty())
+            {
+                // 只记第一个失败，通常所有计数器都是同一个原因
+                reason = std::string(NAMES[i]) + ": " + std::strerror(errno);
+                if (errno == EACCES || errno == EPERM)
+                {
+                    reason += " (see /proc/sys/kernel/perf_event_paranoid)";
+                }
+            }
+        }
+#else
+        reason = "perf_event_open is only available on Linux";
+#endif
+    }
+
+    PerfCounters::~PerfCounters()
+    {
+#ifdef __linux__
+        for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+        {
+            if (fds[i] >= 0)
+            {
+                close(fds[i]);
+            }
+        }
+#endif
+    }
+
+    bool PerfCounters::available() const
+    {
+        for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+        {
+            if (fds[i] >= 0)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool PerfCounters::available(PerfCounter counter) const
+    {
+        return fds[counter] >= 0;
+    }
+
+    const std::string &PerfCounters::error() const
+    {
+        return reason;
+    }
+
+    void PerfCounters::start()
+    {
+#ifdef __linux__
+        for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+        {
+            if (fds[i] >= 0)
+            {
+                ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+                ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    PerfSample PerfCounters::stop()
+    {
+        PerfSample sample;
+        std::memset(&sample, 0, sizeof(sample));
+
+#ifdef __linux__
+        // 先全部停下再读，读的过程不计入
+        for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+        {
+            if (fds[i] >= 0)
+            {
+                ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+
+        for (int i = 0; i < PERF_COUNTER_COUNT; ++i)
+        {
+            // value, time_enabled, time_running
+            std::uint64_t data[3];
+
+            if (fds[i] < 0 || read(fds[i], data, sizeof(data)) != ssize_t(sizeof(data)) || data[2] == 0)
+            {
+                continue;
+            }
+
+            sample.valid[i] = true;
+            sample.values[i] = data[2] < data[1] ? std::uint64_t(double(data[0]) * data[1] / data[2]) : data[0];
+        }
+#endif
+
+        return sample;
+    }
+}
@@ -0,0 +1,224 @@
+#include "Resampler.h"
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#if MYSN_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace mysn
+{
+    struct Resampler::Kernel
+    {
+        std::size_t taps;
+        // PHASE_COUNT 行，每行 taps 个系数
+        std::vector<float> coefficients;
+    };
+
+    namespace
+    {
+        // 每侧保留的过零点个数，决定过渡带宽度
+        const int ZERO_CROSSINGS = 8;
+
+        float dot_scalar(const float *a, const float *b, std::size_t n)
+        {
+            float sum = 0.0f;
+
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                sum += a[i] * b[i];
+            }
+
+            return sum;
+        }
+
+#if MYSN_X86_SIMD
+        float dot_sse2(const float *a, const float *b, std::size_t n)
+        {
+            __m128 acc0 = _mm_setzero_ps();
+            __m128 acc1 = _mm_setzero_ps();
+
+            for (std::size_t i = 0; i < n; i += 8)
+            {
+                acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+                acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+            }
+
+            float lanes[4];
+            _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+
+            return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        }
+
+        MYSN_TARGET_AVX2 float dot_avx2(const float *a, const float *b, std::size_t n)
+        {
+            __m256 acc0 = _mm256_setzero_ps();
+            __m256 acc1 = _mm256_setzero_ps();
+            std::size_t i = 0;
+
+            for (; i + 16 <= n; i += 16)
+            {
+                acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+                acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+            }
+
+            if (i < n)
+            {
+                acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+            }
+
+            __m256 acc = _mm256_add_ps(acc0, acc1);
+            __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+            sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+            sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+
+            return _mm_cvtss_f32(sum);
+        }
+#endif
+    }
+
+    std::shared_ptr<const Resampler::Kernel> Resampler::shared_kernel(double input_rate, double output_rate)
+    {
+        static std::mutex lock;
+        static std::map<std::pair<double, double>, std::weak_ptr<const Kernel>> cache;
+
+        std::lock_guard<std::mutex> guard(lock);
+
+        std::pair<double, double> key(input_rate, output_rate);
+        std::shared_ptr<const Kernel> cached = cache[key].lock();
+
+        if (cached)
+        {
+            return cached;
+        }
+
+        const double pi = 3.14159265358979323846;
+
+        // 截止频率取输出奈奎斯特频率的 90%（升采样时取输入的），单位：周期/输入采样
+        double ratio = output_rate < input_rate ? output_rate / input_rate : 1.0;
+        double cutoff = 0.45 * ratio;
+
+        // 系数个数对齐到 8，便于向量化
+        std::size_t taps = std::size_t(std::ceil(ZERO_CROSSINGS / cutoff));
+        taps = (taps + 7) & ~std::size_t(7);
+
+        std::shared_ptr<Kernel> kernel = std::make_shared<Kernel>();
+        kernel->taps = taps;
+        kernel->coefficients.resize(taps * PHASE_COUNT);
+
+        double half = taps / 2.0;
+
+        for (int phase = 0; phase < PHASE_COUNT; ++phase)
+        {
+            float *row = &kernel->coefficients[phase * taps];
+            double total = 0.0;
+
+            for (std::size_t k = 0; k < taps; ++k)
+            {
+                double t = double(k) - (half - 1.0) - double(phase) / PHASE_COUNT;
+                double x = 2.0 * cutoff * t;
+                double sinc = (x == 0.0) ? 1.0 : std::sin(pi * x) / (pi * x);
+                double w = std::fabs(t) >= half ? 0.0 : 0.42 + 0.5 * std::cos(pi * t / half) + 0.08 * std::cos(2.0 * pi * t / half);
+
+                row[k] = float(sinc * w);
+                total += row[k];
+            }
+
+            // 每个相位直流增益为 1
+            for (std::size_t k = 0; k < taps; ++k)
+            {
+                row[k] = float(row[k] / total);
+            }
+        }
+
+        cache[key] = kernel;
+
+        return kernel;
+    }
+
+    Resampler::Resampler(double input_rate, double output_rate, std::size_t block_size, SimdLevel level)
+        : kernel(shared_kernel(input_rate, output_rate)),
+          level(level),
+          step(std::uint64_t(input_rate / output_rate * 4294967296.0 + 0.5)),
+          position(0),
+          block(block_size),
+          filled(0),
+          history(block_size + kernel->taps, 0.0f)
+    {
+        reset();
+    }
+
+    std::size_t Resampler::block_size() const
+    {
+        return block;
+    }
+
+    std::size_t Resampler::max_output() const
+    {
+        return std::size_t((std::uint64_t(block) << 32) / step) + 2;
+    }
+
+    std::size_t Resampler::taps() const
+    {
+        return kernel->taps;
+    }
+
+    void Resampler::reset()
+    {
+        // 以静音预填，第一个输出对齐到第一个输入采样
+        filled = kernel->taps / 2 - 1;
+        position = 0;
+        std::fill(history.begin(), history.end(), 0.0f);
+    }
+
+    std::size_t Resampler::process(const float *input, std::size_t count, float *output)
+    {
+        assert(count <= block);
+
+        std::memcpy(&history[filled], input, count * sizeof(float));
+        filled += count;
+
+        const std::size_t taps = kernel->taps;
+        const float *coefficients = &kernel->coefficients[0];
+        std::size_t produced = 0;
+
+        float (*dot)(const float *, const float *, std::size_t) = dot_scalar;
+#if MYSN_X86_SIMD
+        if (level == Simd_AVX2)
+        {
+            dot = dot_avx2;
+        }
+        else if (level == Simd_SSE2)
+        {
+            dot = dot_sse2;
+        }
+#endif
+
+        while ((position >> 32) + taps <= filled)
+        {
+            std::size_t index = std::size_t(position >> 32);
+            std::size_t phase = std::size_t(position >> (32 - PHASE_BITS)) & (PHASE_COUNT - 1);
+
+            output[produced++] = dot(&history[index], coefficients + phase * taps, taps);
+            position += step;
+        }
+
+        // 丢弃不再需要的输入
+        std::size_t consumed = std::size_t(position >> 32);
+        if (consumed > filled)
+        {
+            consumed = filled;
+        }
+
+        std::memmove(&history[0], &history[consumed], (filled - consumed) * sizeof(float));
+        filled -= consumed;
+        position -= std::uint64_t(consumed) << 32;
+
+        return produced;
+    }
+}
@@ -0,0 +1,185 @@
+#include "SamplingProfiler.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+namespace mysn
+{
+    SamplingProfiler::SamplingProfiler(std::uint64_t interval)
+        : sample_interval(interval == 0 ? 1 : interval),
+          symbols(nullptr)
+    {
+        clear();
+    }
+
+    void SamplingProfiler::clear()
+    {
+        next_sample = 0;
+        samples = 0;
+        started = false;
+        pc = 0;
+        expected_pc = 0x10000;
+        expected_sp = 0;
+        depth = 0;
+        pc_samples.assign(0x10000, 0);
+        stacks.clear();
+    }
+
+    void SamplingProfiler::set_symbols(const SymbolTable *symbols)
+    {
+        this->symbols = symbols;
+    }
+
+    std::uint64_t SamplingProfiler::interval() const
+    {
+        return sample_interval;
+    }
+
+    std::uint64_t SamplingProfiler::total_samples() const
+    {
+        return samples;
+    }
+
+    std::uint64_t SamplingProfiler::samples_at(Address addr) const
+    {
+        return pc_samples[addr];
+    }
+
+    void SamplingProfiler::enter_discontinuity(CPU &cpu)
+    {
+        // 中断压入了 PC 和状态共 3 个字节
+        if (started && cpu.stack_pointer == Byte(expected_sp - 3))
+        {
+            push_frame(cpu.program_counter, expected_sp, Frame_Interrupt);
+            return;
+        }
+
+        // 第一次运行或 CPU 被重新装载，以当前地址作为根
+        root.target = cpu.program_counter;
+        root.stack_pointer = cpu.stack_pointer;
+        root.kind = Frame_Root;
+        depth = 0;
+
+        if (!started)
+        {
+            started = true;
+            next_sample = cpu.cycles + sample_interval;
+        }
+    }
+
+    void SamplingProfiler::push_call(CPU &cpu)
+    {
+        // 用 peek 读操作数：mem_read 会触发观察点和 I/O 寄存器的副作用，分析器不能改变执行结果
+        Address target = cpu.peek(Address(cpu.program_counter + 1)) | cpu.peek(Address(cpu.program_counter + 2)) << 8;
+
+        push_frame(target, cpu.stack_pointer, Frame_Call);
+    }
+
+    void SamplingProfiler::push_frame(Address target, Byte stack_pointer, FrameKind kind)
+    {
+        if (depth < MAX_DEPTH)
+        {
+            frames[depth].target = target;
+            frames[depth].stack_pointer = stack_pointer;
+            frames[depth].kind = kind;
+            ++depth;
+        }
+    }
+
+    void SamplingProfiler::take_samples(std::uint64_t cycles)
+    {
+        // 一条指令跨过多个采样点（例如 OAM DMA）时一次记多个样本
+        std::uint64_t count = (cycles - next_sample) / sample_interval + 1;
+        next_sample += count * sample_interval;
+        samples += count;
+        pc_samples[pc] += count;
+
+        key.clear();
+        key.push_back(std::uint32_t(root.kind) << 16 | root.target);
+        for (std::size_t i = 0; i < depth; ++i)
+        {
+            key.push_back(std::uint32_t(frames[i].kind) << 16 | frames[i].target);
+        }
+
+        auto found = stacks.find(key);
+        if (found != stacks.end())
+        {
+            found->second += count;
+        }
+        else
+        {
+            stacks[key] = count;
+        }
+    }
+
+    std::string SamplingProfiler::frame_name(std::uint32_t frame) const
+    {
+        static const SymbolTable no_symbols;
+        static const char *prefixes[] = {"entry", "sub", "int"};
+
+        const SymbolTable &table = symbols != nullptr ? *symbols : no_symbols;
+
+        return table.describe(Address(frame & 0xFFFF), prefixes[frame >> 16]);
+    }
+
+    void SamplingProfiler::write_folded(std::ostream &out) const
+    {
+        for (auto &stack : stacks)
+        {
+            for (std::size_t i = 0; i < stack.first.size(); ++i)
+            {
+                out << (i == 0 ? "" : ";") << frame_name(stack.first[i]);
+            }
+
+            out << " " << stack.second << "\n";
+        }
+    }
+
+    void SamplingProfiler::write_hotspots(std::ostream &out, std::size_t limit) const
+    {
+        std::vector<Address> hot;
+
+        for (std::uint32_t addr = 0; addr < 0x10000; ++addr)
+        {
+            if (pc_samples[addr] != 0)
+            {
+                hot.push_back(Address(addr));
+            }
+        }
+
+        std::stable_sort(hot.begin(), hot.end(), [this](Address a, Address b) { return pc_samples[a] > pc_samples[b]; });
+
+        if (hot.size() > limit)
+        {
+            hot.resize(limit);
+        }
+
+        static const SymbolTable no_symbols;
+        const SymbolTable &table = symbols != nullptr ? *symbols : no_symbols;
+
+        out << "address  samples       %  location\n";
+
+        for (Address addr : hot)
+        {
+            out << "  $" << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << addr
+                << std::dec << std::nouppercase << std::setfill(' ')
+                << std::setw(9) << pc_samples[addr]
+                << std::setw(8) << std::fixed << std::setprecision(2) << 100.0 * pc_samples[addr] / samples
+                << "  " << table.describe(addr, "loc") << "\n";
+        }
+    }
+
+    bool SamplingProfiler::dump_folded(const std::string &path) const
+    {
+        std::ofstream out(path.c_str());
+
+        if (!out)
+        {
+            return false;
+        }
+
+        write_folded(out);
+
+        return bool(out);
+    }
+}
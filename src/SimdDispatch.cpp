@@ -0,0 +1,32 @@
+#include "SimdDispatch.h"
+
+namespace mysn
+{
+    namespace
+    {
+        SimdLevel probe()
+        {
+#if MYSN_X86_SIMD
+            __builtin_cpu_init();
+
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            {
+                return Simd_AVX2;
+            }
+
+            if (__builtin_cpu_supports("sse2"))
+            {
+                return Simd_SSE2;
+            }
+#endif
+            return Simd_Scalar;
+        }
+    }
+
+    SimdLevel detect_simd_level()
+    {
+        static const SimdLevel level = probe();
+
+        return level;
+    }
+}
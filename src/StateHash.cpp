@@ -0,0 +1,45 @@
+#include "StateHash.h"
+
+namespace mysn
+{
+    namespace
+    {
+        const std::uint64_t FNV_OFFSET = 14695981039346656037ull;
+        const std::uint64_t FNV_PRIME = 1099511628211ull;
+
+        std::uint64_t mix(std::uint64_t hash, Byte value)
+        {
+            return (hash ^ value) * FNV_PRIME;
+        }
+
+        std::uint64_t hash_ram(std::uint64_t hash, const CPU &cpu)
+        {
+            for (Address addr = 0; addr < 0x0800; ++addr)
+            {
+                hash = mix(hash, cpu.peek(addr));
+            }
+
+            return hash;
+        }
+    }
+
+    std::uint64_t ram_hash(const CPU &cpu)
+    {
+        return hash_ram(FNV_OFFSET, cpu);
+    }
+
+    std::uint64_t state_hash(const CPU &cpu)
+    {
+        std::uint64_t hash = FNV_OFFSET;
+
+        hash = mix(hash, Byte(cpu.program_counter));
+        hash = mix(hash, Byte(cpu.program_counter >> 8));
+        hash = mix(hash, cpu.register_a);
+        hash = mix(hash, cpu.register_x);
+        hash = mix(hash, cpu.register_y);
+        hash = mix(hash, cpu.status);
+        hash = mix(hash, cpu.stack_pointer);
+
+        return hash_ram(hash, cpu);
+    }
+}
@@ -0,0 +1,210 @@
+#include "SymbolTable.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+namespace mysn
+{
+    namespace
+    {
+        bool ends_with(const std::string &text, const std::string &suffix)
+        {
+            return text.size() >= suffix.size() &&
+                   text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+
+        // 解析 "$8000"、"0x8000"、"8000"，都按十六进制
+        bool parse_address(std::string text, Address &addr)
+        {
+            if (!text.empty() && text[0] == '$')
+            {
+                text = text.substr(1);
+            }
+            else if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+            {
+                text = text.substr(2);
+            }
+
+            if (text.empty())
+            {
+                return false;
+            }
+
+            char *end = nullptr;
+            unsigned long value = std::strtoul(text.c_str(), &end, 16);
+
+            if (*end != '\0' || value > 0xFFFFFF)
+            {
+                return false;
+            }
+
+            addr = Address(value);
+            return true;
+        }
+
+        // 从 "key=value,key2=value2" 里取出 key 的值，去掉引号
+        std::string dbg_field(const std::string &line, const std::string &key)
+        {
+            std::string pattern = key + "=";
+            std::string::size_type pos = 0;
+
+            while ((pos = line.find(pattern, pos)) != std::string::npos)
+            {
+                if (pos == 0 || line[pos - 1] == ',' || line[pos - 1] == '\t' || line[pos - 1] == ' ')
+                {
+                    break;
+                }
+                pos += pattern.size();
+            }
+
+            if (pos == std::string::npos)
+            {
+                return std::string();
+            }
+
+            pos += pattern.size();
+            std::string::size_type end = line.find(',', pos);
+            std::string value = line.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+
+            if (value.size() >= 2 && value[0] == '"' && value[value.size() - 1] == '"')
+            {
+                value = value.substr(1, value.size() - 2);
+            }
+
+            return value;
+        }
+    }
+
+    bool SymbolTable::load(const std::string &path)
+    {
+        if (ends_with(path, ".dbg"))
+        {
+            return load_dbg(path);
+        }
+
+        return load_labels(path);
+    }
+
+    bool SymbolTable::load_dbg(const std::string &path)
+    {
+        std::ifstream in(path.c_str());
+
+        if (!in)
+        {
+            return false;
+        }
+
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (line.compare(0, 4, "sym\t") != 0 && line.compare(0, 4, "sym ") != 0)
+            {
+                continue;
+            }
+
+            if (dbg_field(line, "type") != "lab")
+            {
+                continue;
+            }
+
+            Address addr;
+            std::string name = dbg_field(line, "name");
+
+            if (!name.empty() && parse_address(dbg_field(line, "val"), addr))
+            {
+                add(addr, name);
+            }
+        }
+
+        return true;
+    }
+
+    bool SymbolTable::load_labels(const std::string &path)
+    {
+        std::ifstream in(path.c_str());
+
+        if (!in)
+        {
+            return false;
+        }
+
+        std::string line;
+        while (std::getline(in, line))
+        {
+            std::string::size_type comment = line.find(';');
+            if (comment != std::string::npos)
+            {
+                line = line.substr(0, comment);
+            }
+
+            std::istringstream fields(line);
+            std::string first, second, third;
+            fields >> first >> second >> third;
+
+            Address addr;
+
+            if (first == "al" && parse_address(second, addr) && !third.empty())
+            {
+                // VICE 格式，标签名前有一个点
+                add(addr, third[0] == '.' ? third.substr(1) : third);
+            }
+            else if (second == "=" && parse_address(third, addr))
+            {
+                add(addr, first);
+            }
+            else if (!second.empty() && parse_address(first, addr))
+            {
+                add(addr, second);
+            }
+        }
+
+        return true;
+    }
+
+    void SymbolTable::add(Address addr, const std::string &name)
+    {
+        // 同一地址的多个标签保留第一个
+        labels.insert(std::make_pair(addr, name));
+    }
+
+    bool SymbolTable::empty() const
+    {
+        return labels.empty();
+    }
+
+    std::size_t SymbolTable::size() const
+    {
+        return labels.size();
+    }
+
+    const std::string *SymbolTable::find(Address addr) const
+    {
+        auto found = labels.find(addr);
+
+        return found == labels.end() ? nullptr : &found->second;
+    }
+
+    std::string SymbolTable::describe(Address addr, const char *prefix) const
+    {
+        char buffer[32];
+        auto after = labels.upper_bound(addr);
+
+        if (after == labels.begin())
+        {
+            std::snprintf(buffer, sizeof(buffer), "%s_%04X", prefix, unsigned(addr));
+            return buffer;
+        }
+
+        --after;
+
+        if (after->first == addr)
+        {
+            return after->second;
+        }
+
+        std::snprintf(buffer, sizeof(buffer), "+$%X", unsigned(addr - after->first));
+        return after->second + buffer;
+    }
+}
@@ -0,0 +1,124 @@
+#include "ThreadPool.h"
+
+namespace mysn
+{
+    ThreadPool::ThreadPool(int threads)
+        : task(nullptr),
+          count(0),
+          next(0),
+          generation(0),
+          running(0),
+          stopping(false)
+    {
+        int total = threads > 0 ? threads : int(std::thread::hardware_concurrency());
+
+        try
+        {
+            for (int i = 1; i < total; ++i)
+            {
+                workers.push_back(std::thread(&ThreadPool::worker_loop, this));
+            }
+        }
+        catch (...)
+        {
+            // 析构函数不会执行，已经启动的线程要在这里收回
+            stop();
+            throw;
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        stop();
+    }
+
+    void ThreadPool::stop()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+
+        for (std::thread &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    int ThreadPool::size() const
+    {
+        return int(workers.size()) + 1;
+    }
+
+    void ThreadPool::parallel_for(std::size_t count, const std::function<void(std::size_t)> &task)
+    {
+        if (workers.empty() || count <= 1)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                task(i);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            this->task = &task;
+            this->count = count;
+            next.store(0, std::memory_order_relaxed);
+            running = int(workers.size());
+            ++generation;
+        }
+        wake.notify_all();
+
+        drain(task, count);
+
+        // 每个工作线程都要确认做完，task 的引用才能失效
+        std::unique_lock<std::mutex> guard(lock);
+        finished.wait(guard, [this]() { return running == 0; });
+        this->task = nullptr;
+    }
+
+    void ThreadPool::worker_loop()
+    {
+        std::uint64_t seen = 0;
+
+        while (true)
+        {
+            const std::function<void(std::size_t)> *current;
+            std::size_t total;
+
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [&]() { return stopping || generation != seen; });
+
+                if (stopping)
+                {
+                    return;
+                }
+
+                seen = generation;
+                current = task;
+                total = count;
+            }
+
+            drain(*current, total);
+
+            std::lock_guard<std::mutex> guard(lock);
+            if (--running == 0)
+            {
+                finished.notify_one();
+            }
+        }
+    }
+
+    void ThreadPool::drain(const std::function<void(std::size_t)> &task, std::size_t count)
+    {
+        for (std::size_t i = next.fetch_add(1, std::memory_order_relaxed); i < count;
+             i = next.fetch_add(1, std::memory_order_relaxed))
+        {
+            task(i);
+        }
+    }
+}
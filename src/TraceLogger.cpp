@@ -0,0 +1,618 @@
+#include "TraceLogger.h"
+#include "CPUOpcodes.h"
+#include <chrono>
+#include <cstring>
+
+#if MYSN_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace mysn
+{
+    namespace
+    {
+        struct OpcodeInfo
+        {
+            bool valid;
+            CPUOpcodeMnemonics mnemonic;
+            AddressingMode mode;
+            Byte len;
+        };
+
+        // 以操作码为下标展开的指令表，格式化时不查 map
+        const OpcodeInfo *opcode_table()
+        {
+            struct Table
+            {
+                OpcodeInfo entries[256];
+
+                Table()
+                {
+                    std::memset(entries, 0, sizeof(entries));
+
+                    for (auto &opcode : CPUOpcodes::CPU_OPS_CODES_MAP)
+                    {
+                        OpcodeInfo &info = entries[opcode.first];
+                        info.valid = true;
+                        info.mnemonic = opcode.second.mnemonic;
+                        info.mode = opcode.second.mode;
+                        info.len = opcode.second.len;
+                    }
+                }
+            };
+
+            static const Table table;
+
+            return table.entries;
+        }
+
+        struct LineWriter
+        {
+            char *begin;
+            char *p;
+
+            explicit LineWriter(char *out) : begin(out), p(out) {}
+
+            void ch(char c)
+            {
+                *p++ = c;
+            }
+
+            void str(const char *s)
+            {
+                while (*s != '\0')
+                {
+                    *p++ = *s++;
+                }
+            }
+
+            void hex2(unsigned value)
+            {
+                static const char digits[] = "0123456789ABCDEF";
+                *p++ = digits[(value >> 4) & 0xF];
+                *p++ = digits[value & 0xF];
+            }
+
+            void hex4(unsigned value)
+            {
+                hex2(value >> 8);
+                hex2(value);
+            }
+
+            // 右对齐的十进制，width 为 0 时不补空格
+            void dec(std::uint64_t value, int width)
+            {
+                char digits[24];
+                int n = 0;
+
+                do
+                {
+                    digits[n++] = char('0' + value % 10);
+                    value /= 10;
+                } while (value != 0);
+
+                for (int i = n; i < width; ++i)
+                {
+                    *p++ = ' ';
+                }
+                while (n > 0)
+                {
+                    *p++ = digits[--n];
+                }
+            }
+
+            void pad_to(std::size_t column)
+            {
+                while (std::size_t(p - begin) < column)
+                {
+                    *p++ = ' ';
+                }
+            }
+        };
+
+        Address peek_u16(const CPU &cpu, Address addr)
+        {
+            return cpu.peek(addr) | cpu.peek(Address(addr + 1)) << 8;
+        }
+
+        // 零页指针，高字节在页内回绕
+        Address peek_zero_page_u16(const CPU &cpu, Byte addr)
+        {
+            return cpu.peek(addr) | cpu.peek(Byte(addr + 1)) << 8;
+        }
+
+        void write_operand(LineWriter &line, const CPU &cpu, const OpcodeInfo &info, Address pc)
+        {
+            Byte lo = cpu.peek(Address(pc + 1));
+            Address word = peek_u16(cpu, Address(pc + 1));
+
+            switch (info.mode)
+            {
+            case Accumulator:
+                line.str(" A");
+                break;
+
+            case Immediate:
+                line.str(" #$");
+                line.hex2(lo);
+                break;
+
+            case Relative:
+                line.str(" $");
+                line.hex4(Address(pc + 2 + std::int8_t(lo)));
+                break;
+
+            case ZeroPage:
+                line.str(" $");
+                line.hex2(lo);
+                line.str(" = ");
+                line.hex2(cpu.peek(lo));
+                break;
+
+            case ZeroPage_X:
+            case ZeroPage_Y:
+            {
+                Byte addr = Byte(lo + (info.mode == ZeroPage_X ? cpu.register_x : cpu.register_y));
+                line.str(" $");
+                line.hex2(lo);
+                line.str(info.mode == ZeroPage_X ? ",X @ " : ",Y @ ");
+                line.hex2(addr);
+                line.str(" = ");
+                line.hex2(cpu.peek(addr));
+                break;
+            }
+
+            case Absolute:
+                line.str(" $");
+                line.hex4(word);
+                if (info.mnemonic != JMP && info.mnemonic != JSR)
+                {
+                    line.str(" = ");
+                    line.hex2(cpu.peek(word));
+                }
+                break;
+
+            case Absolute_X:
+            case Absolute_Y:
+            {
+                Address addr = Address(word + (info.mode == Absolute_X ? cpu.register_x : cpu.register_y));
+                line.str(" $");
+                line.hex4(word);
+                line.str(info.mode == Absolute_X ? ",X @ " : ",Y @ ");
+                line.hex4(addr);
+                line.str(" = ");
+                line.hex2(cpu.peek(addr));
+                break;
+            }
+
+            case Indirect:
+            {
+                // JMP ($xxFF) 的高字节取自同一页开头
+                Address target = cpu.peek(word) | cpu.peek(Address((word & 0xFF00) | ((word + 1) & 0xFF))) << 8;
+                line.str(" ($");
+                line.hex4(word);
+                line.str(") = ");
+                line.hex4(target);
+                break;
+            }
+
+            case Indirect_X:
+            {
+                Byte pointer = Byte(lo + cpu.register_x);
+                Address addr = peek_zero_page_u16(cpu, pointer);
+                line.str(" ($");
+                line.hex2(lo);
+                line.str(",X) @ ");
+                line.hex2(pointer);
+                line.str(" = ");
+                line.hex4(addr);
+                line.str(" = ");
+                line.hex2(cpu.peek(addr));
+                break;
+            }
+
+            case Indirect_Y:
+            {
+                Address base = peek_zero_page_u16(cpu, lo);
+                Address addr = Address(base + cpu.register_y);
+                line.str(" ($");
+                line.hex2(lo);
+                line.str("),Y = ");
+                line.hex4(base);
+                line.str(" @ ");
+                line.hex4(addr);
+                line.str(" = ");
+                line.hex2(cpu.peek(addr));
+                break;
+            }
+
+            case NoneAddressing:
+                break;
+            }
+        }
+
+        // 写盘线程空闲时的等待
+        void backoff(int &spins)
+        {
+            if (++spins < 64)
+            {
+                std::this_thread::yield();
+            }
+            else
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        }
+
+        bool ends_with(const std::string &text, const std::string &suffix)
+        {
+            return text.size() >= suffix.size() &&
+                   text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+    }
+
+    std::size_t format_trace_line(const CPU &cpu, char *out)
+    {
+        const Address pc = cpu.program_counter;
+        const Byte code = cpu.peek(pc);
+        const OpcodeInfo &info = opcode_table()[code];
+        const Byte len = info.valid ? info.len : 1;
+
+        LineWriter line(out);
+
+        line.hex4(pc);
+        line.str("  ");
+
+        for (Byte i = 0; i < len; ++i)
+        {
+            line.hex2(cpu.peek(Address(pc + i)));
+            line.ch(' ');
+        }
+        line.pad_to(16);
+
+        if (info.valid)
+        {
+            line.str(mnemonic_name(info.mnemonic));
+            write_operand(line, cpu, info, pc);
+        }
+        else
+        {
+            line.str("???");
+        }
+        line.pad_to(48);
+
+        line.str("A:");
+        line.hex2(cpu.register_a);
+        line.str(" X:");
+        line.hex2(cpu.register_x);
+        line.str(" Y:");
+        line.hex2(cpu.register_y);
+        line.str(" P:");
+        line.hex2(cpu.status);
+        line.str(" SP:");
+        line.hex2(cpu.stack_pointer);
+
+        // 每条扫描线 341 个点，一帧 262 条扫描线
+        std::uint64_t dots = cpu.cycles * 3;
+        line.str(" PPU:");
+        line.dec(dots / 341 % 262, 3);
+        line.ch(',');
+        line.dec(dots % 341, 3);
+        line.str(" CYC:");
+        line.dec(cpu.cycles, 0);
+        line.ch('\n');
+
+        return std::size_t(line.p - out);
+    }
+
+    struct TraceStream::Output
+    {
+        std::FILE *file;
+#if MYSN_HAVE_ZLIB
+        gzFile gz;
+#endif
+
+        explicit Output(const std::string &path) : file(nullptr)
+        {
+#if MYSN_HAVE_ZLIB
+            gz = nullptr;
+            if (ends_with(path, ".gz"))
+            {
+                gz = gzopen(path.c_str(), "wb1");
+                return;
+            }
+#else
+            // 没有 zlib 时不支持压缩输出
+            if (ends_with(path, ".gz"))
+            {
+                return;
+            }
+#endif
+            file = std::fopen(path.c_str(), "wb");
+        }
+
+        ~Output()
+        {
+            close();
+        }
+
+        bool is_open() const
+        {
+#if MYSN_HAVE_ZLIB
+            if (gz != nullptr)
+            {
+                return true;
+            }
+#endif
+            return file != nullptr;
+        }
+
+        void write(const void *data, std::size_t length)
+        {
+#if MYSN_HAVE_ZLIB
+            if (gz != nullptr)
+            {
+                gzwrite(gz, data, unsigned(length));
+                return;
+            }
+#endif
+            if (file != nullptr)
+            {
+                std::fwrite(data, 1, length, file);
+            }
+        }
+
+        void close()
+        {
+#if MYSN_HAVE_ZLIB
+            if (gz != nullptr)
+            {
+                gzclose(gz);
+                gz = nullptr;
+            }
+#endif
+            if (file != nullptr)
+            {
+                std::fclose(file);
+                file = nullptr;
+            }
+        }
+    };
+
+    TraceStream::TraceStream(const std::string &path, const std::atomic<bool> &writer_stopped)
+        : ring(CHUNK_SIZE, CHUNK_COUNT),
+          chunk(ring.acquire()),
+          used(4),
+          output(new Output(path)),
+          closing(false),
+          closed(false),
+          writer_stopped(writer_stopped),
+          dropped(false)
+    {
+    }
+
+    TraceStream::~TraceStream()
+    {
+    }
+
+    bool TraceStream::is_open() const
+    {
+        return output->is_open();
+    }
+
+    char *TraceStream::reserve(std::size_t length)
+    {
+        if (used + length > CHUNK_SIZE)
+        {
+            publish();
+        }
+
+        return reinterpret_cast<char *>(chunk + used);
+    }
+
+    void TraceStream::commit(std::size_t length)
+    {
+        used += length;
+    }
+
+    void TraceStream::write(const char *text, std::size_t length)
+    {
+        while (length != 0)
+        {
+            std::size_t n = length < CHUNK_SIZE - 4 ? length : CHUNK_SIZE - 4;
+            std::memcpy(reserve(n), text, n);
+            commit(n);
+            text += n;
+            length -= n;
+        }
+    }
+
+    void TraceStream::publish()
+    {
+        // 写盘线程停止后没人腾出空块，也没人把块写出去
+        if (dropped || writer_stopped.load(std::memory_order_acquire))
+        {
+            drop();
+            return;
+        }
+
+        std::uint32_t length = std::uint32_t(used - 4);
+        std::memcpy(chunk, &length, 4);
+        ring.publish();
+        used = 4;
+
+        int spins = 0;
+        while ((chunk = ring.acquire()) == nullptr)
+        {
+            // 刚发布的块可能赶不上写盘线程最后一轮，按丢失算
+            if (writer_stopped.load(std::memory_order_acquire))
+            {
+                drop();
+                return;
+            }
+            backoff(spins);
+        }
+    }
+
+    void TraceStream::drop()
+    {
+        if (!dropped)
+        {
+            dropped = true;
+            discard.resize(CHUNK_SIZE);
+            chunk = &discard[0];
+        }
+        used = 4;
+    }
+
+    bool TraceStream::lost() const
+    {
+        return dropped;
+    }
+
+    void TraceStream::flush()
+    {
+        if (used > 4)
+        {
+            publish();
+        }
+    }
+
+    void TraceStream::close()
+    {
+        if (closing.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        flush();
+        closing.store(true, std::memory_order_release);
+    }
+
+    bool TraceStream::drain()
+    {
+        bool wrote = false;
+
+        // 先读关闭标志再取块，保证关闭前提交的块都写出去
+        bool finished = closing.load(std::memory_order_acquire);
+
+        while (const std::uint8_t *data = ring.front())
+        {
+            std::uint32_t length;
+            std::memcpy(&length, data, 4);
+            output->write(data + 4, length);
+            ring.release();
+            wrote = true;
+        }
+
+        if (finished && !closed)
+        {
+            output->close();
+            closed = true;
+        }
+
+        return wrote;
+    }
+
+    TraceWriter::TraceWriter() : stopping(false)
+    {
+        writer = std::thread(&TraceWriter::writer_loop, this);
+    }
+
+    TraceWriter::~TraceWriter()
+    {
+        close();
+    }
+
+    TraceStream *TraceWriter::open(const std::string &path)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        streams.push_back(std::unique_ptr<TraceStream>(new TraceStream(path, stopping)));
+
+        return streams.back().get();
+    }
+
+    bool TraceWriter::close()
+    {
+        if (!writer.joinable())
+        {
+            return true;
+        }
+
+        std::size_t unclosed = 0;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+
+            // 流是单生产者的，只能由生产者自己关闭；在这里代为 flush 会和还在写的生产者同时发布块
+            for (auto &stream : streams)
+            {
+                if (!stream->closing.load(std::memory_order_acquire))
+                {
+                    ++unclosed;
+                }
+            }
+        }
+
+        // 还开着的流在写盘线程停止后改为丢弃，不会卡在等空闲块上
+        stopping.store(true, std::memory_order_release);
+        writer.join();
+
+        if (unclosed != 0)
+        {
+            std::fprintf(stderr, "TraceWriter: %zu trace stream(s) not closed by their producer, unflushed data lost\n",
+                         unclosed);
+            return false;
+        }
+
+        return true;
+    }
+
+    void TraceWriter::writer_loop()
+    {
+        std::vector<TraceStream *> active;
+        int spins = 0;
+
+        while (true)
+        {
+            bool stop = stopping.load(std::memory_order_acquire);
+
+            {
+                std::lock_guard<std::mutex> guard(lock);
+
+                active.clear();
+                for (auto &stream : streams)
+                {
+                    active.push_back(stream.get());
+                }
+            }
+
+            bool busy = false;
+            for (TraceStream *stream : active)
+            {
+                busy |= stream->drain();
+            }
+
+            // 生产者在 close() 置位 stopping 之前已经关闭了各自的流，这一轮已经写完。
+            // 没关闭的流以后也不会再写文件，一并关掉，已经写出的部分落盘
+            if (stop)
+            {
+                for (TraceStream *stream : active)
+                {
+                    stream->output->close();
+                    stream->closed = true;
+                }
+                return;
+            }
+
+            if (busy)
+            {
+                spins = 0;
+            }
+            else
+            {
+                backoff(spins);
+            }
+        }
+    }
+}
@@ -0,0 +1,262 @@
+#ifndef APU_H
+#define APU_H
+
+#include "CPU.h"
+#include "AudioMixer.h"
+#include "BlipBuffer.h"
+#include "Resampler.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace mysn
+{
+    class AudioSink;
+
+    // 声道电平变化时向 blip 缓冲区写入阶跃。混音采用 nesdev 上的线性近似，
+    // 每个声道独立换算成采样幅度，所以各声道可以分别推进时间。
+    // levels 不为空时改为按 APU 周期（2 个 CPU 周期）展开电平，交给混音和重采样。
+    struct ChannelOutput
+    {
+        int weight;
+        int last;
+        std::uint8_t *levels;
+        std::uint32_t filled;
+
+        explicit ChannelOutput(int weight);
+
+        void set(BlipBuffer &blip, std::uint32_t time, int level);
+        void fill_to(std::uint32_t index);
+    };
+
+    struct Envelope
+    {
+        bool start;
+        bool loop;
+        bool constant;
+        Byte param;
+        Byte divider;
+        Byte decay;
+
+        Envelope();
+
+        void write(Byte data);
+        void clock();
+        int volume() const;
+    };
+
+    struct PulseChannel
+    {
+        bool second; // 2 号方波的 sweep 取反不减 1
+        bool enabled;
+        Byte duty;
+        Byte phase;
+        DobuleByte timer_period;
+        Byte length;
+        Envelope envelope;
+
+        bool sweep_enabled;
+        bool sweep_negate;
+        bool sweep_reload;
+        Byte sweep_period;
+        Byte sweep_shift;
+        Byte sweep_divider;
+
+        // 下一次定时器时钟的绝对 CPU 周期
+        std::uint64_t time;
+        ChannelOutput output;
+
+        explicit PulseChannel(bool second);
+
+        void write(int reg, Byte data);
+        void clock_quarter();
+        void clock_half();
+        int sweep_target() const;
+        bool muted() const;
+        void run(BlipBuffer &blip, std::uint64_t frame_start, std::uint64_t from, std::uint64_t end);
+    };
+
+    struct TriangleChannel
+    {
+        bool enabled;
+        bool control;
+        Byte linear_reload_value;
+        Byte linear_counter;
+        bool linear_reload;
+        DobuleByte timer_period;
+        Byte length;
+        Byte phase;
+
+        std::uint64_t time;
+        ChannelOutput output;
+
+        TriangleChannel();
+
+        void write(int reg, Byte data);
+        void clock_quarter();
+        void clock_half();
+        void run(BlipBuffer &blip, std::uint64_t frame_start, std::uint64_t from, std::uint64_t end);
+    };
+
+    struct NoiseChannel
+    {
+        bool enabled;
+        bool short_mode;
+        Byte period_index;
+        Byte length;
+        DobuleByte lfsr;
+        Envelope envelope;
+
+        std::uint64_t time;
+        ChannelOutput output;
+
+        NoiseChannel();
+
+        void write(int reg, Byte data);
+        void clock_quarter();
+        void clock_half();
+        void run(BlipBuffer &blip, std::uint64_t frame_start, std::uint64_t from, std::uint64_t end);
+    };
+
+    struct DmcChannel
+    {
+        typedef std::function<Byte(Address)> Reader;
+
+        bool irq_enabled;
+        bool loop;
+        bool irq;
+        Byte rate_index;
+        Byte level;
+        Address sample_address;
+        DobuleByte sample_length;
+
+        Address current_address;
+        DobuleByte bytes_remaining;
+        Byte buffer;
+        bool buffer_full;
+        Byte shift;
+        Byte bits_remaining;
+        bool silence;
+
+        std::uint64_t time;
+        ChannelOutput output;
+
+        // DMA 读取挂起 CPU 的周期数，由 CPU 取走
+        unsigned stall;
+
+        DmcChannel();
+
+        void write(int reg, Byte data);
+        void set_enabled(bool enabled, const Reader &reader);
+        void fill_buffer(const Reader &reader);
+        void start_output_cycle(const Reader &reader);
+        std::uint64_t next_fetch() const;
+        void run(BlipBuffer &blip, std::uint64_t frame_start, std::uint64_t from, std::uint64_t end,
+                 const Reader &reader);
+        // 不产生电平，只按字节边界推进取数时序
+        void run_status(std::uint64_t end, const Reader &reader);
+    };
+
+    // Full_Synthesis 用 blip 缓冲区生成并混合全部波形；Resampled_Synthesis 把各声道电平
+    // 按 APU 周期展开后经向量化的混音器和多相 FIR 重采样输出；Status_Only 只维护 CPU
+    // 能观察到的部分：长度计数器、$4015、帧中断以及 DMC 的取数、中断和 DMA 挂起时序。
+    // 各模式下 CPU 看到的结果逐位一致。
+    enum APUMode
+    {
+        Full_Synthesis,
+        Resampled_Synthesis,
+        Status_Only,
+    };
+
+    /// # APU ($4000-$4017) http://wiki.nesdev.com/w/index.php/APU
+    ///
+    /// 惰性推进：只有在寄存器读写、帧计数器步进、DMC 取数或输出一帧时才把各声道
+    /// 推进到当前 CPU 周期。CPU 在 cycles >= next_event_cycle() 时调用 run_until。
+    class APU
+    {
+    public:
+        static const long CPU_CLOCK_RATE = 1789773;
+        // 约一个 NTSC 视频帧，最长隔这么久把采样交给 sink
+        static const std::uint32_t FLUSH_INTERVAL = 29781;
+
+        explicit APU(long sample_rate = 48000, APUMode mode = Full_Synthesis);
+
+        void reset(std::uint64_t cycle = 0);
+
+        APUMode get_mode() const;
+        void set_mode(APUMode mode);
+
+        void set_sink(AudioSink *sink);
+        void set_dmc_reader(DmcChannel::Reader reader);
+
+        void write_register(Address addr, Byte data, std::uint64_t cycle);
+        Byte read_status(std::uint64_t cycle);
+
+        void run_until(std::uint64_t cycle);
+        // 推进到 cycle 并把这段时间的采样交给 sink
+        void end_frame(std::uint64_t cycle);
+
+        bool irq_pending() const
+        {
+            return frame_irq || dmc.irq;
+        }
+
+        std::uint64_t next_event_cycle() const
+        {
+            return next_event;
+        }
+
+        unsigned take_dma_stall()
+        {
+            unsigned stall = dmc.stall;
+            dmc.stall = 0;
+            return stall;
+        }
+
+    private:
+        APUMode mode;
+
+        PulseChannel pulse1;
+        PulseChannel pulse2;
+        TriangleChannel triangle;
+        NoiseChannel noise;
+        DmcChannel dmc;
+
+        bool five_step;
+        bool irq_inhibit;
+        bool frame_irq;
+        int frame_step;
+        std::uint64_t frame_sequence_start;
+        std::uint64_t frame_next;
+
+        std::uint64_t last_time;
+        std::uint64_t frame_start;
+        std::uint64_t next_event;
+
+        BlipBuffer blip;
+        AudioSink *sink;
+        DmcChannel::Reader dmc_reader;
+        std::vector<std::int16_t> samples;
+
+        // Resampled_Synthesis 的缓冲，首次进入该模式时分配
+        AudioMixer mixer;
+        std::unique_ptr<Resampler> resampler;
+        std::vector<std::uint8_t> levels;
+        std::vector<float> mixed;
+        std::vector<float> resampled;
+        float dc_input;
+        float dc_output;
+
+        void advance(std::uint64_t cycle);
+        void run_channels(std::uint64_t end);
+        void clock_frame_step();
+        void restart_frame_counter(std::uint64_t cycle);
+        void flush(std::uint64_t cycle);
+        void flush_resampled(std::uint64_t cycle);
+        void bind_outputs();
+        void update_next_event();
+    };
+}
+
+#endif // APU_H
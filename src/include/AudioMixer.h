@@ -0,0 +1,38 @@
+#ifndef AUDIOMIXER_H
+#define AUDIOMIXER_H
+
+#include "SimdDispatch.h"
+#include <cstdint>
+#include <cstddef>
+
+namespace mysn
+{
+    // nesdev 的线性混音近似系数，满幅约 0.85
+    const float PULSE_MIX = 0.00752f;
+    const float TRIANGLE_MIX = 0.00851f;
+    const float NOISE_MIX = 0.00494f;
+    const float DMC_MIX = 0.00335f;
+
+    // 五个声道按 APU 周期排列的电平（pulse/noise/triangle 0-15，dmc 0-127）
+    struct ChannelLevels
+    {
+        const std::uint8_t *pulse1;
+        const std::uint8_t *pulse2;
+        const std::uint8_t *triangle;
+        const std::uint8_t *noise;
+        const std::uint8_t *dmc;
+    };
+
+    class AudioMixer
+    {
+    public:
+        explicit AudioMixer(SimdLevel level = detect_simd_level());
+
+        void mix(const ChannelLevels &levels, std::size_t count, float *out) const;
+
+    private:
+        SimdLevel level;
+    };
+}
+
+#endif // AUDIOMIXER_H
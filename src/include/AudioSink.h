@@ -0,0 +1,57 @@
+#ifndef AUDIOSINK_H
+#define AUDIOSINK_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <string>
+
+namespace mysn
+{
+    // APU 输出的单声道 16 位采样的去向
+    class AudioSink
+    {
+    public:
+        virtual ~AudioSink() {}
+
+        virtual void write_samples(const std::int16_t *samples, std::size_t count) = 0;
+    };
+
+    /// 流式 WAV 写入：先写入占位的文件头，边写边追加 PCM 数据，
+    /// close() 或析构时回填 RIFF/data 的长度字段。
+    class WavWriter : public AudioSink
+    {
+    public:
+        WavWriter(const std::string &path, long sample_rate);
+        ~WavWriter();
+
+        bool is_open() const;
+        void write_samples(const std::int16_t *samples, std::size_t count);
+        void close();
+
+    private:
+        std::FILE *file;
+        std::uint32_t data_bytes;
+
+        WavWriter(const WavWriter &);
+        WavWriter &operator=(const WavWriter &);
+
+        void write_header(long sample_rate);
+    };
+
+    class CallbackSink : public AudioSink
+    {
+    public:
+        typedef std::function<void(const std::int16_t *, std::size_t)> Callback;
+
+        explicit CallbackSink(Callback callback);
+
+        void write_samples(const std::int16_t *samples, std::size_t count);
+
+    private:
+        Callback callback;
+    };
+}
+
+#endif // AUDIOSINK_H
@@ -0,0 +1,90 @@
+#ifndef BATCHCPU_H
+#define BATCHCPU_H
+
+#include "CPU.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mysn
+{
+    /// 实验性的批量 CPU：同一个程序的多个实例按结构数组（SoA）存放，每 16 个一组锁步执行。
+    ///
+    ///     BatchCPU batch(1024);
+    ///     batch.load_and_reset(program);
+    ///     for (std::size_t i = 0; i < batch.size(); ++i)
+    ///     {
+    ///         batch.poke(i, 0x0000, inputs[i]);
+    ///     }
+    ///     batch.run();
+    ///
+    /// 组内 PC 相同的实例只译码一次，寄存器运算用 SSE2 一次算 16 个实例（没有 SSE2 时退回逐字节循环）；
+    /// PC 不一致时按 PC 分成几批各自执行，最坏情况每批一个实例，相当于标量执行。
+    ///
+    /// 地址映射与 CPU 相同（见 WRITABLE_MEMORY_SIZE）。每个实例的可写内存交错存放：同一地址上
+    /// 一组 16 个实例的字节相邻，地址相同的读写是一次 16 字节的向量访问，变址寻址地址不同时逐个实例读写。
+    /// $8000-$FFFF 是所有实例共享的只读 ROM，写入被忽略；这是与 CPU 唯一的差别，
+    /// 其余指令语义与 CPU::run_with 逐条一致（两边的改动要同步）。
+    /// 不支持 APU/PPU/手柄，输入用 poke 写进内存。
+    class BatchCPU
+    {
+    public:
+        static const std::size_t LANES = 16;
+        static const Address ROM_START = 0x8000;
+        static const std::size_t RAM_SIZE = WRITABLE_MEMORY_SIZE;
+
+        explicit BatchCPU(std::size_t count);
+
+        std::size_t size() const;
+
+        // 所有实例装载同一个程序并复位，内存清零，与 CPU 刚构造后 load_and_reset 的状态相同
+        void load_and_reset(const std::vector<Byte> &program);
+
+        // 每个实例执行到 BRK 或未知操作码，或者周期数达到 cycle_limit；
+        // 已达到 cycle_limit 的实例不再执行
+        void run(std::uint64_t cycle_limit = ~std::uint64_t(0));
+
+        bool halted(std::size_t index) const;
+        Address program_counter(std::size_t index) const;
+        Byte register_a(std::size_t index) const;
+        Byte register_x(std::size_t index) const;
+        Byte register_y(std::size_t index) const;
+        Byte stack_pointer(std::size_t index) const;
+        Byte status(std::size_t index) const;
+        std::uint64_t cycles(std::size_t index) const;
+
+        Byte peek(std::size_t index, Address addr) const;
+        // 写 ROM 和开放总线被忽略
+        void poke(std::size_t index, Address addr, Byte data);
+
+        // 所有实例累计执行的指令数
+        std::uint64_t instructions() const;
+        // 累计译码次数，instructions() / issues() 是平均每次译码执行的实例数
+        std::uint64_t issues() const;
+
+    private:
+        std::size_t count;
+        std::size_t padded;
+
+        std::vector<Address> program_counters;
+        std::vector<Byte> registers_a;
+        std::vector<Byte> registers_x;
+        std::vector<Byte> registers_y;
+        std::vector<Byte> stack_pointers;
+        std::vector<Byte> statuses;
+        // 补齐到 LANES 的空位也记为已停止
+        std::vector<Byte> stopped;
+        std::vector<std::uint64_t> cycle_counts;
+
+        // 每组 RAM_SIZE * LANES 字节，地址 addr 上第 i 个实例的字节在 writable_offset(addr) * LANES + i
+        std::vector<Byte> ram;
+        std::vector<Byte> rom;
+
+        std::uint64_t executed;
+        std::uint64_t issued;
+
+        void run_group(std::size_t group, std::uint64_t cycle_limit);
+    };
+}
+
+#endif // BATCHCPU_H
@@ -0,0 +1,51 @@
+#ifndef BLIPBUFFER_H
+#define BLIPBUFFER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace mysn
+{
+    /// # Band-limited step synthesis (blip-buffer)
+    ///
+    /// 声道只在输出电平变化时调用 add_delta，缓冲区把每个阶跃展开成一段带限的
+    /// 差分核，读取时积分得到采样。开销与电平变化次数成正比，与采样数无关。
+    ///
+    /// 时间以 CPU 时钟为单位，相对于当前帧的起点（end_frame 之后归零）。
+    class BlipBuffer
+    {
+    public:
+        static const int PHASE_BITS = 6;
+        static const int PHASE_COUNT = 1 << PHASE_BITS;
+        static const int HALF_WIDTH = 8;
+        static const int KERNEL_WIDTH = HALF_WIDTH * 2;
+        // 核的定点精度，一行系数之和恰好等于 KERNEL_UNIT
+        static const int KERNEL_BITS = 13;
+        static const int KERNEL_UNIT = 1 << KERNEL_BITS;
+
+        BlipBuffer(long clock_rate, long sample_rate, std::size_t max_samples);
+
+        void add_delta(std::uint32_t clock_time, int delta);
+        void end_frame(std::uint32_t clock_duration);
+
+        std::size_t samples_available() const;
+        std::size_t read_samples(std::int16_t *out, std::size_t max_samples);
+        void clear();
+
+        long sample_rate() const;
+
+    private:
+        long rate;
+        // 每个时钟对应的采样数，32.32 定点
+        std::uint64_t factor;
+        // 当前帧起点的采样位置（相对 avail），32.32 定点
+        std::uint64_t offset;
+        std::size_t avail;
+        std::size_t capacity;
+        std::int32_t integrator;
+        std::vector<std::int32_t> buffer;
+    };
+}
+
+#endif // BLIPBUFFER_H
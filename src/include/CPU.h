@@ -1,6 +1,10 @@
 #ifndef CPU_H
 #define CPU_H
 
+#include "FlightRecorder.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -52,10 +56,96 @@ namespace mysn
         Negative = 0b10000000,
     };
 
+    /// 每个实例自己的可写内存，连续的一块：
+    ///
+    ///     $0000-$07FF  2KB 内部 RAM，在 $0800-$1FFF 镜像三次
+    ///     $4000-$40FF  I/O 页，没有挂设备的寄存器当作普通内存
+    ///     $6000-$7FFF  8KB PRG RAM
+    ///
+    /// $2000-$3FFF（没挂 PPU 时）和 $4100-$5FFF 是开放总线，读出 0，写入忽略。
+    /// $8000-$FFFF 是 PRG ROM，多个实例共享，见 SharedRom。
+    const std::size_t WRITABLE_MEMORY_SIZE = 0x800 + 0x100 + 0x2000;
+
+    // $8000 以下的地址在可写内存里的偏移，开放总线的地址返回 WRITABLE_MEMORY_SIZE
+    inline std::size_t writable_offset(Address addr)
+    {
+        if (addr < 0x2000)
+        {
+            return addr & 0x7FF;
+        }
+        if ((addr >> 8) == 0x40)
+        {
+            return 0x800 + (addr & 0xFF);
+        }
+        if (addr >= 0x6000 && addr < 0x8000)
+        {
+            return 0x900 + (addr - 0x6000);
+        }
+
+        return WRITABLE_MEMORY_SIZE;
+    }
+
+    // $8000-$FFFF 的 32KB PRG ROM，同一个程序的所有实例共享一份；某个实例写 ROM 时复制出它自己的
+    typedef std::shared_ptr<const std::vector<Byte>> SharedRom;
+
+    // 程序从 $8000 开始放，超过 32KB 的部分丢弃，复位向量指向 $8000
+    SharedRom make_rom(const std::vector<Byte> &program);
+
+    // NTSC 每帧 29780.5 个 CPU 周期，向上取整
+    const std::uint64_t CYCLES_PER_FRAME = 29781;
+
+    // run_with/run_for 返回的原因
+    enum RunExit
+    {
+        // BRK，程序结束
+        Run_Halted,
+        // 未知操作码，程序结束
+        Run_Invalid_Opcode,
+        // 插桩策略调用了 request_stop
+        Run_Stopped,
+        // 以下只由 run_for 返回，CPU 停在指令边界上，再次调用会从这里接着执行
+        Run_Instruction_Limit,
+        Run_Cycle_Limit,
+        Run_Frame_End,
+    };
+
+    /// run_for 的执行预算，为 0（false）的项不限制，几项同时设置时先到者为准。
+    /// 指令不可分割，周期数会超出预算最多一条指令（OAM DMA 时为 513 个周期）。
+    struct RunBudget
+    {
+        // 最多执行的指令数
+        std::uint64_t instructions;
+        // 最多执行的周期数，从调用时的 cycles 算起
+        std::uint64_t cycles;
+        // 执行到下一个帧边界（CYCLES_PER_FRAME 的整数倍）为止
+        bool frame;
+    };
+
+    class APU;
+    class PPU;
+    class Joypad;
+    class Debugger;
+
     class CPU
     {
     private:
-        std::vector<Byte> memory;
+        Byte writable[WRITABLE_MEMORY_SIZE];
+        SharedRom rom;
+        APU *apu;
+        PPU *ppu;
+        Joypad *joypads[2];
+        // 只在 Debugger::run 期间挂接，复制 CPU 时不带过去
+        Debugger *debugger;
+
+        // 每 256 字节一页，RAM/ROM 页直接指向 writable 或 rom，挂了设备的 I/O 页和开放总线为 nullptr。
+        // ROM 页只用来读，写 ROM 走 io_write
+        Byte *pages[256];
+
+        // 当前指令的有效地址是否跨页（含跳转跨页的分支）
+        bool page_crossed;
+
+        // 由 request_stop 置位，执行循环在当前指令结束后返回
+        bool stop_requested;
 
         void update_zero_and_negative_flags(Byte result);
 
@@ -63,7 +153,8 @@ namespace mysn
         void i_and(AddressingMode mode);
         void i_asl(AddressingMode mode);
         void i_asl_accumulator();
-        void branch(bool condition);
+        // 条件成立时跳转并加上额外的周期，返回是否跳转
+        bool branch(bool condition);
         void bit(AddressingMode mode);
         void compare(AddressingMode mode, Byte compare_with);
 
@@ -102,11 +193,29 @@ namespace mysn
         void run();
         void reset();
 
+        void map_pages();
+        // 地址对应的存储单元，开放总线返回 nullptr；写 ROM 时先复制出自己的一份
+        const Byte *read_location(Address addr) const;
+        Byte *write_location(Address addr);
+        Byte io_read(Address addr);
+        void io_write(Address addr, Byte data);
+        void oam_dma(Byte page);
+
+        void poll_apu();
+        void interrupt_irq();
+
         // 获取操作数地址
         Address get_operand_address(AddressingMode mode);
 
     public:
         CPU();
+        // 指令记录用调用者提供的存储，见 FlightRecorder(FlightRecord *, std::size_t)
+        CPU(FlightRecord *recorder_buffer, std::size_t recorder_capacity);
+        // 设备（APU/PPU/手柄/调试器）属于挂接它的那个实例，不随状态复制：
+        // 复制出来的 CPU 不挂任何设备，赋值时保留自己原来挂的设备。
+        // pages 指向自身的 memory，复制时需要重建
+        CPU(const CPU &other);
+        CPU &operator=(const CPU &other);
 
         Address program_counter;
         Byte register_a;
@@ -117,9 +226,55 @@ namespace mysn
         // Status flags
         Byte status;
 
+        // 自上电以来经过的 CPU 周期
+        std::uint64_t cycles;
+
+        // 最近执行过的指令，遇到未知操作码或不支持的寻址模式时写到标准错误
+        FlightRecorder flight_recorder;
+
         void load_and_run(std::vector<Byte> &program);
+        // 只装载并复位，之后用 run_with 分段执行
+        void load_and_reset(std::vector<Byte> &program);
+        // 用 make_rom 生成的 ROM，多个实例装载同一个 ROM 时不复制
+        void load_and_reset(const SharedRom &rom);
+
+        // 寄存器、周期、内存和 ROM 恢复成 other 的状态，挂接的设备不变，指令记录清空而不复制。
+        // 不分配内存，用来从快照快速复位
+        void restore(const CPU &other);
+        // 回到刚构造时的状态（内存清零、ROM 卸下、寄存器和周期复位），保留挂接的设备
+        void hard_reset();
+        // 在插桩策略的钩子里调用：当前指令执行完后 run_with 返回
+        void request_stop();
+
+        // 在预算内执行一段，用来在固定数量的线程上轮流调度大量实例。
+        // 预算全为 0 时与 run() 相同，只会因为程序结束返回
+        RunExit run_for(const RunBudget &budget);
+
+        // 带插桩策略的执行，定义在 CPURun.h，返回 Run_Halted、Run_Invalid_Opcode 或 Run_Stopped
+        template <typename Policy>
+        RunExit run_with(Policy &policy);
+        template <typename Policy>
+        RunExit load_and_run_with(std::vector<Byte> &program, Policy &policy);
         void mem_write(Address addr, Byte data);
         Byte mem_read(Address addr);
+        // 不经过 I/O 设备直接读内存，没有副作用，给跟踪和调试工具用
+        Byte peek(Address addr) const;
+        // 2KB 内部 RAM 的起始地址，CPU 存在期间不变，可以长期持有用来零拷贝地读内存。
+        // 后面紧跟 I/O 页和 PRG RAM，一共 WRITABLE_MEMORY_SIZE 字节
+        const Byte *memory_data() const;
+        // $8000-$FFFF 的 32KB ROM，装载或写 ROM（换成自己的一份）之后要重新获取
+        const Byte *rom_data() const;
+        // 用 memory_data() 存下的 WRITABLE_MEMORY_SIZE 字节覆盖可写内存，给存档恢复用
+        void load_memory(const Byte *data);
+
+        // 把 APU 挂到 $4000-$4017，同时以当前周期为起点复位 APU
+        void attach_apu(APU *apu);
+        // 把 PPU 挂到 $2000-$3FFF，并接管 $4014 的 OAM DMA
+        void attach_ppu(PPU *ppu);
+        // 把手柄挂到 $4016（port 0）或 $4017（port 1），写 $4016 同时锁存两个手柄
+        void attach_joypad(int port, Joypad *joypad);
+        // 有观察点的页改走 io_read/io_write，nullptr 时恢复原来的页表。由 Debugger::run 调用
+        void attach_debugger(Debugger *debugger);
 
         void change_flag(CpuFlags flag, bool data);
         void set_flag(CpuFlags flag);
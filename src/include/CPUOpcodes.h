@@ -106,6 +106,31 @@ namespace mysn
         static std::map<Byte, CPUOpcodes> CPU_OPS_CODES_MAP;
     };
 
+    const char *mnemonic_name(CPUOpcodeMnemonics mnemonic);
+    const char *addressing_mode_name(AddressingMode mode);
+
+    // 变址寻址跨页时多一个周期的读指令（表里标了 "+1 if page crossed" 的）。
+    // 写和读改写指令总是多花这个周期，已经算在表里
+    inline bool adds_page_cycle(CPUOpcodeMnemonics mnemonic)
+    {
+        switch (mnemonic)
+        {
+        case CPUOpcodeMnemonics::ADC:
+        case CPUOpcodeMnemonics::AND:
+        case CPUOpcodeMnemonics::CMP:
+        case CPUOpcodeMnemonics::EOR:
+        case CPUOpcodeMnemonics::LDA:
+        case CPUOpcodeMnemonics::LDX:
+        case CPUOpcodeMnemonics::LDY:
+        case CPUOpcodeMnemonics::ORA:
+        case CPUOpcodeMnemonics::SBC:
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
 }
 
 #endif // CPUOPCODES_H
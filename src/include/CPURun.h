@@ -0,0 +1,531 @@
+#ifndef CPURUN_H
+#define CPURUN_H
+
+#include "CPU.h"
+#include "CPUOpcodes.h"
+
+namespace mysn
+{
+    /// 执行循环按插桩策略（Policy）模板化，每条指令前后各调用一次策略：
+    ///
+    ///     void before_instruction(CPU &cpu, Byte code);  // program_counter 仍指向操作码
+    ///     void after_instruction(CPU &cpu, Byte code, bool page_crossed);  // program_counter 已指向下一条指令
+    ///
+    /// 钩子都是内联的空函数时编译器会把它们整个删掉，run() 用的就是这种策略。
+    /// 钩子里调用 cpu.request_stop() 可以在当前指令结束后返回（例如限制指令数）。
+    struct NullPolicy
+    {
+        void before_instruction(CPU &, Byte) {}
+        void after_instruction(CPU &, Byte, bool) {}
+    };
+
+    template <typename Policy>
+    RunExit CPU::run_with(Policy &policy)
+    {
+        while (true)
+        {
+            if (apu != nullptr)
+            {
+                poll_apu();
+            }
+
+            // 操作码
+            auto code = mem_read(program_counter);
+            flight_recorder.record(program_counter, code, register_a, register_x, register_y,
+                                   status, stack_pointer, cycles);
+            policy.before_instruction(*this, code);
+            ++program_counter;
+            auto opcode = CPUOpcodes::CPU_OPS_CODES_MAP.find(code);
+
+            // 判断操作码是否存在
+            if (opcode == CPUOpcodes::CPU_OPS_CODES_MAP.end())
+            {
+                flight_recorder.fault("invalid opcode");
+                return Run_Invalid_Opcode;
+            }
+
+            auto mnemonic = (opcode->second).mnemonic;
+            auto mode = (opcode->second).mode;
+            auto len = (opcode->second).len;
+            cycles += (opcode->second).cycles;
+            page_crossed = false;
+            bool halted = false;
+            // 自己写了 PC 的指令（跳转、返回、成立的分支）不再按指令长度前进
+            bool jumped = false;
+
+            switch (mnemonic)
+            {
+            case CPUOpcodeMnemonics::ADC:
+            {
+                adc(mode);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::AND:
+            {
+                i_and(mode);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::ASL:
+            {
+                if (mode == AddressingMode::Accumulator)
+                {
+                    i_asl_accumulator();
+                }
+                else
+                {
+
+                    i_asl(mode);
+                }
+                break;
+            }
+
+            case CPUOpcodeMnemonics::BCC:
+            {
+                jumped = branch(!contain_flag(CpuFlags::Carry));
+                break;
+            }
+
+            case CPUOpcodeMnemonics::BCS:
+            {
+                jumped = branch(contain_flag(CpuFlags::Carry));
+                break;
+            }
+
+            case CPUOpcodeMnemonics::BEQ:
+            {
+                jumped = branch(contain_flag(CpuFlags::Zero));
+                break;
+            }
+
+            case CPUOpcodeMnemonics::BIT:
+            {
+                bit(mode);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::BMI:
+            {
+                jumped = branch(contain_flag(CpuFlags::Negative));
+                break;
+            }
+
+            case CPUOpcodeMnemonics::BNE:
+            {
+                jumped = branch(!contain_flag(CpuFlags::Zero));
+                break;
+            }
+
+            case CPUOpcodeMnemonics::BPL:
+            {
+                jumped = branch(!contain_flag(CpuFlags::Negative));
+                break;
+            }
+
+            case CPUOpcodeMnemonics::BVC:
+            {
+                jumped = branch(!contain_flag(CpuFlags::Overflow));
+                break;
+            }
+
+            case CPUOpcodeMnemonics::BVS:
+            {
+                jumped = branch(contain_flag(CpuFlags::Overflow));
+                break;
+            }
+
+            case CPUOpcodeMnemonics::CLC:
+            {
+                clear_flag(CpuFlags::Carry);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::CLD:
+            {
+                clear_flag(CpuFlags::Decimal_Mode);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::CLI:
+            {
+                clear_flag(CpuFlags::Interrupt_Disable);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::CLV:
+            {
+                clear_flag(CpuFlags::Overflow);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::CMP:
+            {
+                compare(mode, register_a);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::CPX:
+            {
+                compare(mode, register_x);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::CPY:
+            {
+                compare(mode, register_y);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::DEC:
+            {
+                dec(mode);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::DEX:
+            {
+                dex();
+                break;
+            }
+
+            case CPUOpcodeMnemonics::DEY:
+            {
+                dey();
+                break;
+            }
+
+            case CPUOpcodeMnemonics::EOR:
+            {
+                eor(mode);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::INC:
+            {
+                inc(mode);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::INX:
+            {
+                inx();
+                break;
+            }
+
+            case CPUOpcodeMnemonics::INY:
+            {
+                iny();
+                break;
+            }
+
+            case CPUOpcodeMnemonics::JMP:
+            {
+                if (mode == AddressingMode::Absolute)
+                {
+                    auto addr = mem_read_u16(program_counter);
+                    program_counter = addr;
+                }
+                else if (mode == AddressingMode::Indirect)
+                {
+                    Address location = mem_read_u16(program_counter);
+                    //6502 has a bug such that the when the vector of anindirect address begins at the last byte of a page,
+                    //the second byte is fetched from the beginning of that page rather than the beginning of the next
+                    //Recreating here:
+                    Address Page = location & 0xff00;
+                    program_counter = mem_read(location) |
+                                      mem_read(Page | ((location + 1) & 0xff)) << 8;
+                }
+
+                jumped = true;
+                break;
+            }
+
+            case CPUOpcodeMnemonics::JSR:
+            {
+                stack_push_u16(program_counter + 1);
+                auto target_address = mem_read_u16(program_counter);
+                program_counter = target_address;
+                jumped = true;
+                break;
+            }
+
+            case CPUOpcodeMnemonics::LDA:
+            {
+                lda(mode);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::LDX:
+            {
+                ldx(mode);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::LDY:
+            {
+                ldy(mode);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::LSR:
+            {
+                if (mode == AddressingMode::Accumulator)
+                {
+                    lsr_accumulator();
+                }
+                else
+                {
+                    lsr(mode);
+                }
+                break;
+            }
+
+            case CPUOpcodeMnemonics::NOP:
+            {
+                break;
+            }
+
+            case CPUOpcodeMnemonics::ORA:
+            {
+                ora(mode);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::PHA:
+            {
+                stack_push(register_a);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::PHP:
+            {
+                // 压栈的副本带 B 标志，寄存器本身不变
+                stack_push(status | CpuFlags::Break | CpuFlags::Break2);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::PLA:
+            {
+                pla();
+                break;
+            }
+
+            case CPUOpcodeMnemonics::PLP:
+            {
+                status = stack_pop();
+                clear_flag(CpuFlags::Break);
+                set_flag(CpuFlags::Break2);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::ROL:
+            {
+                if (mode == AddressingMode::Accumulator)
+                {
+                    rol_accumulator();
+                }
+                else
+                {
+                    rol(mode);
+                }
+                break;
+            }
+
+            case CPUOpcodeMnemonics::ROR:
+            {
+                if (mode == AddressingMode::Accumulator)
+                {
+                    ror_accumulator();
+                }
+                else
+                {
+                    ror(mode);
+                }
+                break;
+            }
+
+            case CPUOpcodeMnemonics::RTI:
+            {
+                status = stack_pop();
+                clear_flag(CpuFlags::Break);
+                set_flag(CpuFlags::Break2);
+
+                program_counter = stack_pop_u16();
+                jumped = true;
+                break;
+            }
+
+            case CPUOpcodeMnemonics::RTS:
+            {
+                program_counter = stack_pop_u16() + 1;
+                jumped = true;
+                break;
+            }
+
+            case CPUOpcodeMnemonics::SBC:
+            {
+                sbc(mode);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::SEC:
+            {
+                set_flag(CpuFlags::Carry);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::SED:
+            {
+                set_flag(CpuFlags::Decimal_Mode);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::SEI:
+            {
+                set_flag(CpuFlags::Interrupt_Disable);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::STA:
+            {
+                sta(mode);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::STX:
+            {
+                auto addr = get_operand_address(mode);
+                mem_write(addr, register_x);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::STY:
+            {
+                auto addr = get_operand_address(mode);
+                mem_write(addr, register_y);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::TAX:
+            {
+                tax();
+                break;
+            }
+
+            case CPUOpcodeMnemonics::TAY:
+            {
+                register_y = register_a;
+                update_zero_and_negative_flags(register_y);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::TSX:
+            {
+                register_x = stack_pointer;
+                update_zero_and_negative_flags(register_x);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::TXA:
+            {
+                register_a = register_x;
+                update_zero_and_negative_flags(register_a);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::TXS:
+            {
+                stack_pointer = register_x;
+                break;
+            }
+
+            case CPUOpcodeMnemonics::TYA:
+            {
+                register_a = register_y;
+                update_zero_and_negative_flags(register_a);
+                break;
+            }
+
+            case CPUOpcodeMnemonics::BRK:
+            {
+                halted = true;
+                break;
+            }
+            }
+
+            if (!halted && !jumped)
+            {
+                program_counter += (len - 1);
+            }
+
+            if (page_crossed && adds_page_cycle(mnemonic))
+            {
+                ++cycles;
+            }
+
+            policy.after_instruction(*this, code, page_crossed);
+
+            if (halted)
+            {
+                stop_requested = false;
+                return Run_Halted;
+            }
+            if (stop_requested)
+            {
+                stop_requested = false;
+                return Run_Stopped;
+            }
+        }
+    }
+
+    // 常用策略在 CPU.cpp 里显式实例化，和其它 CPU 成员函数在同一编译单元，内联不受影响
+    class OpcodeProfiler;
+    class SamplingProfiler;
+    class Tracer;
+    class CoverageMap;
+
+    extern template RunExit CPU::run_with<NullPolicy>(NullPolicy &policy);
+    extern template RunExit CPU::run_with<OpcodeProfiler>(OpcodeProfiler &policy);
+    extern template RunExit CPU::run_with<SamplingProfiler>(SamplingProfiler &policy);
+    extern template RunExit CPU::run_with<Tracer>(Tracer &policy);
+    extern template RunExit CPU::run_with<CoverageMap>(CoverageMap &policy);
+
+    template <typename Predicate>
+    struct UntilPolicy
+    {
+        Predicate predicate;
+
+        void before_instruction(CPU &, Byte) {}
+
+        void after_instruction(CPU &cpu, Byte, bool)
+        {
+            if (predicate(static_cast<const CPU &>(cpu)))
+            {
+                cpu.request_stop();
+            }
+        }
+    };
+
+    /// 每条指令执行完后检查 predicate(const CPU &)，为 true 时停下（返回 Run_Stopped）。
+    /// 谓词按类型内联进执行循环，不经过 std::function：
+    ///
+    ///     run_until(cpu, [](const CPU &cpu) { return cpu.peek(0x00FF) != 0; });
+    template <typename Predicate>
+    RunExit run_until(CPU &cpu, Predicate predicate)
+    {
+        UntilPolicy<Predicate> policy = {predicate};
+
+        return cpu.run_with(policy);
+    }
+
+    template <typename Policy>
+    RunExit CPU::load_and_run_with(std::vector<Byte> &program, Policy &policy)
+    {
+        load(program);
+        reset();
+        return run_with(policy);
+    }
+}
+
+#endif // CPURUN_H
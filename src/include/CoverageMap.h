@@ -0,0 +1,73 @@
+#ifndef COVERAGEMAP_H
+#define COVERAGEMAP_H
+
+#include "CPU.h"
+#include "SimdDispatch.h"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace mysn
+{
+    /// PRG 地址空间（$8000-$FFFF）的执行覆盖位图，每个字节一位，取操作码时置位。
+    /// 作为 CPU::run_with 的插桩策略使用，不用时没有任何开销：
+    ///
+    ///     CoverageMap coverage;
+    ///     cpu.load_and_run_with(program, coverage);
+    ///     coverage.save("run.cov");
+    ///     coverage.write_summary(std::cout);
+    ///
+    /// 目前没有 mapper，按 8KB（最小的常见切换粒度）把 PRG 分成 4 个 bank 汇总。
+    /// 多次运行的位图可以用 merge 按位或合并。
+    class CoverageMap
+    {
+    public:
+        static const Address PRG_START = 0x8000;
+        static const std::size_t PRG_SIZE = 0x8000;
+        static const std::size_t BANK_SIZE = 0x2000;
+        static const std::size_t BANK_COUNT = PRG_SIZE / BANK_SIZE;
+        static const std::size_t BITMAP_BYTES = PRG_SIZE / 8;
+
+        CoverageMap();
+
+        void before_instruction(CPU &cpu, Byte)
+        {
+            std::uint32_t offset = std::uint32_t(cpu.program_counter) - PRG_START;
+
+            if (offset < PRG_SIZE)
+            {
+                bitmap[offset >> 3] |= Byte(1 << (offset & 7));
+            }
+        }
+
+        void after_instruction(CPU &, Byte, bool) {}
+
+        void clear();
+
+        bool covered(Address addr) const;
+        std::size_t covered_count() const;
+        std::size_t bank_covered_count(std::size_t bank) const;
+
+        const Byte *data() const;
+
+        // 按位或合并另一次运行的覆盖
+        void merge(const CoverageMap &other, SimdLevel level = detect_simd_level());
+
+        // 二进制格式：16 字节头（"MSCV"、版本、起始地址、字节数）后接位图，整数都是小端
+        bool save(const std::string &path) const;
+        // 文件头不匹配时返回 false，原有内容不变
+        bool load(const std::string &path);
+
+        // 每个 bank 的覆盖字节数和百分比
+        void write_summary(std::ostream &out) const;
+
+    private:
+        Byte bitmap[BITMAP_BYTES];
+    };
+
+    // dst[i] |= src[i]，count 任意
+    void merge_coverage_bits(Byte *dst, const Byte *src, std::size_t count, SimdLevel level = detect_simd_level());
+}
+
+#endif // COVERAGEMAP_H
@@ -0,0 +1,110 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include "CPU.h"
+#include <cstdint>
+#include <vector>
+
+namespace mysn
+{
+    enum WatchKind
+    {
+        Watch_Read = 1,
+        Watch_Write = 2,
+        // 写入的值与原值不同时才触发
+        Watch_Change = 4,
+    };
+
+    enum DebugStop
+    {
+        // 没有命中，run 是因为程序结束返回的
+        Debug_None,
+        Debug_Breakpoint,
+        Debug_Watchpoint,
+        Debug_Cycle_Limit,
+    };
+
+    /// PC 断点、内存观察点和周期上限，作为 CPU::run_with 的插桩策略使用：
+    ///
+    ///     Debugger debugger;
+    ///     debugger.add_breakpoint(0x8123);
+    ///     debugger.add_watchpoint(0x00FF, Watch_Change);
+    ///     debugger.run(cpu);
+    ///     if (debugger.stop_reason() == Debug_Watchpoint) ...
+    ///
+    /// 断点在每条指令执行完后检查新的 PC，先查 256 位的页位图，所在页没有断点时只多一次位测试。
+    /// 命中时 CPU 停在断点处、断点处的指令还没执行；从断点处继续 run 会先执行这条指令。
+    ///
+    /// 观察点不在执行循环里检查：run 期间 CPU 把有观察点的页从页表里摘掉，这些页的读写和
+    /// I/O 寄存器一样走 io_read/io_write 慢路径，在那里比对地址。命中后当前指令照常执行完再停下。
+    /// 读观察点对取指和取操作数同样生效。没有观察点的页、以及不经过 run 的执行都不受影响。
+    /// 内部 RAM 的观察点覆盖全部四个镜像（$00FF 也会被 $08FF、$10FF、$18FF 的读写触发），
+    /// stop_address 报告 $0000-$07FF 里的地址。
+    class Debugger
+    {
+    public:
+        Debugger();
+
+        void add_breakpoint(Address pc);
+        void remove_breakpoint(Address pc);
+        // kinds 为 WatchKind 的组合，重复添加时合并
+        void add_watchpoint(Address addr, int kinds);
+        void remove_watchpoint(Address addr);
+        // 清掉所有断点、观察点和周期上限
+        void clear();
+
+        // cycles 达到 limit 后停下，0 不限制
+        void set_cycle_limit(std::uint64_t limit);
+
+        // 执行到命中断点、观察点、周期上限或程序结束
+        RunExit run(CPU &cpu);
+
+        DebugStop stop_reason() const;
+        // 断点的 PC 或观察点的地址
+        Address stop_address() const;
+        // 触发观察点的指令所在的地址
+        Address stop_instruction() const;
+
+        void before_instruction(CPU &cpu, Byte)
+        {
+            instruction = cpu.program_counter;
+        }
+
+        void after_instruction(CPU &cpu, Byte, bool)
+        {
+            Address pc = cpu.program_counter;
+
+            if (reason == Debug_None && break_pages[pc >> 8] && breakpoints[pc])
+            {
+                stop(cpu, Debug_Breakpoint, pc);
+            }
+            else if (reason == Debug_None && cpu.cycles >= cycle_limit)
+            {
+                stop(cpu, Debug_Cycle_Limit, pc);
+            }
+        }
+
+        // 以下由 CPU 调用
+        bool page_watched(int page) const;
+        void on_read(CPU &cpu, Address addr);
+        void on_write(CPU &cpu, Address addr, Byte old_value, Byte data);
+
+    private:
+        // 每个地址一个字节：断点为 1，观察点为 WatchKind 的组合
+        std::vector<Byte> breakpoints;
+        std::vector<Byte> watchpoints;
+        // 每页有没有断点/观察点
+        Byte break_pages[256];
+        Byte watch_pages[256];
+        std::uint64_t cycle_limit;
+
+        DebugStop reason;
+        Address address;
+        Address instruction;
+
+        void stop(CPU &cpu, DebugStop reason, Address address);
+        void update_page(Byte *pages, const std::vector<Byte> &flags, int page);
+    };
+}
+
+#endif // DEBUGGER_H
@@ -0,0 +1,131 @@
+#ifndef DIVERGENCE_H
+#define DIVERGENCE_H
+
+#include "BatchCPU.h"
+#include "CPU.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace mysn
+{
+    // 对比用的完整状态
+    struct CoreState
+    {
+        Address program_counter;
+        Byte register_a;
+        Byte register_x;
+        Byte register_y;
+        Byte stack_pointer;
+        Byte status;
+        std::uint64_t cycles;
+        // 程序已经结束（BRK 或未知操作码）
+        bool halted;
+        // PC 处的 3 个字节，打印出问题的指令用
+        Byte instruction[3];
+        // 按 writable_offset 排列
+        Byte memory[WRITABLE_MEMORY_SIZE];
+    };
+
+    // 寄存器、周期、是否结束和全部可写内存的 FNV-1a（不含 instruction）
+    std::uint64_t core_state_hash(const CoreState &state);
+
+    /// 参与对比的一个核心。两个核心以周期数为共同的时间轴：run_to 执行到 cycles >= cycle_limit
+    /// 的第一个指令边界，所以只要两边的周期数一致，停下时执行过的指令也相同。
+    /// clone 用作检查点，二分时从检查点复制出来往前跑
+    class DivergenceCore
+    {
+    public:
+        virtual ~DivergenceCore() {}
+
+        virtual std::unique_ptr<DivergenceCore> clone() const = 0;
+        // 返回执行后程序是否还在运行，已经结束时什么也不做
+        virtual bool run_to(std::uint64_t cycle_limit) = 0;
+        virtual void capture(CoreState &state) const = 0;
+    };
+
+    // CPU::run_for 执行。设备不随 CPU 复制，clone 出来的核心不挂任何设备，所以只适合不挂设备的程序
+    class CPUCore : public DivergenceCore
+    {
+    public:
+        explicit CPUCore(const SharedRom &rom);
+        explicit CPUCore(const CPU &cpu);
+
+        std::unique_ptr<DivergenceCore> clone() const;
+        bool run_to(std::uint64_t cycle_limit);
+        void capture(CoreState &state) const;
+
+        CPU cpu;
+
+    private:
+        bool halted;
+    };
+
+    // 只有一个实例的 BatchCPU
+    class BatchCPUCore : public DivergenceCore
+    {
+    public:
+        explicit BatchCPUCore(const std::vector<Byte> &program);
+
+        std::unique_ptr<DivergenceCore> clone() const;
+        bool run_to(std::uint64_t cycle_limit);
+        void capture(CoreState &state) const;
+
+        BatchCPU batch;
+    };
+
+    /// 每隔 interval 个周期记一次状态哈希，和前一项一起再哈希一次，所以一旦出现差异，之后的每一项都不同。
+    /// 参考核心跑一遍记下来，之后验证别的核心时不必再跑参考核心，只比较每项 8 字节。
+    /// 文本格式：第一行 "mysn-hash-chain 1 <interval>"，之后每行一项，16 位十六进制
+    struct HashChain
+    {
+        std::uint64_t interval;
+        // 第 i 项是从开始执行了 (i + 1) * interval 个周期时的链值
+        std::vector<std::uint64_t> links;
+
+        bool save(const std::string &path) const;
+        bool load(const std::string &path);
+    };
+
+    // 执行到程序结束或 cycle_limit 为止，core 停在最后
+    HashChain record_hash_chain(DivergenceCore &core, std::uint64_t interval, std::uint64_t cycle_limit);
+
+    struct Divergence
+    {
+        // 没有找到差异时为 false，其余字段无意义
+        bool found;
+        // 两边都执行到 cycles >= cycle 时第一次不同；before 是两边相同的上一个状态，
+        // 下一条指令（before.instruction）执行后分别得到 reference 和 candidate
+        std::uint64_t cycle;
+        CoreState before;
+        CoreState reference;
+        CoreState candidate;
+    };
+
+    /// 两个核心从各自的当前状态（通常是刚复位）同步执行，每 interval 个周期比较一次完整状态，
+    /// 第一次不同时从上一个检查点二分到具体的指令：
+    ///
+    ///     CPUCore reference(make_rom(program));
+    ///     BatchCPUCore candidate(program);
+    ///     Divergence divergence = find_divergence(reference, candidate, 1 << 16, limit);
+    ///     if (divergence.found) write_divergence(std::cerr, divergence);
+    ///
+    /// 二分每一步从检查点复制两个核心往前跑，总共多执行大约 2 * interval 个周期。
+    /// 两边都结束或执行到 cycle_limit 仍相同时返回 found == false。
+    /// 执行结束后两个核心停在哪里没有规定
+    Divergence find_divergence(DivergenceCore &reference, DivergenceCore &candidate,
+                               std::uint64_t interval, std::uint64_t cycle_limit);
+
+    /// 同上，但参考核心的结果来自 record_hash_chain：先只跑 candidate，和链逐项比较找到第一个不同的检查点，
+    /// 再让两个核心都跑到它前一个检查点，在这一段里二分。reference 必须和记录链时从同一个状态开始。
+    /// candidate 比链更早结束、或者链记到的地方都一致时返回 found == false
+    Divergence find_divergence(DivergenceCore &reference, DivergenceCore &candidate, const HashChain &chain);
+
+    // 出问题的指令、两边的寄存器和每个不同的内存字节
+    void write_divergence(std::ostream &out, const Divergence &divergence);
+}
+
+#endif // DIVERGENCE_H
@@ -0,0 +1,144 @@
+#ifndef EXPLORER_H
+#define EXPLORER_H
+
+#include "CPU.h"
+#include "StateHash.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mysn
+{
+    class Joypad;
+
+    /// 定长的并发哈希集合，只存 64 位状态哈希，开放寻址 + CAS，插入不加锁。
+    ///
+    /// 内存在构造时一次分配（capacity 向上取 2 的幂，每个槽 8 字节）。装满 7/8 之后
+    /// 不再插入，insert 返回 false 并计入 dropped，已访问状态的数量因此有上界。
+    class StateHashSet
+    {
+    public:
+        explicit StateHashSet(std::size_t capacity);
+
+        // 第一次见到返回 true
+        bool insert(std::uint64_t hash);
+        bool contains(std::uint64_t hash) const;
+
+        std::size_t size() const;
+        std::size_t capacity() const;
+        std::uint64_t dropped() const;
+
+    private:
+        std::unique_ptr<std::atomic<std::uint64_t>[]> slots;
+        std::size_t mask;
+        std::size_t limit;
+        std::atomic<std::size_t> count;
+        std::atomic<std::uint64_t> rejected;
+
+        StateHashSet(const StateHashSet &);
+        StateHashSet &operator=(const StateHashSet &);
+    };
+
+    struct ExploreConfig
+    {
+        // 工作线程数，0 表示 std::thread::hardware_concurrency()
+        int threads;
+        // 每次扩展随机生成的输入帧数
+        std::size_t frames_per_step;
+        // 每个前沿状态尝试的输入序列个数
+        std::size_t sequences_per_state;
+        // 前沿最多保留的状态数，超出时丢掉新奇度最低的
+        std::size_t max_frontier;
+        // 已访问集合的槽数
+        std::size_t visited_capacity;
+        // 扩展的前沿状态总数上限
+        std::uint64_t max_expansions;
+        unsigned seed;
+        // 新奇度特征：这些地址上没见过（或很少见）的值得分高
+        std::vector<Address> features;
+        // 可选：返回 true 的状态记为 Explore_Goal
+        std::function<bool(const CPU &)> goal;
+
+        ExploreConfig();
+    };
+
+    enum ExploreEvent
+    {
+        // 程序执行了 BRK 或未知操作码
+        Explore_Halted,
+        // goal 返回 true
+        Explore_Goal,
+    };
+
+    struct ExploreFinding
+    {
+        ExploreEvent event;
+        std::uint64_t hash;
+        // 从根状态开始逐帧的按键，用同样的帧切分重放可以复现
+        std::vector<Byte> inputs;
+    };
+
+    /// 并行状态空间探索：维护一个按新奇度排序的存档前沿，工作线程取出得分最高的状态，
+    /// 用随机输入序列逐帧扩展，按 state_hash 在 StateHashSet 里去重，新状态放回前沿。
+    ///
+    ///     ExploreConfig config;
+    ///     config.features = {0x0010, 0x0011};  // 例如房间号、坐标
+    ///     config.goal = [](const CPU &cpu) { return cpu.peek(0x0010) == 7; };
+    ///     Explorer explorer(cpu, config);
+    ///     explorer.run();
+    ///
+    /// 存档就是 CPU 的副本（约 10.5KB 可写内存，ROM 共享不复制），内存上界约为 max_frontier 份存档加已访问集合。
+    /// 只复制 CPU 和内存，根状态上挂的 APU/PPU 不参与探索；每个工作线程有自己的手柄（port 0）。
+    /// goal 会在多个工作线程里同时调用，只能读取传入的 CPU。
+    /// 帧按 CYCLES_PER_FRAME 切分，与 ForkServer 一致。
+    class Explorer
+    {
+    public:
+        // joypad 为根状态 port 0 上手柄的当前状态，为空时按刚上电处理
+        Explorer(const CPU &root, const ExploreConfig &config, const Joypad *joypad = nullptr);
+        ~Explorer();
+
+        // 扩展到 max_expansions 或前沿为空
+        void run();
+
+        std::uint64_t expansions() const;
+        std::size_t visited() const;
+        std::size_t frontier_size() const;
+        std::vector<ExploreFinding> findings() const;
+
+    private:
+        struct Node;
+        struct Worker;
+
+        ExploreConfig config;
+        StateHashSet seen;
+        // 每个特征 256 个值的出现次数
+        std::unique_ptr<std::atomic<std::uint32_t>[]> feature_counts;
+
+        mutable std::mutex lock;
+        std::condition_variable wake;
+        std::multimap<double, std::shared_ptr<const Node>> frontier;
+        std::vector<ExploreFinding> found;
+        std::uint64_t started;
+        std::atomic<std::uint64_t> finished;
+        int busy;
+
+        Explorer(const Explorer &);
+        Explorer &operator=(const Explorer &);
+
+        void worker_loop(unsigned seed);
+        std::shared_ptr<const Node> take();
+        void expand(Worker &worker, const Node &node);
+        double novelty(const CPU &cpu);
+        void push(std::shared_ptr<const Node> node, double score);
+        void report(ExploreEvent event, std::uint64_t hash, const std::vector<Byte> &inputs);
+    };
+}
+
+#endif // EXPLORER_H
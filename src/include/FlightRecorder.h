@@ -0,0 +1,100 @@
+#ifndef FLIGHTRECORDER_H
+#define FLIGHTRECORDER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace mysn
+{
+    // 一条指令执行前的状态，16 字节；pc 到 sp 的布局和 record 里拼的 64 位字一致（小端）
+    struct FlightRecord
+    {
+        std::uint64_t cycles;
+        std::uint16_t pc;
+        std::uint8_t opcode;
+        std::uint8_t a;
+        std::uint8_t x;
+        std::uint8_t y;
+        std::uint8_t status;
+        std::uint8_t sp;
+    };
+
+    /// 最近 N 条指令的环形记录，CPU 每条指令写一条，只有几次普通的存储，不做格式化。
+    ///
+    /// 以下情况把记录按时间顺序写出来：
+    ///   - 遇到未知操作码或不支持的寻址模式（fault）
+    ///   - install_crash_handler 之后收到 SIGSEGV/SIGBUS/SIGILL/SIGFPE/SIGABRT
+    ///   - 手动调用 dump
+    ///
+    /// 写出用的是 write(2) 和手写的十六进制转换，可以在信号处理函数里调用。
+    class FlightRecorder
+    {
+    public:
+        // 单独的 CPU 默认留最近 2048 条（32KB），够回答“怎么走到这里的”。
+        // 大量实例的场合（InstancePool、Explorer 的存档）各自用小得多的记录
+        static const std::size_t DEFAULT_CAPACITY = 2048;
+
+        explicit FlightRecorder(std::size_t capacity = DEFAULT_CAPACITY);
+        // 用调用者提供的 capacity 条存储（capacity 须为 2 的幂，记录器存在期间有效），不分配内存。
+        // 这样的记录器不登记到崩溃处理函数，fault 和 dump 照常写出；复制出来的记录器改用自己的存储
+        FlightRecorder(FlightRecord *buffer, std::size_t capacity);
+        FlightRecorder(const FlightRecorder &other);
+        FlightRecorder &operator=(const FlightRecorder &other);
+        ~FlightRecorder();
+
+        void record(std::uint16_t pc, std::uint8_t opcode, std::uint8_t a, std::uint8_t x, std::uint8_t y,
+                    std::uint8_t status, std::uint8_t sp, std::uint64_t cycles)
+        {
+            // 拼成一个 64 位字，两次存储写完一条记录
+            std::uint64_t state = std::uint64_t(pc) | std::uint64_t(opcode) << 16 | std::uint64_t(a) << 24 |
+                                  std::uint64_t(x) << 32 | std::uint64_t(y) << 40 |
+                                  std::uint64_t(status) << 48 | std::uint64_t(sp) << 56;
+            FlightRecord &r = data[next & mask];
+            r.cycles = cycles;
+            std::memcpy(&r.pc, &state, sizeof(state));
+            ++next;
+        }
+
+        // 容量取不小于 capacity 的 2 的幂，已有记录清空，之后用自己分配的存储
+        void set_capacity(std::size_t capacity);
+        std::size_t capacity() const;
+        std::uint64_t total_recorded() const;
+        void clear();
+
+        // 按时间顺序的记录，最早的在前
+        std::vector<FlightRecord> snapshot() const;
+
+        // fault 和崩溃时写到哪里：fd < 0 表示不写，默认是标准错误
+        void set_dump_fd(int fd);
+        int dump_fd() const;
+
+        void dump(int fd, const char *reason) const;
+        void dump(std::FILE *file, const char *reason) const;
+        // 异常路径调用：写到 dump_fd
+        void fault(const char *reason) const;
+
+        // 安装致命信号的处理函数，崩溃时写出所有存活的记录器，然后按默认方式结束进程
+        static void install_crash_handler();
+
+    private:
+        // 自己分配的存储，用调用者的存储时为空
+        std::vector<FlightRecord> records;
+        FlightRecord *data;
+        std::uint64_t mask;
+        std::uint64_t next;
+        int fd;
+        // fault 时已经写出的位置，之后的 abort 不再重复写
+        mutable std::uint64_t faulted_at;
+        // 是否占了崩溃处理函数的一个槽位
+        bool registered;
+
+        void register_instance();
+        void unregister_instance();
+        static void crash_handler(int signal);
+    };
+}
+
+#endif // FLIGHTRECORDER_H
@@ -0,0 +1,90 @@
+#ifndef FORKSERVER_H
+#define FORKSERVER_H
+
+#include "CPU.h"
+#include "StateHash.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mysn
+{
+    class Joypad;
+
+    enum ForkOutcome
+    {
+        // 所有输入帧都跑完了
+        Fork_Completed,
+        // 程序在输入用完前结束（BRK 或未知操作码）
+        Fork_Halted,
+        // 子进程被信号终止
+        Fork_Crashed,
+        // fork/pipe 失败，或子进程没有写回结果
+        Fork_Failed,
+    };
+
+    // 子进程通过管道写回的结果，定长、不含指针
+    struct ForkResult
+    {
+        ForkOutcome outcome;
+        int signal;
+        std::uint32_t frames;
+        std::uint64_t cycles;
+        Address program_counter;
+        Byte register_a;
+        Byte register_x;
+        Byte register_y;
+        Byte status;
+        Byte stack_pointer;
+        // $0000-$07FF 的 FNV-1a
+        std::uint64_t ram_hash;
+    };
+
+    /// AFL 式的 fork server（仅 Linux/POSIX）：父进程先把模拟器推进到感兴趣的位置，
+    /// 之后每个测试用例 fork 一个子进程，初始化好的状态由内核写时复制共享，
+    /// 子进程只执行输入的尾部，结果通过管道写回。
+    ///
+    ///     ForkServer server(cpu, &joypad);
+    ///     server.run_to_frame(600);
+    ///     std::vector<ForkResult> results = server.run_cases(cases, 8);
+    ///
+    /// 一个用例是逐帧的按键（每字节一帧，见 JoypadButton）。CPU、手柄和挂接的设备都在
+    /// 父进程里，子进程对它们的修改不会影响父进程和其它用例。
+    class ForkServer
+    {
+    public:
+        ForkServer(CPU &cpu, Joypad *joypad);
+
+        // 在父进程里执行到 program_counter == pc（该指令尚未执行）；
+        // 程序先结束或超过 max_cycles 时返回 false
+        bool run_to_pc(Address pc, std::uint64_t max_cycles);
+        // 在父进程里执行到第 frame 帧开始；程序先结束时返回 false
+        bool run_to_frame(std::uint64_t frame);
+        std::uint64_t frame() const;
+
+        ForkResult run_case(const std::vector<Byte> &inputs);
+        // 最多同时运行 parallel 个子进程，结果按用例顺序返回
+        std::vector<ForkResult> run_cases(const std::vector<std::vector<Byte>> &cases, int parallel);
+
+    private:
+        struct Child
+        {
+            int pid;
+            int fd;
+            std::size_t index;
+        };
+
+        CPU &cpu;
+        Joypad *joypad;
+
+        // 执行到 cycle_limit 或 pc；程序自己结束时返回 false
+        bool run_until(std::uint64_t cycle_limit, bool stop_at_pc, Address pc);
+
+        Child spawn(const std::vector<Byte> &inputs, std::size_t index, ForkResult &failed);
+        ForkResult collect(const Child &child);
+        // 子进程里执行
+        ForkResult execute(const std::vector<Byte> &inputs);
+    };
+}
+
+#endif // FORKSERVER_H
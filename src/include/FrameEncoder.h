@@ -0,0 +1,102 @@
+#ifndef FRAMEENCODER_H
+#define FRAMEENCODER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mysn
+{
+    enum FrameFormat
+    {
+        Frame_Raw_RGB,
+        Frame_Y4M,
+        Frame_PNG,
+    };
+
+    // 把一帧 RGB24（逐行、无填充）写到磁盘。只在写盘线程里调用
+    class FrameEncoder
+    {
+    public:
+        virtual ~FrameEncoder() {}
+
+        virtual bool is_open() const = 0;
+        virtual void write_frame(const std::uint8_t *rgb) = 0;
+        virtual void close() {}
+    };
+
+    // 所有帧首尾相接写进同一个文件，可用 ffmpeg -f rawvideo -pix_fmt rgb24 读取
+    class RawRgbEncoder : public FrameEncoder
+    {
+    public:
+        RawRgbEncoder(const std::string &path, int width, int height);
+        ~RawRgbEncoder();
+
+        bool is_open() const;
+        void write_frame(const std::uint8_t *rgb);
+        void close();
+
+    private:
+        std::FILE *file;
+        std::size_t frame_bytes;
+
+        RawRgbEncoder(const RawRgbEncoder &);
+        RawRgbEncoder &operator=(const RawRgbEncoder &);
+    };
+
+    /// YUV4MPEG2 https://wiki.multimedia.cx/index.php/YUV4MPEG2
+    ///
+    /// 4:2:0 全范围 BT.601，帧率为 NTSC 的 39375000/655171 ≈ 60.0988。
+    class Y4mEncoder : public FrameEncoder
+    {
+    public:
+        Y4mEncoder(const std::string &path, int width, int height);
+        ~Y4mEncoder();
+
+        bool is_open() const;
+        void write_frame(const std::uint8_t *rgb);
+        void close();
+
+    private:
+        std::FILE *file;
+        int width;
+        int height;
+        // Y、U、V 三个平面连续存放，构造时分配
+        std::vector<std::uint8_t> planes;
+
+        Y4mEncoder(const Y4mEncoder &);
+        Y4mEncoder &operator=(const Y4mEncoder &);
+    };
+
+    // 每帧一个文件：<prefix>_000000.png、<prefix>_000001.png ...
+    // 有 zlib 时用最快档压缩，没有时写不压缩的 stored 块
+    class PngEncoder : public FrameEncoder
+    {
+    public:
+        PngEncoder(const std::string &prefix, int width, int height);
+
+        bool is_open() const;
+        void write_frame(const std::uint8_t *rgb);
+
+    private:
+        std::string prefix;
+        int width;
+        int height;
+        std::uint32_t index;
+        bool failed;
+        // 每行前加一个滤波类型字节后的原始数据
+        std::vector<std::uint8_t> scanlines;
+        std::vector<std::uint8_t> compressed;
+        std::vector<char> path;
+
+        std::size_t deflate();
+    };
+
+    std::unique_ptr<FrameEncoder> make_frame_encoder(FrameFormat format, const std::string &path,
+                                                     int width, int height);
+}
+
+#endif // FRAMEENCODER_H
@@ -0,0 +1,92 @@
+#ifndef FRAMERECORDER_H
+#define FRAMERECORDER_H
+
+#include "FrameEncoder.h"
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace mysn
+{
+    /// 单生产者单消费者的帧缓冲环，所有帧缓冲在构造时一次分配并循环复用。
+    ///
+    /// head 只由生产者写、tail 只由消费者写，两端各自用 acquire/release 同步，不加锁。
+    class FrameRing
+    {
+    public:
+        FrameRing(std::size_t frame_bytes, std::size_t capacity);
+
+        std::size_t frame_bytes() const;
+        std::size_t capacity() const;
+
+        // 生产者：取下一块空闲缓冲，环满时返回 nullptr
+        std::uint8_t *acquire();
+        void publish();
+
+        // 消费者：取最早的一帧，环空时返回 nullptr
+        const std::uint8_t *front();
+        void release();
+
+    private:
+        std::size_t bytes;
+        std::size_t slots;
+        std::vector<std::uint8_t> storage;
+
+        // 两个计数器分开放在不同缓存行，避免生产者和消费者互相抢同一行
+        char pad0[64];
+        std::atomic<std::size_t> head;
+        char pad1[64];
+        std::atomic<std::size_t> tail;
+        char pad2[64];
+
+        FrameRing(const FrameRing &);
+        FrameRing &operator=(const FrameRing &);
+    };
+
+    enum FramePolicy
+    {
+        // 写盘跟不上时模拟线程等待空闲缓冲
+        Block_When_Full,
+        // 写盘跟不上时丢掉新帧，模拟不受影响
+        Drop_When_Full,
+    };
+
+    /// 录像：模拟线程填帧，后台线程交给 FrameEncoder 写盘。
+    ///
+    ///     uint8_t *rgb = recorder.begin_frame();
+    ///     if (rgb != nullptr) { /* 填 width*height*3 字节 */ recorder.end_frame(); }
+    class FrameRecorder
+    {
+    public:
+        FrameRecorder(std::unique_ptr<FrameEncoder> encoder, int width, int height,
+                      FramePolicy policy = Block_When_Full, std::size_t capacity = 8);
+        ~FrameRecorder();
+
+        std::uint8_t *begin_frame();
+        void end_frame();
+        // 写完已提交的帧后结束写盘线程
+        void close();
+
+        std::uint64_t frames_written() const;
+        std::uint64_t frames_dropped() const;
+
+    private:
+        FrameRing ring;
+        std::unique_ptr<FrameEncoder> encoder;
+        FramePolicy policy;
+        std::atomic<bool> stopping;
+        std::atomic<std::uint64_t> written;
+        std::atomic<std::uint64_t> dropped;
+        std::thread writer;
+
+        FrameRecorder(const FrameRecorder &);
+        FrameRecorder &operator=(const FrameRecorder &);
+
+        void writer_loop();
+    };
+}
+
+#endif // FRAMERECORDER_H
@@ -0,0 +1,72 @@
+#ifndef INSTANCEPOOL_H
+#define INSTANCEPOOL_H
+
+#include "CPU.h"
+#include "Joypad.h"
+#include "PPU.h"
+#include <cstddef>
+
+namespace mysn
+{
+    /// 池里的一个实例：CPU 挂着自己的 PPU 和 port 0 的手柄
+    struct PoolInstance
+    {
+        CPU cpu;
+        PPU ppu;
+        Joypad joypad;
+
+        // 指令记录放在 recorder_buffer 里，RECORDER_CAPACITY 条
+        explicit PoolInstance(FlightRecord *recorder_buffer);
+    };
+
+    /// 固定数量的实例，连同复位用的快照一起放在一整块内存里，给频繁开局、结束的场合用：
+    ///
+    ///     InstancePool pool(4096, make_rom(program));
+    ///     pool.instance(0).cpu.run_for(budget);    // 开机跑一段
+    ///     pool.set_snapshot(pool.instance(0));     // 以后都从这里开始
+    ///     for (;;)
+    ///     {
+    ///         pool.instance(i).joypad.set_buttons(buttons);
+    ///         pool.instance(i).cpu.run_for(budget);
+    ///         if (...) pool.reset(i);
+    ///     }
+    ///
+    /// 内存在构造时一次分配（Linux 上是按 2MB 对齐的匿名映射，并建议内核用大页），
+    /// 实例的指令记录也放在这块内存里，不登记到崩溃处理函数（实例数量不受 64 个槽位限制）。
+    /// 之后的执行和 reset 都不分配内存：reset 用 CPU::restore 拷回 10.5KB 的可写内存和寄存器，
+    /// ROM 只是换回共享的那一份。实例地址在池存在期间不变。
+    class InstancePool
+    {
+    public:
+        // 每个实例的指令记录条数（1KB，单独的 CPU 默认 32KB），须为 2 的幂
+        static const std::size_t RECORDER_CAPACITY = 64;
+
+        // 所有实例和快照都装载 rom 并复位（上电状态）；count 大到放不下时抛 std::bad_alloc
+        InstancePool(std::size_t count, const SharedRom &rom);
+        ~InstancePool();
+
+        std::size_t size() const;
+        PoolInstance &instance(std::size_t index);
+        const PoolInstance &instance(std::size_t index) const;
+
+        // 以 state 的当前状态作为之后 reset 的起点，state 可以是池里的实例
+        void set_snapshot(const PoolInstance &state);
+        const PoolInstance &snapshot() const;
+
+        void reset(std::size_t index);
+        void reset_all();
+
+    private:
+        std::size_t count;
+        // count 个实例之后紧跟快照，再之后是它们的指令记录
+        PoolInstance *instances;
+        FlightRecord *records;
+        void *arena;
+        std::size_t arena_size;
+
+        InstancePool(const InstancePool &);
+        InstancePool &operator=(const InstancePool &);
+    };
+}
+
+#endif // INSTANCEPOOL_H
@@ -0,0 +1,51 @@
+#ifndef JOYPAD_H
+#define JOYPAD_H
+
+#include "CPU.h"
+#include <cstddef>
+
+namespace mysn
+{
+    // 按 $4016/$4017 移位输出的顺序排列
+    enum JoypadButton
+    {
+        Button_A = 0b00000001,
+        Button_B = 0b00000010,
+        Button_Select = 0b00000100,
+        Button_Start = 0b00001000,
+        Button_Up = 0b00010000,
+        Button_Down = 0b00100000,
+        Button_Left = 0b01000000,
+        Button_Right = 0b10000000,
+    };
+
+    /// 标准手柄 http://wiki.nesdev.com/w/index.php/Standard_controller
+    ///
+    /// 写 $4016 的第 0 位为 1 时持续锁存按键状态，置 0 后每读一次移出一位，
+    /// 8 位读完之后一直读到 1。读出的高位是开路总线，这里固定为 $40。
+    class Joypad
+    {
+    public:
+        // save_state 写出的字节数
+        static const std::size_t STATE_SIZE = 3;
+
+        Joypad();
+
+        void set_buttons(Byte buttons);
+        Byte buttons() const;
+
+        void write(Byte data);
+        Byte read();
+
+        // 按键、移位寄存器和 strobe，存档用
+        void save_state(Byte *data) const;
+        void load_state(const Byte *data);
+
+    private:
+        Byte state;
+        Byte shift;
+        bool strobe;
+    };
+}
+
+#endif // JOYPAD_H
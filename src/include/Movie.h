@@ -0,0 +1,158 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include "CPU.h"
+#include "Joypad.h"
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mysn
+{
+    class ThreadPool;
+
+    struct MovieFrame
+    {
+        // 两个手柄在这一帧按下的键，JoypadButton 的组合
+        Byte port0;
+        Byte port1;
+        // 这一帧结束时的 state_hash，has_hash 为 false 时不检查
+        bool has_hash;
+        std::uint64_t hash;
+    };
+
+    /// 逐帧的手柄输入录像，可选地带每帧结束时的状态哈希。文本格式，一行一项：
+    ///
+    ///     mysn-movie 1
+    ///     # 注释
+    ///     title 1-1 any%
+    ///     |.......A|........|9c1f0e3b5a7d2468
+    ///     |R......A|........|
+    ///
+    /// 第一行是格式版本。"|" 开头的是帧，两个手柄各 8 个字符，按 RLDUTSBA（右左下上、
+    /// Start、Select、B、A）的顺序，"." 表示没按；最后是 16 位十六进制的哈希，可以为空。
+    /// 其余的行是元数据，第一个空格前是键，之后是值，按出现顺序保存。
+    class Movie
+    {
+    public:
+        std::vector<std::pair<std::string, std::string>> metadata;
+        std::vector<MovieFrame> frames;
+
+        // 没有这个键时返回空串
+        std::string get(const std::string &key) const;
+        // 已有的键替换值，否则加在最后
+        void set(const std::string &key, const std::string &value);
+
+        // 格式不对时返回 false，原有内容不变
+        bool read(std::istream &in);
+        void write(std::ostream &out) const;
+
+        bool load(const std::string &path);
+        bool save(const std::string &path) const;
+    };
+
+    enum ReplayStatus
+    {
+        // 所有帧都回放完了，哈希都一致
+        Replay_Completed,
+        Replay_Mismatch,
+        // 程序在录像结束前停下了（BRK 或未知操作码）
+        Replay_Halted,
+    };
+
+    struct ReplayResult
+    {
+        ReplayStatus status;
+        // 回放完的帧数；不一致或停下时是出问题的那一帧的下标
+        std::size_t frame;
+        // 出问题时的 PC 和哈希
+        Address program_counter;
+        std::uint64_t expected_hash;
+        std::uint64_t actual_hash;
+    };
+
+    /// 回放到某一帧开始前的完整状态：寄存器、周期、可写内存和两个手柄（见 MovieReplayer::save_state）。
+    /// 不含 ROM，恢复时用正在验证的那个版本的 ROM
+    struct MovieCheckpoint
+    {
+        // 已经回放完的帧数
+        std::size_t frame;
+        std::vector<Byte> state;
+    };
+
+    // 检查点和录像分开存放，习惯上放在录像旁边，文件名加 .ckpt。二进制格式，状态大小不对时读取失败，原有内容不变
+    bool save_checkpoints(const std::string &path, const std::vector<MovieCheckpoint> &checkpoints);
+    bool load_checkpoints(const std::string &path, std::vector<MovieCheckpoint> &checkpoints);
+
+    /// 不渲染、不出声，以最快速度回放录像：
+    ///
+    ///     MovieReplayer replayer(cpu, &joypad, nullptr);
+    ///     ReplayResult result = replayer.verify(movie);
+    ///     if (result.status == Replay_Mismatch) ...
+    ///
+    /// 每帧先设置按键，再用 CPU::run_for 执行到下一个帧边界（与 ForkServer、Explorer 的帧划分一致），
+    /// 然后比较 state_hash。CPU 从调用时的状态开始执行，通常是刚复位。只挂手柄时没有渲染和音频开销，
+    /// 挂了 APU 就照常合成。没挂的手柄口忽略录像里的按键。
+    ///
+    /// 哈希只能说明哪一帧不同；要看具体差在哪，用正确的版本回放到同一帧（run 的 frames 参数），
+    /// 再用 write_state_diff 对比两边的状态。
+    class MovieReplayer
+    {
+    public:
+        // save_state 的字节数
+        static const std::size_t STATE_SIZE = 16 + WRITABLE_MEMORY_SIZE + 2 * Joypad::STATE_SIZE;
+
+        MovieReplayer(CPU &cpu, Joypad *port0, Joypad *port1);
+
+        // 回放全部帧，遇到第一个不一致的哈希就停下
+        ReplayResult verify(const Movie &movie);
+        // 从 CPU 的当前状态开始回放 [begin, end) 帧，CPU 应当处在已回放完 begin 帧的状态
+        ReplayResult verify(const Movie &movie, std::size_t begin, std::size_t end);
+        // 只回放前 frames 帧，不检查哈希
+        ReplayResult run(const Movie &movie, std::size_t frames);
+        // 回放全部帧，把每帧结束时的哈希写进 movie
+        ReplayResult record(Movie &movie);
+        // 同上，另外在第 0、interval、2 * interval…… 帧开始前和最后一帧结束后各存一个检查点。
+        // interval 为 0 时不存
+        ReplayResult record(Movie &movie, std::size_t interval, std::vector<MovieCheckpoint> &checkpoints);
+
+        // CPU（不含 ROM 和指令记录）和挂着的手柄的状态，也记下挂了哪几个手柄口
+        std::vector<Byte> save_state() const;
+        // 大小不对或挂的手柄口和存档时不同时返回 false，不做任何修改
+        bool load_state(const std::vector<Byte> &state);
+
+    private:
+        CPU &cpu;
+        Joypad *port0;
+        Joypad *port1;
+
+        // 执行一帧，程序停下时返回 false
+        bool run_frame(const MovieFrame &frame);
+    };
+
+    /// 按检查点把录像分段，在 pool 上并行验证：
+    ///
+    ///     std::vector<MovieCheckpoint> checkpoints;
+    ///     recorder.record(movie, 3600, checkpoints);    // 录制时每分钟存一个
+    ///     ...
+    ///     ReplayResult result = verify_segments(movie, checkpoints, rom, pool);
+    ///
+    /// 相邻两个检查点之间是一段。每段用自己的 CPU 和手柄（按检查点记下的手柄口挂接）装载 rom，
+    /// 从前一个检查点的状态开始回放，检查每帧的哈希，最后确认到达的状态和后一个检查点完全一致。
+    /// 各段互不依赖，耗时大致随线程数线性下降。第一个检查点之前和最后一个之后的帧不检查。
+    ///
+    /// 返回帧下标最小的问题，和从头 verify 找到的相同（前面的段都通过时）。段末状态和检查点不一致时
+    /// frame 是段的最后一帧，哈希是两边 save_state 的 FNV-1a；检查点无法恢复时在它那一帧报 Replay_Mismatch，
+    /// 哈希为 0。全部通过时 frame 是最后一个检查点的帧数
+    ReplayResult verify_segments(const Movie &movie, const std::vector<MovieCheckpoint> &checkpoints,
+                                 const SharedRom &rom, ThreadPool &pool);
+
+    // 寄存器逐个列出不同的，RAM（$0000-$07FF）每个不同的字节一行，完全相同时写 "identical"
+    void write_state_diff(std::ostream &out, const CPU &expected, const CPU &actual);
+}
+
+#endif // MOVIE_H
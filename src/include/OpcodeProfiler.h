@@ -0,0 +1,57 @@
+#ifndef OPCODEPROFILER_H
+#define OPCODEPROFILER_H
+
+#include "CPU.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace mysn
+{
+    /// 按操作码统计的执行剖析，作为 CPU::run_with 的插桩策略使用：
+    ///
+    ///     OpcodeProfiler profiler;
+    ///     cpu.load_and_run_with(program, profiler);
+    ///     profiler.dump("profile.json");
+    ///
+    /// 计数都放在以操作码为下标的平坦数组里，每条指令只有几次加法。
+    /// 周期数是指令前后 cpu.cycles 的差，包括 OAM DMA 之类由指令引起的挂起。
+    class OpcodeProfiler
+    {
+    public:
+        OpcodeProfiler();
+
+        void before_instruction(CPU &cpu, Byte)
+        {
+            start_cycles = cpu.cycles;
+        }
+
+        void after_instruction(CPU &cpu, Byte code, bool page_crossed)
+        {
+            ++counts[code];
+            cycle_totals[code] += cpu.cycles - start_cycles;
+            page_crosses[code] += page_crossed;
+        }
+
+        void clear();
+
+        std::uint64_t count(Byte code) const;
+        std::uint64_t cycles(Byte code) const;
+        std::uint64_t page_cross_count(Byte code) const;
+        std::uint64_t total_instructions() const;
+
+        // 按执行次数降序的文本报告，末尾附按寻址模式的汇总
+        void write_report(std::ostream &out) const;
+        void write_json(std::ostream &out) const;
+        // 路径以 .json 结尾写 JSON，否则写文本报告
+        bool dump(const std::string &path) const;
+
+    private:
+        std::uint64_t counts[256];
+        std::uint64_t cycle_totals[256];
+        std::uint64_t page_crosses[256];
+        std::uint64_t start_cycles;
+    };
+}
+
+#endif // OPCODEPROFILER_H
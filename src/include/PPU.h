@@ -0,0 +1,33 @@
+#ifndef PPU_H
+#define PPU_H
+
+#include "CPU.h"
+
+namespace mysn
+{
+    /// # PPU 寄存器 ($2000-$3FFF，每 8 字节镜像) http://wiki.nesdev.com/w/index.php/PPU_registers
+    ///
+    /// 目前只实现精灵属性内存（OAM）：OAMADDR($2003)、OAMDATA($2004) 以及 $4014 的 OAM DMA，
+    /// 其余寄存器只锁存最后一次写入的值。
+    class PPU
+    {
+    public:
+        PPU();
+
+        // 256 字节，64 个精灵 × 4 字节
+        Byte oam[256];
+        Byte oam_address;
+        Byte registers[8];
+
+        void reset();
+
+        void write_register(Address addr, Byte data);
+        Byte read_register(Address addr);
+
+        void write_oam_data(Byte data);
+        // 把 CPU 的一整页拷进 OAM，从 OAMADDR 开始回绕，结束后 OAMADDR 不变
+        void oam_dma(const Byte *page);
+    };
+}
+
+#endif // PPU_H
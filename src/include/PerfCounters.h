@@ -0,0 +1,75 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <cstdint>
+#include <string>
+
+namespace mysn
+{
+    enum PerfCounter
+    {
+        Perf_Cycles,
+        Perf_Instructions,
+        Perf_Branch_Misses,
+        Perf_L1d_Misses,
+        Perf_LLC_Misses,
+        PERF_COUNTER_COUNT,
+    };
+
+    // 计数器名字，和 perf stat 的事件名一致
+    const char *perf_counter_name(PerfCounter counter);
+
+    // 一段被测区间的宿主机计数
+    struct PerfSample
+    {
+        // 打不开或者这段时间没被调度上 PMU 的计数器为 false
+        bool valid[PERF_COUNTER_COUNT];
+        // 被多路复用时已按 enabled / running 的比例放大
+        std::uint64_t values[PERF_COUNTER_COUNT];
+
+        bool has(PerfCounter counter) const { return valid[counter]; }
+
+        // 宿主机每周期指令数，缺少计数时为负数
+        double ipc() const;
+        // 每条模拟指令平均的事件数，缺少计数或 emulated 为 0 时为负数
+        double per_instruction(PerfCounter counter, std::uint64_t emulated) const;
+    };
+
+    /// 用 Linux 的 perf_event_open 在被测区间前后读宿主机的硬件计数：
+    ///
+    ///     PerfCounters counters;
+    ///     counters.start();
+    ///     cpu.run();
+    ///     PerfSample sample = counters.stop();
+    ///     if (sample.has(Perf_Branch_Misses)) ...
+    ///
+    /// 只统计本线程的用户态。每个计数器单独打开而不是编成一组，虚拟机或容器里只缺某几个时
+    /// 其余的照常工作；一个也打不开（非 Linux、没有 PMU、perf_event_paranoid 太高）时
+    /// available() 为 false，error() 说明原因，start/stop 照常调用，stop 返回全部无效的结果
+    class PerfCounters
+    {
+    public:
+        PerfCounters();
+        ~PerfCounters();
+
+        // 至少有一个计数器可用
+        bool available() const;
+        bool available(PerfCounter counter) const;
+        // 打开失败的原因，全部打开时为空
+        const std::string &error() const;
+
+        // 清零并开始计数
+        void start();
+        // 停止计数并读出从 start 到现在的值
+        PerfSample stop();
+
+    private:
+        int fds[PERF_COUNTER_COUNT];
+        std::string reason;
+
+        PerfCounters(const PerfCounters &);
+        PerfCounters &operator=(const PerfCounters &);
+    };
+}
+
+#endif // PERFCOUNTERS_H
@@ -0,0 +1,50 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include "SimdDispatch.h"
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace mysn
+{
+    /// 多相 FIR 重采样，输入输出采样率任意（例如 APU 周期的 894886Hz -> 48000Hz）。
+    ///
+    /// 每次 process 最多接受 block_size 个输入，全部缓冲在构造时分配，稳态下不再分配内存。
+    /// 滤波器系数只与采样率有关，相同参数的实例共享同一份只读系数表。
+    class Resampler
+    {
+    public:
+        static const int PHASE_BITS = 8;
+        static const int PHASE_COUNT = 1 << PHASE_BITS;
+
+        Resampler(double input_rate, double output_rate, std::size_t block_size,
+                  SimdLevel level = detect_simd_level());
+
+        std::size_t block_size() const;
+        // 一次 process 最多产生的输出个数
+        std::size_t max_output() const;
+        std::size_t taps() const;
+
+        std::size_t process(const float *input, std::size_t count, float *output);
+        void reset();
+
+    private:
+        struct Kernel;
+
+        std::shared_ptr<const Kernel> kernel;
+        SimdLevel level;
+        // 每个输出采样前进的输入采样数，32.32 定点
+        std::uint64_t step;
+        // 下一个输出在 history 中的位置，32.32 定点
+        std::uint64_t position;
+        std::size_t block;
+        std::size_t filled;
+        std::vector<float> history;
+
+        static std::shared_ptr<const Kernel> shared_kernel(double input_rate, double output_rate);
+    };
+}
+
+#endif // RESAMPLER_H
@@ -0,0 +1,117 @@
+#ifndef SAMPLINGPROFILER_H
+#define SAMPLINGPROFILER_H
+
+#include "CPU.h"
+#include "SymbolTable.h"
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace mysn
+{
+    /// 采样式热点/调用图剖析，作为 CPU::run_with 的插桩策略使用。
+    ///
+    /// 每经过 interval 个 CPU 周期记录一次当前指令地址和影子调用栈。
+    /// 影子栈在 JSR 时压入目标地址，在两条指令之间 PC 不连续（IRQ/NMI 进入）时压入中断帧；
+    /// 栈指针回到帧建立前的位置（RTS、RTI 或程序自己改栈）时弹出。
+    ///
+    /// write_folded 的输出每行是 "reset;main;sub_8123 42"，可以直接交给 flamegraph.pl。
+    class SamplingProfiler
+    {
+    public:
+        static const std::size_t MAX_DEPTH = 128;
+
+        explicit SamplingProfiler(std::uint64_t interval = 1000);
+
+        void before_instruction(CPU &cpu, Byte code)
+        {
+            if (cpu.program_counter != expected_pc)
+            {
+                enter_discontinuity(cpu);
+            }
+
+            pc = cpu.program_counter;
+
+            if (code == 0x20)
+            {
+                push_call(cpu);
+            }
+        }
+
+        void after_instruction(CPU &cpu, Byte, bool)
+        {
+            expected_pc = cpu.program_counter;
+            expected_sp = cpu.stack_pointer;
+
+            while (depth != 0 && frames[depth - 1].stack_pointer <= cpu.stack_pointer)
+            {
+                --depth;
+            }
+
+            if (cpu.cycles >= next_sample)
+            {
+                take_samples(cpu.cycles);
+            }
+        }
+
+        void clear();
+        void set_symbols(const SymbolTable *symbols);
+
+        std::uint64_t interval() const;
+        std::uint64_t total_samples() const;
+        // 落在某个指令地址上的样本数
+        std::uint64_t samples_at(Address addr) const;
+
+        void write_folded(std::ostream &out) const;
+        // 按样本数降序的热点指令地址
+        void write_hotspots(std::ostream &out, std::size_t limit = 20) const;
+        bool dump_folded(const std::string &path) const;
+
+    private:
+        enum FrameKind
+        {
+            Frame_Root,
+            Frame_Call,
+            Frame_Interrupt,
+        };
+
+        struct Frame
+        {
+            Address target;
+            // 帧建立前的栈指针，栈指针回到这里说明已经返回
+            Byte stack_pointer;
+            FrameKind kind;
+        };
+
+        std::uint64_t sample_interval;
+        std::uint64_t next_sample;
+        std::uint64_t samples;
+        bool started;
+        Address pc;
+        // 上一条指令执行完后的 PC/SP。下一条指令开始时 PC 不同且栈里多了 3 个字节说明中间进了中断，
+        // 否则是重新开始运行
+        std::uint32_t expected_pc;
+        Byte expected_sp;
+
+        Frame root;
+        Frame frames[MAX_DEPTH];
+        // 超出 MAX_DEPTH 的调用不再入栈，按栈指针弹出时自然对齐
+        std::size_t depth;
+
+        std::vector<std::uint64_t> pc_samples;
+        // 键是根帧和各层帧的 (kind << 16 | 目标地址)
+        std::map<std::vector<std::uint32_t>, std::uint64_t> stacks;
+        std::vector<std::uint32_t> key;
+        const SymbolTable *symbols;
+
+        void enter_discontinuity(CPU &cpu);
+        void push_call(CPU &cpu);
+        void push_frame(Address target, Byte stack_pointer, FrameKind kind);
+        void take_samples(std::uint64_t cycles);
+        std::string frame_name(std::uint32_t key) const;
+    };
+}
+
+#endif // SAMPLINGPROFILER_H
@@ -0,0 +1,25 @@
+#ifndef SIMDDISPATCH_H
+#define SIMDDISPATCH_H
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MYSN_X86_SIMD 1
+#define MYSN_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define MYSN_X86_SIMD 0
+#endif
+
+namespace mysn
+{
+    // 运行时选择的向量指令集，热点函数各自提供 SSE2/AVX2 版本和标量版本
+    enum SimdLevel
+    {
+        Simd_Scalar,
+        Simd_SSE2,
+        Simd_AVX2,
+    };
+
+    // 当前 CPU 支持的最高级别（只检测一次）
+    SimdLevel detect_simd_level();
+}
+
+#endif // SIMDDISPATCH_H
@@ -0,0 +1,16 @@
+#ifndef STATEHASH_H
+#define STATEHASH_H
+
+#include "CPU.h"
+#include <cstdint>
+
+namespace mysn
+{
+    // 2KB 内部 RAM（$0000-$07FF）的 FNV-1a，用 peek 读取
+    std::uint64_t ram_hash(const CPU &cpu);
+
+    // 寄存器（不含周期数）加 2KB 内部 RAM 的 FNV-1a，用来判断两个状态是否相同
+    std::uint64_t state_hash(const CPU &cpu);
+}
+
+#endif // STATEHASH_H
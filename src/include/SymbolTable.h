@@ -0,0 +1,37 @@
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+
+#include "CPU.h"
+#include <map>
+#include <string>
+
+namespace mysn
+{
+    /// 6502 地址到标签名的映射，用于剖析和跟踪输出的符号化。
+    ///
+    /// 支持两种文件：
+    ///   - ld65 --dbgfile 生成的 ca65 调试信息（只取 type=lab 的 sym 行）
+    ///   - 简单标签文件，每行 "8000 reset"、"reset = $8000" 或 ld65 -Ln 的 "al 008000 .reset"
+    class SymbolTable
+    {
+    public:
+        // 按扩展名选择格式，.dbg 之外都当作标签文件；读不到文件返回 false
+        bool load(const std::string &path);
+        bool load_dbg(const std::string &path);
+        bool load_labels(const std::string &path);
+
+        void add(Address addr, const std::string &name);
+        bool empty() const;
+        std::size_t size() const;
+
+        // 精确匹配的标签，没有返回 nullptr
+        const std::string *find(Address addr) const;
+        // "name"、"name+$12"，地址之前没有任何标签时返回 prefix_XXXX
+        std::string describe(Address addr, const char *prefix = "sub") const;
+
+    private:
+        std::map<Address, std::string> labels;
+    };
+}
+
+#endif // SYMBOLTABLE_H
@@ -0,0 +1,60 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mysn
+{
+    /// 常驻的工作线程，按下标并行执行一批任务：
+    ///
+    ///     ThreadPool pool(8);
+    ///     pool.parallel_for(cpus.size(), [&](std::size_t i) { cpus[i].run_with(policy[i]); });
+    ///
+    /// 调用线程也参与执行，所以只创建 threads - 1 个工作线程。下标用原子计数器分发，
+    /// 适合每个任务都比较重（例如跑一帧）的场合。parallel_for 不能嵌套，也不能从多个线程同时调用。
+    class ThreadPool
+    {
+    public:
+        // threads 为 0 时用 std::thread::hardware_concurrency()
+        explicit ThreadPool(int threads);
+        ~ThreadPool();
+
+        // 包括调用线程在内的线程数
+        int size() const;
+
+        // 对 [0, count) 的每个下标调用一次 task，全部完成后返回
+        void parallel_for(std::size_t count, const std::function<void(std::size_t)> &task);
+
+    private:
+        std::vector<std::thread> workers;
+
+        std::mutex lock;
+        std::condition_variable wake;
+        std::condition_variable finished;
+
+        const std::function<void(std::size_t)> *task;
+        std::size_t count;
+        std::atomic<std::size_t> next;
+        // 每批任务加一，工作线程据此判断有没有新任务
+        std::uint64_t generation;
+        // 还没做完当前这一批的工作线程数
+        int running;
+        bool stopping;
+
+        ThreadPool(const ThreadPool &);
+        ThreadPool &operator=(const ThreadPool &);
+
+        void stop();
+        void worker_loop();
+        void drain(const std::function<void(std::size_t)> &task, std::size_t count);
+    };
+}
+
+#endif // THREADPOOL_H
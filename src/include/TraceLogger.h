@@ -0,0 +1,137 @@
+#ifndef TRACELOGGER_H
+#define TRACELOGGER_H
+
+#include "CPU.h"
+#include "FrameRecorder.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mysn
+{
+    // 一行跟踪文本的最大长度（含换行）
+    const std::size_t TRACE_LINE_MAX = 128;
+
+    /// 按 nestest.log 的格式格式化即将执行的一条指令，返回写入的字节数（含换行），不写结尾的 0：
+    ///
+    ///     C000  4C F5 C5  JMP $C5F5                       A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 21 CYC:7
+    ///
+    /// 操作数注释里的内存值用 peek 读取，不会触发 I/O 副作用。PPU 列由 CPU 周期推算（每周期 3 个点）。
+    std::size_t format_trace_line(const CPU &cpu, char *out);
+
+    /// 一个模拟线程独占的跟踪输出：文本先写进当前块，块满后整块交给写盘线程。
+    ///
+    /// 块在 TraceWriter::open 时一次分配，通过单生产者单消费者的环循环使用；
+    /// 写盘跟不上时生产者等待空闲块，跟踪不会丢行。除了构造，所有操作（包括 close）都只能在生产者线程里调用。
+    /// 唯一的例外是生产者还没 close 时 TraceWriter 就关闭了：之后写入的数据无处可去，
+    /// 生产者不再等待空闲块而是丢弃，lost() 变为 true。
+    class TraceStream
+    {
+    public:
+        static const std::size_t CHUNK_SIZE = 64 * 1024;
+        static const std::size_t CHUNK_COUNT = 8;
+
+        ~TraceStream();
+
+        bool is_open() const;
+
+        // 取得至少 length 字节的连续空间，写完后用 commit 提交实际长度
+        char *reserve(std::size_t length);
+        void commit(std::size_t length);
+        void write(const char *text, std::size_t length);
+
+        // 把未满的块也交给写盘线程
+        void flush();
+        // flush 后不再写入，写盘线程写完剩余数据后关闭文件。生产者写完后自己调用
+        void close();
+        // 写盘线程已经停止，有数据被丢弃
+        bool lost() const;
+
+    private:
+        friend class TraceWriter;
+
+        struct Output;
+
+        FrameRing ring;
+        // 生产者当前在写的块，前 4 字节存已用长度
+        std::uint8_t *chunk;
+        std::size_t used;
+        std::unique_ptr<Output> output;
+        std::atomic<bool> closing;
+        bool closed;
+        // 所属 TraceWriter 的写盘线程是否已经停止
+        const std::atomic<bool> &writer_stopped;
+        bool dropped;
+        // 写盘线程停止后接替环里的块，写进去的数据直接丢弃
+        std::vector<std::uint8_t> discard;
+
+        TraceStream(const std::string &path, const std::atomic<bool> &writer_stopped);
+        TraceStream(const TraceStream &);
+        TraceStream &operator=(const TraceStream &);
+
+        void publish();
+        // 改用 discard，之后的写入都丢弃
+        void drop();
+        // 写盘线程调用：写出所有已提交的块，返回是否写了东西
+        bool drain();
+    };
+
+    /// 后台写盘线程，服务任意多个 TraceStream。
+    ///
+    ///     TraceWriter writer;
+    ///     TraceStream *stream = writer.open("trace.log");  // .gz 结尾写 gzip
+    ///     Tracer tracer(stream);
+    ///     cpu.load_and_run_with(program, tracer);
+    ///     stream->close();                                 // 在生产者线程里
+    ///     writer.close();
+    class TraceWriter
+    {
+    public:
+        TraceWriter();
+        ~TraceWriter();
+
+        // 打开失败时返回的流 is_open() 为 false，写入会被丢弃；流归 TraceWriter 所有
+        TraceStream *open(const std::string &path);
+        // 等写盘线程写完所有流的数据后结束它。只做收尾，不碰生产者那一侧：
+        // 调用前每个流都必须已经由它的生产者 close。有流还开着时把个数写到标准错误并返回 false，
+        // 这些流未 flush 的部分和之后的写入会丢失（见 TraceStream::lost），生产者不会因此卡住
+        bool close();
+
+    private:
+        std::mutex lock;
+        std::vector<std::unique_ptr<TraceStream>> streams;
+        std::atomic<bool> stopping;
+        std::thread writer;
+
+        TraceWriter(const TraceWriter &);
+        TraceWriter &operator=(const TraceWriter &);
+
+        void writer_loop();
+    };
+
+    // CPU::run_with 的跟踪策略，每条指令执行前写一行
+    class Tracer
+    {
+    public:
+        explicit Tracer(TraceStream *stream) : stream(stream) {}
+
+        void before_instruction(CPU &cpu, Byte)
+        {
+            char *line = stream->reserve(TRACE_LINE_MAX);
+            stream->commit(format_trace_line(cpu, line));
+        }
+
+        void after_instruction(CPU &, Byte, bool) {}
+
+    private:
+        TraceStream *stream;
+    };
+}
+
+#endif // TRACELOGGER_H
@@ -0,0 +1,270 @@
+#include "APU.h"
+#include "AudioSink.h"
+#include "CPU.h"
+#include <vector>
+#include <assert.h>
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+void test_length_counter_status()
+{
+    mysn::APU apu;
+
+    // 帧中断关闭，4 步模式
+    apu.write_register(0x4017, 0x40, 0);
+    apu.write_register(0x4015, 0x01, 0);
+    // 长度索引 1 => 254
+    apu.write_register(0x4003, 0x08, 0);
+    mysn::Byte status = apu.read_status(1);
+    assert(status == 0x01);
+
+    // 长度为 10（索引 0），每帧两次半帧时钟，5 帧后归零
+    apu.write_register(0x4003, 0x00, 10);
+    status = apu.read_status(29830 * 4);
+    assert(status == 0x01);
+    status = apu.read_status(29830 * 5 + 10);
+    assert(status == 0x00);
+
+    // 关闭声道立即清零长度
+    apu.write_register(0x4003, 0x08, 29830 * 6);
+    apu.write_register(0x4015, 0x00, 29830 * 6);
+    status = apu.read_status(29830 * 6);
+    assert(status == 0x00);
+}
+
+void test_frame_irq()
+{
+    mysn::APU apu;
+
+    assert(!apu.irq_pending());
+    apu.run_until(29828);
+    assert(!apu.irq_pending());
+    apu.run_until(29829);
+    assert(apu.irq_pending());
+
+    // 读 $4015 返回并清除帧中断
+    mysn::Byte status = apu.read_status(29830);
+    assert(status & 0x40);
+    assert(!apu.irq_pending());
+
+    // 5 步模式不产生帧中断
+    apu.write_register(0x4017, 0x80, 30000);
+    apu.run_until(30000 + 37282 * 2);
+    assert(!apu.irq_pending());
+}
+
+void test_dmc_irq_and_stall()
+{
+    mysn::APU apu;
+    int reads = 0;
+
+    apu.set_dmc_reader([&reads](mysn::Address) {
+        ++reads;
+        return mysn::Byte(0x55);
+    });
+
+    apu.write_register(0x4017, 0x40, 0);
+    // IRQ 开启，最快速率，长度 17 字节
+    apu.write_register(0x4010, 0x8F, 0);
+    apu.write_register(0x4013, 0x01, 0);
+    apu.write_register(0x4015, 0x10, 0);
+
+    assert(reads == 1);
+    unsigned stall = apu.take_dma_stall();
+    mysn::Byte status = apu.read_status(1);
+    assert(stall == 4);
+    assert(status == 0x10);
+
+    // 每个字节 8 * 54 周期
+    apu.run_until(54 * 8 * 17);
+    assert(reads == 17);
+    assert(apu.irq_pending());
+    status = apu.read_status(54 * 8 * 17);
+    stall = apu.take_dma_stall();
+    assert(status == 0x80);
+    assert(stall == 16 * 4);
+
+    // 写 $4015 清除 DMC 中断
+    apu.write_register(0x4015, 0x00, 54 * 8 * 18);
+    assert(!apu.irq_pending());
+}
+
+void test_pulse_output_to_sink()
+{
+    mysn::APU apu;
+    size_t total = 0;
+    int peak = 0;
+
+    mysn::CallbackSink sink([&](const int16_t *samples, size_t count) {
+        total += count;
+        for (size_t i = 0; i < count; ++i)
+        {
+            peak = max(peak, abs(int(samples[i])));
+        }
+    });
+    apu.set_sink(&sink);
+
+    apu.write_register(0x4017, 0x40, 0);
+    apu.write_register(0x4015, 0x01, 0);
+    // 50% 占空比，常量音量 15，约 440Hz
+    apu.write_register(0x4000, 0xBF, 0);
+    apu.write_register(0x4002, 0xFD, 0);
+    apu.write_register(0x4003, 0x08, 0);
+
+    apu.end_frame(mysn::APU::CPU_CLOCK_RATE / 10);
+
+    // 0.1 秒 @48kHz
+    assert(total >= 4799 && total <= 4801);
+    assert(peak > 1000);
+}
+
+void test_wav_writer()
+{
+    const char *path = "APU_test_output.wav";
+
+    {
+        mysn::WavWriter wav(path, 48000);
+        assert(wav.is_open());
+
+        int16_t samples[100] = {0};
+        wav.write_samples(samples, 100);
+        wav.write_samples(samples, 50);
+    }
+
+    FILE *file = fopen(path, "rb");
+    assert(file != nullptr);
+    fseek(file, 0, SEEK_END);
+    assert(ftell(file) == 44 + 150 * 2);
+
+    unsigned char header[44];
+    fseek(file, 0, SEEK_SET);
+    size_t header_read = fread(header, 1, 44, file);
+    assert(header_read == 44);
+    assert(header[40] == 44 && header[41] == 1); // data 长度 300
+    fclose(file);
+    remove(path);
+}
+
+void test_cpu_reads_apu_status()
+{
+    mysn::CPU cpu = mysn::CPU();
+    mysn::APU apu;
+    cpu.attach_apu(&apu);
+
+    /**
+        LDA #$40
+        STA $4017
+        LDA #$01
+        STA $4015
+        LDA #$08
+        STA $4003
+        LDA $4015
+        BRK
+     */
+    vector<uint8_t> program = {0xa9, 0x40, 0x8d, 0x17, 0x40, 0xa9, 0x01, 0x8d, 0x15, 0x40,
+                               0xa9, 0x08, 0x8d, 0x03, 0x40, 0xad, 0x15, 0x40, 0x00};
+    cpu.load_and_run(program);
+
+    assert(cpu.register_a == 0x01);
+    assert(cpu.cycles > 0);
+}
+
+struct StatusRun
+{
+    uint64_t cycles;
+    uint8_t a, x, y, status, sp;
+    uint8_t irq_count, last_status, polled;
+};
+
+StatusRun run_status_program(mysn::APUMode mode)
+{
+    mysn::CPU cpu = mysn::CPU();
+    mysn::APU apu(48000, mode);
+    cpu.attach_apu(&apu);
+
+    // IRQ 处理程序在 $8040：INC $10; LDA $4015; STA $11; LDA #$0F; STA $4015; RTI
+    /**
+        LDA #$00  STA $4017      4 步模式，帧中断开启
+        LDA #$8F  STA $4010      DMC IRQ 开启，最快速率
+        LDA #$02  STA $4013      33 字节
+        LDA #$1F  STA $4015
+        LDA #$08  STA $4003
+     loop:
+        LDA $0010 STA $12
+        INX       BNE loop
+        INY       CPY #$10  BNE loop
+        BRK
+     */
+    vector<uint8_t> program = {0xa9, 0x00, 0x8d, 0x17, 0x40, 0xa9, 0x8f, 0x8d, 0x10, 0x40,
+                               0xa9, 0x02, 0x8d, 0x13, 0x40, 0xa9, 0x1f, 0x8d, 0x15, 0x40,
+                               0xa9, 0x08, 0x8d, 0x03, 0x40,
+                               0xad, 0x10, 0x00, 0x85, 0x12, 0xe8, 0xd0, 0xf8,
+                               0xc8, 0xc0, 0x10, 0xd0, 0xf3, 0x00};
+    program.resize(0x40, 0xea);
+    vector<uint8_t> handler = {0xe6, 0x10, 0xad, 0x15, 0x40, 0x85, 0x11,
+                               0xa9, 0x0f, 0x8d, 0x15, 0x40, 0x40};
+    program.insert(program.end(), handler.begin(), handler.end());
+    // 装载时整个 ROM 被替换，IRQ 向量要放在程序里
+    program.resize(0x8000, 0);
+    program[0x7FFE] = 0x40;
+    program[0x7FFF] = 0x80;
+
+    cpu.load_and_run(program);
+
+    StatusRun result = {cpu.cycles, cpu.register_a, cpu.register_x, cpu.register_y, cpu.status,
+                        cpu.stack_pointer, cpu.mem_read(0x10), cpu.mem_read(0x11), cpu.mem_read(0x12)};
+    return result;
+}
+
+void test_status_only_mode_matches_full_mode()
+{
+    StatusRun full = run_status_program(mysn::Full_Synthesis);
+    StatusRun fast = run_status_program(mysn::Status_Only);
+
+    // 至少经历了一次 DMC 中断和帧中断
+    assert(full.irq_count >= 2);
+
+    assert(full.cycles == fast.cycles);
+    assert(full.a == fast.a && full.x == fast.x && full.y == fast.y);
+    assert(full.status == fast.status && full.sp == fast.sp);
+    assert(full.irq_count == fast.irq_count);
+    assert(full.last_status == fast.last_status);
+    assert(full.polled == fast.polled);
+}
+
+void test_status_only_mode_produces_no_audio()
+{
+    mysn::APU apu(48000, mysn::Status_Only);
+    size_t total = 0;
+
+    mysn::CallbackSink sink([&](const int16_t *, size_t count) { total += count; });
+    apu.set_sink(&sink);
+
+    apu.write_register(0x4015, 0x01, 0);
+    apu.write_register(0x4000, 0xBF, 0);
+    apu.write_register(0x4003, 0x08, 0);
+    apu.end_frame(29781 * 2);
+
+    mysn::Byte status = apu.read_status(29781 * 2);
+    assert(total == 0);
+    assert(status & 0x01);
+
+    // 切回完整模式后恢复输出
+    apu.set_mode(mysn::Full_Synthesis);
+    apu.end_frame(29781 * 3);
+    assert(total > 700);
+}
+
+int main()
+{
+    test_length_counter_status();
+    test_frame_irq();
+    test_dmc_irq_and_stall();
+    test_pulse_output_to_sink();
+    test_wav_writer();
+    test_cpu_reads_apu_status();
+    test_status_only_mode_matches_full_mode();
+    test_status_only_mode_produces_no_audio();
+}
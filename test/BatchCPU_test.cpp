@@ -0,0 +1,233 @@
+#include "BatchCPU.h"
+#include "CPU.h"
+#include "CPUOpcodes.h"
+#include "CPURun.h"
+#include <vector>
+#include <assert.h>
+#include <random>
+
+using namespace std;
+
+struct CycleLimit
+{
+    uint64_t limit;
+
+    void before_instruction(mysn::CPU &, mysn::Byte) {}
+
+    void after_instruction(mysn::CPU &cpu, mysn::Byte, bool)
+    {
+        if (cpu.cycles >= limit)
+        {
+            cpu.request_stop();
+        }
+    }
+};
+
+// 每个实例的输入写在 $0000 开始的几个字节
+void check_against_scalar(const vector<uint8_t> &program, const vector<vector<uint8_t>> &inputs, uint64_t limit)
+{
+    mysn::BatchCPU batch(inputs.size());
+    batch.load_and_reset(program);
+
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+        for (size_t k = 0; k < inputs[i].size(); ++k)
+        {
+            batch.poke(i, mysn::Address(k), inputs[i][k]);
+        }
+    }
+
+    batch.run(limit);
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+        mysn::CPU cpu = mysn::CPU();
+        // 随机程序经常碰到未知操作码，不需要指令记录
+        cpu.flight_recorder.set_dump_fd(-1);
+        vector<uint8_t> copy = program;
+        cpu.load_and_reset(copy);
+        for (size_t k = 0; k < inputs[i].size(); ++k)
+        {
+            cpu.mem_write(mysn::Address(k), inputs[i][k]);
+        }
+
+        CycleLimit policy = {limit};
+        cpu.run_with(policy);
+
+        assert(batch.program_counter(i) == cpu.program_counter);
+        assert(batch.register_a(i) == cpu.register_a);
+        assert(batch.register_x(i) == cpu.register_x);
+        assert(batch.register_y(i) == cpu.register_y);
+        assert(batch.stack_pointer(i) == cpu.stack_pointer);
+        assert(batch.status(i) == cpu.status);
+        assert(batch.cycles(i) == cpu.cycles);
+        assert(batch.halted(i) || batch.cycles(i) >= limit);
+
+        for (uint32_t addr = 0; addr < mysn::BatchCPU::ROM_START; ++addr)
+        {
+            assert(batch.peek(i, mysn::Address(addr)) == cpu.peek(mysn::Address(addr)));
+        }
+
+        total += cpu.cycles;
+    }
+
+    assert(batch.instructions() > 0 && total > 0);
+}
+
+void test_lockstep()
+{
+    // 256 x 256 次 CLC/ADC #/EOR zp/STA zp
+    vector<uint8_t> program = {
+        0xa2, 0x00, 0xa0, 0x00, 0x18, 0x69, 0x03, 0x45, 0x10, 0x85, 0x10,
+        0xc8, 0xd0, 0xf6, 0xe8, 0xd0, 0xf1, 0x00,
+    };
+
+    vector<vector<uint8_t>> inputs(32);
+    check_against_scalar(program, inputs, ~uint64_t(0));
+
+    // 输入都相同时每次译码都执行整组 16 个实例
+    mysn::BatchCPU batch(32);
+    batch.load_and_reset(program);
+    batch.run();
+    assert(batch.instructions() == batch.issues() * mysn::BatchCPU::LANES);
+    assert(batch.halted(0) && batch.halted(31));
+    assert(batch.peek(5, 0x10) == batch.peek(30, 0x10));
+}
+
+/**
+          LDY #$00
+    loop: LDA $00       ; 每个实例不同的输入
+          LSR A
+          STA $00
+          BCC skip
+          JSR sub
+          JMP next
+    skip: INC $20,X
+          LDA ($01),Y
+          STA $0300,Y
+    next: INY
+          CPY #$08
+          BNE loop
+          LDA $20
+          ASL A
+          SBC #$05
+          BIT $21
+          ROR $21
+          BRK
+     sub: PHA
+          INX
+          STX $40,Y
+          CLC
+          ADC $21
+          STA $21
+          PLA
+          RTS
+ */
+void test_divergent_lanes()
+{
+    vector<uint8_t> program = {
+        0xa0, 0x00,
+        0xa5, 0x00, 0x4a, 0x85, 0x00, 0x90, 0x06,
+        0x20, 0x25, 0x80, 0x4c, 0x16, 0x80,
+        0xf6, 0x20, 0xb1, 0x01, 0x99, 0x00, 0x03,
+        0xc8, 0xc0, 0x08, 0xd0, 0xe7,
+        0xa5, 0x20, 0x0a, 0xe9, 0x05, 0x24, 0x21, 0x66, 0x21,
+        0x00,
+        0x48, 0xe8, 0x96, 0x40, 0x18, 0x65, 0x21, 0x85, 0x21, 0x68, 0x60,
+    };
+
+    vector<vector<uint8_t>> inputs;
+    for (int i = 0; i < 20; ++i)
+    {
+        inputs.push_back({uint8_t(i * 37), uint8_t(i), 0x02});
+    }
+    check_against_scalar(program, inputs, ~uint64_t(0));
+
+    // 输入不同时 PC 会分开，每次译码平均不到 16 个实例
+    mysn::BatchCPU batch(16);
+    batch.load_and_reset(program);
+    for (int i = 0; i < 16; ++i)
+    {
+        batch.poke(i, 0x00, uint8_t(i * 37));
+    }
+    batch.run();
+    assert(batch.instructions() < batch.issues() * mysn::BatchCPU::LANES);
+}
+
+void test_cycle_limit_resumes()
+{
+    vector<uint8_t> program = {0xa2, 0x00, 0xa0, 0x00, 0xc8, 0xd0, 0xfd, 0xe8, 0xd0, 0xf8, 0x00};
+
+    mysn::BatchCPU batch(3);
+    batch.load_and_reset(program);
+    batch.run(1000);
+
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        assert(!batch.halted(i));
+        assert(batch.cycles(i) >= 1000 && batch.cycles(i) < 1010);
+    }
+
+    batch.run();
+    assert(batch.halted(0) && batch.halted(2));
+    assert(batch.program_counter(1) == 0x800b);
+}
+
+// 随机程序：除了不写 $8000 以上（BatchCPU 的 ROM 只读），和 CPU 的结果逐字节一致
+void test_random_programs()
+{
+    vector<uint8_t> opcodes;
+    for (auto &opcode : mysn::CPUOpcodes::CPU_OPS_CODES_MAP)
+    {
+        // STA ($zp,X) 和 STA ($zp),Y 的地址可能落在 ROM
+        if (opcode.first != 0x81 && opcode.first != 0x91)
+        {
+            opcodes.push_back(opcode.first);
+        }
+    }
+
+    mt19937 rng(2024);
+
+    for (int round = 0; round < 30; ++round)
+    {
+        vector<uint8_t> program;
+        while (program.size() < 256)
+        {
+            const mysn::CPUOpcodes &info = mysn::CPUOpcodes::CPU_OPS_CODES_MAP.at(opcodes[rng() % opcodes.size()]);
+            program.push_back(info.code);
+
+            for (int k = 1; k < info.len; ++k)
+            {
+                program.push_back(uint8_t(rng()));
+            }
+
+            bool absolute = info.mode == mysn::Absolute || info.mode == mysn::Absolute_X || info.mode == mysn::Absolute_Y;
+            if (absolute && info.mnemonic != mysn::JMP && info.mnemonic != mysn::JSR)
+            {
+                program.back() &= 0x07;
+            }
+        }
+
+        vector<vector<uint8_t>> inputs;
+        for (int i = 0; i < 20; ++i)
+        {
+            vector<uint8_t> input(16);
+            for (uint8_t &byte : input)
+            {
+                byte = uint8_t(rng() % 4 == 0 ? 0 : rng());
+            }
+            inputs.push_back(input);
+        }
+
+        check_against_scalar(program, inputs, 20000);
+    }
+}
+
+int main()
+{
+    test_lockstep();
+    test_divergent_lanes();
+    test_cycle_limit_resumes();
+    test_random_programs();
+}
@@ -1,4 +1,5 @@
 #include "CPU.h"
+#include "CPURun.h"
 #include <vector>
 #include <assert.h>
 #include <iostream>
@@ -395,6 +396,199 @@ void test_inc()
     assert(cpu.mem_read(0xaa) == 0x00);
 }
 
+void test_hard_reset()
+{
+    mysn::CPU cpu = mysn::CPU();
+
+    /**
+        LDX #$05
+        STX $0300
+        PHA
+        BRK
+     */
+    vector<uint8_t> program = {0xa2, 0x05, 0x8e, 0x00, 0x03, 0x48, 0x00};
+    cpu.load_and_run(program);
+    assert(cpu.mem_read(0x0300) == 0x05);
+    assert(cpu.stack_pointer == 0xfc);
+
+    cpu.hard_reset();
+    assert(cpu.mem_read(0x0300) == 0x00);
+    assert(cpu.mem_read(0x8000) == 0x00);
+    assert(cpu.register_x == 0 && cpu.stack_pointer == 0xfd && cpu.cycles == 0);
+    assert(cpu.flight_recorder.total_recorded() == 0);
+}
+
+// 执行 limit 条指令后停下
+struct StopAfter
+{
+    int limit;
+
+    void before_instruction(mysn::CPU &, mysn::Byte) {}
+
+    void after_instruction(mysn::CPU &cpu, mysn::Byte, bool)
+    {
+        if (--limit == 0)
+        {
+            cpu.request_stop();
+        }
+    }
+};
+
+void test_request_stop()
+{
+    mysn::CPU cpu = mysn::CPU();
+
+    /**
+        loop: INX
+        JMP loop
+     */
+    vector<uint8_t> program = {0xe8, 0x4c, 0x00, 0x80};
+    StopAfter policy = {9};
+    cpu.load_and_run_with(program, policy);
+    assert(cpu.register_x == 5);
+    assert(cpu.program_counter == 0x8001);
+
+    policy.limit = 1;
+    cpu.run_with(policy);
+    assert(cpu.program_counter == 0x8000);
+
+    // 停下后可以接着执行
+    policy.limit = 2;
+    cpu.run_with(policy);
+    assert(cpu.register_x == 6);
+    assert(cpu.program_counter == 0x8000);
+}
+
+void test_run_for()
+{
+    mysn::CPU cpu = mysn::CPU();
+
+    /**
+        loop: INX       ; 2 周期
+        JMP loop        ; 3 周期
+     */
+    vector<uint8_t> program = {0xe8, 0x4c, 0x00, 0x80};
+    cpu.load_and_reset(program);
+
+    mysn::RunBudget instructions = {3, 0, false};
+    mysn::RunExit reason = cpu.run_for(instructions);
+    assert(reason == mysn::Run_Instruction_Limit);
+    assert(cpu.register_x == 2);
+    assert(cpu.program_counter == 0x8001);
+
+    // 从停下的地方接着执行，周期预算从当前周期算起
+    uint64_t start = cpu.cycles;
+    mysn::RunBudget cycles = {0, 10, false};
+    reason = cpu.run_for(cycles);
+    assert(reason == mysn::Run_Cycle_Limit);
+    assert(cpu.cycles == start + 10);
+    assert(cpu.register_x == 4);
+
+    mysn::RunBudget frame = {0, 0, true};
+    reason = cpu.run_for(frame);
+    assert(reason == mysn::Run_Frame_End);
+    assert(cpu.cycles >= mysn::CYCLES_PER_FRAME && cpu.cycles < mysn::CYCLES_PER_FRAME + 3);
+    reason = cpu.run_for(frame);
+    assert(reason == mysn::Run_Frame_End);
+    assert(cpu.cycles / mysn::CYCLES_PER_FRAME == 2);
+
+    // 先到者为准
+    mysn::RunBudget both = {1, 0, true};
+    reason = cpu.run_for(both);
+    assert(reason == mysn::Run_Instruction_Limit);
+    mysn::RunBudget far = {0, 100 * mysn::CYCLES_PER_FRAME, true};
+    reason = cpu.run_for(far);
+    assert(reason == mysn::Run_Frame_End);
+    assert(cpu.cycles / mysn::CYCLES_PER_FRAME == 3);
+
+    // 程序结束优先于预算：INX; BRK
+    vector<uint8_t> halts = {0xe8, 0x00};
+    cpu.load_and_reset(halts);
+    mysn::RunBudget two = {2, 0, false};
+    reason = cpu.run_for(two);
+    assert(reason == mysn::Run_Halted);
+
+    cpu.load_and_reset(halts);
+    mysn::RunBudget unlimited = {0, 0, false};
+    reason = cpu.run_for(unlimited);
+    assert(reason == mysn::Run_Halted);
+    assert(cpu.register_x == 1);
+
+    vector<uint8_t> invalid = {0xe8, 0x02};
+    cpu.flight_recorder.set_dump_fd(-1);
+    cpu.load_and_reset(invalid);
+    reason = cpu.run_for(unlimited);
+    assert(reason == mysn::Run_Invalid_Opcode);
+}
+
+void test_memory_map()
+{
+    mysn::CPU cpu = mysn::CPU();
+
+    // $0000-$07FF 在 $0800-$1FFF 镜像
+    cpu.mem_write(0x0812, 0x34);
+    assert(cpu.mem_read(0x0012) == 0x34);
+    assert(cpu.mem_read(0x1812) == 0x34);
+    assert(cpu.memory_data()[0x12] == 0x34);
+
+    // PRG RAM 和没挂设备的 I/O 页可读写，其余是开放总线
+    cpu.mem_write(0x6000, 0x56);
+    cpu.mem_write(0x4018, 0x78);
+    cpu.mem_write(0x5000, 0x9a);
+    cpu.mem_write(0x2000, 0xbc);
+    assert(cpu.mem_read(0x6000) == 0x56);
+    assert(cpu.mem_read(0x4018) == 0x78);
+    assert(cpu.mem_read(0x5000) == 0x00);
+    assert(cpu.mem_read(0x2000) == 0x00);
+}
+
+void test_shared_rom()
+{
+    // LDA $8010; STA $10; BRK，$8010 是数据
+    vector<uint8_t> program = {0xad, 0x10, 0x80, 0x85, 0x10, 0x00};
+    program.resize(0x11, 0);
+    program[0x10] = 0x11;
+    mysn::SharedRom rom = mysn::make_rom(program);
+    assert(rom->size() == 0x8000);
+    assert((*rom)[0x7FFC] == 0x00 && (*rom)[0x7FFD] == 0x80);
+
+    mysn::CPU first = mysn::CPU();
+    mysn::CPU second = mysn::CPU();
+    first.load_and_reset(rom);
+    second.load_and_reset(rom);
+    assert(rom.use_count() == 3);
+
+    // 写 ROM 的实例复制出自己的一份，其它实例不受影响
+    first.mem_write(0x8010, 0x22);
+    assert(rom.use_count() == 2);
+    assert((*rom)[0x10] == 0x11);
+
+    mysn::NullPolicy policy;
+    first.run_with(policy);
+    second.run_with(policy);
+    assert(first.mem_read(0x10) == 0x22);
+    assert(second.mem_read(0x10) == 0x11);
+
+    // 复制 CPU 不复制 ROM
+    mysn::CPU copy = second;
+    assert(rom.use_count() == 3);
+    copy.hard_reset();
+    assert(rom.use_count() == 2);
+    assert(copy.mem_read(0x8000) == 0x00);
+}
+
+void test_load_longer_than_prg()
+{
+    mysn::CPU cpu = mysn::CPU();
+
+    // 超出 $FFFF 的部分被丢弃，复位向量仍指向 $8000
+    vector<uint8_t> program(0x9000, 0xe8);
+    program[0] = 0x00;
+    cpu.load_and_run(program);
+    assert(cpu.program_counter == 0x8001);
+    assert(cpu.mem_read(0xfffc) == 0x00 && cpu.mem_read(0xfffd) == 0x80);
+}
+
 int main()
 {
     test_set_clear_flag();
@@ -418,4 +612,11 @@ int main()
     test_dec();
     test_dex();
     test_inc();
+
+    test_hard_reset();
+    test_request_stop();
+    test_run_for();
+    test_memory_map();
+    test_shared_rom();
+    test_load_longer_than_prg();
 }
\ No newline at end of file
@@ -0,0 +1,351 @@
+#include "CPU.h"
+#include "Divergence.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <assert.h>
+
+using namespace std;
+
+/**
+    用法：Conformance_test [cpu|batch [image.nes golden.log [lines]]]
+
+    在指定的执行核心上逐条执行测试镜像，和 nestest 格式的黄金轨迹逐行比较
+    PC、A、X、Y、P、SP 和周期数，再不带轨迹地整段跑一遍计时。不给镜像时跑内置的用例，
+    什么参数都不给时在所有核心上跑内置的用例。
+
+    镜像是 iNES 格式的 NROM-128（16KB PRG 映射到 $8000 和 $C000）。两个核心都从 $8000 复位，
+    所以在 $8000 放一段 SEI; JMP <入口>，入口是轨迹第一行的 PC，执行到那里时的状态与 nestest 的
+    上电状态一致（P 的 I 位置位，SP 为 $FD）。周期数按与第一行的差比较，P 不比较第 4、5 位（B 标志）。
+ */
+
+struct TraceLine
+{
+    mysn::Address pc;
+    mysn::Byte a;
+    mysn::Byte x;
+    mysn::Byte y;
+    mysn::Byte p;
+    mysn::Byte sp;
+    uint64_t cycles;
+};
+
+// P 里实际存在的标志位
+const mysn::Byte FLAG_MASK = 0xCF;
+
+bool parse_field(const string &line, const char *name, unsigned long long &value)
+{
+    size_t pos = line.find(name);
+
+    if (pos == string::npos)
+    {
+        return false;
+    }
+
+    value = strtoull(line.c_str() + pos + strlen(name), nullptr, name[0] == 'C' ? 10 : 16);
+    return true;
+}
+
+// "C000  4C F5 C5  JMP $C5F5      A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 21 CYC:7"
+bool parse_trace_line(const string &line, TraceLine &out)
+{
+    unsigned long long pc, a, x, y, p, sp, cycles;
+
+    if (line.size() < 4 ||
+        !parse_field(line, " A:", a) || !parse_field(line, " X:", x) || !parse_field(line, " Y:", y) ||
+        !parse_field(line, " P:", p) || !parse_field(line, " SP:", sp) || !parse_field(line, "CYC:", cycles))
+    {
+        return false;
+    }
+
+    pc = strtoull(line.substr(0, 4).c_str(), nullptr, 16);
+    TraceLine parsed = {mysn::Address(pc), mysn::Byte(a), mysn::Byte(x), mysn::Byte(y), mysn::Byte(p), mysn::Byte(sp), cycles};
+    out = parsed;
+    return true;
+}
+
+bool parse_trace(istream &in, vector<TraceLine> &lines)
+{
+    string line;
+
+    while (getline(in, line))
+    {
+        if (line.empty())
+        {
+            continue;
+        }
+
+        TraceLine parsed;
+        if (!parse_trace_line(line, parsed))
+        {
+            return false;
+        }
+        lines.push_back(parsed);
+    }
+
+    return true;
+}
+
+// iNES NROM-128 的 PRG 镜像成 32KB，$8000 处换成跳到 entry 的引导代码
+bool nrom_program(const vector<mysn::Byte> &image, mysn::Address entry, vector<mysn::Byte> &program)
+{
+    const size_t header = 16;
+    const size_t prg_size = 0x4000;
+
+    if (image.size() < header + prg_size || memcmp(image.data(), "NES\x1a", 4) != 0 || image[4] != 1 ||
+        (image[6] & 0xF0) != 0 || (image[7] & 0xF0) != 0)
+    {
+        return false;
+    }
+
+    size_t prg = header + ((image[6] & 0x04) ? 512 : 0);
+    program.assign(image.begin() + prg, image.begin() + prg + prg_size);
+    program.insert(program.end(), image.begin() + prg, image.begin() + prg + prg_size);
+
+    // SEI; JMP entry
+    mysn::Byte boot[] = {0x78, 0x4c, mysn::Byte(entry), mysn::Byte(entry >> 8)};
+    copy(boot, boot + sizeof(boot), program.begin());
+    return true;
+}
+
+unique_ptr<mysn::DivergenceCore> make_core(const string &core, const vector<mysn::Byte> &program)
+{
+    if (core == "cpu")
+    {
+        return unique_ptr<mysn::DivergenceCore>(new mysn::CPUCore(mysn::make_rom(program)));
+    }
+    if (core == "batch")
+    {
+        return unique_ptr<mysn::DivergenceCore>(new mysn::BatchCPUCore(program));
+    }
+
+    return unique_ptr<mysn::DivergenceCore>();
+}
+
+void write_line(ostream &out, const char *name, const TraceLine &line)
+{
+    char text[96];
+    snprintf(text, sizeof(text), "%s %04X  A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%llu", name,
+             line.pc, line.a, line.x, line.y, line.p, line.sp, (unsigned long long)line.cycles);
+    out << text << '\n';
+}
+
+double seconds_since(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// 通过时返回 true；逐条执行用 run_to(cycles + 1)，每条指令至少 2 个周期，所以正好执行一条
+bool run_conformance(const string &name, const string &core_name, const vector<mysn::Byte> &image,
+                     const vector<TraceLine> &golden, size_t limit)
+{
+    vector<mysn::Byte> program;
+
+    if (golden.empty() || !nrom_program(image, golden[0].pc, program))
+    {
+        cerr << name << ": not an NROM-128 image or empty trace\n";
+        return false;
+    }
+
+    unique_ptr<mysn::DivergenceCore> core = make_core(core_name, program);
+    mysn::CoreState state;
+    size_t count = limit < golden.size() ? limit : golden.size();
+
+    auto start = chrono::steady_clock::now();
+
+    // 引导代码
+    core->capture(state);
+    for (int i = 0; i < 2 && state.program_counter != golden[0].pc; ++i)
+    {
+        core->run_to(state.cycles + 1);
+        core->capture(state);
+    }
+
+    uint64_t base = state.cycles - golden[0].cycles;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        TraceLine actual = {state.program_counter, state.register_a, state.register_x, state.register_y,
+                            state.status, state.stack_pointer, state.cycles - base};
+        const TraceLine &expected = golden[i];
+
+        if (actual.pc != expected.pc || actual.a != expected.a || actual.x != expected.x ||
+            actual.y != expected.y || (actual.p & FLAG_MASK) != (expected.p & FLAG_MASK) ||
+            actual.sp != expected.sp || actual.cycles != expected.cycles)
+        {
+            cerr << name << " [" << core_name << "]: mismatch at line " << i + 1 << '\n';
+            write_line(cerr, "expected", expected);
+            write_line(cerr, "actual  ", actual);
+            return false;
+        }
+
+        if (i + 1 < count && (state.halted || !core->run_to(state.cycles + 1)))
+        {
+            cerr << name << " [" << core_name << "]: halted before line " << i + 2 << '\n';
+            return false;
+        }
+        core->capture(state);
+    }
+
+    double traced = seconds_since(start);
+
+    // 不比较轨迹，整段跑到同一个周期数
+    unique_ptr<mysn::DivergenceCore> fast = make_core(core_name, program);
+    start = chrono::steady_clock::now();
+    fast->run_to(state.cycles);
+    double untraced = seconds_since(start);
+
+    printf("%-24s %-6s %8zu lines  traced %8.3f ms  untraced %8.3f ms\n", name.c_str(), core_name.c_str(),
+           count, traced * 1e3, untraced * 1e3);
+    return true;
+}
+
+/**
+    C000  LDX #$05  LDY #$03  JSR $C040          ; JSR 不贯穿到 LDA
+    C007  TXA  TYA  TXS                          ; 不贯穿到 BRK
+    C00A  LDX #$FF  TXS  PHP  PLA  STA $10       ; PHP 压栈的副本带 B 标志，P 本身不变
+    C011  LDA #$77  STA $10,X  LDA $0F           ; 变址零页回绕
+    C017  LDA #0  STA $FF  LDA #3  STA $00       ; 零页指针 $FF/$00 -> $0300
+    C01F  LDA #$5A  STA $0300
+    C024  LDY #0  LDA ($FF),Y                    ; 指针高字节在零页内回绕
+    C028  LDX #0  LDA ($FF,X)                    ; 高字节从内存读
+    C02C  LDX #1  LDA $02FF,X                    ; 跨页 +1
+    C031  BNE +0  BEQ +16  JMP $C0F0             ; 成立 +1，不成立 0
+    C0F0  BNE +$20                               ; 跳到另一页 +2
+    C112  BRK
+    C040  INX  RTS
+ */
+vector<mysn::Byte> builtin_image()
+{
+    vector<mysn::Byte> image = {'N', 'E', 'S', 0x1a, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    vector<mysn::Byte> prg(0x4000, 0);
+    const mysn::Byte main[] = {0xa2, 0x05, 0xa0, 0x03, 0x20, 0x40, 0xc0,
+                               0x8a, 0x98, 0x9a,
+                               0xa2, 0xff, 0x9a, 0x08, 0x68, 0x85, 0x10,
+                               0xa9, 0x77, 0x95, 0x10, 0xa5, 0x0f,
+                               0xa9, 0x00, 0x85, 0xff, 0xa9, 0x03, 0x85, 0x00,
+                               0xa9, 0x5a, 0x8d, 0x00, 0x03,
+                               0xa0, 0x00, 0xb1, 0xff,
+                               0xa2, 0x00, 0xa1, 0xff,
+                               0xa2, 0x01, 0xbd, 0xff, 0x02,
+                               0xd0, 0x00, 0xf0, 0x10, 0x4c, 0xf0, 0xc0};
+    const mysn::Byte subroutine[] = {0xe8, 0x60};
+    const mysn::Byte far_branch[] = {0xd0, 0x20};
+
+    copy(main, main + sizeof(main), prg.begin());
+    copy(subroutine, subroutine + sizeof(subroutine), prg.begin() + 0x40);
+    copy(far_branch, far_branch + sizeof(far_branch), prg.begin() + 0xf0);
+
+    image.insert(image.end(), prg.begin(), prg.end());
+    return image;
+}
+
+// 按 6502 手册逐条算出来的，P 按 nestest 的习惯带第 5 位
+const char *const BUILTIN_TRACE =
+    "C000  A:00 X:00 Y:00 P:24 SP:FD CYC:7\n"
+    "C002  A:00 X:05 Y:00 P:24 SP:FD CYC:9\n"
+    "C004  A:00 X:05 Y:03 P:24 SP:FD CYC:11\n"
+    "C040  A:00 X:05 Y:03 P:24 SP:FB CYC:17\n"
+    "C041  A:00 X:06 Y:03 P:24 SP:FB CYC:19\n"
+    "C007  A:00 X:06 Y:03 P:24 SP:FD CYC:25\n"
+    "C008  A:06 X:06 Y:03 P:24 SP:FD CYC:27\n"
+    "C009  A:03 X:06 Y:03 P:24 SP:FD CYC:29\n"
+    "C00A  A:03 X:06 Y:03 P:24 SP:06 CYC:31\n"
+    "C00C  A:03 X:FF Y:03 P:A4 SP:06 CYC:33\n"
+    "C00D  A:03 X:FF Y:03 P:A4 SP:FF CYC:35\n"
+    "C00E  A:03 X:FF Y:03 P:A4 SP:FE CYC:38\n"
+    "C00F  A:B4 X:FF Y:03 P:A4 SP:FF CYC:42\n"
+    "C011  A:B4 X:FF Y:03 P:A4 SP:FF CYC:45\n"
+    "C013  A:77 X:FF Y:03 P:24 SP:FF CYC:47\n"
+    "C015  A:77 X:FF Y:03 P:24 SP:FF CYC:51\n"
+    "C017  A:77 X:FF Y:03 P:24 SP:FF CYC:54\n"
+    "C019  A:00 X:FF Y:03 P:26 SP:FF CYC:56\n"
+    "C01B  A:00 X:FF Y:03 P:26 SP:FF CYC:59\n"
+    "C01D  A:03 X:FF Y:03 P:24 SP:FF CYC:61\n"
+    "C01F  A:03 X:FF Y:03 P:24 SP:FF CYC:64\n"
+    "C021  A:5A X:FF Y:03 P:24 SP:FF CYC:66\n"
+    "C024  A:5A X:FF Y:03 P:24 SP:FF CYC:70\n"
+    "C026  A:5A X:FF Y:00 P:26 SP:FF CYC:72\n"
+    "C028  A:5A X:FF Y:00 P:24 SP:FF CYC:77\n"
+    "C02A  A:5A X:00 Y:00 P:26 SP:FF CYC:79\n"
+    "C02C  A:5A X:00 Y:00 P:24 SP:FF CYC:85\n"
+    "C02E  A:5A X:01 Y:00 P:24 SP:FF CYC:87\n"
+    "C031  A:5A X:01 Y:00 P:24 SP:FF CYC:92\n"
+    "C033  A:5A X:01 Y:00 P:24 SP:FF CYC:95\n"
+    "C035  A:5A X:01 Y:00 P:24 SP:FF CYC:97\n"
+    "C0F0  A:5A X:01 Y:00 P:24 SP:FF CYC:100\n"
+    "C112  A:5A X:01 Y:00 P:24 SP:FF CYC:104\n";
+
+bool read_file(const char *path, vector<mysn::Byte> &data)
+{
+    ifstream in(path, ios::binary);
+
+    if (!in)
+    {
+        return false;
+    }
+
+    data.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    return true;
+}
+
+bool run_builtin(const string &core)
+{
+    vector<TraceLine> golden;
+    istringstream trace(BUILTIN_TRACE);
+    bool parsed = parse_trace(trace, golden);
+    assert(parsed && golden.size() == 33);
+
+    return run_conformance("builtin", core, builtin_image(), golden, golden.size());
+}
+
+int main(int argc, char **argv)
+{
+    // nestest 原始格式
+    TraceLine line;
+    bool parsed = parse_trace_line("C72A  A9 00     LDA #$00                        A:00 X:00 Y:00 P:26 SP:FB PPU: 30,  0 CYC:3413", line);
+    assert(parsed && line.pc == 0xC72A && line.p == 0x26 && line.sp == 0xFB && line.cycles == 3413);
+
+    if (argc == 1)
+    {
+        bool cpu = run_builtin("cpu");
+        bool batch = run_builtin("batch");
+
+        return cpu && batch ? 0 : 1;
+    }
+
+    string core = argv[1];
+
+    if (!make_core(core, vector<mysn::Byte>()))
+    {
+        cerr << "usage: Conformance_test [cpu|batch [image.nes golden.log [lines]]]\n";
+        return 2;
+    }
+
+    if (argc == 2)
+    {
+        return run_builtin(core) ? 0 : 1;
+    }
+
+    vector<mysn::Byte> image;
+    vector<TraceLine> golden;
+    ifstream trace(argc > 3 ? argv[3] : "");
+
+    if (argc < 4 || !read_file(argv[2], image) || !trace || !parse_trace(trace, golden))
+    {
+        cerr << "cannot read image or trace\n";
+        return 2;
+    }
+
+    size_t limit = argc > 4 ? size_t(strtoull(argv[4], nullptr, 10)) : golden.size();
+
+    return run_conformance(argv[2], core, image, golden, limit) ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+#include "CPU.h"
+#include "CPURun.h"
+#include "CoverageMap.h"
+#include <vector>
+#include <assert.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+using namespace std;
+
+void run_program(mysn::CoverageMap &coverage, vector<mysn::Byte> program)
+{
+    mysn::CPU cpu = mysn::CPU();
+    cpu.load_and_run_with(program, coverage);
+}
+
+void test_marks_opcode_fetches()
+{
+    mysn::CoverageMap coverage;
+
+    // 没有跳转的 BEQ，只有操作码所在的字节被标记
+    run_program(coverage, {0xa9, 0x01, 0xf0, 0x02, 0xa2, 0x02, 0x00});
+
+    assert(coverage.covered(0x8000));
+    assert(!coverage.covered(0x8001));
+    assert(coverage.covered(0x8002));
+    assert(!coverage.covered(0x8003));
+    assert(coverage.covered(0x8004));
+    assert(coverage.covered(0x8006));
+    assert(!coverage.covered(0x8007));
+    assert(!coverage.covered(0x0000));
+    assert(coverage.covered_count() == 4);
+    assert(coverage.bank_covered_count(0) == 4);
+    assert(coverage.bank_covered_count(1) == 0);
+
+    coverage.clear();
+    assert(coverage.covered_count() == 0);
+}
+
+void test_merge()
+{
+    mysn::CoverageMap a;
+    mysn::CoverageMap b;
+
+    run_program(a, {0xa9, 0x01, 0xf0, 0x02, 0xa2, 0x02, 0x00});
+
+    vector<mysn::Byte> jump(0x12, 0x00);
+    jump[0] = 0x4c;
+    jump[1] = 0x10;
+    jump[2] = 0x80;
+    jump[0x10] = 0xe8;
+    run_program(b, jump);
+    assert(b.covered_count() == 3);
+
+    a.merge(b);
+    assert(a.covered_count() == 6);
+    assert(a.covered(0x8010) && a.covered(0x8011));
+
+    // 各指令集的合并结果一致，长度不是向量宽度的倍数
+    const size_t count = 1000;
+    vector<mysn::Byte> src(count);
+    vector<mysn::Byte> dst(count);
+    srand(7);
+    for (size_t i = 0; i < count; ++i)
+    {
+        src[i] = mysn::Byte(rand());
+        dst[i] = mysn::Byte(rand());
+    }
+
+    vector<mysn::Byte> expected(dst);
+    mysn::merge_coverage_bits(expected.data(), src.data(), count, mysn::Simd_Scalar);
+
+    const mysn::SimdLevel levels[] = {mysn::Simd_SSE2, mysn::Simd_AVX2};
+    for (mysn::SimdLevel level : levels)
+    {
+        if (level > mysn::detect_simd_level())
+        {
+            continue;
+        }
+
+        vector<mysn::Byte> merged(dst);
+        mysn::merge_coverage_bits(merged.data(), src.data(), count, level);
+        assert(merged == expected);
+    }
+}
+
+void test_save_and_load()
+{
+    const char *path = "CoverageMap_test.cov";
+    const char *bad = "CoverageMap_test_bad.cov";
+
+    mysn::CoverageMap coverage;
+    run_program(coverage, {0xa9, 0x01, 0xf0, 0x02, 0xa2, 0x02, 0x00});
+    bool saved = coverage.save(path);
+    assert(saved);
+
+    FILE *file = fopen(path, "rb");
+    assert(file != nullptr);
+    fseek(file, 0, SEEK_END);
+    assert(ftell(file) == long(16 + mysn::CoverageMap::BITMAP_BYTES));
+    fclose(file);
+
+    mysn::CoverageMap loaded;
+    bool read = loaded.load(path);
+    assert(read);
+    assert(memcmp(loaded.data(), coverage.data(), mysn::CoverageMap::BITMAP_BYTES) == 0);
+
+    // 文件头不对时保留原有内容
+    file = fopen(bad, "wb");
+    fputs("not a coverage file", file);
+    fclose(file);
+    bool read_bad = loaded.load(bad);
+    bool read_missing = loaded.load("CoverageMap_test_missing.cov");
+    assert(!read_bad && !read_missing);
+    assert(loaded.covered_count() == 4);
+
+    remove(path);
+    remove(bad);
+}
+
+void test_summary()
+{
+    mysn::CoverageMap coverage;
+    run_program(coverage, {0xa9, 0x01, 0xf0, 0x02, 0xa2, 0x02, 0x00});
+
+    ostringstream out;
+    coverage.write_summary(out);
+
+    assert(out.str() ==
+           "bank  range              covered     total         %\n"
+           "   0  $8000-$9FFF                4      8192      0.05\n"
+           "   1  $A000-$BFFF                0      8192      0.00\n"
+           "   2  $C000-$DFFF                0      8192      0.00\n"
+           "   3  $E000-$FFFF                0      8192      0.00\n"
+           "\n"
+           "total 4 of 32768 bytes (0.01%)\n");
+}
+
+int main()
+{
+    test_marks_opcode_fetches();
+    test_merge();
+    test_save_and_load();
+    test_summary();
+}
@@ -0,0 +1,184 @@
+#include "CPU.h"
+#include "CPURun.h"
+#include "Debugger.h"
+#include <vector>
+#include <assert.h>
+
+using namespace std;
+
+/**
+    $8000 LDX #0
+    $8002 INX
+    $8003 STX $10
+    $8005 CPX #5
+    $8007 BNE $8002
+    $8009 LDA $20
+    $800B STA $21
+    $800D STA $21
+    $800F BRK
+ */
+vector<uint8_t> program = {0xa2, 0x00, 0xe8, 0x86, 0x10, 0xe0, 0x05, 0xd0, 0xf9,
+                           0xa5, 0x20, 0x85, 0x21, 0x85, 0x21, 0x00};
+
+void test_breakpoint()
+{
+    mysn::CPU cpu;
+    mysn::Debugger debugger;
+    cpu.load_and_reset(program);
+
+    debugger.add_breakpoint(0x8002);
+    mysn::RunExit reason = debugger.run(cpu);
+    assert(reason == mysn::Run_Stopped);
+    assert(debugger.stop_reason() == mysn::Debug_Breakpoint);
+    assert(debugger.stop_address() == 0x8002);
+    assert(cpu.program_counter == 0x8002);
+    assert(cpu.register_x == 0);
+
+    // 从断点处继续会先执行断点处的指令
+    reason = debugger.run(cpu);
+    assert(reason == mysn::Run_Stopped);
+    assert(cpu.program_counter == 0x8002);
+    assert(cpu.register_x == 1);
+
+    debugger.remove_breakpoint(0x8002);
+    debugger.add_breakpoint(0x8009);
+    reason = debugger.run(cpu);
+    assert(reason == mysn::Run_Stopped);
+    assert(cpu.program_counter == 0x8009);
+    assert(cpu.register_x == 5);
+
+    debugger.clear();
+    reason = debugger.run(cpu);
+    assert(reason == mysn::Run_Halted);
+    assert(debugger.stop_reason() == mysn::Debug_None);
+}
+
+void test_watchpoint()
+{
+    mysn::CPU cpu;
+    mysn::Debugger debugger;
+    cpu.load_and_reset(program);
+
+    // 命中后当前指令照常执行完
+    debugger.add_watchpoint(0x0010, mysn::Watch_Change);
+    mysn::RunExit reason = debugger.run(cpu);
+    assert(reason == mysn::Run_Stopped);
+    assert(debugger.stop_reason() == mysn::Debug_Watchpoint);
+    assert(debugger.stop_address() == 0x0010);
+    assert(debugger.stop_instruction() == 0x8003);
+    assert(cpu.program_counter == 0x8005);
+    assert(cpu.peek(0x0010) == 1);
+
+    reason = debugger.run(cpu);
+    assert(reason == mysn::Run_Stopped);
+    assert(cpu.peek(0x0010) == 2);
+
+    debugger.remove_watchpoint(0x0010);
+    debugger.add_watchpoint(0x0020, mysn::Watch_Read);
+    reason = debugger.run(cpu);
+    assert(reason == mysn::Run_Stopped);
+    assert(debugger.stop_address() == 0x0020);
+    assert(debugger.stop_instruction() == 0x8009);
+    assert(cpu.register_x == 5);
+
+    // 写入的值没变，Watch_Change 不触发
+    debugger.add_watchpoint(0x0021, mysn::Watch_Change);
+    reason = debugger.run(cpu);
+    assert(reason == mysn::Run_Halted);
+    assert(debugger.stop_reason() == mysn::Debug_None);
+
+    cpu.load_and_reset(program);
+    debugger.clear();
+    debugger.add_watchpoint(0x0021, mysn::Watch_Write);
+    reason = debugger.run(cpu);
+    assert(reason == mysn::Run_Stopped);
+    assert(debugger.stop_instruction() == 0x800b);
+    reason = debugger.run(cpu);
+    assert(reason == mysn::Run_Stopped);
+    assert(debugger.stop_instruction() == 0x800d);
+
+    // run 返回后页表恢复，观察点不再生效
+    mysn::NullPolicy policy;
+    cpu.load_and_reset(program);
+    reason = cpu.run_with(policy);
+    assert(reason == mysn::Run_Halted);
+}
+
+void test_watchpoint_through_mirror()
+{
+    /**
+        $8000 LDA #$42
+        $8002 STA $08FF
+        $8005 STA $18FF
+        $8008 LDA $10FF
+        $800B BRK
+     */
+    vector<uint8_t> mirrored = {0xa9, 0x42, 0x8d, 0xff, 0x08, 0x8d, 0xff, 0x18, 0xad, 0xff, 0x10, 0x00};
+
+    mysn::CPU cpu;
+    mysn::Debugger debugger;
+    cpu.load_and_reset(mirrored);
+
+    // $00FF 的观察点对 $08FF 的写入同样生效
+    debugger.add_watchpoint(0x00FF, mysn::Watch_Change);
+    mysn::RunExit reason = debugger.run(cpu);
+    assert(reason == mysn::Run_Stopped);
+    assert(debugger.stop_reason() == mysn::Debug_Watchpoint);
+    assert(debugger.stop_address() == 0x00FF);
+    assert(debugger.stop_instruction() == 0x8002);
+    assert(cpu.peek(0x00FF) == 0x42);
+
+    // 在另一个镜像上加的读观察点，经 $10FF 读取时命中；STA $18FF 不触发读观察点
+    debugger.clear();
+    debugger.add_watchpoint(0x18FF, mysn::Watch_Read);
+    reason = debugger.run(cpu);
+    assert(reason == mysn::Run_Stopped);
+    assert(debugger.stop_address() == 0x00FF);
+    assert(debugger.stop_instruction() == 0x8008);
+    assert(cpu.register_a == 0x42);
+
+    // 从任一镜像都能删掉
+    debugger.remove_watchpoint(0x08FF);
+    cpu.load_and_reset(mirrored);
+    reason = debugger.run(cpu);
+    assert(reason == mysn::Run_Halted);
+}
+
+void test_cycle_limit()
+{
+    mysn::CPU cpu;
+    mysn::Debugger debugger;
+    cpu.load_and_reset(program);
+
+    debugger.set_cycle_limit(10);
+    mysn::RunExit reason = debugger.run(cpu);
+    assert(reason == mysn::Run_Stopped);
+    assert(debugger.stop_reason() == mysn::Debug_Cycle_Limit);
+    assert(cpu.cycles >= 10 && cpu.cycles < 16);
+
+    debugger.set_cycle_limit(0);
+    reason = debugger.run(cpu);
+    assert(reason == mysn::Run_Halted);
+}
+
+void test_run_until()
+{
+    mysn::CPU cpu;
+    cpu.load_and_reset(program);
+
+    mysn::RunExit reason = mysn::run_until(cpu, [](const mysn::CPU &cpu) { return cpu.peek(0x0010) == 3; });
+    assert(reason == mysn::Run_Stopped);
+    assert(cpu.register_x == 3);
+    assert(cpu.program_counter == 0x8005);
+}
+
+int main()
+{
+    test_breakpoint();
+    test_watchpoint();
+    test_watchpoint_through_mirror();
+    test_cycle_limit();
+    test_run_until();
+
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include "Divergence.h"
+#include <cstdio>
+#include <sstream>
+#include <vector>
+#include <assert.h>
+
+using namespace std;
+
+/**
+          LDX #0
+    loop: STX $00  LDA $00  STA $0200,X  ADC $10  STA $10
+          INX  BNE loop
+          LDA #$55  STA $8040     ; 写 ROM：CPU 复制出自己的一份，BatchCPU 忽略
+          LDA $8040  STA $11      ; 两边从这里开始不同
+          BRK
+ */
+vector<uint8_t> rom_write_program()
+{
+    vector<uint8_t> program = {0xa2, 0x00,
+                               0x86, 0x00, 0xa5, 0x00, 0x9d, 0x00, 0x02, 0x65, 0x10, 0x85, 0x10,
+                               0xe8, 0xd0, 0xf2,
+                               0xa9, 0x55, 0x8d, 0x40, 0x80,
+                               0xad, 0x40, 0x80, 0x85, 0x11,
+                               0x00};
+    return program;
+}
+
+vector<uint8_t> loop_program()
+{
+    vector<uint8_t> program = rom_write_program();
+    program.resize(16);
+    program.push_back(0x00);
+    return program;
+}
+
+void test_agreeing_cores()
+{
+    vector<uint8_t> program = loop_program();
+    mysn::CPUCore reference(mysn::make_rom(program));
+    mysn::BatchCPUCore candidate(program);
+
+    mysn::Divergence divergence = mysn::find_divergence(reference, candidate, 1000, 1000000);
+    assert(!divergence.found);
+
+    mysn::CoreState state;
+    candidate.capture(state);
+    assert(state.halted);
+    assert(state.memory[0x2ff] == 0xff);
+
+    stringstream out;
+    mysn::write_divergence(out, divergence);
+    assert(out.str() == "no divergence\n");
+}
+
+void test_first_divergent_instruction()
+{
+    vector<uint8_t> program = rom_write_program();
+    mysn::CPUCore reference(mysn::make_rom(program));
+    mysn::BatchCPUCore candidate(program);
+
+    mysn::Divergence divergence = mysn::find_divergence(reference, candidate, 1000, 1000000);
+    assert(divergence.found);
+    assert(divergence.before.program_counter == 0x8015);
+    assert(divergence.before.instruction[0] == 0xad);
+    assert(divergence.before.cycles + 1 == divergence.cycle);
+    assert(divergence.reference.register_a == 0x55);
+    assert(divergence.candidate.register_a == 0x00);
+    assert(divergence.reference.program_counter == divergence.candidate.program_counter);
+
+    stringstream out;
+    mysn::write_divergence(out, divergence);
+    assert(out.str().find("instruction at $8015: ad 40 80") != string::npos);
+    assert(out.str().find("reference: PC:8018 A:55") != string::npos);
+    assert(out.str().find("candidate: PC:8018 A:00") != string::npos);
+}
+
+void test_hash_chain()
+{
+    vector<uint8_t> program = rom_write_program();
+    mysn::CPUCore recorder(mysn::make_rom(program));
+    mysn::HashChain chain = mysn::record_hash_chain(recorder, 500, 1000000);
+    assert(chain.links.size() > 2);
+
+    const char *path = "Divergence_test.chain";
+    mysn::HashChain loaded;
+    bool saved = chain.save(path);
+    bool read = loaded.load(path);
+    assert(saved && read);
+    assert(loaded.interval == 500 && loaded.links == chain.links);
+    remove(path);
+
+    // 同一个核心和链完全一致
+    mysn::CPUCore same(mysn::make_rom(program));
+    mysn::CPUCore same_reference(mysn::make_rom(program));
+    mysn::Divergence none = mysn::find_divergence(same_reference, same, loaded);
+    assert(!none.found);
+
+    // 从链找到的和两个核心并排跑找到的是同一条指令
+    mysn::CPUCore reference(mysn::make_rom(program));
+    mysn::BatchCPUCore candidate(program);
+    mysn::Divergence divergence = mysn::find_divergence(reference, candidate, loaded);
+    assert(divergence.found);
+    assert(divergence.before.program_counter == 0x8015);
+    assert(divergence.reference.register_a == 0x55 && divergence.candidate.register_a == 0x00);
+}
+
+int main()
+{
+    test_agreeing_cores();
+    test_first_divergent_instruction();
+    test_hash_chain();
+
+    return 0;
+}
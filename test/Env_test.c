@@ -0,0 +1,121 @@
+#include "mysn_env.h"
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#define COUNT 37
+
+/* 轮询手柄：按 A 时 $10 置 1，按 B 时 BRK；每一轮把 $10 写到 $0200，再 OAM DMA 第 2 页 */
+static const uint8_t program[] = {
+    0xA9, 0x01, 0x8D, 0x16, 0x40, 0xA9, 0x00, 0x8D, 0x16, 0x40,
+    0xAD, 0x16, 0x40, 0x29, 0x01, 0xF0, 0x04, 0xA9, 0x01, 0x85, 0x10,
+    0xAD, 0x16, 0x40, 0x29, 0x01, 0xD0, 0x0C,
+    0xA5, 0x10, 0x8D, 0x00, 0x02, 0xA9, 0x02, 0x8D, 0x14, 0x40, 0xD0, 0xD8,
+    0x00};
+
+static int all_zero(const uint8_t *data, size_t size)
+{
+    size_t i;
+
+    for (i = 0; i < size; ++i)
+    {
+        if (data[i] != 0)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void test_step_and_views(void)
+{
+    mysn_batch *batch = mysn_create_batch(COUNT, program, sizeof(program), 4);
+    uint8_t actions[COUNT];
+    const uint8_t *ram[COUNT];
+    const uint8_t *frame[COUNT];
+    const uint8_t *done;
+    size_t i;
+
+    assert(batch != NULL);
+    assert(mysn_batch_size(batch) == COUNT);
+
+    for (i = 0; i < COUNT; ++i)
+    {
+        actions[i] = i % 3 == 0 ? 1 : (i % 3 == 1 ? 2 : 0);
+        ram[i] = mysn_ram(batch, i);
+        frame[i] = mysn_frame(batch, i);
+        assert(mysn_cycles(batch, i) == 0);
+    }
+    done = mysn_done(batch);
+
+    mysn_step(batch, actions, 2);
+
+    for (i = 0; i < COUNT; ++i)
+    {
+        /* 视图的地址在 step 前后不变 */
+        assert(mysn_ram(batch, i) == ram[i]);
+        assert(mysn_frame(batch, i) == frame[i]);
+
+        assert(done[i] == (i % 3 == 1));
+        if (!done[i])
+        {
+            assert(ram[i][0x10] == (i % 3 == 0));
+            assert(frame[i][0] == ram[i][0x10]);
+            assert(mysn_cycles(batch, i) >= 2 * 29781);
+        }
+    }
+
+    /* 结束的实例不再执行 */
+    {
+        uint64_t cycles = mysn_cycles(batch, 1);
+        mysn_step(batch, NULL, 1);
+        assert(mysn_cycles(batch, 1) == cycles);
+        assert(done[1] == 1);
+    }
+
+    mysn_reset(batch, NULL);
+    assert(mysn_done(batch) == done);
+    for (i = 0; i < COUNT; ++i)
+    {
+        assert(done[i] == 0);
+        assert(all_zero(ram[i], MYSN_RAM_SIZE));
+        assert(mysn_cycles(batch, i) == 0);
+    }
+
+    mysn_destroy_batch(batch);
+}
+
+static void test_seeds(void)
+{
+    uint64_t seeds[2] = {0, 7};
+    uint8_t first[MYSN_RAM_SIZE];
+    mysn_batch *batch = mysn_create_batch(2, program, sizeof(program), 1);
+
+    assert(batch != NULL);
+
+    mysn_reset(batch, seeds);
+    assert(all_zero(mysn_ram(batch, 0), MYSN_RAM_SIZE));
+    assert(!all_zero(mysn_ram(batch, 1), MYSN_RAM_SIZE));
+    memcpy(first, mysn_ram(batch, 1), MYSN_RAM_SIZE);
+
+    /* 同一个种子得到同样的上电 RAM */
+    mysn_reset(batch, seeds);
+    assert(memcmp(first, mysn_ram(batch, 1), MYSN_RAM_SIZE) == 0);
+
+    mysn_destroy_batch(batch);
+}
+
+int main(void)
+{
+    assert(mysn_env_version() == MYSN_ENV_VERSION);
+    assert(mysn_create_batch(1, NULL, 4, 1) == NULL);
+    /* 放不下的实例数返回 NULL，不会有异常穿过 C 接口 */
+    assert(mysn_create_batch(SIZE_MAX, program, sizeof(program), 1) == NULL);
+    assert(mysn_create_batch(SIZE_MAX / 2, program, sizeof(program), 1) == NULL);
+
+    test_step_and_views();
+    test_seeds();
+
+    return 0;
+}
@@ -0,0 +1,204 @@
+#include "CPU.h"
+#include "CPURun.h"
+#include "Explorer.h"
+#include "ForkServer.h"
+#include "Joypad.h"
+#include <vector>
+#include <assert.h>
+#include <atomic>
+#include <thread>
+
+using namespace std;
+
+/**
+    loop: LDA #$01
+          STA $4016
+          LDA #$00
+          STA $4016
+          LDX #$08
+    read: LDA $4016
+          LSR A
+          ROR $11     ; 本帧的按键
+          DEX
+          BNE read
+          LDA $11
+          ORA $12     ; 按过的键
+          STA $12
+          CMP #$FF
+          BNE loop
+          BRK         ; 8 个键都按过
+ */
+vector<uint8_t> buttons_program()
+{
+    return {
+        0xa9, 0x01, 0x8d, 0x16, 0x40, 0xa9, 0x00, 0x8d, 0x16, 0x40,
+        0xa2, 0x08,
+        0xad, 0x16, 0x40, 0x4a, 0x66, 0x11, 0xca, 0xd0, 0xf7,
+        0xa5, 0x11, 0x05, 0x12, 0x85, 0x12,
+        0xc9, 0xff, 0xd0, 0xe1,
+        0x00,
+    };
+}
+
+struct CycleLimit
+{
+    uint64_t limit;
+    bool reached;
+
+    void before_instruction(mysn::CPU &, mysn::Byte) {}
+
+    void after_instruction(mysn::CPU &cpu, mysn::Byte, bool)
+    {
+        if (cpu.cycles >= limit)
+        {
+            reached = true;
+            cpu.request_stop();
+        }
+    }
+};
+
+// 按与 Explorer 相同的帧切分重放，返回程序是否结束
+bool replay(mysn::CPU cpu, const vector<uint8_t> &inputs, uint8_t &pressed)
+{
+    mysn::Joypad joypad;
+    cpu.attach_joypad(0, &joypad);
+
+    for (uint8_t buttons : inputs)
+    {
+        joypad.set_buttons(buttons);
+        CycleLimit policy = {(cpu.cycles / mysn::CYCLES_PER_FRAME + 1) * mysn::CYCLES_PER_FRAME, false};
+        cpu.run_with(policy);
+
+        if (!policy.reached)
+        {
+            pressed = cpu.peek(0x12);
+            return true;
+        }
+    }
+
+    pressed = cpu.peek(0x12);
+    return false;
+}
+
+void test_state_hash_set()
+{
+    mysn::StateHashSet set(100);
+    assert(set.capacity() == 128);
+
+    bool first = set.insert(42);
+    bool again = set.insert(42);
+    assert(first && !again);
+    assert(set.contains(42));
+    assert(!set.contains(43));
+
+    // 0 也是合法的哈希
+    first = set.insert(0);
+    again = set.insert(0);
+    assert(first && !again);
+
+    // 装到 7/8 后拒绝插入
+    for (uint64_t i = 1000; i < 1200; ++i)
+    {
+        set.insert(i * 0x9e3779b97f4a7c15ull);
+    }
+    assert(set.size() == 112);
+    assert(set.dropped() > 0);
+
+    // 多线程插入同一批哈希，每个只成功一次
+    mysn::StateHashSet shared(1 << 16);
+    atomic<int> inserted(0);
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.push_back(thread([&]() {
+            for (uint64_t i = 1; i <= 10000; ++i)
+            {
+                if (shared.insert(i * 0x9e3779b97f4a7c15ull))
+                {
+                    ++inserted;
+                }
+            }
+        }));
+    }
+    for (thread &t : threads)
+    {
+        t.join();
+    }
+    assert(inserted == 10000);
+    assert(shared.size() == 10000);
+}
+
+void test_explore_finds_halt()
+{
+    mysn::CPU cpu = mysn::CPU();
+    vector<uint8_t> program = buttons_program();
+    cpu.load_and_reset(program);
+
+    mysn::ExploreConfig config;
+    config.threads = 4;
+    config.frames_per_step = 2;
+    config.sequences_per_state = 4;
+    config.max_frontier = 64;
+    config.visited_capacity = 1 << 12;
+    config.max_expansions = 50;
+    config.features = {0x11, 0x12};
+    config.goal = [](const mysn::CPU &state) { return state.peek(0x12) == 0x0f; };
+
+    mysn::Explorer explorer(cpu, config);
+    explorer.run();
+
+    assert(explorer.expansions() <= 50);
+    assert(explorer.visited() > 1);
+    assert(explorer.frontier_size() <= 64);
+
+    vector<mysn::ExploreFinding> findings = explorer.findings();
+    bool halted = false;
+    for (const mysn::ExploreFinding &finding : findings)
+    {
+        uint8_t pressed = 0;
+        bool ended = replay(cpu, finding.inputs, pressed);
+
+        if (finding.event == mysn::Explore_Halted)
+        {
+            assert(ended && pressed == 0xff);
+            halted = true;
+        }
+        else
+        {
+            assert(!ended && pressed == 0x0f);
+        }
+    }
+    assert(halted);
+
+    // 根状态不受影响
+    assert(cpu.cycles == 0 && cpu.peek(0x12) == 0);
+}
+
+void test_duplicates_are_dropped()
+{
+    // 不读手柄的程序每次扩展的几个序列结果都相同，只有一个新状态
+    mysn::CPU cpu = mysn::CPU();
+    vector<uint8_t> program = {0xe8, 0xd0, 0xfd, 0xc8, 0x4c, 0x00, 0x80};
+    cpu.load_and_reset(program);
+
+    mysn::ExploreConfig config;
+    config.threads = 2;
+    config.frames_per_step = 1;
+    config.sequences_per_state = 3;
+    config.visited_capacity = 1 << 10;
+    config.max_expansions = 10;
+
+    mysn::Explorer explorer(cpu, config);
+    explorer.run();
+
+    assert(explorer.expansions() == 10);
+    assert(explorer.visited() == 11);
+    assert(explorer.findings().empty());
+}
+
+int main()
+{
+    test_state_hash_set();
+    test_explore_finds_halt();
+    test_duplicates_are_dropped();
+}
@@ -0,0 +1,159 @@
+#include "CPU.h"
+#include "FlightRecorder.h"
+#include <vector>
+#include <assert.h>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+string read_file(const char *path)
+{
+    string text;
+    FILE *file = fopen(path, "rb");
+    assert(file != nullptr);
+
+    int c;
+    while ((c = fgetc(file)) != EOF)
+    {
+        text.push_back(char(c));
+    }
+    fclose(file);
+
+    return text;
+}
+
+void test_records_every_instruction()
+{
+    mysn::CPU cpu = mysn::CPU();
+    vector<mysn::Byte> program = {0xa9, 0x05, 0xaa, 0xe8, 0x00};
+
+    cpu.load_and_run(program);
+
+    vector<mysn::FlightRecord> records = cpu.flight_recorder.snapshot();
+    assert(records.size() == 4);
+    assert(cpu.flight_recorder.total_recorded() == 4);
+
+    // 记录的是指令执行前的状态
+    assert(records[0].pc == 0x8000 && records[0].opcode == 0xa9 && records[0].a == 0x00);
+    assert(records[1].pc == 0x8002 && records[1].opcode == 0xaa && records[1].a == 0x05);
+    assert(records[2].pc == 0x8003 && records[2].opcode == 0xe8 && records[2].x == 0x05);
+    assert(records[3].pc == 0x8004 && records[3].opcode == 0x00 && records[3].x == 0x06);
+    assert(records[3].sp == 0xfd);
+    assert(records[0].cycles < records[1].cycles && records[2].cycles < records[3].cycles);
+}
+
+void test_ring_keeps_latest()
+{
+    mysn::CPU cpu = mysn::CPU();
+    cpu.flight_recorder.set_capacity(6);
+    assert(cpu.flight_recorder.capacity() == 8);
+
+    // 20 次 INX 后 BRK
+    vector<mysn::Byte> program(20, 0xe8);
+    program.push_back(0x00);
+    cpu.load_and_run(program);
+
+    vector<mysn::FlightRecord> records = cpu.flight_recorder.snapshot();
+    assert(cpu.flight_recorder.total_recorded() == 21);
+    assert(records.size() == 8);
+    assert(records.front().pc == 0x8000 + 13 && records.front().x == 13);
+    assert(records.back().pc == 0x8000 + 20 && records.back().opcode == 0x00);
+
+    // 复制的 CPU 带着自己的一份记录
+    mysn::CPU copy = cpu;
+    cpu.flight_recorder.clear();
+    assert(cpu.flight_recorder.snapshot().empty());
+    assert(copy.flight_recorder.snapshot().size() == 8);
+}
+
+void test_invalid_opcode_dump()
+{
+    const char *path = "FlightRecorder_test_fault.log";
+
+    mysn::CPU cpu = mysn::CPU();
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    cpu.flight_recorder.set_dump_fd(fd);
+
+    vector<mysn::Byte> program = {0xa9, 0x7f, 0x02};
+    cpu.load_and_run(program);
+    close(fd);
+
+    assert(read_file(path) ==
+           "flight recorder: invalid opcode, last 2 of 2 instructions\n"
+           "8000  A9  A:00 X:00 Y:00 P:00 SP:FD CYC:0\n"
+           "8002  02  A:7F X:00 Y:00 P:00 SP:FD CYC:2\n");
+    remove(path);
+
+    // fd < 0 时不写
+    cpu.flight_recorder.set_dump_fd(-1);
+    cpu.load_and_run(program);
+    assert(cpu.flight_recorder.total_recorded() == 4);
+}
+
+void test_crash_handler()
+{
+    const char *path = "FlightRecorder_test_crash.log";
+
+    pid_t pid = fork();
+    assert(pid >= 0);
+
+    if (pid == 0)
+    {
+        mysn::FlightRecorder::install_crash_handler();
+
+        mysn::CPU cpu = mysn::CPU();
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        cpu.flight_recorder.set_dump_fd(fd);
+
+        vector<mysn::Byte> program = {0xa0, 0x03, 0x00};
+        cpu.load_and_run(program);
+        abort();
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+
+    string text = read_file(path);
+    assert(text.compare(0, 44, "flight recorder: abort, last 2 of 2 instruct") == 0);
+    assert(text.find("8002  00  A:00 X:00 Y:03") != string::npos);
+    remove(path);
+}
+
+void test_long_reason_truncated()
+{
+    const char *path = "FlightRecorder_test_long.log";
+
+    mysn::CPU cpu = mysn::CPU();
+    vector<mysn::Byte> program = {0xe8, 0x00};
+    cpu.load_and_run(program);
+
+    // 原因装满一行的缓冲，后面的计数截掉而不是写出界
+    string reason(200, 'r');
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    assert(fd >= 0);
+    cpu.flight_recorder.dump(fd, reason.c_str());
+    close(fd);
+
+    string text = read_file(path);
+    assert(text.compare(0, 17, "flight recorder: ") == 0);
+    assert(text.find("8000  E8  A:00 X:00") != string::npos);
+    assert(text.find(" instructions\n") == string::npos);
+    remove(path);
+}
+
+int main()
+{
+    test_records_every_instruction();
+    test_ring_keeps_latest();
+    test_invalid_opcode_dump();
+    test_crash_handler();
+    test_long_reason_truncated();
+}
@@ -0,0 +1,110 @@
+#include "CPU.h"
+#include "ForkServer.h"
+#include "Joypad.h"
+#include <vector>
+#include <assert.h>
+
+using namespace std;
+
+/**
+    loop: LDA #$01
+          STA $4016
+          LDA #$00
+          STA $4016
+          LDA $4016   ; A 键
+          AND #$01
+          BEQ skip
+          INC $10
+    skip: LDA $4016   ; B 键
+          AND #$01
+          BEQ loop
+          BRK
+ */
+vector<uint8_t> counter_program()
+{
+    return {
+        0xa9, 0x01, 0x8d, 0x16, 0x40, 0xa9, 0x00, 0x8d, 0x16, 0x40,
+        0xad, 0x16, 0x40, 0x29, 0x01,
+        0xf0, 0x02,
+        0xe6, 0x10,
+        0xad, 0x16, 0x40, 0x29, 0x01,
+        0xf0, 0xe6,
+        0x00,
+    };
+}
+
+void test_boot_then_fork()
+{
+    mysn::CPU cpu = mysn::CPU();
+    mysn::Joypad joypad;
+    cpu.attach_joypad(0, &joypad);
+
+    vector<uint8_t> program = counter_program();
+    cpu.load_and_reset(program);
+
+    mysn::ForkServer server(cpu, &joypad);
+    bool reached = server.run_to_pc(0x8013, 1000);
+    assert(reached);
+    assert(cpu.program_counter == 0x8013);
+    reached = server.run_to_frame(3);
+    assert(reached);
+    assert(server.frame() == 3);
+
+    uint64_t boot_cycles = cpu.cycles;
+    uint64_t boot_hash = mysn::ram_hash(cpu);
+
+    vector<vector<uint8_t>> cases = {
+        {0, 0, 0},
+        {mysn::Button_A, 0, mysn::Button_A, 0},
+        {0, 0, 0},
+        {mysn::Button_A, 0, mysn::Button_A, 0},
+        {0, mysn::Button_B, 0, 0},
+    };
+    vector<mysn::ForkResult> results = server.run_cases(cases, 2);
+    assert(results.size() == cases.size());
+
+    // 没按键时 RAM 不变
+    assert(results[0].outcome == mysn::Fork_Completed);
+    assert(results[0].frames == 3);
+    assert(results[0].ram_hash == boot_hash);
+    assert(results[0].cycles >= 6 * mysn::CYCLES_PER_FRAME);
+
+    // 按过 A 的用例 RAM 变了，同样的输入结果相同
+    assert(results[1].outcome == mysn::Fork_Completed);
+    assert(results[1].frames == 4);
+    assert(results[1].ram_hash != boot_hash);
+    assert(results[1].ram_hash == results[3].ram_hash);
+    assert(results[1].cycles == results[3].cycles);
+    assert(results[0].ram_hash == results[2].ram_hash);
+
+    // 第 2 帧按 B 后 BRK
+    assert(results[4].outcome == mysn::Fork_Halted);
+    assert(results[4].frames == 1);
+
+    // 子进程的执行不影响父进程
+    assert(cpu.cycles == boot_cycles);
+    assert(mysn::ram_hash(cpu) == boot_hash);
+    assert(joypad.buttons() == 0);
+
+    mysn::ForkResult single = server.run_case(cases[1]);
+    assert(single.outcome == mysn::Fork_Completed);
+    assert(single.ram_hash == results[1].ram_hash);
+}
+
+void test_program_ends_before_target()
+{
+    mysn::CPU cpu = mysn::CPU();
+    vector<uint8_t> program = {0xe8, 0x00};
+    cpu.load_and_reset(program);
+
+    mysn::ForkServer server(cpu, nullptr);
+    bool reached = server.run_to_frame(1);
+    assert(!reached);
+    assert(cpu.register_x == 1);
+}
+
+int main()
+{
+    test_boot_then_fork();
+    test_program_ends_before_target();
+}
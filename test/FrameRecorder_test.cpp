@@ -0,0 +1,244 @@
+#include "FrameRecorder.h"
+#include <vector>
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+vector<uint8_t> read_file(const char *path)
+{
+    vector<uint8_t> data;
+    FILE *file = fopen(path, "rb");
+    assert(file != nullptr);
+
+    int c;
+    while ((c = fgetc(file)) != EOF)
+    {
+        data.push_back(uint8_t(c));
+    }
+    fclose(file);
+
+    return data;
+}
+
+void fill_frame(uint8_t *rgb, size_t bytes, int frame)
+{
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        rgb[i] = uint8_t(frame * 7 + i);
+    }
+}
+
+// 每帧等待外部放行，用来模拟写盘跟不上
+class GatedEncoder : public mysn::FrameEncoder
+{
+public:
+    atomic<bool> open_gate;
+    atomic<int> frames;
+    int delay_ms;
+
+    GatedEncoder(bool gate_open, int delay_ms) : open_gate(gate_open), frames(0), delay_ms(delay_ms) {}
+
+    bool is_open() const { return true; }
+
+    void write_frame(const uint8_t *)
+    {
+        while (!open_gate.load())
+        {
+            this_thread::yield();
+        }
+        this_thread::sleep_for(chrono::milliseconds(delay_ms));
+        ++frames;
+    }
+};
+
+void test_ring_order_and_capacity()
+{
+    mysn::FrameRing ring(4, 2);
+    assert(ring.front() == nullptr);
+
+    uint8_t *a = ring.acquire();
+    a[0] = 1;
+    ring.publish();
+    uint8_t *b = ring.acquire();
+    b[0] = 2;
+    ring.publish();
+
+    // 满了
+    assert(ring.acquire() == nullptr);
+
+    assert(ring.front()[0] == 1);
+    ring.release();
+
+    // 释放的缓冲被复用
+    assert(ring.acquire() == a);
+    ring.publish();
+
+    assert(ring.front()[0] == 2);
+    ring.release();
+    ring.front();
+    ring.release();
+    assert(ring.front() == nullptr);
+}
+
+void test_raw_rgb_recording()
+{
+    const char *path = "FrameRecorder_test_output.rgb";
+    const int width = 8, height = 4, count = 20;
+    const size_t bytes = width * height * 3;
+
+    {
+        mysn::FrameRecorder recorder(mysn::make_frame_encoder(mysn::Frame_Raw_RGB, path, width, height),
+                                     width, height, mysn::Block_When_Full, 3);
+
+        for (int f = 0; f < count; ++f)
+        {
+            uint8_t *rgb = recorder.begin_frame();
+            assert(rgb != nullptr);
+            fill_frame(rgb, bytes, f);
+            recorder.end_frame();
+        }
+
+        recorder.close();
+        assert(recorder.frames_written() == count);
+        assert(recorder.frames_dropped() == 0);
+    }
+
+    vector<uint8_t> data = read_file(path);
+    assert(data.size() == bytes * count);
+
+    vector<uint8_t> expected(bytes);
+    for (int f = 0; f < count; ++f)
+    {
+        fill_frame(&expected[0], bytes, f);
+        assert(memcmp(&data[f * bytes], &expected[0], bytes) == 0);
+    }
+
+    remove(path);
+}
+
+void test_y4m_recording()
+{
+    const char *path = "FrameRecorder_test_output.y4m";
+    const int width = 4, height = 2;
+
+    {
+        mysn::FrameRecorder recorder(mysn::make_frame_encoder(mysn::Frame_Y4M, path, width, height),
+                                     width, height);
+
+        for (int f = 0; f < 2; ++f)
+        {
+            uint8_t *rgb = recorder.begin_frame();
+            memset(rgb, f == 0 ? 128 : 255, width * height * 3);
+            recorder.end_frame();
+        }
+    }
+
+    vector<uint8_t> data = read_file(path);
+    const char *header = "YUV4MPEG2 W4 H2 F39375000:655171 Ip A1:1 C420jpeg\n";
+    size_t header_size = strlen(header);
+    size_t frame_size = 6 + 4 * 2 + 2 * 2 * 1;
+
+    assert(data.size() == header_size + 2 * frame_size);
+    assert(memcmp(&data[0], header, header_size) == 0);
+    assert(memcmp(&data[header_size], "FRAME\n", 6) == 0);
+
+    // 灰色：亮度不变，色度居中
+    for (size_t i = 0; i < 8 + 4; ++i)
+    {
+        assert(data[header_size + 6 + i] == 128);
+    }
+    assert(data[header_size + frame_size + 6] == 255);
+
+    remove(path);
+}
+
+void test_png_recording()
+{
+    const int width = 3, height = 2;
+
+    {
+        mysn::FrameRecorder recorder(mysn::make_frame_encoder(mysn::Frame_PNG, "FrameRecorder_test", width, height),
+                                     width, height);
+
+        for (int f = 0; f < 2; ++f)
+        {
+            fill_frame(recorder.begin_frame(), width * height * 3, f);
+            recorder.end_frame();
+        }
+    }
+
+    const char *paths[] = {"FrameRecorder_test_000000.png", "FrameRecorder_test_000001.png"};
+    const uint8_t signature[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+
+    for (const char *path : paths)
+    {
+        vector<uint8_t> data = read_file(path);
+
+        assert(data.size() > 8 + 25 + 12 + 12);
+        assert(memcmp(&data[0], signature, 8) == 0);
+        assert(memcmp(&data[12], "IHDR", 4) == 0);
+        assert(data[19] == width && data[23] == height);
+        assert(memcmp(&data[data.size() - 8], "IEND", 4) == 0);
+
+        remove(path);
+    }
+}
+
+void test_drop_policy_never_blocks()
+{
+    GatedEncoder *encoder = new GatedEncoder(false, 0);
+    mysn::FrameRecorder recorder(unique_ptr<mysn::FrameEncoder>(encoder), 2, 2, mysn::Drop_When_Full, 2);
+
+    int accepted = 0;
+    for (int f = 0; f < 10; ++f)
+    {
+        uint8_t *rgb = recorder.begin_frame();
+        if (rgb != nullptr)
+        {
+            recorder.end_frame();
+            ++accepted;
+        }
+    }
+
+    // 写盘线程卡住时最多容纳环里的 2 帧加上正在写的 1 帧
+    assert(accepted <= 3);
+    assert(recorder.frames_dropped() == uint64_t(10 - accepted));
+
+    encoder->open_gate = true;
+    recorder.close();
+    assert(recorder.frames_written() == uint64_t(accepted));
+}
+
+void test_block_policy_keeps_every_frame()
+{
+    GatedEncoder *encoder = new GatedEncoder(true, 1);
+    mysn::FrameRecorder recorder(unique_ptr<mysn::FrameEncoder>(encoder), 2, 2, mysn::Block_When_Full, 2);
+
+    for (int f = 0; f < 20; ++f)
+    {
+        uint8_t *rgb = recorder.begin_frame();
+        assert(rgb != nullptr);
+        recorder.end_frame();
+    }
+
+    recorder.close();
+    assert(recorder.frames_written() == 20);
+    assert(recorder.frames_dropped() == 0);
+    assert(encoder->frames == 20);
+}
+
+int main()
+{
+    test_ring_order_and_capacity();
+    test_raw_rgb_recording();
+    test_y4m_recording();
+    test_png_recording();
+    test_drop_policy_never_blocks();
+    test_block_policy_keeps_every_frame();
+}
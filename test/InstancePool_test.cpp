@@ -0,0 +1,173 @@
+#include "CPU.h"
+#include "InstancePool.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <assert.h>
+
+using namespace std;
+
+// 统计堆分配次数，检查稳态下的执行和复位不分配内存
+std::atomic<size_t> allocations(0);
+
+void *operator new(size_t size)
+{
+    ++allocations;
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+/**
+    LDA $10
+    CLC
+    ADC #1
+    STA $10        ; 每轮 $10 加一
+    STA $6000
+    LDA $4016      ; 读手柄
+    STA $11
+    JMP $8000
+ */
+vector<uint8_t> program = {0xa5, 0x10, 0x18, 0x69, 0x01, 0x85, 0x10, 0x8d, 0x00, 0x60,
+                           0xad, 0x16, 0x40, 0x85, 0x11, 0x4c, 0x00, 0x80};
+
+void test_reset_to_power_on()
+{
+    mysn::SharedRom rom = mysn::make_rom(program);
+    mysn::InstancePool pool(5, rom);
+    assert(pool.size() == 5);
+
+    for (size_t i = 0; i < pool.size(); ++i)
+    {
+        mysn::PoolInstance &instance = pool.instance(i);
+        assert(instance.cpu.program_counter == 0x8000);
+        assert(instance.cpu.cycles == 0);
+        // 实例之间互不重叠
+        assert(i == 0 || &instance.cpu != &pool.instance(i - 1).cpu);
+    }
+
+    mysn::RunBudget budget = {0, 0, true};
+    mysn::PoolInstance &instance = pool.instance(3);
+    instance.joypad.set_buttons(mysn::Button_A);
+    assert(instance.cpu.run_for(budget) == mysn::Run_Frame_End);
+    assert(instance.cpu.peek(0x10) != 0 && instance.cpu.peek(0x6000) == instance.cpu.peek(0x10));
+
+    pool.reset(3);
+    assert(instance.cpu.program_counter == 0x8000);
+    assert(instance.cpu.cycles == 0);
+    assert(instance.cpu.peek(0x10) == 0 && instance.cpu.peek(0x6000) == 0);
+    assert(instance.joypad.buttons() == 0);
+    // 手柄还挂在原来的实例上，读 $4016 的高位是 $40
+    instance.cpu.run_for(budget);
+    assert((instance.cpu.peek(0x11) & 0x40) != 0);
+}
+
+void test_reset_to_snapshot()
+{
+    mysn::InstancePool pool(4, mysn::make_rom(program));
+    mysn::RunBudget budget = {0, 0, true};
+
+    pool.instance(0).cpu.run_for(budget);
+    pool.set_snapshot(pool.instance(0));
+    mysn::Byte counter = pool.instance(0).cpu.peek(0x10);
+    uint64_t cycles = pool.instance(0).cpu.cycles;
+
+    pool.reset_all();
+    for (size_t i = 0; i < pool.size(); ++i)
+    {
+        assert(pool.instance(i).cpu.cycles == cycles);
+        assert(pool.instance(i).cpu.peek(0x10) == counter);
+        assert(pool.instance(i).cpu.program_counter == pool.snapshot().cpu.program_counter);
+    }
+
+    // 写过 ROM 的实例复位后换回共享的 ROM
+    pool.instance(1).cpu.mem_write(0x8001, 0x20);
+    pool.reset(1);
+    assert(pool.instance(1).cpu.peek(0x8001) == 0x10);
+}
+
+void test_steady_state_does_not_allocate()
+{
+    mysn::InstancePool pool(64, mysn::make_rom(program));
+    mysn::RunBudget budget = {0, 0, true};
+
+    size_t before = allocations.load();
+    for (int episode = 0; episode < 4; ++episode)
+    {
+        for (size_t i = 0; i < pool.size(); ++i)
+        {
+            pool.instance(i).joypad.set_buttons(mysn::Byte(i));
+            pool.instance(i).cpu.run_for(budget);
+        }
+        pool.reset_all();
+    }
+    assert(allocations.load() == before);
+}
+
+void test_recorders_live_in_arena()
+{
+    mysn::SharedRom rom = mysn::make_rom(program);
+
+    // 实例数超过崩溃处理函数的 64 个槽位，指令记录也不另外分配
+    size_t before = allocations.load();
+    mysn::InstancePool pool(100, rom);
+    assert(allocations.load() == before);
+
+    mysn::CPU &cpu = pool.instance(99).cpu;
+    assert(cpu.flight_recorder.capacity() == mysn::InstancePool::RECORDER_CAPACITY);
+    mysn::RunBudget budget = {100, 0, false};
+    assert(cpu.run_for(budget) == mysn::Run_Instruction_Limit);
+    assert(cpu.flight_recorder.total_recorded() == 100);
+
+    vector<mysn::FlightRecord> records = cpu.flight_recorder.snapshot();
+    assert(records.size() == mysn::InstancePool::RECORDER_CAPACITY);
+    assert(pool.instance(98).cpu.flight_recorder.total_recorded() == 0);
+
+    // 复制出来的 CPU 带着自己的一份记录
+    mysn::CPU copy = cpu;
+    pool.reset(99);
+    assert(cpu.flight_recorder.total_recorded() == 0);
+    assert(copy.flight_recorder.snapshot().size() == mysn::InstancePool::RECORDER_CAPACITY);
+}
+
+void test_oversized_count_rejected()
+{
+    mysn::SharedRom rom = mysn::make_rom(program);
+    const size_t counts[] = {SIZE_MAX, SIZE_MAX / 2, SIZE_MAX / sizeof(mysn::PoolInstance)};
+
+    // count + 1 溢出时不能映射一块小区域再越界构造
+    for (size_t count : counts)
+    {
+        bool thrown = false;
+        try
+        {
+            mysn::InstancePool pool(count, rom);
+        }
+        catch (const std::bad_alloc &)
+        {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+}
+
+int main()
+{
+    test_reset_to_power_on();
+    test_reset_to_snapshot();
+    test_steady_state_does_not_allocate();
+    test_recorders_live_in_arena();
+    test_oversized_count_rejected();
+
+    return 0;
+}
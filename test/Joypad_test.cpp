@@ -0,0 +1,105 @@
+#include "CPU.h"
+#include "Joypad.h"
+#include <vector>
+#include <assert.h>
+
+using namespace std;
+
+void test_shift_register()
+{
+    mysn::Joypad joypad;
+    joypad.set_buttons(mysn::Button_A | mysn::Button_Start | mysn::Button_Right);
+
+    // 锁存期间一直读到 A
+    joypad.write(1);
+    assert(joypad.read() == 0x41);
+    assert(joypad.read() == 0x41);
+
+    joypad.write(0);
+    const mysn::Byte expected[8] = {1, 0, 0, 1, 0, 0, 0, 1};
+    for (int i = 0; i < 8; ++i)
+    {
+        assert(joypad.read() == (0x40 | expected[i]));
+    }
+
+    // 8 位读完之后读到 1
+    assert(joypad.read() == 0x41);
+    assert(joypad.read() == 0x41);
+}
+
+void test_cpu_ports()
+{
+    mysn::CPU cpu = mysn::CPU();
+    mysn::Joypad first;
+    mysn::Joypad second;
+    cpu.attach_joypad(0, &first);
+    cpu.attach_joypad(1, &second);
+
+    first.set_buttons(mysn::Button_B);
+    second.set_buttons(mysn::Button_A);
+
+    /**
+        LDA #$01
+        STA $4016
+        LDA #$00
+        STA $4016
+        LDA $4016   ; A
+        STA $00
+        LDA $4016   ; B
+        STA $01
+        LDA $4017   ; 第二个手柄的 A
+        STA $02
+        BRK
+     */
+    vector<uint8_t> program = {
+        0xa9, 0x01, 0x8d, 0x16, 0x40, 0xa9, 0x00, 0x8d, 0x16, 0x40,
+        0xad, 0x16, 0x40, 0x85, 0x00,
+        0xad, 0x16, 0x40, 0x85, 0x01,
+        0xad, 0x17, 0x40, 0x85, 0x02,
+        0x00,
+    };
+    cpu.load_and_run(program);
+
+    assert(cpu.mem_read(0x00) == 0x40);
+    assert(cpu.mem_read(0x01) == 0x41);
+    assert(cpu.mem_read(0x02) == 0x41);
+
+    // 卸下后 $4016 回到普通内存
+    cpu.attach_joypad(0, nullptr);
+    cpu.attach_joypad(1, nullptr);
+    cpu.mem_write(0x4016, 0x12);
+    assert(cpu.mem_read(0x4016) == 0x12);
+}
+
+void test_copy_does_not_share_devices()
+{
+    mysn::CPU cpu = mysn::CPU();
+    mysn::Joypad joypad;
+    cpu.attach_joypad(0, &joypad);
+    joypad.set_buttons(mysn::Button_A);
+    joypad.write(1);
+    joypad.write(0);
+
+    // 复制出来的 CPU 不挂手柄，读 $4016 不会移走原来手柄的位
+    mysn::CPU copy = cpu;
+    copy.mem_read(0x4016);
+    assert(cpu.mem_read(0x4016) == 0x41);
+
+    // 赋值保留自己的手柄
+    mysn::CPU other = mysn::CPU();
+    mysn::Joypad own;
+    other.attach_joypad(0, &own);
+    other = copy;
+    other.mem_read(0x4016);
+    assert(joypad.read() == 0x40);
+    own.set_buttons(mysn::Button_A);
+    own.write(1);
+    assert(other.mem_read(0x4016) == 0x41);
+}
+
+int main()
+{
+    test_shift_register();
+    test_cpu_ports();
+    test_copy_does_not_share_devices();
+}
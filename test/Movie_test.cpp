@@ -0,0 +1,221 @@
+#include "CPU.h"
+#include "Joypad.h"
+#include "Movie.h"
+#include "ThreadPool.h"
+#include <cstdio>
+#include <sstream>
+#include <vector>
+#include <assert.h>
+
+using namespace std;
+
+/**
+    loop: LDA #1  STA $4016
+          LDA #0  STA $4016
+          LDA $4016  AND #1      ; A 键
+          CLC  ADC $10  STA $10  ; 按住 A 的每一轮 $10 加 step
+          JMP loop
+ */
+vector<uint8_t> counter_program(uint8_t step)
+{
+    vector<uint8_t> program = {0xa9, 0x01, 0x8d, 0x16, 0x40, 0xa9, 0x00, 0x8d, 0x16, 0x40,
+                               0xad, 0x16, 0x40, 0x29, 0x01, 0xf0, 0x02, 0xa9, step,
+                               0x18, 0x65, 0x10, 0x85, 0x10, 0x4c, 0x00, 0x80};
+    return program;
+}
+
+mysn::Movie make_movie()
+{
+    mysn::Movie movie;
+    movie.set("title", "counter test");
+    movie.set("rom", "counter");
+
+    for (int i = 0; i < 20; ++i)
+    {
+        mysn::MovieFrame frame = {mysn::Byte(i >= 5 && i % 2 == 1 ? mysn::Button_A : 0), 0, false, 0};
+        movie.frames.push_back(frame);
+    }
+
+    return movie;
+}
+
+struct Machine
+{
+    mysn::CPU cpu;
+    mysn::Joypad joypad;
+
+    Machine(uint8_t step)
+    {
+        vector<uint8_t> program = counter_program(step);
+        cpu.attach_joypad(0, &joypad);
+        cpu.load_and_reset(program);
+    }
+};
+
+void test_format_round_trip()
+{
+    mysn::Movie movie = make_movie();
+    movie.frames[3].port1 = mysn::Button_Start | mysn::Button_Right;
+    movie.frames[4].has_hash = true;
+    movie.frames[4].hash = 0x0123456789abcdefull;
+
+    stringstream text;
+    movie.write(text);
+
+    mysn::Movie copy;
+    bool read = copy.read(text);
+    assert(read);
+    assert(copy.get("title") == "counter test");
+    assert(copy.get("missing") == "");
+    assert(copy.frames.size() == 20);
+    assert(copy.frames[3].port1 == (mysn::Button_Start | mysn::Button_Right));
+    assert(copy.frames[7].port0 == mysn::Button_A);
+    assert(!copy.frames[3].has_hash);
+    assert(copy.frames[4].has_hash && copy.frames[4].hash == 0x0123456789abcdefull);
+
+    stringstream expected;
+    expected << "mysn-movie 1\n# comment\ntitle t\n|R......A|....T...|\n";
+    read = copy.read(expected);
+    assert(read);
+    assert(copy.frames.size() == 1 && copy.frames[0].port0 == (mysn::Button_Right | mysn::Button_A));
+    assert(copy.frames[0].port1 == mysn::Button_Start);
+
+    // 格式不对时原有内容不变
+    stringstream bad_header("mysn-movie 2\n");
+    stringstream bad_buttons("mysn-movie 1\n|X.......|........|\n");
+    stringstream bad_hash("mysn-movie 1\n|........|........|123\n");
+    bool header_read = copy.read(bad_header);
+    bool buttons_read = copy.read(bad_buttons);
+    bool hash_read = copy.read(bad_hash);
+    assert(!header_read && !buttons_read && !hash_read);
+    assert(copy.frames.size() == 1 && copy.get("title") == "t");
+
+    const char *path = "Movie_test.mov";
+    bool saved = movie.save(path);
+    bool loaded = copy.load(path);
+    assert(saved && loaded);
+    assert(copy.frames.size() == 20 && copy.frames[4].hash == movie.frames[4].hash);
+    remove(path);
+}
+
+void test_record_and_verify()
+{
+    mysn::Movie movie = make_movie();
+    Machine recorder(1);
+    mysn::MovieReplayer record(recorder.cpu, &recorder.joypad, nullptr);
+    mysn::ReplayResult recorded = record.record(movie);
+    assert(recorded.status == mysn::Replay_Completed);
+    assert(movie.frames[19].has_hash);
+    assert(recorder.cpu.peek(0x10) != 0);
+
+    // 同一个版本回放完全一致
+    Machine same(1);
+    mysn::MovieReplayer replay(same.cpu, &same.joypad, nullptr);
+    mysn::ReplayResult result = replay.verify(movie);
+    assert(result.status == mysn::Replay_Completed);
+    assert(result.frame == 20);
+    assert(same.cpu.cycles == recorder.cpu.cycles);
+
+    // 改过的版本在第一次按 A 的帧出现差异
+    Machine changed(2);
+    mysn::MovieReplayer check(changed.cpu, &changed.joypad, nullptr);
+    result = check.verify(movie);
+    assert(result.status == mysn::Replay_Mismatch);
+    assert(result.frame == 5);
+    assert(result.program_counter == changed.cpu.program_counter);
+    assert(result.expected_hash == movie.frames[5].hash);
+    assert(result.actual_hash != result.expected_hash);
+
+    // 正确的版本回放到同一帧再对比
+    Machine reference(1);
+    mysn::MovieReplayer to_frame(reference.cpu, &reference.joypad, nullptr);
+    mysn::ReplayResult stopped = to_frame.run(movie, result.frame + 1);
+    assert(stopped.frame == 6);
+
+    stringstream diff;
+    mysn::write_state_diff(diff, reference.cpu, changed.cpu);
+    assert(diff.str().find("$0010: ") != string::npos);
+
+    stringstream identical;
+    mysn::write_state_diff(identical, reference.cpu, reference.cpu);
+    assert(identical.str() == "identical\n");
+}
+
+void test_halt_during_replay()
+{
+    mysn::CPU cpu;
+    vector<uint8_t> program = {0xe8, 0x00};
+    cpu.load_and_reset(program);
+
+    mysn::MovieReplayer replay(cpu, nullptr, nullptr);
+    mysn::ReplayResult result = replay.verify(make_movie());
+    assert(result.status == mysn::Replay_Halted);
+    assert(result.frame == 0);
+}
+
+void test_checkpoint_segments()
+{
+    vector<uint8_t> program = counter_program(1);
+    mysn::SharedRom rom = mysn::make_rom(program);
+    mysn::Movie movie = make_movie();
+
+    Machine recorder(1);
+    mysn::MovieReplayer record(recorder.cpu, &recorder.joypad, nullptr);
+    vector<mysn::MovieCheckpoint> checkpoints;
+    mysn::ReplayResult recorded = record.record(movie, 4, checkpoints);
+    assert(recorded.status == mysn::Replay_Completed);
+    assert(checkpoints.size() == 6);
+    assert(checkpoints[1].frame == 4 && checkpoints[5].frame == 20);
+    assert(checkpoints[5].state == record.save_state());
+
+    const char *path = "Movie_test.ckpt";
+    vector<mysn::MovieCheckpoint> loaded;
+    bool saved = mysn::save_checkpoints(path, checkpoints);
+    bool read = mysn::load_checkpoints(path, loaded);
+    assert(saved && read);
+    assert(loaded.size() == 6 && loaded[3].frame == 12 && loaded[3].state == checkpoints[3].state);
+    remove(path);
+
+    // 从检查点恢复后接着回放，和从头回放的结果一样
+    Machine resumed(1);
+    mysn::MovieReplayer resume(resumed.cpu, &resumed.joypad, nullptr);
+    bool restored = resume.load_state(checkpoints[2].state);
+    assert(restored);
+    mysn::ReplayResult resumed_result = resume.verify(movie, 8, 20);
+    assert(resumed_result.status == mysn::Replay_Completed);
+    assert(resumed.cpu.cycles == recorder.cpu.cycles);
+
+    // 挂的手柄口不同的存档不能恢复
+    mysn::MovieReplayer no_joypad(resumed.cpu, nullptr, nullptr);
+    restored = no_joypad.load_state(checkpoints[2].state);
+    assert(!restored);
+
+    mysn::ThreadPool pool(4);
+    mysn::ReplayResult result = mysn::verify_segments(movie, checkpoints, rom, pool);
+    assert(result.status == mysn::Replay_Completed);
+    assert(result.frame == 20);
+
+    // 改过的版本，报的是第一个有差异的帧
+    vector<uint8_t> changed_program = counter_program(2);
+    result = mysn::verify_segments(movie, checkpoints, mysn::make_rom(changed_program), pool);
+    assert(result.status == mysn::Replay_Mismatch);
+    assert(result.frame == 5);
+    assert(result.expected_hash == movie.frames[5].hash);
+
+    // 哈希不覆盖的状态（这里是 PRG RAM）在段末和检查点比较
+    checkpoints[3].state[16 + 0x900] ^= 0xFF;
+    result = mysn::verify_segments(movie, checkpoints, rom, pool);
+    assert(result.status == mysn::Replay_Mismatch);
+    assert(result.frame == 11);
+    assert(result.expected_hash != result.actual_hash);
+}
+
+int main()
+{
+    test_format_round_trip();
+    test_record_and_verify();
+    test_halt_during_replay();
+    test_checkpoint_segments();
+
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include "CPU.h"
+#include "CPURun.h"
+#include "OpcodeProfiler.h"
+#include <vector>
+#include <assert.h>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+// 记录每条指令开始时的 PC
+struct PcRecorder
+{
+    vector<mysn::Address> pcs;
+
+    void before_instruction(mysn::CPU &cpu, mysn::Byte) { pcs.push_back(cpu.program_counter); }
+    void after_instruction(mysn::CPU &, mysn::Byte, bool) {}
+};
+
+void test_policy_sees_every_instruction()
+{
+    mysn::CPU cpu = mysn::CPU();
+    PcRecorder recorder;
+
+    // LDA #$01; LDX #$02; BRK
+    vector<mysn::Byte> program = {0xa9, 0x01, 0xa2, 0x02, 0x00};
+    cpu.load_and_run_with(program, recorder);
+
+    assert(recorder.pcs.size() == 3);
+    assert(recorder.pcs[0] == 0x8000);
+    assert(recorder.pcs[1] == 0x8002);
+    assert(recorder.pcs[2] == 0x8004);
+    assert(cpu.register_x == 0x02);
+}
+
+void test_profiler_counts()
+{
+    mysn::CPU cpu = mysn::CPU();
+    mysn::OpcodeProfiler profiler;
+
+    // LDX #$F0; loop: LDA $02F0,X; INX; BNE loop; BRK
+    // X >= $10 时 $02F0+X 跨到 $03xx
+    vector<mysn::Byte> program = {0xa2, 0xf0, 0xbd, 0xf0, 0x02, 0xe8, 0xd0, 0xfa, 0x00};
+    cpu.load_and_run_with(program, profiler);
+
+    assert(profiler.count(0xa2) == 1);
+    assert(profiler.count(0xbd) == 16);
+    assert(profiler.count(0xe8) == 16);
+    assert(profiler.count(0xd0) == 16);
+    assert(profiler.count(0x00) == 1);
+    assert(profiler.total_instructions() == 50);
+
+    // 跨页的读多一个周期，成立的分支多一个周期
+    assert(profiler.cycles(0xbd) == 16 * 5);
+    assert(profiler.cycles(0xd0) == 15 * 3 + 2);
+    // $02F0 + $F0..$FF 全部跨页
+    assert(profiler.page_cross_count(0xbd) == 16);
+    assert(profiler.page_cross_count(0xe8) == 0);
+
+    uint64_t total_cycles = 0;
+    for (int code = 0; code < 256; ++code)
+    {
+        total_cycles += profiler.cycles(mysn::Byte(code));
+    }
+    assert(total_cycles == cpu.cycles);
+
+    ostringstream report;
+    profiler.write_report(report);
+    // 次数最多的排在最前，同次数按操作码
+    assert(report.str().find("$BD  LDA") < report.str().find("$E8  INX"));
+    assert(report.str().find("Absolute_X") != string::npos);
+
+    ostringstream json;
+    profiler.write_json(json);
+    assert(json.str().find("\"total_instructions\": 50") != string::npos);
+    assert(json.str().find("{\"opcode\": 189, \"mnemonic\": \"LDA\", \"mode\": \"Absolute_X\", \"count\": 16, \"cycles\": 80, \"page_crosses\": 16}") != string::npos);
+
+    profiler.clear();
+    assert(profiler.total_instructions() == 0);
+}
+
+void test_null_policy_matches_run()
+{
+    vector<mysn::Byte> program = {0xa2, 0xf0, 0xbd, 0xf0, 0x02, 0xe8, 0xd0, 0xfa, 0x00};
+
+    mysn::CPU plain = mysn::CPU();
+    plain.load_and_run(program);
+
+    mysn::CPU with_policy = mysn::CPU();
+    mysn::NullPolicy policy;
+    with_policy.load_and_run_with(program, policy);
+
+    assert(plain.cycles == with_policy.cycles);
+    assert(plain.register_a == with_policy.register_a);
+    assert(plain.register_x == with_policy.register_x);
+    assert(plain.program_counter == with_policy.program_counter);
+}
+
+int main()
+{
+    test_policy_sees_every_instruction();
+    test_profiler_counts();
+    test_null_policy_matches_run();
+}
@@ -0,0 +1,129 @@
+#include "CPU.h"
+#include "APU.h"
+#include "PPU.h"
+#include <vector>
+#include <assert.h>
+#include <iostream>
+
+using namespace std;
+
+void test_oam_registers()
+{
+    mysn::CPU cpu = mysn::CPU();
+    mysn::PPU ppu;
+    cpu.attach_ppu(&ppu);
+
+    // OAMADDR = $FE，连续写 OAMDATA 会回绕到 0
+    cpu.mem_write(0x2003, 0xFE);
+    cpu.mem_write(0x2004, 0x11);
+    cpu.mem_write(0x2004, 0x22);
+    cpu.mem_write(0x200C, 0x33);
+
+    assert(ppu.oam[0xFE] == 0x11);
+    assert(ppu.oam[0xFF] == 0x22);
+    assert(ppu.oam[0x00] == 0x33);
+    assert(ppu.oam_address == 0x01);
+
+    cpu.mem_write(0x3FFB, 0xFF);
+    assert(cpu.mem_read(0x2004) == 0x22);
+}
+
+void test_oam_dma_from_ram()
+{
+    mysn::CPU cpu = mysn::CPU();
+    mysn::PPU ppu;
+    cpu.attach_ppu(&ppu);
+
+    for (int i = 0; i < 256; ++i)
+    {
+        cpu.mem_write(0x0200 + i, mysn::Byte(i ^ 0x5A));
+    }
+
+    // LDA #$10; STA $2003; LDA #$02; STA $4014; BRK
+    vector<mysn::Byte> program = {0xa9, 0x10, 0x8d, 0x03, 0x20, 0xa9, 0x02, 0x8d, 0x14, 0x40, 0x00};
+    cpu.load_and_run(program);
+
+    for (int i = 0; i < 256; ++i)
+    {
+        assert(ppu.oam[(0x10 + i) & 0xFF] == mysn::Byte(i ^ 0x5A));
+    }
+    assert(ppu.oam_address == 0x10);
+
+    // STA $4014 之后周期数为偶数（2 + 4 + 2 + 4），挂起 513 个周期
+    assert(cpu.cycles == 2 + 4 + 2 + 4 + 513 + 7);
+}
+
+void test_oam_dma_odd_cycle_alignment()
+{
+    mysn::CPU cpu = mysn::CPU();
+    mysn::PPU ppu;
+    cpu.attach_ppu(&ppu);
+    cpu.mem_write(0x0010, 0x03);
+
+    // LDA $10; STA $4014; BRK，写入发生在第 7 个周期，多等 1 个周期
+    vector<mysn::Byte> program = {0xa5, 0x10, 0x8d, 0x14, 0x40, 0x00};
+    cpu.load_and_run(program);
+
+    assert(cpu.cycles == 3 + 4 + 514 + 7);
+}
+
+void test_oam_dma_from_io_page()
+{
+    mysn::CPU cpu = mysn::CPU();
+    mysn::APU apu;
+    mysn::PPU ppu;
+    cpu.attach_apu(&apu);
+    cpu.attach_ppu(&ppu);
+
+    for (int i = 0x18; i < 256; ++i)
+    {
+        cpu.mem_write(0x4000 + i, mysn::Byte(i));
+    }
+
+    // 打开脉冲 1 并装载长度计数器，$4015 读出 1
+    cpu.mem_write(0x4015, 0x01);
+    cpu.mem_write(0x4003, 0x08);
+
+    // I/O 页逐字节读，$4015 经过 APU
+    vector<mysn::Byte> program = {0xa9, 0x40, 0x8d, 0x14, 0x40, 0x00};
+    cpu.load_and_run(program);
+
+    assert((ppu.oam[0x15] & 0x01) == 0x01);
+    for (int i = 0x18; i < 256; ++i)
+    {
+        assert(ppu.oam[i] == mysn::Byte(i));
+    }
+}
+
+void test_dma_ignored_without_ppu()
+{
+    mysn::CPU cpu = mysn::CPU();
+
+    vector<mysn::Byte> program = {0xa9, 0x02, 0x8d, 0x14, 0x40, 0x00};
+    cpu.load_and_run(program);
+
+    assert(cpu.mem_read(0x4014) == 0x02);
+    assert(cpu.cycles == 2 + 4 + 7);
+}
+
+void test_copy_keeps_own_memory()
+{
+    mysn::CPU cpu = mysn::CPU();
+    cpu.mem_write(0x0300, 0x42);
+
+    mysn::CPU copy = cpu;
+    copy.mem_write(0x0300, 0x24);
+
+    assert(cpu.mem_read(0x0300) == 0x42);
+    assert(copy.mem_read(0x0300) == 0x24);
+}
+
+int main()
+{
+    test_oam_registers();
+    test_oam_dma_from_ram();
+    test_oam_dma_odd_cycle_alignment();
+    test_oam_dma_from_io_page();
+    test_dma_ignored_without_ppu();
+    test_copy_keeps_own_memory();
+}
@@ -0,0 +1,99 @@
+#include "CPU.h"
+#include "PerfCounters.h"
+#include <assert.h>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// 256 x 256 次 DEY/BNE
+vector<mysn::Byte> busy_loop()
+{
+    return {
+        0xa2, 0x00, // LDX #$00
+        0xa0, 0x00, // outer: LDY #$00
+        0x88,       // inner: DEY
+        0xd0, 0xfd, // BNE inner
+        0xca,       // DEX
+        0xd0, 0xf8, // BNE outer
+        0x00,       // BRK
+    };
+}
+
+void test_sample_helpers()
+{
+    mysn::PerfSample sample;
+    memset(&sample, 0, sizeof(sample));
+
+    // 没有计数时都返回负数
+    assert(sample.ipc() < 0);
+    assert(sample.per_instruction(mysn::Perf_Branch_Misses, 100) < 0);
+
+    sample.valid[mysn::Perf_Cycles] = true;
+    sample.values[mysn::Perf_Cycles] = 1000;
+    sample.valid[mysn::Perf_Instructions] = true;
+    sample.values[mysn::Perf_Instructions] = 2500;
+    sample.valid[mysn::Perf_Branch_Misses] = true;
+    sample.values[mysn::Perf_Branch_Misses] = 50;
+
+    assert(sample.ipc() == 2.5);
+    assert(sample.per_instruction(mysn::Perf_Branch_Misses, 100) == 0.5);
+    assert(sample.per_instruction(mysn::Perf_Branch_Misses, 0) < 0);
+    assert(sample.per_instruction(mysn::Perf_LLC_Misses, 100) < 0);
+
+    assert(strcmp(mysn::perf_counter_name(mysn::Perf_Branch_Misses), "branch-misses") == 0);
+}
+
+// 没有 PMU 的机器上也要能跑，只检查打开成功的计数器
+void test_measured_region()
+{
+    mysn::PerfCounters counters;
+
+    if (!counters.available())
+    {
+        assert(!counters.error().empty());
+        cout << "hardware counters unavailable: " << counters.error() << "\n";
+    }
+
+    vector<mysn::Byte> program = busy_loop();
+    mysn::CPU cpu;
+
+    counters.start();
+    cpu.load_and_run(program);
+    mysn::PerfSample sample = counters.stop();
+
+    for (int i = 0; i < mysn::PERF_COUNTER_COUNT; ++i)
+    {
+        mysn::PerfCounter counter = mysn::PerfCounter(i);
+
+        // 打不开的一定无效
+        assert(counters.available(counter) || !sample.has(counter));
+    }
+
+    // 模拟 13 万多条指令，宿主机至少执行这么多条
+    if (sample.has(mysn::Perf_Instructions))
+    {
+        assert(sample.values[mysn::Perf_Instructions] > 65536 * 2);
+    }
+    if (sample.has(mysn::Perf_Cycles))
+    {
+        assert(sample.values[mysn::Perf_Cycles] > 0);
+    }
+
+    // 重新 start 会清零，空区间远小于上面的计数
+    counters.start();
+    mysn::PerfSample empty = counters.stop();
+    if (sample.has(mysn::Perf_Instructions) && empty.has(mysn::Perf_Instructions))
+    {
+        assert(empty.values[mysn::Perf_Instructions] < sample.values[mysn::Perf_Instructions]);
+    }
+}
+
+int main()
+{
+    test_sample_helpers();
+    test_measured_region();
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include "APU.h"
+#include "AudioMixer.h"
+#include "AudioSink.h"
+#include "Resampler.h"
+#include <vector>
+#include <assert.h>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+const double PI = 3.14159265358979323846;
+
+// 单频点能量（Goertzel）
+double tone_magnitude(const vector<float> &samples, size_t begin, double frequency, double rate)
+{
+    double coeff = 2.0 * cos(2.0 * PI * frequency / rate);
+    double s1 = 0.0, s2 = 0.0;
+
+    for (size_t i = begin; i < samples.size(); ++i)
+    {
+        double s0 = samples[i] + coeff * s1 - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+
+    double n = double(samples.size() - begin);
+    return sqrt(s1 * s1 + s2 * s2 - coeff * s1 * s2) * 2.0 / n;
+}
+
+vector<mysn::SimdLevel> available_levels()
+{
+    vector<mysn::SimdLevel> levels = {mysn::Simd_Scalar};
+
+    if (mysn::detect_simd_level() >= mysn::Simd_SSE2)
+    {
+        levels.push_back(mysn::Simd_SSE2);
+    }
+    if (mysn::detect_simd_level() >= mysn::Simd_AVX2)
+    {
+        levels.push_back(mysn::Simd_AVX2);
+    }
+
+    return levels;
+}
+
+void test_mixer_paths_agree()
+{
+    const size_t count = 1003;
+    vector<uint8_t> p1(count), p2(count), t(count), n(count), d(count);
+
+    srand(1);
+    for (size_t i = 0; i < count; ++i)
+    {
+        p1[i] = rand() % 16;
+        p2[i] = rand() % 16;
+        t[i] = rand() % 16;
+        n[i] = rand() % 16;
+        d[i] = rand() % 128;
+    }
+
+    mysn::ChannelLevels levels = {&p1[0], &p2[0], &t[0], &n[0], &d[0]};
+    vector<float> expected(count);
+    mysn::AudioMixer(mysn::Simd_Scalar).mix(levels, count, &expected[0]);
+
+    assert(fabs(expected[0] - (mysn::PULSE_MIX * (p1[0] + p2[0]) + mysn::TRIANGLE_MIX * t[0] +
+                               mysn::NOISE_MIX * n[0] + mysn::DMC_MIX * d[0])) < 1e-6);
+
+    for (mysn::SimdLevel level : available_levels())
+    {
+        vector<float> out(count);
+        mysn::AudioMixer(level).mix(levels, count, &out[0]);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            assert(fabs(out[i] - expected[i]) < 1e-5);
+        }
+    }
+}
+
+vector<float> resample_sine(mysn::SimdLevel level, double in_rate, double out_rate, double frequency)
+{
+    const size_t block = 4096;
+    mysn::Resampler resampler(in_rate, out_rate, block, level);
+    vector<float> input(block), output(resampler.max_output()), result;
+
+    size_t t = 0;
+    for (int b = 0; b < 40; ++b)
+    {
+        for (size_t i = 0; i < block; ++i, ++t)
+        {
+            input[i] = float(0.5 * sin(2.0 * PI * frequency * t / in_rate));
+        }
+
+        size_t produced = resampler.process(&input[0], block, &output[0]);
+        assert(produced <= resampler.max_output());
+        result.insert(result.end(), output.begin(), output.begin() + produced);
+    }
+
+    return result;
+}
+
+void test_resampler_preserves_tone()
+{
+    const double in_rate = 1789773 / 2.0;
+    const double out_rate = 48000;
+
+    vector<float> reference = resample_sine(mysn::Simd_Scalar, in_rate, out_rate, 1000.0);
+
+    // 输出个数符合采样率之比，差额是滤波器尚未输出的半个核长
+    mysn::Resampler probe(in_rate, out_rate, 4096);
+    double expected = 40 * 4096 * out_rate / in_rate;
+    double pending = probe.taps() / 2 * out_rate / in_rate;
+    assert(double(reference.size()) <= expected + 1.0);
+    assert(double(reference.size()) >= expected - pending - 1.0);
+
+    // 通带内幅度保持，其它频点几乎没有能量
+    assert(fabs(tone_magnitude(reference, 200, 1000.0, out_rate) - 0.5) < 0.01);
+    assert(tone_magnitude(reference, 200, 3000.0, out_rate) < 0.01);
+
+    for (mysn::SimdLevel level : available_levels())
+    {
+        vector<float> out = resample_sine(level, in_rate, out_rate, 1000.0);
+        assert(out.size() == reference.size());
+
+        for (size_t i = 0; i < out.size(); ++i)
+        {
+            assert(fabs(out[i] - reference[i]) < 1e-4);
+        }
+    }
+}
+
+void test_resampler_rejects_ultrasonic()
+{
+    // 高于输出奈奎斯特频率的分量被滤除而不是混叠到可听频段
+    vector<float> out = resample_sine(mysn::detect_simd_level(), 1789773 / 2.0, 44100, 30000.0);
+
+    assert(tone_magnitude(out, 200, 44100 - 30000.0, 44100) < 0.005);
+}
+
+void test_apu_resampled_output()
+{
+    mysn::APU apu(44100, mysn::Resampled_Synthesis);
+    vector<float> samples;
+
+    mysn::CallbackSink sink([&](const int16_t *data, size_t count) {
+        for (size_t i = 0; i < count; ++i)
+        {
+            samples.push_back(data[i] / 32767.0f);
+        }
+    });
+    apu.set_sink(&sink);
+
+    apu.write_register(0x4017, 0x40, 0);
+    apu.write_register(0x4015, 0x01, 0);
+    // 50% 占空比，常量音量 15，约 440Hz
+    apu.write_register(0x4000, 0xBF, 0);
+    apu.write_register(0x4002, 0xFD, 0);
+    apu.write_register(0x4003, 0x08, 0);
+    apu.end_frame(mysn::APU::CPU_CLOCK_RATE / 2);
+
+    // 0.5 秒 @44.1kHz，减去滤波器延迟
+    assert(samples.size() <= 22051 && samples.size() >= 22050 - 12);
+    assert(tone_magnitude(samples, 2000, 440.4, 44100) > 0.05);
+    assert(tone_magnitude(samples, 2000, 300.0, 44100) < 0.01);
+}
+
+int main()
+{
+    test_mixer_paths_agree();
+    test_resampler_preserves_tone();
+    test_resampler_rejects_ultrasonic();
+    test_apu_resampled_output();
+}
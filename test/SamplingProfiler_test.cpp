@@ -0,0 +1,173 @@
+#include "CPU.h"
+#include "CPURun.h"
+#include "APU.h"
+#include "SamplingProfiler.h"
+#include "SymbolTable.h"
+#include <vector>
+#include <assert.h>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+using namespace std;
+
+// 把若干段代码按偏移拼成从 $8000 开始的程序
+vector<mysn::Byte> assemble(const map<int, vector<mysn::Byte>> &segments)
+{
+    vector<mysn::Byte> program;
+
+    for (auto &segment : segments)
+    {
+        if (program.size() < size_t(segment.first))
+        {
+            program.resize(segment.first, 0xea);
+        }
+        program.insert(program.end(), segment.second.begin(), segment.second.end());
+    }
+
+    return program;
+}
+
+vector<mysn::Byte> nested_calls()
+{
+    return assemble({
+        {0x00, {0x20, 0x10, 0x80, 0x00}},             // main: JSR outer; BRK
+        {0x10, {0xa2, 0x00,                           // outer: LDX #$00
+                0x20, 0x20, 0x80,                     // loop: JSR inner
+                0xe8,                                 // INX
+                0xd0, 0xfa,                           // BNE loop
+                0x60}},                               // RTS
+        {0x20, {0xa0, 0x10,                           // inner: LDY #$10
+                0x88,                                 // wait: DEY
+                0xd0, 0xfd,                           // BNE wait
+                0x60}},                               // RTS
+    });
+}
+
+map<string, uint64_t> parse_folded(const mysn::SamplingProfiler &profiler)
+{
+    ostringstream out;
+    profiler.write_folded(out);
+
+    map<string, uint64_t> stacks;
+    istringstream in(out.str());
+    string stack;
+    uint64_t count;
+
+    while (in >> stack >> count)
+    {
+        stacks[stack] = count;
+    }
+
+    return stacks;
+}
+
+void test_call_stacks()
+{
+    mysn::CPU cpu = mysn::CPU();
+    mysn::SamplingProfiler profiler(10);
+    vector<mysn::Byte> program = nested_calls();
+
+    cpu.load_and_run_with(program, profiler);
+
+    assert(profiler.total_samples() == cpu.cycles / 10);
+
+    map<string, uint64_t> stacks = parse_folded(profiler);
+    uint64_t sum = 0;
+    for (auto &stack : stacks)
+    {
+        sum += stack.second;
+    }
+    assert(sum == profiler.total_samples());
+
+    // 绝大部分时间在 inner 的循环里
+    assert(stacks["entry_8000;sub_8010;sub_8020"] > profiler.total_samples() * 3 / 4);
+    assert(stacks["entry_8000;sub_8010"] > 0);
+    assert(profiler.samples_at(0x8022) + profiler.samples_at(0x8023) > profiler.total_samples() * 3 / 4);
+
+    ostringstream hotspots;
+    profiler.write_hotspots(hotspots, 3);
+    assert(hotspots.str().find("$8022") != string::npos);
+}
+
+void test_symbolized_output()
+{
+    const char *labels = "SamplingProfiler_test.lbl";
+    const char *dbg = "SamplingProfiler_test.dbg";
+
+    FILE *file = fopen(labels, "w");
+    fputs("; comment\nmain = $8000\n8010 outer\n", file);
+    fclose(file);
+
+    file = fopen(dbg, "w");
+    fputs("version\tmajor=2,minor=0\n"
+          "sym\tid=0,name=\"inner\",addrsize=absolute,scope=0,def=3,ref=7,val=0x8020,seg=0,type=lab\n"
+          "sym\tid=1,name=\"COUNT\",addrsize=zeropage,scope=0,def=4,val=0x10,type=equ\n",
+          file);
+    fclose(file);
+
+    mysn::SymbolTable symbols;
+    assert(symbols.load(labels));
+    assert(symbols.load(dbg));
+    assert(symbols.size() == 3);
+    assert(!symbols.load("SamplingProfiler_test.missing"));
+
+    assert(symbols.describe(0x8023) == "inner+$3");
+    assert(symbols.describe(0x7000) == "sub_7000");
+
+    mysn::CPU cpu = mysn::CPU();
+    mysn::SamplingProfiler profiler(10);
+    profiler.set_symbols(&symbols);
+    vector<mysn::Byte> program = nested_calls();
+    cpu.load_and_run_with(program, profiler);
+
+    map<string, uint64_t> stacks = parse_folded(profiler);
+    assert(stacks["main;outer;inner"] > 0);
+    assert(stacks["main;outer"] > 0);
+
+    remove(labels);
+    remove(dbg);
+}
+
+void test_interrupt_frames()
+{
+    mysn::CPU cpu = mysn::CPU();
+    mysn::APU apu;
+    mysn::SamplingProfiler profiler(7);
+    cpu.attach_apu(&apu);
+
+    vector<mysn::Byte> program = assemble({
+        {0x00, {0x58,                                 // CLI
+                0xa9, 0x00, 0x8d, 0x17, 0x40,         // 4 步模式，允许帧中断
+                0xe6, 0x10,                           // loop: INC $10
+                0xd0, 0xfc,                           // BNE loop
+                0xe6, 0x11,                           // INC $11
+                0xa5, 0x11,                           // LDA $11
+                0xc9, 0x40,                           // CMP #$40
+                0xd0, 0xf4,                           // BNE loop
+                0x00}},                               // BRK
+        {0x40, {0xad, 0x15, 0x40,                     // irq: LDA $4015
+                0xa0, 0x40, 0x88, 0xd0, 0xfd,         // 在中断里多停留一会
+                0x40}},                               // RTI
+    });
+    // 装载时整个 ROM 被替换，IRQ 向量要放在程序里
+    program.resize(0x8000, 0);
+    program[0x7FFE] = 0x40;
+    program[0x7FFF] = 0x80;
+
+    cpu.load_and_run_with(program, profiler);
+
+    map<string, uint64_t> stacks = parse_folded(profiler);
+    assert(stacks["entry_8000;int_8040"] > 0);
+    // RTI 之后回到根帧
+    assert(stacks["entry_8000"] > stacks["entry_8000;int_8040"]);
+    assert(stacks.size() == 2);
+}
+
+int main()
+{
+    test_call_stacks();
+    test_symbolized_output();
+    test_interrupt_frames();
+}
@@ -0,0 +1,246 @@
+#include "CPU.h"
+#include "CPURun.h"
+#include "TraceLogger.h"
+#include <vector>
+#include <assert.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+string trace_line(const mysn::CPU &cpu)
+{
+    char line[mysn::TRACE_LINE_MAX];
+    size_t length = mysn::format_trace_line(cpu, line);
+
+    assert(length <= mysn::TRACE_LINE_MAX);
+    return string(line, length);
+}
+
+void place(mysn::CPU &cpu, mysn::Address addr, const vector<mysn::Byte> &bytes)
+{
+    for (size_t i = 0; i < bytes.size(); ++i)
+    {
+        cpu.mem_write(mysn::Address(addr + i), bytes[i]);
+    }
+    cpu.program_counter = addr;
+}
+
+vector<string> read_lines(const char *path)
+{
+    vector<string> lines;
+    FILE *file = fopen(path, "rb");
+    assert(file != nullptr);
+
+    string line;
+    int c;
+    while ((c = fgetc(file)) != EOF)
+    {
+        line.push_back(char(c));
+        if (c == '\n')
+        {
+            lines.push_back(line);
+            line.clear();
+        }
+    }
+    assert(line.empty());
+    fclose(file);
+
+    return lines;
+}
+
+void test_nestest_format()
+{
+    mysn::CPU cpu = mysn::CPU();
+    cpu.status = 0x24;
+
+    // nestest.log 开头几行
+    place(cpu, 0xC000, {0x4c, 0xf5, 0xc5});
+    cpu.cycles = 7;
+    assert(trace_line(cpu) == "C000  4C F5 C5  JMP $C5F5                       A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 21 CYC:7\n");
+
+    place(cpu, 0xC5F5, {0xa2, 0x00});
+    cpu.cycles = 10;
+    assert(trace_line(cpu) == "C5F5  A2 00     LDX #$00                        A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 30 CYC:10\n");
+
+    place(cpu, 0xC5F7, {0x86, 0x00});
+    cpu.status = 0x26;
+    cpu.cycles = 12;
+    assert(trace_line(cpu) == "C5F7  86 00     STX $00 = 00                    A:00 X:00 Y:00 P:26 SP:FD PPU:  0, 36 CYC:12\n");
+}
+
+void test_addressing_mode_annotations()
+{
+    mysn::CPU cpu = mysn::CPU();
+    cpu.mem_write(0x0080, 0x00);
+    cpu.mem_write(0x0081, 0x02);
+    cpu.mem_write(0x0200, 0xDB);
+    cpu.mem_write(0x02FF, 0x7E);
+    cpu.mem_write(0x0089, 0x00);
+    cpu.mem_write(0x008A, 0x03);
+    cpu.mem_write(0x0334, 0x89);
+    cpu.mem_write(0x0310, 0x77);
+
+    place(cpu, 0x8000, {0x4a});
+    assert(trace_line(cpu) == "8000  4A        LSR A                           A:00 X:00 Y:00 P:00 SP:FD PPU:  0,  0 CYC:0\n");
+
+    cpu.mem_write(0x0200, 0x5A);
+    place(cpu, 0x8000, {0xa1, 0x80});
+    assert(trace_line(cpu) == "8000  A1 80     LDA ($80,X) @ 80 = 0200 = 5A    A:00 X:00 Y:00 P:00 SP:FD PPU:  0,  0 CYC:0\n");
+    cpu.mem_write(0x0200, 0xDB);
+
+    cpu.register_y = 0x34;
+    place(cpu, 0x8000, {0xb1, 0x89});
+    assert(trace_line(cpu) == "8000  B1 89     LDA ($89),Y = 0300 @ 0334 = 89  A:00 X:00 Y:34 P:00 SP:FD PPU:  0,  0 CYC:0\n");
+    cpu.register_y = 0;
+
+    // 间接跳转的页内回绕
+    place(cpu, 0x8000, {0x6c, 0xff, 0x02});
+    assert(trace_line(cpu) == "8000  6C FF 02  JMP ($02FF) = DB7E              A:00 X:00 Y:00 P:00 SP:FD PPU:  0,  0 CYC:0\n");
+
+    place(cpu, 0x8000, {0xd0, 0xfe});
+    assert(trace_line(cpu) == "8000  D0 FE     BNE $8000                       A:00 X:00 Y:00 P:00 SP:FD PPU:  0,  0 CYC:0\n");
+
+    cpu.register_x = 0x10;
+    place(cpu, 0x8000, {0xbd, 0x00, 0x03});
+    assert(trace_line(cpu) == "8000  BD 00 03  LDA $0300,X @ 0310 = 77         A:00 X:10 Y:00 P:00 SP:FD PPU:  0,  0 CYC:0\n");
+
+    // 零页变址在页内回绕
+    cpu.register_x = 0x20;
+    place(cpu, 0x8000, {0xb5, 0xf0});
+    assert(trace_line(cpu) == "8000  B5 F0     LDA $F0,X @ 10 = 00             A:00 X:20 Y:00 P:00 SP:FD PPU:  0,  0 CYC:0\n");
+    cpu.register_x = 0;
+
+    place(cpu, 0x8000, {0x20, 0x00, 0x90});
+    assert(trace_line(cpu) == "8000  20 00 90  JSR $9000                       A:00 X:00 Y:00 P:00 SP:FD PPU:  0,  0 CYC:0\n");
+
+    place(cpu, 0x8000, {0x02});
+    assert(trace_line(cpu) == "8000  02        ???                             A:00 X:00 Y:00 P:00 SP:FD PPU:  0,  0 CYC:0\n");
+
+    place(cpu, 0x8000, {0xea});
+    cpu.cycles = 114;
+    assert(trace_line(cpu) == "8000  EA        NOP                             A:00 X:00 Y:00 P:00 SP:FD PPU:  1,  1 CYC:114\n");
+}
+
+void test_traced_run()
+{
+    const char *path = "TraceLogger_test_output.log";
+
+    mysn::CPU cpu = mysn::CPU();
+    mysn::TraceWriter writer;
+    mysn::TraceStream *stream = writer.open(path);
+    assert(stream->is_open());
+
+    // 256 x 16 次内层循环，约 1MB 文本，超过环里所有块的容量
+    vector<mysn::Byte> program = {
+        0xa2, 0x00,       // LDX #$00
+        0xa0, 0x10,       // outer: LDY #$10
+        0x88,             // inner: DEY
+        0xd0, 0xfd,       // BNE inner
+        0xe8,             // INX
+        0xd0, 0xf8,       // BNE outer
+        0x00,             // BRK
+    };
+
+    mysn::Tracer tracer(stream);
+    cpu.load_and_run_with(program, tracer);
+    stream->close();
+    writer.close();
+
+    vector<string> lines = read_lines(path);
+    size_t expected = 1 + 256 * (1 + 16 * 2 + 2) + 1;
+    assert(lines.size() == expected);
+    assert(lines[0] == "8000  A2 00     LDX #$00                        A:00 X:00 Y:00 P:00 SP:FD PPU:  0,  0 CYC:0\n");
+    assert(lines.back().compare(0, 20, "800A  00        BRK ") == 0);
+
+    // 周期列单调递增，最后一行是 BRK 执行前的周期
+    uint64_t last = 0;
+    for (const string &line : lines)
+    {
+        uint64_t cycle = strtoull(line.c_str() + line.find("CYC:") + 4, nullptr, 10);
+        assert(cycle >= last);
+        last = cycle;
+    }
+    assert(last + 7 == cpu.cycles);
+
+    remove(path);
+}
+
+void test_multiple_streams_and_compression()
+{
+    const char *plain = "TraceLogger_test_a.log";
+    const char *compressed = "TraceLogger_test_b.log.gz";
+
+    mysn::TraceWriter writer;
+    mysn::TraceStream *a = writer.open(plain);
+    mysn::TraceStream *b = writer.open(compressed);
+    // 没有 zlib 时 .gz 打不开
+    bool compressed_open = b->is_open();
+
+    mysn::CPU cpu_a = mysn::CPU();
+    mysn::CPU cpu_b = mysn::CPU();
+    vector<mysn::Byte> program = {0xa9, 0x01, 0xaa, 0x00};
+    mysn::Tracer tracer_a(a);
+    mysn::Tracer tracer_b(b);
+
+    cpu_a.load_and_run_with(program, tracer_a);
+    cpu_b.load_and_run_with(program, tracer_b);
+    a->write("# done\n", 7);
+    a->close();
+    b->close();
+    writer.close();
+
+    vector<string> lines = read_lines(plain);
+    assert(lines.size() == 4);
+    assert(lines[3] == "# done\n");
+    remove(plain);
+
+    if (compressed_open)
+    {
+        FILE *file = fopen(compressed, "rb");
+        assert(file != nullptr);
+        assert(fgetc(file) == 0x1f && fgetc(file) == 0x8b);
+        fclose(file);
+        remove(compressed);
+    }
+}
+
+void test_writer_closed_before_stream()
+{
+    const char *path = "TraceLogger_test_unclosed.log";
+
+    mysn::TraceWriter writer;
+    mysn::TraceStream *stream = writer.open(path);
+    stream->write("first\n", 6);
+    stream->flush();
+
+    // 生产者忘了 close：报告出来，不静默丢数据
+    assert(!writer.close());
+
+    // 写盘线程已经停止，写满整个环也不会卡住，数据丢弃
+    string line(1000, 'x');
+    line.push_back('\n');
+    for (size_t i = 0; i < 2 * mysn::TraceStream::CHUNK_COUNT * mysn::TraceStream::CHUNK_SIZE / line.size(); ++i)
+    {
+        stream->write(line.c_str(), line.size());
+    }
+    assert(stream->lost());
+    stream->close();
+
+    // close 之前发布的块已经写出
+    vector<string> lines = read_lines(path);
+    assert(!lines.empty() && lines[0] == "first\n");
+    remove(path);
+}
+
+int main()
+{
+    test_nestest_format();
+    test_addressing_mode_annotations();
+    test_traced_run();
+    test_multiple_streams_and_compression();
+    test_writer_closed_before_stream();
+}